@@ -0,0 +1,14 @@
+#ifndef _CHANGECONFIGURATIONREQJSON_H_
+#define _CHANGECONFIGURATIONREQJSON_H_
+
+#include <cJSON.h>
+
+struct ChangeConfigurationReq {
+    char * key;
+    char * value;
+};
+
+struct ChangeConfigurationReq * cJSON_ParseChangeConfigurationReq(const char * s);
+char * cJSON_PrintChangeConfigurationReq(const struct ChangeConfigurationReq * x);
+
+#endif
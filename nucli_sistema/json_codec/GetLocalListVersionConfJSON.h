@@ -0,0 +1,14 @@
+#ifndef _GETLOCALLISTVERSIONCONFJSON_H_
+#define _GETLOCALLISTVERSIONCONFJSON_H_
+
+#include <cJSON.h>
+#include <stdint.h>
+
+struct GetLocalListVersionConf {
+    int64_t list_version;
+};
+
+struct GetLocalListVersionConf * cJSON_ParseGetLocalListVersionConf(const char * s);
+char * cJSON_PrintGetLocalListVersionConf(const struct GetLocalListVersionConf * x);
+
+#endif
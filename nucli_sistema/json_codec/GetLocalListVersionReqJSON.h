@@ -0,0 +1,12 @@
+#ifndef _GETLOCALLISTVERSIONREQJSON_H_
+#define _GETLOCALLISTVERSIONREQJSON_H_
+
+#include <cJSON.h>
+
+struct GetLocalListVersionReq {
+};
+
+struct GetLocalListVersionReq * cJSON_ParseGetLocalListVersionReq(const char * s);
+char * cJSON_PrintGetLocalListVersionReq(const struct GetLocalListVersionReq * x);
+
+#endif
@@ -0,0 +1,135 @@
+/**
+ * stdout
+ * This file has been autogenerated using quicktype https://github.com/quicktype/quicktype - DO NOT EDIT
+ * This file depends of https://github.com/DaveGamble/cJSON, https://github.com/joelguittet/c-list and https://github.com/joelguittet/c-hashtable
+ * To parse json data from json string use the following: struct <type> * data = cJSON_Parse<type>(<string>);
+ * To get json data from cJSON object use the following: struct <type> * data = cJSON_Get<type>Value(<cjson>);
+ * To get cJSON object from json data use the following: cJSON * cjson = cJSON_Create<type>(<data>);
+ * To print json string from json data use the following: char * string = cJSON_Print<type>(<data>);
+ * To delete json data use the following: cJSON_Delete<type>(<data>);
+ */
+
+#ifndef __STDOUT__
+#define __STDOUT__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cJSON.h>
+#include <hashtable.h>
+#include <list.h>
+#include "SendLocalListConfJSON.h"
+#include "mystrdup.h"
+
+#ifndef cJSON_Bool
+#define cJSON_Bool (cJSON_True | cJSON_False)
+#endif
+#ifndef cJSON_Map
+#define cJSON_Map (1 << 16)
+#endif
+#ifndef cJSON_Enum
+#define cJSON_Enum (1 << 17)
+#endif
+
+static enum Status_SendLocalList cJSON_GetStatusValue(const cJSON * j);
+static cJSON * cJSON_CreateStatus(const enum Status_SendLocalList x);
+
+static struct SendLocalListConf * cJSON_GetSendLocalListConfValue(const cJSON * j);
+static cJSON * cJSON_CreateSendLocalListConf(const struct SendLocalListConf * x);
+static void cJSON_DeleteSendLocalListConf(struct SendLocalListConf * x);
+
+// Modificació: afegeixo l'else de x = -1 i x = -2 i if (cJSON_GetStringValue(j) != NULL) {
+static enum Status_SendLocalList cJSON_GetStatusValue(const cJSON * j) {
+    enum Status_SendLocalList x = 0;
+    if (NULL != j) {
+        if (cJSON_GetStringValue(j) != NULL) {
+            if (!strcmp(cJSON_GetStringValue(j), "Accepted")) x = STATUS_SEND_LOCAL_LIST_ACCEPTED;
+            else if (!strcmp(cJSON_GetStringValue(j), "Failed")) x = STATUS_SEND_LOCAL_LIST_FAILED;
+            else if (!strcmp(cJSON_GetStringValue(j), "NotSupported")) x = STATUS_SEND_LOCAL_LIST_NOT_SUPPORTED;
+            else if (!strcmp(cJSON_GetStringValue(j), "VersionMismatch")) x = STATUS_SEND_LOCAL_LIST_VERSION_MISMATCH;
+            else
+                x = -1;
+        }
+        else
+            x = -2;
+    }
+    return x;
+}
+
+static cJSON * cJSON_CreateStatus(const enum Status_SendLocalList x) {
+    cJSON * j = NULL;
+    switch (x) {
+        case STATUS_SEND_LOCAL_LIST_ACCEPTED: j = cJSON_CreateString("Accepted"); break;
+        case STATUS_SEND_LOCAL_LIST_FAILED: j = cJSON_CreateString("Failed"); break;
+        case STATUS_SEND_LOCAL_LIST_NOT_SUPPORTED: j = cJSON_CreateString("NotSupported"); break;
+        case STATUS_SEND_LOCAL_LIST_VERSION_MISMATCH: j = cJSON_CreateString("VersionMismatch"); break;
+    }
+    return j;
+}
+
+struct SendLocalListConf * cJSON_ParseSendLocalListConf(const char * s) {
+    struct SendLocalListConf * x = NULL;
+    if (NULL != s) {
+        cJSON * j = cJSON_Parse(s);
+        if (NULL != j) {
+            x = cJSON_GetSendLocalListConfValue(j);
+            cJSON_Delete(j);
+        }
+    }
+    return x;
+}
+
+// Modificació: afegeixo else x->status = -1;
+static struct SendLocalListConf * cJSON_GetSendLocalListConfValue(const cJSON * j) {
+    struct SendLocalListConf * x = NULL;
+    if (NULL != j) {
+        if (NULL != (x = cJSON_malloc(sizeof(struct SendLocalListConf)))) {
+            memset(x, 0, sizeof(struct SendLocalListConf));
+            if (cJSON_HasObjectItem(j, "status")) {
+                x->status = cJSON_GetStatusValue(cJSON_GetObjectItemCaseSensitive(j, "status"));
+            }
+            else
+                x->status = -1;
+        }
+    }
+    return x;
+}
+
+static cJSON * cJSON_CreateSendLocalListConf(const struct SendLocalListConf * x) {
+    cJSON * j = NULL;
+    if (NULL != x) {
+        if (NULL != (j = cJSON_CreateObject())) {
+            cJSON_AddItemToObject(j, "status", cJSON_CreateStatus(x->status));
+        }
+    }
+    return j;
+}
+
+char * cJSON_PrintSendLocalListConf(const struct SendLocalListConf * x) {
+    char * s = NULL;
+    if (NULL != x) {
+        cJSON * j = cJSON_CreateSendLocalListConf(x);
+        if (NULL != j) {
+            s = cJSON_Print(j);
+            cJSON_Delete(j);
+        }
+    }
+    return s;
+}
+
+static void cJSON_DeleteSendLocalListConf(struct SendLocalListConf * x) {
+    if (NULL != x) {
+        cJSON_free(x);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STDOUT__ */
@@ -0,0 +1,20 @@
+#ifndef _SENDLOCALLISTCONFJSON_H_
+#define _SENDLOCALLISTCONFJSON_H_
+
+#include <cJSON.h>
+
+enum Status_SendLocalList {
+    STATUS_SEND_LOCAL_LIST_ACCEPTED,
+    STATUS_SEND_LOCAL_LIST_FAILED,
+    STATUS_SEND_LOCAL_LIST_NOT_SUPPORTED,
+    STATUS_SEND_LOCAL_LIST_VERSION_MISMATCH,
+};
+
+struct SendLocalListConf {
+    enum Status_SendLocalList status;
+};
+
+struct SendLocalListConf * cJSON_ParseSendLocalListConf(const char * s);
+char * cJSON_PrintSendLocalListConf(const struct SendLocalListConf * x);
+
+#endif
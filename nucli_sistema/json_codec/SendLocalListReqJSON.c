@@ -0,0 +1,332 @@
+/**
+ * stdout
+ * This file has been autogenerated using quicktype https://github.com/quicktype/quicktype - DO NOT EDIT
+ * This file depends of https://github.com/DaveGamble/cJSON, https://github.com/joelguittet/c-list and https://github.com/joelguittet/c-hashtable
+ * To parse json data from json string use the following: struct <type> * data = cJSON_Parse<type>(<string>);
+ * To get json data from cJSON object use the following: struct <type> * data = cJSON_Get<type>Value(<cjson>);
+ * To get cJSON object from json data use the following: cJSON * cjson = cJSON_Create<type>(<data>);
+ * To print json string from json data use the following: char * string = cJSON_Print<type>(<data>);
+ * To delete json data use the following: cJSON_Delete<type>(<data>);
+ */
+
+#ifndef __STDOUT__
+#define __STDOUT__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cJSON.h>
+#include <hashtable.h>
+#include <list.h>
+#include "SendLocalListReqJSON.h"
+#include "mystrdup.h"
+
+#ifndef cJSON_Bool
+#define cJSON_Bool (cJSON_True | cJSON_False)
+#endif
+#ifndef cJSON_Map
+#define cJSON_Map (1 << 16)
+#endif
+#ifndef cJSON_Enum
+#define cJSON_Enum (1 << 17)
+#endif
+
+static enum Status_LocalList cJSON_GetStatusValue(const cJSON * j);
+static cJSON * cJSON_CreateStatus(const enum Status_LocalList x);
+
+static enum UpdateType cJSON_GetUpdateTypeValue(const cJSON * j);
+static cJSON * cJSON_CreateUpdateType(const enum UpdateType x);
+
+static struct IdTagInfo_LocalList * cJSON_GetIdTagInfoValue(const cJSON * j);
+static cJSON * cJSON_CreateIdTagInfo(const struct IdTagInfo_LocalList * x);
+static void cJSON_DeleteIdTagInfo(struct IdTagInfo_LocalList * x);
+
+static struct AuthorizationData * cJSON_GetAuthorizationDataValue(const cJSON * j);
+static cJSON * cJSON_CreateAuthorizationData(const struct AuthorizationData * x);
+static void cJSON_DeleteAuthorizationData(struct AuthorizationData * x);
+
+static struct SendLocalListReq * cJSON_GetSendLocalListReqValue(const cJSON * j);
+static cJSON * cJSON_CreateSendLocalListReq(const struct SendLocalListReq * x);
+static void cJSON_DeleteSendLocalListReq(struct SendLocalListReq * x);
+
+// Modificació: afegeixo l'else de x = -1 i x = -2 i if (cJSON_GetStringValue(j) != NULL) {
+static enum Status_LocalList cJSON_GetStatusValue(const cJSON * j) {
+    enum Status_LocalList x = 0;
+    if (NULL != j) {
+        if (cJSON_GetStringValue(j) != NULL) {
+            if (!strcmp(cJSON_GetStringValue(j), "Accepted")) x = STATUS_LOCAL_LIST_ACCEPTED;
+            else if (!strcmp(cJSON_GetStringValue(j), "Blocked")) x = STATUS_LOCAL_LIST_BLOCKED;
+            else if (!strcmp(cJSON_GetStringValue(j), "ConcurrentTx")) x = STATUS_LOCAL_LIST_CONCURRENT_TX;
+            else if (!strcmp(cJSON_GetStringValue(j), "Expired")) x = STATUS_LOCAL_LIST_EXPIRED;
+            else if (!strcmp(cJSON_GetStringValue(j), "Invalid")) x = STATUS_LOCAL_LIST_INVALID;
+            else
+                x = -1;
+        }
+        else
+            x = -2;
+    }
+    return x;
+}
+
+static cJSON * cJSON_CreateStatus(const enum Status_LocalList x) {
+    cJSON * j = NULL;
+    switch (x) {
+        case STATUS_LOCAL_LIST_ACCEPTED: j = cJSON_CreateString("Accepted"); break;
+        case STATUS_LOCAL_LIST_BLOCKED: j = cJSON_CreateString("Blocked"); break;
+        case STATUS_LOCAL_LIST_CONCURRENT_TX: j = cJSON_CreateString("ConcurrentTx"); break;
+        case STATUS_LOCAL_LIST_EXPIRED: j = cJSON_CreateString("Expired"); break;
+        case STATUS_LOCAL_LIST_INVALID: j = cJSON_CreateString("Invalid"); break;
+    }
+    return j;
+}
+
+// Modificació: afegeixo l'else de x = -1 i x = -2 i if (cJSON_GetStringValue(j) != NULL) {
+static enum UpdateType cJSON_GetUpdateTypeValue(const cJSON * j) {
+    enum UpdateType x = 0;
+    if (NULL != j) {
+        if (cJSON_GetStringValue(j) != NULL) {
+            if (!strcmp(cJSON_GetStringValue(j), "Differential")) x = UPDATETYPE_DIFFERENTIAL;
+            else if (!strcmp(cJSON_GetStringValue(j), "Full")) x = UPDATETYPE_FULL;
+            else
+                x = -1;
+        }
+        else
+            x = -2;
+    }
+    return x;
+}
+
+static cJSON * cJSON_CreateUpdateType(const enum UpdateType x) {
+    cJSON * j = NULL;
+    switch (x) {
+        case UPDATETYPE_DIFFERENTIAL: j = cJSON_CreateString("Differential"); break;
+        case UPDATETYPE_FULL: j = cJSON_CreateString("Full"); break;
+    }
+    return j;
+}
+
+static struct IdTagInfo_LocalList * cJSON_GetIdTagInfoValue(const cJSON * j) {
+    struct IdTagInfo_LocalList * x = NULL;
+    if (NULL != j) {
+        if (NULL != (x = cJSON_malloc(sizeof(struct IdTagInfo_LocalList)))) {
+            memset(x, 0, sizeof(struct IdTagInfo_LocalList));
+            if (cJSON_HasObjectItem(j, "expiryDate")) {
+                x->expiry_date = mystrdup(cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(j, "expiryDate")));
+            }
+            if (cJSON_HasObjectItem(j, "parentIdTag")) {
+                x->parent_id_tag = mystrdup(cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(j, "parentIdTag")));
+            }
+            if (cJSON_HasObjectItem(j, "status")) {
+                x->status = cJSON_GetStatusValue(cJSON_GetObjectItemCaseSensitive(j, "status"));
+            }
+            else
+                x->status = -1;
+        }
+    }
+    return x;
+}
+
+static cJSON * cJSON_CreateIdTagInfo(const struct IdTagInfo_LocalList * x) {
+    cJSON * j = NULL;
+    if (NULL != x) {
+        if (NULL != (j = cJSON_CreateObject())) {
+            if (NULL != x->expiry_date) {
+                cJSON_AddStringToObject(j, "expiryDate", x->expiry_date);
+            }
+            if (NULL != x->parent_id_tag) {
+                cJSON_AddStringToObject(j, "parentIdTag", x->parent_id_tag);
+            }
+            cJSON_AddItemToObject(j, "status", cJSON_CreateStatus(x->status));
+        }
+    }
+    return j;
+}
+
+static void cJSON_DeleteIdTagInfo(struct IdTagInfo_LocalList * x) {
+    if (NULL != x) {
+        if (NULL != x->expiry_date) {
+            cJSON_free(x->expiry_date);
+        }
+        if (NULL != x->parent_id_tag) {
+            cJSON_free(x->parent_id_tag);
+        }
+        cJSON_free(x);
+    }
+}
+
+struct AuthorizationData * cJSON_ParseAuthorizationData(const char * s) {
+    struct AuthorizationData * x = NULL;
+    if (NULL != s) {
+        cJSON * j = cJSON_Parse(s);
+        if (NULL != j) {
+            x = cJSON_GetAuthorizationDataValue(j);
+            cJSON_Delete(j);
+        }
+    }
+    return x;
+}
+
+static struct AuthorizationData * cJSON_GetAuthorizationDataValue(const cJSON * j) {
+    struct AuthorizationData * x = NULL;
+    if (NULL != j) {
+        if (NULL != (x = cJSON_malloc(sizeof(struct AuthorizationData)))) {
+            memset(x, 0, sizeof(struct AuthorizationData));
+            if (cJSON_HasObjectItem(j, "idTag")) {
+                x->id_tag = mystrdup(cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(j, "idTag")));
+            }
+            else {
+                if (NULL != (x->id_tag = cJSON_malloc(sizeof(char)))) {
+                    x->id_tag[0] = '\0';
+                }
+            }
+            if (cJSON_HasObjectItem(j, "idTagInfo")) {
+                x->id_tag_info = cJSON_GetIdTagInfoValue(cJSON_GetObjectItemCaseSensitive(j, "idTagInfo"));
+            }
+        }
+    }
+    return x;
+}
+
+static cJSON * cJSON_CreateAuthorizationData(const struct AuthorizationData * x) {
+    cJSON * j = NULL;
+    if (NULL != x) {
+        if (NULL != (j = cJSON_CreateObject())) {
+            if (NULL != x->id_tag) {
+                cJSON_AddStringToObject(j, "idTag", x->id_tag);
+            }
+            else {
+                cJSON_AddStringToObject(j, "idTag", "");
+            }
+            if (NULL != x->id_tag_info) {
+                cJSON_AddItemToObject(j, "idTagInfo", cJSON_CreateIdTagInfo(x->id_tag_info));
+            }
+        }
+    }
+    return j;
+}
+
+char * cJSON_PrintAuthorizationData(const struct AuthorizationData * x) {
+    char * s = NULL;
+    if (NULL != x) {
+        cJSON * j = cJSON_CreateAuthorizationData(x);
+        if (NULL != j) {
+            s = cJSON_Print(j);
+            cJSON_Delete(j);
+        }
+    }
+    return s;
+}
+
+static void cJSON_DeleteAuthorizationData(struct AuthorizationData * x) {
+    if (NULL != x) {
+        if (NULL != x->id_tag) {
+            cJSON_free(x->id_tag);
+        }
+        if (NULL != x->id_tag_info) {
+            cJSON_DeleteIdTagInfo(x->id_tag_info);
+        }
+        cJSON_free(x);
+    }
+}
+
+struct SendLocalListReq * cJSON_ParseSendLocalListReq(const char * s) {
+    struct SendLocalListReq * x = NULL;
+    if (NULL != s) {
+        cJSON * j = cJSON_Parse(s);
+        if (NULL != j) {
+            x = cJSON_GetSendLocalListReqValue(j);
+            cJSON_Delete(j);
+        }
+    }
+    return x;
+}
+
+// Modificació: afegeixo else x->list_version = -1 i else x->update_type = -1;
+static struct SendLocalListReq * cJSON_GetSendLocalListReqValue(const cJSON * j) {
+    struct SendLocalListReq * x = NULL;
+    if (NULL != j) {
+        if (NULL != (x = cJSON_malloc(sizeof(struct SendLocalListReq)))) {
+            memset(x, 0, sizeof(struct SendLocalListReq));
+            if (cJSON_HasObjectItem(j, "localAuthorizationList")) {
+                list_t * x1 = list_create(false, NULL);
+                if (NULL != x1) {
+                    cJSON * e1 = NULL;
+                    cJSON * j1 = cJSON_GetObjectItemCaseSensitive(j, "localAuthorizationList");
+                    cJSON_ArrayForEach(e1, j1) {
+                        list_add_tail(x1, cJSON_GetAuthorizationDataValue(e1), sizeof(struct AuthorizationData *));
+                    }
+                    x->local_authorization_list = x1;
+                }
+            }
+            if (cJSON_HasObjectItem(j, "listVersion")) {
+                x->list_version = cJSON_GetNumberValue(cJSON_GetObjectItemCaseSensitive(j, "listVersion"));
+            }
+            else
+                x->list_version = -1;
+            if (cJSON_HasObjectItem(j, "updateType")) {
+                x->update_type = cJSON_GetUpdateTypeValue(cJSON_GetObjectItemCaseSensitive(j, "updateType"));
+            }
+            else
+                x->update_type = -1;
+        }
+    }
+    return x;
+}
+
+static cJSON * cJSON_CreateSendLocalListReq(const struct SendLocalListReq * x) {
+    cJSON * j = NULL;
+    if (NULL != x) {
+        if (NULL != (j = cJSON_CreateObject())) {
+            if (NULL != x->local_authorization_list) {
+                cJSON * j1 = cJSON_AddArrayToObject(j, "localAuthorizationList");
+                if (NULL != j1) {
+                    struct AuthorizationData * x1 = list_get_head(x->local_authorization_list);
+                    while (NULL != x1) {
+                        cJSON_AddItemToArray(j1, cJSON_CreateAuthorizationData(x1));
+                        x1 = list_get_next(x->local_authorization_list);
+                    }
+                }
+            }
+            cJSON_AddNumberToObject(j, "listVersion", x->list_version);
+            cJSON_AddItemToObject(j, "updateType", cJSON_CreateUpdateType(x->update_type));
+        }
+    }
+    return j;
+}
+
+char * cJSON_PrintSendLocalListReq(const struct SendLocalListReq * x) {
+    char * s = NULL;
+    if (NULL != x) {
+        cJSON * j = cJSON_CreateSendLocalListReq(x);
+        if (NULL != j) {
+            s = cJSON_Print(j);
+            cJSON_Delete(j);
+        }
+    }
+    return s;
+}
+
+static void cJSON_DeleteSendLocalListReq(struct SendLocalListReq * x) {
+    if (NULL != x) {
+        if (NULL != x->local_authorization_list) {
+            struct AuthorizationData * x1 = list_get_head(x->local_authorization_list);
+            while (NULL != x1) {
+                cJSON_DeleteAuthorizationData(x1);
+                x1 = list_get_next(x->local_authorization_list);
+            }
+            list_release(x->local_authorization_list);
+        }
+        cJSON_free(x);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STDOUT__ */
@@ -0,0 +1,43 @@
+#ifndef _SENDLOCALLISTREQJSON_H_
+#define _SENDLOCALLISTREQJSON_H_
+
+#include <cJSON.h>
+#include <list.h>
+#include <stdint.h>
+
+enum Status_LocalList {
+    STATUS_LOCAL_LIST_ACCEPTED,
+    STATUS_LOCAL_LIST_BLOCKED,
+    STATUS_LOCAL_LIST_CONCURRENT_TX,
+    STATUS_LOCAL_LIST_EXPIRED,
+    STATUS_LOCAL_LIST_INVALID,
+};
+
+enum UpdateType {
+    UPDATETYPE_DIFFERENTIAL,
+    UPDATETYPE_FULL,
+};
+
+struct IdTagInfo_LocalList {
+    char * expiry_date;
+    char * parent_id_tag;
+    enum Status_LocalList status;
+};
+
+struct AuthorizationData {
+    char * id_tag;
+    struct IdTagInfo_LocalList * id_tag_info;
+};
+
+struct SendLocalListReq {
+    list_t * local_authorization_list;
+    int64_t list_version;
+    enum UpdateType update_type;
+};
+
+struct AuthorizationData * cJSON_ParseAuthorizationData(const char * s);
+char * cJSON_PrintAuthorizationData(const struct AuthorizationData * x);
+struct SendLocalListReq * cJSON_ParseSendLocalListReq(const char * s);
+char * cJSON_PrintSendLocalListReq(const struct SendLocalListReq * x);
+
+#endif
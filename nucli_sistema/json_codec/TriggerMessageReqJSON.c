@@ -0,0 +1,149 @@
+/**
+ * stdout
+ * This file has been autogenerated using quicktype https://github.com/quicktype/quicktype - DO NOT EDIT
+ * This file depends of https://github.com/DaveGamble/cJSON, https://github.com/joelguittet/c-list and https://github.com/joelguittet/c-hashtable
+ * To parse json data from json string use the following: struct <type> * data = cJSON_Parse<type>(<string>);
+ * To get json data from cJSON object use the following: struct <type> * data = cJSON_Get<type>Value(<cjson>);
+ * To get cJSON object from json data use the following: cJSON * cjson = cJSON_Create<type>(<data>);
+ * To print json string from json data use the following: char * string = cJSON_Print<type>(<data>);
+ * To delete json data use the following: cJSON_Delete<type>(<data>);
+ */
+
+#ifndef __STDOUT__
+#define __STDOUT__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cJSON.h>
+#include <hashtable.h>
+#include "TriggerMessageReqJSON.h"
+#include "mystrdup.h"
+
+#ifndef cJSON_Bool
+#define cJSON_Bool (cJSON_True | cJSON_False)
+#endif
+#ifndef cJSON_Map
+#define cJSON_Map (1 << 16)
+#endif
+#ifndef cJSON_Enum
+#define cJSON_Enum (1 << 17)
+#endif
+
+static enum RequestedMessage cJSON_GetRequestedMessageValue(const cJSON * j);
+static cJSON * cJSON_CreateRequestedMessage(const enum RequestedMessage x);
+
+static struct TriggerMessageReq * cJSON_GetTriggerMessageReqValue(const cJSON * j);
+static cJSON * cJSON_CreateTriggerMessageReq(const struct TriggerMessageReq * x);
+static void cJSON_DeleteTriggerMessageReq(struct TriggerMessageReq * x);
+
+// Modificació: afegeixo l'else de x = -1 i x = -2 i if (cJSON_GetStringValue(j) != NULL) {
+static enum RequestedMessage cJSON_GetRequestedMessageValue(const cJSON * j) {
+    enum RequestedMessage x = 0;
+    if (NULL != j) {
+        if (cJSON_GetStringValue(j) != NULL) {
+            if (!strcmp(cJSON_GetStringValue(j), "BootNotification")) x = REQUESTEDMESSAGE_BOOT_NOTIFICATION;
+            else if (!strcmp(cJSON_GetStringValue(j), "DiagnosticsStatusNotification")) x = REQUESTEDMESSAGE_DIAGNOSTICS_STATUS_NOTIFICATION;
+            else if (!strcmp(cJSON_GetStringValue(j), "FirmwareStatusNotification")) x = REQUESTEDMESSAGE_FIRMWARE_STATUS_NOTIFICATION;
+            else if (!strcmp(cJSON_GetStringValue(j), "Heartbeat")) x = REQUESTEDMESSAGE_HEARTBEAT;
+            else if (!strcmp(cJSON_GetStringValue(j), "MeterValues")) x = REQUESTEDMESSAGE_METER_VALUES;
+            else if (!strcmp(cJSON_GetStringValue(j), "StatusNotification")) x = REQUESTEDMESSAGE_STATUS_NOTIFICATION;
+            else
+                x = -1;
+        }
+        else
+            x = -2;
+    }
+    return x;
+}
+
+static cJSON * cJSON_CreateRequestedMessage(const enum RequestedMessage x) {
+    cJSON * j = NULL;
+    switch (x) {
+        case REQUESTEDMESSAGE_BOOT_NOTIFICATION: j = cJSON_CreateString("BootNotification"); break;
+        case REQUESTEDMESSAGE_DIAGNOSTICS_STATUS_NOTIFICATION: j = cJSON_CreateString("DiagnosticsStatusNotification"); break;
+        case REQUESTEDMESSAGE_FIRMWARE_STATUS_NOTIFICATION: j = cJSON_CreateString("FirmwareStatusNotification"); break;
+        case REQUESTEDMESSAGE_HEARTBEAT: j = cJSON_CreateString("Heartbeat"); break;
+        case REQUESTEDMESSAGE_METER_VALUES: j = cJSON_CreateString("MeterValues"); break;
+        case REQUESTEDMESSAGE_STATUS_NOTIFICATION: j = cJSON_CreateString("StatusNotification"); break;
+    }
+    return j;
+}
+
+struct TriggerMessageReq * cJSON_ParseTriggerMessageReq(const char * s) {
+    struct TriggerMessageReq * x = NULL;
+    if (NULL != s) {
+        cJSON * j = cJSON_Parse(s);
+        if (NULL != j) {
+            x = cJSON_GetTriggerMessageReqValue(j);
+            cJSON_Delete(j);
+        }
+    }
+    return x;
+}
+
+// Modificació: x->requested_message = -1
+static struct TriggerMessageReq * cJSON_GetTriggerMessageReqValue(const cJSON * j) {
+    struct TriggerMessageReq * x = NULL;
+    if (NULL != j) {
+        if (NULL != (x = cJSON_malloc(sizeof(struct TriggerMessageReq)))) {
+            memset(x, 0, sizeof(struct TriggerMessageReq));
+            if (cJSON_HasObjectItem(j, "connectorId")) {
+                if (NULL != (x->connector_id = cJSON_malloc(sizeof(int64_t)))) {
+                    *x->connector_id = cJSON_GetNumberValue(cJSON_GetObjectItemCaseSensitive(j, "connectorId"));
+                }
+            }
+            if (cJSON_HasObjectItem(j, "requestedMessage")) {
+                x->requested_message = cJSON_GetRequestedMessageValue(cJSON_GetObjectItemCaseSensitive(j, "requestedMessage"));
+            }
+            else
+                x->requested_message = -1;
+        }
+    }
+    return x;
+}
+
+static cJSON * cJSON_CreateTriggerMessageReq(const struct TriggerMessageReq * x) {
+    cJSON * j = NULL;
+    if (NULL != x) {
+        if (NULL != (j = cJSON_CreateObject())) {
+            if (NULL != x->connector_id) {
+                cJSON_AddNumberToObject(j, "connectorId", *x->connector_id);
+            }
+            cJSON_AddItemToObject(j, "requestedMessage", cJSON_CreateRequestedMessage(x->requested_message));
+        }
+    }
+    return j;
+}
+
+char * cJSON_PrintTriggerMessageReq(const struct TriggerMessageReq * x) {
+    char * s = NULL;
+    if (NULL != x) {
+        cJSON * j = cJSON_CreateTriggerMessageReq(x);
+        if (NULL != j) {
+            s = cJSON_Print(j);
+            cJSON_Delete(j);
+        }
+    }
+    return s;
+}
+
+static void cJSON_DeleteTriggerMessageReq(struct TriggerMessageReq * x) {
+    if (NULL != x) {
+        if (NULL != x->connector_id) {
+            cJSON_free(x->connector_id);
+        }
+        cJSON_free(x);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STDOUT__ */
@@ -0,0 +1,481 @@
+/*
+ *  FILE
+ *      auth_store.c - magatzem central d'idTags
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Magatzem central d'idTags versionat. Cada modificació incrementa la versió de la llista i
+ *      es guarda a l'entrada modificada, de manera que es pot generar una actualització diferencial
+ *      (SendLocalList Differential) amb només les entrades canviades des de la versió que té cada
+ *      carregador. Els idTags esborrats es recorden fins a AUTH_STORE_MAX_DELETED; quan es descarten,
+ *      els carregadors amb una versió anterior reben la llista completa (Full).
+ *      La versió es guarda a la base de dades (taula auth_list_version) i en reiniciar es continua a
+ *      partir de la guardada. Com que el contingut del magatzem no es guarda, els carregadors que tenen
+ *      una versió d'abans del reinici reben la llista completa en lloc d'un diferencial incorrecte.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <strings.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <list.h>
+#include <sqlite3.h>
+#include "ocpp_cs.h"
+#include "ws_server.h"
+#include "auth_store.h"
+
+#define EXPIRY_DATE_LEN 32
+
+// entrada del magatzem
+struct auth_entry {
+    char id_tag[ID_TAG_LEN + 1];
+    char parent_id_tag[ID_TAG_LEN + 1];
+    char expiry_date[EXPIRY_DATE_LEN];
+    enum Status_LocalList status;
+    int64_t version;                    // versió de la llista en què es va modificar l'entrada
+    bool deleted;                       // l'idTag s'ha esborrat a la versió indicada
+};
+
+static struct auth_entry entries[AUTH_STORE_MAX_ENTRIES];
+static int num_entries = 0;
+static int num_deleted = 0;
+static int64_t list_version = 0;        // versió actual de la llista
+static int64_t min_diff_version = 0;    // versió mínima a partir de la qual es pot enviar un diferencial
+static pthread_mutex_t store_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Prototips de les funcions
+static struct auth_entry *find_entry(const char *id_tag);
+static void compact_deleted(void);
+static int read_version(void *arg, int argc, char **argv, char **col_names);
+static void persist_version(int64_t version);
+
+/*
+ *  NAME
+ *      auth_store_init - Inicialitza el magatzem d'idTags
+ *  SYNOPSIS
+ *      void auth_store_init(void);
+ *  DESCRIPTION
+ *      Crea la taula auth_list_version si no existeix i carrega els idTags de la auth_list al magatzem
+ *      amb estat Accepted, com a la versió següent a l'última guardada. Els diferencials només es poden
+ *      calcular a partir d'aquesta versió.
+ *  RETURN VALUE
+ *      Res.
+ */
+void auth_store_init(void)
+{
+    sqlite3 *db;
+    int rc;
+    char *errmsg;
+    int64_t saved_version = 0;
+
+    rc = sqlite3_open(DATABASE_PATH, &db);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: ERROR opening SQLite DB: %s\n", __func__, sqlite3_errmsg(db));
+    }
+    else {
+        rc = sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS auth_list_version (id INTEGER PRIMARY KEY CHECK (id = 0), "
+            "version INTEGER NOT NULL);"
+            "SELECT version FROM auth_list_version WHERE id = 0;", read_version, &saved_version, &errmsg);
+        if (rc != SQLITE_OK) {
+            syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+            sqlite3_free(errmsg);
+        }
+    }
+    sqlite3_close(db); // tanca la base de dades correctament
+
+    if (saved_version < 0)
+        saved_version = 0;
+
+    pthread_mutex_lock(&store_lock);
+
+    num_entries = 0;
+    num_deleted = 0;
+    list_version = saved_version + 1;
+    min_diff_version = list_version; // les versions d'abans del reinici reben la llista completa
+
+    for (size_t i = 0; i < auth_list_len && num_entries < AUTH_STORE_MAX_ENTRIES; i++) {
+        struct auth_entry *entry = &entries[num_entries++];
+        memset(entry, 0, sizeof(struct auth_entry));
+        snprintf(entry->id_tag, sizeof(entry->id_tag), "%s", auth_list[i]);
+        entry->status = STATUS_LOCAL_LIST_ACCEPTED;
+        entry->version = list_version;
+    }
+
+    int64_t version = list_version;
+    pthread_mutex_unlock(&store_lock);
+
+    persist_version(version);
+    syslog(LOG_INFO, "%s: versió de la llista d'idTags %ld", __func__, version);
+}
+
+/*
+ *  NAME
+ *      auth_store_check - Comprova si un idTag està autoritzat
+ *  SYNOPSIS
+ *      bool auth_store_check(const char *id_tag);
+ *  DESCRIPTION
+ *      Comprova si un idTag es troba al magatzem, no està esborrat i té l'estat Accepted.
+ *  RETURN VALUE
+ *      Retorna true si és vàlid.
+ *      Retorna false en cas contrari.
+ */
+bool auth_store_check(const char *id_tag)
+{
+    bool valid = false;
+
+    pthread_mutex_lock(&store_lock);
+    struct auth_entry *entry = find_entry(id_tag);
+    if (entry != NULL && !entry->deleted && entry->status == STATUS_LOCAL_LIST_ACCEPTED)
+        valid = true;
+    pthread_mutex_unlock(&store_lock);
+
+    return valid;
+}
+
+/*
+ *  NAME
+ *      auth_store_set - Afegeix o modifica un idTag
+ *  SYNOPSIS
+ *      int64_t auth_store_set(const char *id_tag, enum Status_LocalList status, const char *expiry_date, const char *parent_id_tag);
+ *  DESCRIPTION
+ *      Afegeix un idTag al magatzem o modifica'n l'estat, la data d'expiració i el parentIdTag.
+ *      expiry_date i parent_id_tag poden ser NULL. Si l'entrada no canvia no s'incrementa la versió.
+ *  RETURN VALUE
+ *      Retorna la versió de la llista resultant.
+ *      Retorna -1 si l'idTag no és vàlid o el magatzem està ple.
+ */
+int64_t auth_store_set(const char *id_tag, enum Status_LocalList status, const char *expiry_date, const char *parent_id_tag)
+{
+    int64_t version = -1;
+    bool changed = false;
+
+    if (id_tag == NULL || strlen(id_tag) == 0 || strlen(id_tag) > ID_TAG_LEN)
+        return -1;
+
+    if (expiry_date == NULL)
+        expiry_date = "";
+    if (parent_id_tag == NULL)
+        parent_id_tag = "";
+
+    pthread_mutex_lock(&store_lock);
+
+    struct auth_entry *entry = find_entry(id_tag);
+    if (entry != NULL && !entry->deleted && entry->status == status && strcmp(entry->expiry_date, expiry_date) == 0
+        && strcmp(entry->parent_id_tag, parent_id_tag) == 0) {
+        version = list_version;
+    }
+    else {
+        if (entry == NULL && num_entries == AUTH_STORE_MAX_ENTRIES)
+            compact_deleted();
+
+        if (entry == NULL && num_entries < AUTH_STORE_MAX_ENTRIES) {
+            entry = &entries[num_entries++];
+            memset(entry, 0, sizeof(struct auth_entry));
+            snprintf(entry->id_tag, sizeof(entry->id_tag), "%s", id_tag);
+        }
+
+        if (entry != NULL) {
+            if (entry->deleted)
+                num_deleted--;
+            entry->deleted = false;
+            entry->status = status;
+            snprintf(entry->expiry_date, sizeof(entry->expiry_date), "%s", expiry_date);
+            snprintf(entry->parent_id_tag, sizeof(entry->parent_id_tag), "%s", parent_id_tag);
+            entry->version = ++list_version;
+            version = list_version;
+            changed = true;
+        }
+        else
+            syslog(LOG_WARNING, "%s: magatzem d'idTags ple, no s'ha pogut afegir %s", __func__, id_tag);
+    }
+
+    pthread_mutex_unlock(&store_lock);
+
+    if (changed)
+        persist_version(version);
+
+    return version;
+}
+
+/*
+ *  NAME
+ *      auth_store_remove - Esborra un idTag
+ *  SYNOPSIS
+ *      int64_t auth_store_remove(const char *id_tag);
+ *  DESCRIPTION
+ *      Marca un idTag com a esborrat perquè s'enviï sense idTagInfo en la següent actualització diferencial.
+ *  RETURN VALUE
+ *      Retorna la versió de la llista resultant.
+ *      Retorna -1 si l'idTag no es troba al magatzem.
+ */
+int64_t auth_store_remove(const char *id_tag)
+{
+    int64_t version = -1;
+
+    pthread_mutex_lock(&store_lock);
+
+    struct auth_entry *entry = find_entry(id_tag);
+    if (entry != NULL && !entry->deleted) {
+        entry->deleted = true;
+        entry->version = ++list_version;
+        version = list_version;
+        if (++num_deleted > AUTH_STORE_MAX_DELETED)
+            compact_deleted();
+    }
+
+    pthread_mutex_unlock(&store_lock);
+
+    if (version != -1)
+        persist_version(version);
+
+    return version;
+}
+
+/*
+ *  NAME
+ *      auth_store_apply - Aplica una AuthorizationData al magatzem
+ *  SYNOPSIS
+ *      int64_t auth_store_apply(const char *payload);
+ *  DESCRIPTION
+ *      Parseja una AuthorizationData ({"idTag": ..., "idTagInfo": {...}}) i l'aplica al magatzem.
+ *      Igual que en una actualització diferencial, si no hi ha idTagInfo l'idTag s'esborra.
+ *  RETURN VALUE
+ *      Retorna la versió de la llista resultant.
+ *      Retorna -1 si el payload no és vàlid o no s'ha pogut aplicar.
+ */
+int64_t auth_store_apply(const char *payload)
+{
+    int64_t version = -1;
+
+    struct AuthorizationData *data = cJSON_ParseAuthorizationData(payload);
+    if (data == NULL || data->id_tag == NULL || strlen(data->id_tag) == 0) {
+        syslog(LOG_WARNING, "%s: AuthorizationData no vàlida", __func__);
+    }
+    else if (data->id_tag_info == NULL) {
+        version = auth_store_remove(data->id_tag);
+    }
+    else if ((int)data->id_tag_info->status < 0) {
+        syslog(LOG_WARNING, "%s: status no vàlid per l'idTag %s", __func__, data->id_tag);
+    }
+    else {
+        version = auth_store_set(data->id_tag, data->id_tag_info->status, data->id_tag_info->expiry_date,
+                                 data->id_tag_info->parent_id_tag);
+    }
+
+    if (data != NULL) {
+        if (data->id_tag_info != NULL) {
+            free(data->id_tag_info->expiry_date);
+            free(data->id_tag_info->parent_id_tag);
+            free(data->id_tag_info);
+        }
+        free(data->id_tag);
+        free(data);
+    }
+
+    return version;
+}
+
+/*
+ *  NAME
+ *      auth_store_version - Retorna la versió actual de la llista
+ *  SYNOPSIS
+ *      int64_t auth_store_version(void);
+ *  DESCRIPTION
+ *      Retorna la versió actual de la llista d'idTags.
+ *  RETURN VALUE
+ *      La versió actual de la llista.
+ */
+int64_t auth_store_version(void)
+{
+    pthread_mutex_lock(&store_lock);
+    int64_t version = list_version;
+    pthread_mutex_unlock(&store_lock);
+
+    return version;
+}
+
+/*
+ *  NAME
+ *      auth_store_build_update - Forma el payload d'un SendLocalList
+ *  SYNOPSIS
+ *      char *auth_store_build_update(int64_t from_version, bool force_full, int64_t *version);
+ *  DESCRIPTION
+ *      Forma el payload d'un SendLocalList per un carregador que té la versió from_version de la llista.
+ *      Si el carregador té una versió vàlida i prou recent s'envia un Differential amb només les entrades
+ *      modificades a partir d'aquesta versió (les esborrades sense idTagInfo). En cas contrari, o si
+ *      force_full és true, s'envia la llista completa (Full). A version es retorna la versió enviada.
+ *  RETURN VALUE
+ *      Retorna el payload, que s'ha d'alliberar amb free().
+ *      Retorna NULL si el carregador ja té la llista actualitzada o en cas d'error.
+ */
+char *auth_store_build_update(int64_t from_version, bool force_full, int64_t *version)
+{
+    char *payload = NULL;
+
+    pthread_mutex_lock(&store_lock);
+
+    bool full = force_full || from_version <= 0 || from_version < min_diff_version || from_version > list_version;
+
+    if (!full && from_version == list_version) {
+        pthread_mutex_unlock(&store_lock);
+        return NULL;
+    }
+
+    struct AuthorizationData *data = calloc(num_entries, sizeof(struct AuthorizationData));
+    struct IdTagInfo_LocalList *info = calloc(num_entries, sizeof(struct IdTagInfo_LocalList));
+    list_t *auth_data_list = list_create(false, NULL);
+
+    if ((data == NULL && num_entries > 0) || (info == NULL && num_entries > 0) || auth_data_list == NULL) {
+        syslog(LOG_ERR, "%s: no s'ha pogut reservar memòria", __func__);
+    }
+    else {
+        int n = 0;
+        for (int i = 0; i < num_entries; i++) {
+            struct auth_entry *entry = &entries[i];
+
+            if (full && entry->deleted)
+                continue;
+            if (!full && entry->version <= from_version)
+                continue;
+
+            data[n].id_tag = entry->id_tag;
+            if (!entry->deleted) {
+                info[n].status = entry->status;
+                info[n].expiry_date = (strlen(entry->expiry_date) > 0) ? entry->expiry_date : NULL;
+                info[n].parent_id_tag = (strlen(entry->parent_id_tag) > 0) ? entry->parent_id_tag : NULL;
+                data[n].id_tag_info = &info[n];
+            }
+            list_add_tail(auth_data_list, &data[n], sizeof(struct AuthorizationData *));
+            n++;
+        }
+
+        struct SendLocalListReq request = {
+            .local_authorization_list = auth_data_list,
+            .list_version = list_version,
+            .update_type = full ? UPDATETYPE_FULL : UPDATETYPE_DIFFERENTIAL
+        };
+        payload = cJSON_PrintSendLocalListReq(&request);
+        *version = list_version;
+    }
+
+    pthread_mutex_unlock(&store_lock);
+
+    if (auth_data_list != NULL)
+        list_release(auth_data_list);
+    free(info);
+    free(data);
+
+    return payload;
+}
+
+/*
+ *  NAME
+ *      find_entry - Busca un idTag al magatzem
+ *  SYNOPSIS
+ *      static struct auth_entry *find_entry(const char *id_tag);
+ *  DESCRIPTION
+ *      Busca un idTag al magatzem, incloent-hi els esborrats. S'ha de cridar amb store_lock agafat.
+ *  RETURN VALUE
+ *      Retorna l'entrada de l'idTag.
+ *      Retorna NULL si no es troba.
+ */
+static struct auth_entry *find_entry(const char *id_tag)
+{
+    if (id_tag == NULL)
+        return NULL;
+
+    for (int i = 0; i < num_entries; i++) {
+        if (strcasecmp(entries[i].id_tag, id_tag) == 0)
+            return &entries[i];
+    }
+
+    return NULL;
+}
+
+/*
+ *  NAME
+ *      compact_deleted - Descarta els idTags esborrats
+ *  SYNOPSIS
+ *      static void compact_deleted(void);
+ *  DESCRIPTION
+ *      Descarta els idTags esborrats del magatzem. Com que ja no es poden enviar en un diferencial,
+ *      els carregadors amb una versió anterior a l'actual hauran de rebre la llista completa.
+ *      S'ha de cridar amb store_lock agafat.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void compact_deleted(void)
+{
+    int n = 0;
+
+    for (int i = 0; i < num_entries; i++) {
+        if (!entries[i].deleted)
+            entries[n++] = entries[i];
+    }
+
+    if (n != num_entries)
+        min_diff_version = list_version;
+
+    num_entries = n;
+    num_deleted = 0;
+}
+
+/*
+ *  NAME
+ *      read_version - Callback per llegir la versió guardada
+ *  SYNOPSIS
+ *      static int read_version(void *arg, int argc, char **argv, char **col_names);
+ *  DESCRIPTION
+ *      Callback de sqlite3_exec() que guarda el valor de version a arg.
+ *  RETURN VALUE
+ *      0.
+ */
+static int read_version(void *arg, int argc, char **argv, char **col_names)
+{
+    if (argc > 0 && argv[0] != NULL)
+        *(int64_t *)arg = strtoll(argv[0], NULL, 10);
+
+    return 0;
+}
+
+/*
+ *  NAME
+ *      persist_version - Guarda la versió de la llista a la base de dades
+ *  SYNOPSIS
+ *      static void persist_version(int64_t version);
+ *  DESCRIPTION
+ *      Guarda a la taula auth_list_version la versió de la llista, si és més gran que la guardada
+ *      (dues modificacions concurrents es poden guardar en l'ordre contrari).
+ *  RETURN VALUE
+ *      Res.
+ */
+static void persist_version(int64_t version)
+{
+    sqlite3 *db;
+    int rc;
+    char *errmsg;
+
+    rc = sqlite3_open(DATABASE_PATH, &db);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: ERROR opening SQLite DB: %s\n", __func__, sqlite3_errmsg(db));
+    }
+    else {
+        char query[160];
+        snprintf(query, sizeof(query), "INSERT INTO auth_list_version(id, version) VALUES(0, %ld) "
+            "ON CONFLICT(id) DO UPDATE SET version = max(version, excluded.version);", version);
+        rc = sqlite3_exec(db, query, 0, 0, &errmsg);
+        if (rc != SQLITE_OK) {
+            syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+            sqlite3_free(errmsg);
+        }
+    }
+    sqlite3_close(db); // tanca la base de dades correctament
+}
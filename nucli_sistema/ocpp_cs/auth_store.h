@@ -0,0 +1,32 @@
+/*
+ *  FILE
+ *      auth_store.h - header d'auth_store.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header del magatzem central d'idTags versionat.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _AUTH_STORE_H_
+#define _AUTH_STORE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "SendLocalListReqJSON.h"
+
+#define AUTH_STORE_MAX_ENTRIES 256  // màxim d'idTags del magatzem central
+#define AUTH_STORE_MAX_DELETED 64   // màxim d'idTags esborrats que es recorden per fer actualitzacions diferencials
+
+void auth_store_init(void);
+bool auth_store_check(const char *id_tag);
+int64_t auth_store_set(const char *id_tag, enum Status_LocalList status, const char *expiry_date, const char *parent_id_tag);
+int64_t auth_store_remove(const char *id_tag);
+int64_t auth_store_apply(const char *payload);
+int64_t auth_store_version(void);
+char *auth_store_build_update(int64_t from_version, bool force_full, int64_t *version);
+
+#endif
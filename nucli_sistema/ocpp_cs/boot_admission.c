@@ -0,0 +1,133 @@
+/*
+ *  FILE
+ *      boot_admission.c - control d'admissió dels BootNotification
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Quan el sistema de control es reinicia, tots els carregadors es tornen a connectar i envien
+ *      el BootNotification alhora, i just després cadascun envia els seus StatusNotification i els
+ *      MeterValues que tenia guardats. Per repartir aquesta càrrega, els BootNotification s'accepten
+ *      amb una galleda de fitxes (BOOT_ADMISSION_RATE per segon, com a màxim BOOT_ADMISSION_BURST
+ *      seguits) i a la resta se'ls respon Pending amb un interval diferent per a cada carregador,
+ *      de manera que tornin a enviar el BootNotification un darrere l'altre.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <syslog.h>
+#include "ocpp_cs.h"
+#include "boot_admission.h"
+
+#define TOKEN_MS (1000 / BOOT_ADMISSION_RATE) // mil·lisegons que es triga a generar una fitxa
+
+static pthread_mutex_t admission_lock = PTHREAD_MUTEX_INITIALIZER;
+static int64_t tokens_ms = BOOT_ADMISSION_BURST * TOKEN_MS;    // fitxes disponibles, en mil·lisegons de generació
+static int64_t last_refill_ms = -1;                             // última vegada que s'han afegit fitxes
+static int64_t horizon_ms = 0;                                  // hora fins a la qual ja s'han repartit els reintents
+static uint32_t jitter_state = 0;                               // estat del generador de nombres aleatoris
+
+// Prototips de les funcions
+static int64_t now_ms(void);
+static uint32_t next_jitter(void);
+
+/*
+ *  NAME
+ *      boot_admission_take - Decideix si s'accepta un BootNotification
+ *  SYNOPSIS
+ *      bool boot_admission_take(int *retry_interval);
+ *  DESCRIPTION
+ *      Agafa una fitxa de la galleda si n'hi ha. Si no n'hi ha, reserva al carregador el següent
+ *      espai lliure després dels reintents ja repartits i guarda a retry_interval els segons que ha
+ *      d'esperar (amb una part aleatòria perquè no coincideixin), com a màxim RESEND_BOOT_NOTIFICATION_INTERVAL.
+ *  RETURN VALUE
+ *      Retorna true si el carregador es pot acceptar.
+ *      Retorna false si s'ha de respondre Pending.
+ */
+bool boot_admission_take(int *retry_interval)
+{
+    int64_t now = now_ms();
+    bool admitted;
+
+    pthread_mutex_lock(&admission_lock);
+
+    // afegeixo les fitxes generades des de l'última vegada
+    if (last_refill_ms >= 0) {
+        tokens_ms += now - last_refill_ms;
+        if (tokens_ms > BOOT_ADMISSION_BURST * TOKEN_MS)
+            tokens_ms = BOOT_ADMISSION_BURST * TOKEN_MS;
+    }
+    last_refill_ms = now;
+
+    admitted = tokens_ms >= TOKEN_MS;
+    if (admitted) {
+        tokens_ms -= TOKEN_MS;
+    }
+    else { // el carregador ha d'esperar al següent espai lliure
+        if (horizon_ms < now)
+            horizon_ms = now;
+        horizon_ms += TOKEN_MS;
+
+        int64_t wait = horizon_ms - now;
+        if (jitter_state == 0)
+            jitter_state = (uint32_t)now | 1;
+        wait += next_jitter() % (wait / 4 + 1); // fins a un 25% més perquè no tornin tots alhora
+
+        int interval = (int)((wait + 999) / 1000);
+        if (interval < 1)
+            interval = 1;
+        if (interval > RESEND_BOOT_NOTIFICATION_INTERVAL)
+            interval = RESEND_BOOT_NOTIFICATION_INTERVAL;
+        *retry_interval = interval;
+    }
+
+    pthread_mutex_unlock(&admission_lock);
+
+    if (!admitted)
+        syslog(LOG_NOTICE, "%s: massa BootNotification, es respon Pending (interval %d s)", __func__, *retry_interval);
+
+    return admitted;
+}
+
+/*
+ *  NAME
+ *      now_ms - Retorna l'hora actual
+ *  SYNOPSIS
+ *      static int64_t now_ms(void);
+ *  DESCRIPTION
+ *      Retorna l'hora del rellotge monòton en mil·lisegons.
+ *  RETURN VALUE
+ *      L'hora en mil·lisegons.
+ */
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ *  NAME
+ *      next_jitter - Genera un nombre aleatori
+ *  SYNOPSIS
+ *      static uint32_t next_jitter(void);
+ *  DESCRIPTION
+ *      Genera el següent nombre del generador xorshift32. S'ha de cridar amb admission_lock agafat.
+ *  RETURN VALUE
+ *      El nombre generat.
+ */
+static uint32_t next_jitter(void)
+{
+    jitter_state ^= jitter_state << 13;
+    jitter_state ^= jitter_state >> 17;
+    jitter_state ^= jitter_state << 5;
+
+    return jitter_state;
+}
@@ -0,0 +1,21 @@
+/*
+ *  FILE
+ *      boot_admission.h - header de boot_admission.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header del control d'admissió dels BootNotification.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _BOOT_ADMISSION_H_
+#define _BOOT_ADMISSION_H_
+
+#include <stdbool.h>
+
+bool boot_admission_take(int *retry_interval);
+
+#endif
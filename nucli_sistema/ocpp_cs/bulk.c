@@ -0,0 +1,719 @@
+/*
+ *  FILE
+ *      bulk.c - motor d'operacions massives
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Executa una mateixa operació sobre tots els carregadors que compleixen un filtre.
+ *      Cada feina s'executa en un thread propi amb una finestra de concurrència configurable,
+ *      timeout i reintents per carregador. El progrés i el resultat agregat s'envien a la web.
+ *
+ *      Format de la feina (Flask:bulk:<acció>:<feina>):
+ *          {"filter": {"chargers": [1, 2], "vendor": "...", "model": "..."},
+ *           "payload": {...}, "concurrency": 4, "timeout": 10, "retries": 1}
+ *      Tots els camps són opcionals. Només s'envia als carregadors connectats amb el
+ *      BootNotification acceptat.
+ *
+ *      Els clients web també poden enviar ordres en JSON, sense passar pel format Flask:...:
+ *          {"id": "...", "action": "reset", "targets": [1, {"charger": 2, "payload": {...}}],
+ *           "payload": {...}, "concurrency": 4, "timeout": 10, "retries": 1}
+ *      Cada carregador pot tenir el seu propi payload. Les respostes (commandAccepted,
+ *      commandError, commandProgress i commandResult, amb el mateix id) només s'envien al
+ *      client que ha enviat l'ordre, amb el resultat de cada carregador.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <cJSON.h>
+#include "ocpp_cs.h"
+#include "ws_server.h"
+#include "web_hub.h"
+#include "bulk.h"
+
+// operacions que es poden executar de forma massiva i la seva opció de send_request()
+static const struct {
+    const char *action;
+    int option;
+} bulk_actions[] = {
+    {"changeAvailability", '1'},
+    {"clearCache", '2'},
+    {"dataTransfer", '3'},
+    {"getConfiguration", '4'},
+    {"reset", '7'},
+    {"sendLocalList", '9'},
+    {"getLocalListVersion", 'A'},
+    {"changeConfiguration", 'B'},
+    {"triggerMessage", 'C'},
+    {"remoteStartTransaction", '5'},
+    {"unlockConnector", '8'}
+};
+
+// resultat d'un carregador dins d'una feina
+struct bulk_target {
+    int charger;                // índex del carregador a charger_vars, -1 si no està connectat
+    int charger_id;             // identificador del carregador
+    char *payload;              // payload propi del carregador, NULL per fer servir el de la feina
+    enum tx_result_t result;    // resultat de l'últim intent
+    int attempts;               // intents fets
+    char status[32];            // camp status de la resposta, si n'hi ha
+};
+
+// feina massiva
+struct bulk_job {
+    int id;
+    int option;
+    char action[32];
+    char *payload;
+    int concurrency;
+    int timeout;
+    int retries;
+    bool command;               // ordre JSON d'un client web
+    char correlation[BULK_ID_LEN]; // identificador de l'ordre
+    ws_cli_conn_t reply_to;     // client que ha enviat la feina o l'ordre, l'únic que en rep el progrés i el resultat
+    struct bulk_target *targets;
+    int num_targets;
+    int next;                   // següent carregador pendent
+    int done;                   // carregadors acabats
+    int ok;                     // carregadors amb resposta sense errors
+    pthread_mutex_t lock;
+};
+
+extern ChargerVars charger_vars[];
+
+static int last_job_id = 0;
+
+// Prototips de les funcions
+static struct bulk_job *new_job(const char *action, int option, const cJSON *json, int max_targets);
+static bool launch_job(struct bulk_job *job);
+static void free_job(struct bulk_job *job);
+static int get_bulk_option(const char *action);
+static int find_charger(int64_t charger_id);
+static void send_command_error(ws_cli_conn_t client, const char *id, const char *error);
+static bool match_filter(const cJSON *filter, const ChargerVars *vars);
+static void *bulk_job_thread(void *arg);
+static void *bulk_worker(void *arg);
+static void run_target(struct bulk_job *job, struct bulk_target *target);
+static void send_progress(struct bulk_job *job);
+static void send_result(struct bulk_job *job);
+static const char *result_name(enum tx_result_t result);
+
+/*
+ *  NAME
+ *      bulk_start - Inicia una feina massiva
+ *  SYNOPSIS
+ *      int bulk_start(ws_cli_conn_t client, const char *action, const char *job_text);
+ *  DESCRIPTION
+ *      Parseja la feina, selecciona els carregadors que compleixen el filtre i
+ *      la llança en un thread a part, de manera que no bloqueja qui la crida.
+ *      El progrés i el resultat només s'envien a client, de manera que la feina es rebutja si
+ *      client no està subscrit.
+ *  RETURN VALUE
+ *      Retorna l'identificador de la feina.
+ *      Retorna -1 en cas d'error.
+ */
+int bulk_start(ws_cli_conn_t client, const char *action, const char *job_text)
+{
+    if (!web_hub_subscribed(client)) { // no rebria el resultat
+        syslog(LOG_WARNING, "%s: feina massiva d'un client no subscrit", __func__);
+        return -1;
+    }
+
+    int option = get_bulk_option(action);
+    if (option == -1) {
+        syslog(LOG_WARNING, "%s: operació massiva no suportada: %s", __func__, action ? action : "(null)");
+        return -1;
+    }
+
+    cJSON *json = cJSON_Parse((job_text && strlen(job_text) > 0) ? job_text : "{}");
+    if (json == NULL || !cJSON_IsObject(json)) {
+        syslog(LOG_WARNING, "%s: feina massiva mal formada", __func__);
+        cJSON_Delete(json);
+        return -1;
+    }
+
+    struct bulk_job *job = new_job(action, option, json, MAX_CHARGERS);
+    if (job == NULL) {
+        cJSON_Delete(json);
+        return -1;
+    }
+    job->reply_to = client;
+
+    // selecciono els carregadors
+    const cJSON *filter = cJSON_GetObjectItemCaseSensitive(json, "filter");
+    for (int i = 1; i <= MAX_CHARGERS; i++) {
+        if (match_filter(filter, &charger_vars[i])) {
+            job->targets[job->num_targets].charger = i;
+            job->targets[job->num_targets].charger_id = charger_vars[i].charger_id;
+            job->targets[job->num_targets].result = tx_result_not_sent;
+            job->num_targets++;
+        }
+    }
+
+    cJSON_Delete(json);
+
+    int id = job->id;
+    if (!launch_job(job))
+        return -1;
+
+    return id;
+}
+
+/*
+ *  NAME
+ *      bulk_command - Executa una ordre JSON d'un client web
+ *  SYNOPSIS
+ *      int bulk_command(ws_cli_conn_t client, const char *text, size_t len);
+ *  DESCRIPTION
+ *      Parseja l'ordre (text, de len bytes) i l'executa com una feina massiva sobre els carregadors
+ *      de targets, que poden ser identificadors de qualsevol mida o objectes amb el seu propi payload.
+ *      Els carregadors que no estan connectats o acceptats surten al resultat com a notSent.
+ *      Les respostes només s'envien a client, de manera que l'ordre es rebutja si client no està
+ *      subscrit (no en podria rebre el resultat).
+ *  RETURN VALUE
+ *      Retorna l'identificador de la feina.
+ *      Retorna -1 en cas d'error (i s'envia un commandError a client).
+ */
+int bulk_command(ws_cli_conn_t client, const char *text, size_t len)
+{
+    char id[BULK_ID_LEN] = "";
+
+    cJSON *json = cJSON_ParseWithLength(text, len);
+    if (json == NULL || !cJSON_IsObject(json)) {
+        syslog(LOG_WARNING, "%s: ordre mal formada", __func__);
+        send_command_error(client, id, "FormationViolation");
+        cJSON_Delete(json);
+        return -1;
+    }
+
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(json, "id");
+    if (cJSON_IsString(item) && strpbrk(item->valuestring, "\"\\") == NULL) // l'id es torna dins dels missatges JSON
+        snprintf(id, sizeof(id), "%s", item->valuestring);
+    else if (cJSON_IsNumber(item))
+        snprintf(id, sizeof(id), "%.0f", item->valuedouble);
+
+    item = cJSON_GetObjectItemCaseSensitive(json, "action");
+    int option = get_bulk_option(cJSON_IsString(item) ? item->valuestring : NULL);
+    if (option == -1) {
+        send_command_error(client, id, "NotSupported");
+        cJSON_Delete(json);
+        return -1;
+    }
+
+    const cJSON *targets = cJSON_GetObjectItemCaseSensitive(json, "targets");
+    int num_targets = cJSON_GetArraySize(targets);
+    if (!cJSON_IsArray(targets) || num_targets == 0 || num_targets > BULK_MAX_TARGETS) {
+        send_command_error(client, id, "TypeConstraintViolation");
+        cJSON_Delete(json);
+        return -1;
+    }
+
+    struct bulk_job *job = new_job(item->valuestring, option, json, num_targets);
+    if (job == NULL) {
+        send_command_error(client, id, "InternalError");
+        cJSON_Delete(json);
+        return -1;
+    }
+    job->command = true;
+    job->reply_to = client;
+    snprintf(job->correlation, sizeof(job->correlation), "%s", id);
+
+    // carregadors de l'ordre: un identificador o {"charger": identificador, "payload": {...}}
+    const cJSON *target = NULL;
+    cJSON_ArrayForEach(target, targets) {
+        const cJSON *charger = cJSON_IsObject(target) ? cJSON_GetObjectItemCaseSensitive(target, "charger") : target;
+        if (!cJSON_IsNumber(charger) || charger->valuedouble < INT_MIN || charger->valuedouble > INT_MAX) {
+            send_command_error(client, id, "TypeConstraintViolation");
+            free_job(job);
+            cJSON_Delete(json);
+            return -1;
+        }
+
+        struct bulk_target *t = &job->targets[job->num_targets++];
+        t->charger_id = (int)charger->valuedouble;
+        t->charger = find_charger(t->charger_id);
+        t->result = tx_result_not_sent;
+
+        const cJSON *payload = cJSON_IsObject(target) ? cJSON_GetObjectItemCaseSensitive(target, "payload") : NULL;
+        if (payload != NULL)
+            t->payload = cJSON_PrintUnformatted(payload);
+    }
+
+    cJSON_Delete(json);
+
+    char information[BULK_ID_LEN + 128];
+    snprintf(information, sizeof(information), "{\"type\": \"commandAccepted\", \"id\": \"%s\", \"job\": %d, \"total\": %d}",
+        job->correlation, job->id, job->num_targets);
+    if (!web_hub_send(client, information)) { // el client no està subscrit: no rebria el resultat
+        syslog(LOG_WARNING, "%s: ordre %s d'un client no subscrit", __func__, job->correlation);
+        free_job(job);
+        return -1;
+    }
+
+    int job_id = job->id;
+    if (!launch_job(job)) {
+        send_command_error(client, id, "InternalError");
+        return -1;
+    }
+
+    return job_id;
+}
+
+/*
+ *  NAME
+ *      new_job - Crea una feina massiva
+ *  SYNOPSIS
+ *      static struct bulk_job *new_job(const char *action, int option, const cJSON *json, int max_targets);
+ *  DESCRIPTION
+ *      Reserva una feina amb espai per max_targets carregadors i llegeix els paràmetres
+ *      (concurrency, timeout, retries i payload) de json.
+ *  RETURN VALUE
+ *      Retorna la feina.
+ *      Retorna NULL en cas d'error.
+ */
+static struct bulk_job *new_job(const char *action, int option, const cJSON *json, int max_targets)
+{
+    struct bulk_job *job = calloc(1, sizeof(struct bulk_job));
+    if (job == NULL) {
+        syslog(LOG_ERR, "%s: calloc failed", __func__);
+        return NULL;
+    }
+
+    job->targets = calloc(max_targets > 0 ? max_targets : 1, sizeof(struct bulk_target));
+    if (job->targets == NULL) {
+        syslog(LOG_ERR, "%s: calloc failed", __func__);
+        free(job);
+        return NULL;
+    }
+
+    job->id = __atomic_add_fetch(&last_job_id, 1, __ATOMIC_SEQ_CST);
+    job->option = option;
+    job->reply_to = (ws_cli_conn_t)-1;
+    snprintf(job->action, sizeof(job->action), "%s", action);
+    pthread_mutex_init(&job->lock, NULL);
+
+    // paràmetres de la feina
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(json, "concurrency");
+    if (!cJSON_IsNumber(item))
+        job->concurrency = BULK_DEFAULT_CONCURRENCY;
+    else
+        job->concurrency = item->valuedouble < 1 ? 1 : item->valuedouble > BULK_MAX_CONCURRENCY ? BULK_MAX_CONCURRENCY : (int)item->valuedouble;
+
+    item = cJSON_GetObjectItemCaseSensitive(json, "timeout");
+    job->timeout = cJSON_IsNumber(item) && item->valuedouble >= 1 && item->valuedouble <= INT_MAX ? (int)item->valuedouble : BULK_DEFAULT_TIMEOUT;
+
+    item = cJSON_GetObjectItemCaseSensitive(json, "retries");
+    if (!cJSON_IsNumber(item))
+        job->retries = 0;
+    else
+        job->retries = item->valuedouble < 0 ? 0 : item->valuedouble > BULK_MAX_RETRIES ? BULK_MAX_RETRIES : (int)item->valuedouble;
+
+    item = cJSON_GetObjectItemCaseSensitive(json, "payload");
+    job->payload = (item != NULL) ? cJSON_PrintUnformatted(item) : NULL;
+
+    return job;
+}
+
+/*
+ *  NAME
+ *      launch_job - Llança una feina massiva
+ *  SYNOPSIS
+ *      static bool launch_job(struct bulk_job *job);
+ *  DESCRIPTION
+ *      Llança la feina en un thread a part, de manera que no bloqueja qui la crida.
+ *      Si no es pot crear el thread, allibera la feina.
+ *  RETURN VALUE
+ *      Retorna true si s'ha llançat la feina.
+ *      Retorna false en cas contrari.
+ */
+static bool launch_job(struct bulk_job *job)
+{
+    syslog(LOG_INFO, "%s: feina %d: %s a %d carregadors (concurrència %d, timeout %d s, reintents %d)", __func__,
+        job->id, job->action, job->num_targets, job->concurrency, job->timeout, job->retries);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, bulk_job_thread, job) != 0) {
+        syslog(LOG_ERR, "%s: pthread_create failed", __func__);
+        free_job(job);
+        return false;
+    }
+    pthread_detach(thread);
+
+    return true;
+}
+
+/*
+ *  NAME
+ *      free_job - Allibera una feina massiva
+ *  SYNOPSIS
+ *      static void free_job(struct bulk_job *job);
+ *  DESCRIPTION
+ *      Allibera la feina, els seus payloads i la llista de carregadors.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void free_job(struct bulk_job *job)
+{
+    for (int i = 0; i < job->num_targets; i++)
+        cJSON_free(job->targets[i].payload);
+    pthread_mutex_destroy(&job->lock);
+    free(job->targets);
+    free(job->payload);
+    free(job);
+}
+
+/*
+ *  NAME
+ *      get_bulk_option - Retorna l'opció de send_request() d'una operació
+ *  SYNOPSIS
+ *      static int get_bulk_option(const char *action);
+ *  DESCRIPTION
+ *      Busca l'operació a la taula d'operacions massives.
+ *  RETURN VALUE
+ *      Retorna l'opció de send_request().
+ *      Retorna -1 si l'operació no es pot executar de forma massiva.
+ */
+static int get_bulk_option(const char *action)
+{
+    if (action == NULL)
+        return -1;
+
+    for (size_t i = 0; i < sizeof(bulk_actions) / sizeof(bulk_actions[0]); i++) {
+        if (strcmp(bulk_actions[i].action, action) == 0)
+            return bulk_actions[i].option;
+    }
+
+    return -1;
+}
+
+/*
+ *  NAME
+ *      find_charger - Busca un carregador pel seu identificador
+ *  SYNOPSIS
+ *      static int find_charger(int64_t charger_id);
+ *  DESCRIPTION
+ *      Busca el carregador amb identificador charger_id entre els connectats amb el
+ *      BootNotification acceptat.
+ *  RETURN VALUE
+ *      Retorna l'índex del carregador a charger_vars.
+ *      Retorna -1 si no està connectat o acceptat.
+ */
+static int find_charger(int64_t charger_id)
+{
+    for (int i = 1; i <= MAX_CHARGERS; i++) {
+        if (charger_vars[i].charger_id == charger_id && match_filter(NULL, &charger_vars[i]))
+            return i;
+    }
+
+    return -1;
+}
+
+/*
+ *  NAME
+ *      match_filter - Comprova si un carregador compleix el filtre
+ *  SYNOPSIS
+ *      static bool match_filter(const cJSON *filter, const ChargerVars *vars);
+ *  DESCRIPTION
+ *      Comprova si el carregador està connectat i acceptat i, si s'indiquen al filtre,
+ *      si es troba a la llista de carregadors i té el vendor i el model indicats.
+ *  RETURN VALUE
+ *      Retorna true si el compleix.
+ *      Retorna false en cas contrari.
+ */
+static bool match_filter(const cJSON *filter, const ChargerVars *vars)
+{
+    if (vars->client == -1 || vars->boot.status != STATUS_BOOT_ACCEPTED)
+        return false;
+
+    if (filter == NULL)
+        return true;
+
+    const cJSON *chargers = cJSON_GetObjectItemCaseSensitive(filter, "chargers");
+    if (cJSON_IsArray(chargers)) {
+        bool found = false;
+        const cJSON *charger = NULL;
+        cJSON_ArrayForEach(charger, chargers) {
+            if (cJSON_IsNumber(charger) && charger->valuedouble == vars->charger_id) {
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            return false;
+    }
+
+    const cJSON *vendor = cJSON_GetObjectItemCaseSensitive(filter, "vendor");
+    if (cJSON_IsString(vendor) && strcmp(vendor->valuestring, vars->current_vendor) != 0)
+        return false;
+
+    const cJSON *model = cJSON_GetObjectItemCaseSensitive(filter, "model");
+    if (cJSON_IsString(model) && strcmp(model->valuestring, vars->current_model) != 0)
+        return false;
+
+    return true;
+}
+
+/*
+ *  NAME
+ *      bulk_job_thread - Thread d'una feina massiva
+ *  SYNOPSIS
+ *      static void *bulk_job_thread(void *arg);
+ *  DESCRIPTION
+ *      Llança tants workers com la finestra de concurrència, espera que acabin,
+ *      envia el resultat agregat a la web i allibera la feina.
+ *  RETURN VALUE
+ *      NULL.
+ */
+static void *bulk_job_thread(void *arg)
+{
+    struct bulk_job *job = arg;
+    pthread_t workers[BULK_MAX_CONCURRENCY];
+    int num_workers = (job->concurrency < job->num_targets) ? job->concurrency : job->num_targets;
+    int started = 0;
+
+    for (int i = 0; i < num_workers; i++) {
+        if (pthread_create(&workers[started], NULL, bulk_worker, job) == 0)
+            started++;
+        else
+            syslog(LOG_WARNING, "%s: no s'ha pogut crear el worker %d", __func__, i);
+    }
+
+    if (started == 0 && job->num_targets > 0) // sense workers ho faig des d'aquest thread
+        bulk_worker(job);
+
+    for (int i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+
+    send_result(job);
+    free_job(job);
+
+    return NULL;
+}
+
+/*
+ *  NAME
+ *      bulk_worker - Worker d'una feina massiva
+ *  SYNOPSIS
+ *      static void *bulk_worker(void *arg);
+ *  DESCRIPTION
+ *      Agafa el següent carregador pendent fins que no en queda cap.
+ *  RETURN VALUE
+ *      NULL.
+ */
+static void *bulk_worker(void *arg)
+{
+    struct bulk_job *job = arg;
+
+    while (true) {
+        pthread_mutex_lock(&job->lock);
+        struct bulk_target *target = (job->next < job->num_targets) ? &job->targets[job->next++] : NULL;
+        pthread_mutex_unlock(&job->lock);
+
+        if (target == NULL)
+            break;
+
+        run_target(job, target);
+
+        pthread_mutex_lock(&job->lock);
+        job->done++;
+        if (target->result == tx_result_ok)
+            job->ok++;
+        pthread_mutex_unlock(&job->lock);
+
+        send_progress(job);
+    }
+
+    return NULL;
+}
+
+/*
+ *  NAME
+ *      run_target - Executa l'operació en un carregador
+ *  SYNOPSIS
+ *      static void run_target(struct bulk_job *job, struct bulk_target *target);
+ *  DESCRIPTION
+ *      Envia la petició al carregador i la torna a enviar si hi ha timeout o la resposta
+ *      té errors, fins a esgotar els reintents. Una resposta sense errors però amb un status
+ *      diferent d'Accepted no es reintenta.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void run_target(struct bulk_job *job, struct bulk_target *target)
+{
+    char response[256];
+
+    if (target->charger == -1) { // el carregador no està connectat
+        target->result = tx_result_not_sent;
+        return;
+    }
+
+    ChargerVars *vars = &charger_vars[target->charger];
+    const char *job_payload = (target->payload != NULL) ? target->payload : job->payload;
+
+    for (int attempt = 0; attempt <= job->retries; attempt++) {
+        if (vars->client == -1) { // s'ha desconnectat
+            target->result = tx_result_not_sent;
+            break;
+        }
+
+        // send_request() modifica el payload -> en faig una còpia per cada intent
+        char *payload = (job_payload != NULL) ? strdup(job_payload) : NULL;
+        memset(response, 0, sizeof(response));
+        target->result = send_request_timeout(job->option, payload, vars, job->timeout, response, sizeof(response));
+        target->attempts++;
+        free(payload);
+
+        if (target->result == tx_result_ok || target->result == tx_result_not_sent)
+            break;
+    }
+
+    if (target->result == tx_result_ok) {
+        cJSON *json = cJSON_Parse(response);
+        const cJSON *status = cJSON_GetObjectItemCaseSensitive(json, "status");
+        if (cJSON_IsString(status))
+            snprintf(target->status, sizeof(target->status), "%s", status->valuestring);
+        cJSON_Delete(json);
+    }
+}
+
+/*
+ *  NAME
+ *      send_progress - Envia el progrés d'una feina a la web
+ *  SYNOPSIS
+ *      static void send_progress(struct bulk_job *job);
+ *  DESCRIPTION
+ *      Envia al client que ha enviat la feina quants carregadors s'han acabat i quants sense errors.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void send_progress(struct bulk_job *job)
+{
+    char information[BULK_ID_LEN + 256];
+
+    pthread_mutex_lock(&job->lock);
+    if (job->command)
+        snprintf(information, sizeof(information), "{\"type\": \"commandProgress\", \"id\": \"%s\", \"job\": %d, \"action\": \"%s\", "
+            "\"total\": %d, \"done\": %d, \"ok\": %d, \"failed\": %d}", job->correlation, job->id, job->action, job->num_targets,
+            job->done, job->ok, job->done - job->ok);
+    else
+        snprintf(information, sizeof(information), "{\"type\": \"bulkProgress\", \"job\": %d, \"action\": \"%s\", \"total\": %d, "
+            "\"done\": %d, \"ok\": %d, \"failed\": %d}", job->id, job->action, job->num_targets, job->done, job->ok, job->done - job->ok);
+    pthread_mutex_unlock(&job->lock);
+
+    // Envio el missatge només al client que ha enviat la feina
+    web_hub_send(job->reply_to, information);
+}
+
+/*
+ *  NAME
+ *      send_result - Envia el resultat agregat d'una feina a la web
+ *  SYNOPSIS
+ *      static void send_result(struct bulk_job *job);
+ *  DESCRIPTION
+ *      Envia al client que ha enviat la feina els totals per resultat i per status de la resposta,
+ *      i el resultat de cada carregador.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void send_result(struct bulk_job *job)
+{
+    cJSON *json = cJSON_CreateObject();
+    if (json == NULL)
+        return;
+
+    cJSON_AddStringToObject(json, "type", job->command ? "commandResult" : "bulkResult");
+    if (job->command)
+        cJSON_AddStringToObject(json, "id", job->correlation);
+    cJSON_AddNumberToObject(json, "job", job->id);
+    cJSON_AddStringToObject(json, "action", job->action);
+    cJSON_AddNumberToObject(json, "total", job->num_targets);
+
+    cJSON *results = cJSON_AddObjectToObject(json, "results");
+    cJSON *statuses = cJSON_AddObjectToObject(json, "statuses");
+    cJSON *chargers = cJSON_AddArrayToObject(json, "chargers");
+
+    for (int i = 0; i < job->num_targets; i++) {
+        const struct bulk_target *target = &job->targets[i];
+        const char *result = result_name(target->result);
+
+        cJSON *count = cJSON_GetObjectItemCaseSensitive(results, result);
+        if (count == NULL)
+            cJSON_AddNumberToObject(results, result, 1);
+        else
+            cJSON_SetNumberValue(count, count->valuedouble + 1);
+
+        if (strlen(target->status) > 0) {
+            count = cJSON_GetObjectItemCaseSensitive(statuses, target->status);
+            if (count == NULL)
+                cJSON_AddNumberToObject(statuses, target->status, 1);
+            else
+                cJSON_SetNumberValue(count, count->valuedouble + 1);
+        }
+
+        cJSON *charger = cJSON_CreateObject();
+        cJSON_AddNumberToObject(charger, "charger", target->charger_id);
+        cJSON_AddStringToObject(charger, "result", result);
+        cJSON_AddStringToObject(charger, "status", target->status);
+        cJSON_AddNumberToObject(charger, "attempts", target->attempts);
+        cJSON_AddItemToArray(chargers, charger);
+    }
+
+    char *information = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+
+    if (information != NULL) {
+        // Envio el missatge només al client que ha enviat la feina
+        web_hub_send(job->reply_to, information);
+        cJSON_free(information);
+    }
+
+    syslog(LOG_INFO, "%s: feina %d acabada: %d/%d sense errors", __func__, job->id, job->ok, job->num_targets);
+}
+
+/*
+ *  NAME
+ *      result_name - Retorna el nom d'un resultat
+ *  SYNOPSIS
+ *      static const char *result_name(enum tx_result_t result);
+ *  DESCRIPTION
+ *      Retorna el nom d'un resultat de petició per enviar-lo a la web.
+ *  RETURN VALUE
+ *      El nom del resultat.
+ */
+static const char *result_name(enum tx_result_t result)
+{
+    switch (result) {
+        case tx_result_ok: return "ok";
+        case tx_result_error: return "error";
+        case tx_result_timeout: return "timeout";
+        case tx_result_pending: return "pending";
+        default: return "notSent";
+    }
+}
+
+/*
+ *  NAME
+ *      send_command_error - Respon una ordre que no s'ha pogut executar
+ *  SYNOPSIS
+ *      static void send_command_error(ws_cli_conn_t client, const char *id, const char *error);
+ *  DESCRIPTION
+ *      Envia a client un commandError amb l'identificador de l'ordre i el motiu.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void send_command_error(ws_cli_conn_t client, const char *id, const char *error)
+{
+    char information[BULK_ID_LEN + 128];
+
+    snprintf(information, sizeof(information), "{\"type\": \"commandError\", \"id\": \"%s\", \"error\": \"%s\"}", id, error);
+    web_hub_send(client, information);
+}
@@ -0,0 +1,30 @@
+/*
+ *  FILE
+ *      bulk.h - header de bulk.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header del motor d'operacions massives sobre els carregadors.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _BULK_H_
+#define _BULK_H_
+
+#include <stddef.h>
+#include <ws.h>
+
+#define BULK_DEFAULT_CONCURRENCY 4  // carregadors atesos alhora si no s'indica
+#define BULK_MAX_CONCURRENCY 64     // màxim de carregadors atesos alhora
+#define BULK_DEFAULT_TIMEOUT 10     // temps de timeout per carregador (s) si no s'indica
+#define BULK_MAX_RETRIES 5          // màxim de reintents per carregador
+#define BULK_MAX_TARGETS 1024       // màxim de carregadors d'una ordre
+#define BULK_ID_LEN 64              // mida màxima de l'identificador d'una ordre
+
+int bulk_start(ws_cli_conn_t client, const char *action, const char *job_text);
+int bulk_command(ws_cli_conn_t client, const char *text, size_t len);
+
+#endif
@@ -0,0 +1,223 @@
+/*
+ *  FILE
+ *      call_cache.c - memòria cau de respostes de les peticions retransmeses
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Quan es perd un CALLRESULT, el carregador torna a enviar el MeterValues, StartTransaction o
+ *      StopTransaction amb el mateix uniqueId. Per no tornar a processar la petició (i duplicar files
+ *      a la base de dades o reservar un altre transactionId), per cada carregador es guarden les
+ *      últimes respostes en un anell de CALL_CACHE_ENTRIES posicions, i si arriba una petició repetida
+ *      es respon amb la resposta guardada sense cridar la funció que la gestiona.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <syslog.h>
+#include "ocpp_cs.h"
+#include "ws_server.h"
+#include "utils.h"
+#include "call_cache.h"
+
+// resposta guardada d'una petició
+struct call_entry {
+    bool valid;
+    uint32_t payload_hash;                          // hash del payload, per no confondre dues peticions amb el mateix uniqueId
+    char unique_id[CALL_CACHE_ID_LEN];
+    char action[CALL_CACHE_ACTION_LEN];
+    char response[CALL_CACHE_RESPONSE_LEN];
+};
+
+// anell de respostes d'un carregador
+struct call_cache {
+    pthread_mutex_t lock;
+    unsigned int next;                              // posició de l'anell on es guardarà la propera resposta
+    bool pending;                                   // s'està processant una petició i s'espera la seva resposta
+    ws_cli_conn_t pending_client;                   // client al qual s'enviarà la resposta
+    struct call_entry pending_entry;                // petició que s'està processant
+    struct call_entry entries[CALL_CACHE_ENTRIES];
+};
+
+static struct call_cache caches[MAX_CHARGERS + 1] = {
+    [0 ... MAX_CHARGERS] = { .lock = PTHREAD_MUTEX_INITIALIZER }
+};
+
+// Prototips de les funcions
+static struct call_cache *get_cache(const ChargerVars *vars);
+static uint32_t hash_payload(const char *payload);
+
+/*
+ *  NAME
+ *      call_cache_reset - Esborra les respostes guardades d'un carregador
+ *  SYNOPSIS
+ *      void call_cache_reset(const ChargerVars *vars);
+ *  DESCRIPTION
+ *      S'ha de cridar quan el carregador es reinicia (BootNotification), ja que llavors pot tornar
+ *      a fer servir uniqueIds que ja havia enviat.
+ *  RETURN VALUE
+ *      Res.
+ */
+void call_cache_reset(const ChargerVars *vars)
+{
+    struct call_cache *cache = get_cache(vars);
+
+    if (cache == NULL)
+        return;
+
+    pthread_mutex_lock(&cache->lock);
+    cache->next = 0;
+    cache->pending = false;
+    memset(cache->entries, 0, sizeof(cache->entries));
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/*
+ *  NAME
+ *      call_cache_replay - Respon una petició repetida
+ *  SYNOPSIS
+ *      bool call_cache_replay(const ChargerVars *vars, const struct header_st *header, const char *payload);
+ *  DESCRIPTION
+ *      Busca una resposta guardada amb el mateix uniqueId, acció i payload. Si n'hi ha, la torna a enviar
+ *      al carregador. Si no n'hi ha, es deixa la petició pendent perquè call_cache_store() en guardi
+ *      la resposta.
+ *  RETURN VALUE
+ *      Retorna true si s'ha enviat la resposta guardada (no cal processar la petició).
+ *      Retorna false en cas contrari.
+ */
+bool call_cache_replay(const ChargerVars *vars, const struct header_st *header, const char *payload)
+{
+    struct call_cache *cache = get_cache(vars);
+    char response[CALL_CACHE_RESPONSE_LEN];
+    uint32_t hash;
+    bool found = false;
+
+    if (cache == NULL || strlen(header->unique_id) >= CALL_CACHE_ID_LEN || strlen(header->action) >= CALL_CACHE_ACTION_LEN)
+        return false;
+
+    hash = hash_payload(payload);
+
+    pthread_mutex_lock(&cache->lock);
+    for (int i = 0; i < CALL_CACHE_ENTRIES; i++) {
+        struct call_entry *entry = &cache->entries[i];
+        if (entry->valid && strcmp(entry->unique_id, header->unique_id) == 0 && strcmp(entry->action, header->action) == 0) {
+            if (entry->payload_hash == hash) {
+                snprintf(response, sizeof(response), "%s", entry->response);
+                found = true;
+            }
+            else {
+                syslog(LOG_WARNING, "%s: el carregador %d ha reutilitzat el uniqueId %s amb un altre payload", __func__,
+                    vars->charger_id, header->unique_id);
+                entry->valid = false;
+            }
+            break;
+        }
+    }
+
+    if (!found) { // la petició es processarà i se'n guardarà la resposta
+        cache->pending = true;
+        cache->pending_client = vars->client;
+        cache->pending_entry.payload_hash = hash;
+        snprintf(cache->pending_entry.unique_id, CALL_CACHE_ID_LEN, "%s", header->unique_id);
+        snprintf(cache->pending_entry.action, CALL_CACHE_ACTION_LEN, "%s", header->action);
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    if (found) {
+        syslog(LOG_NOTICE, "%s: petició %s %s repetida, es torna a enviar la resposta", __func__, header->action, header->unique_id);
+        ws_send("CALL RESULT", response, vars->client);
+    }
+
+    return found;
+}
+
+/*
+ *  NAME
+ *      call_cache_store - Guarda la resposta d'una petició
+ *  SYNOPSIS
+ *      void call_cache_store(ws_cli_conn_t client, const char *response);
+ *  DESCRIPTION
+ *      Es crida des de ws_send() amb cada CALLRESULT enviat. Si el carregador del client té una
+ *      petició pendent amb el mateix uniqueId, es guarda la resposta a l'anell.
+ *  RETURN VALUE
+ *      Res.
+ */
+void call_cache_store(ws_cli_conn_t client, const char *response)
+{
+    size_t response_len = strlen(response);
+
+    for (int i = 0; i <= MAX_CHARGERS; i++) {
+        struct call_cache *cache = &caches[i];
+
+        pthread_mutex_lock(&cache->lock);
+        if (cache->pending && cache->pending_client == client) {
+            size_t id_len = strlen(cache->pending_entry.unique_id);
+
+            // la resposta té el format [3,<uniqueId>,{...}]
+            if (strncmp(response, "[3,", 3) == 0 && strncmp(response + 3, cache->pending_entry.unique_id, id_len) == 0 &&
+                response[3 + id_len] == ',') {
+
+                if (response_len < CALL_CACHE_RESPONSE_LEN) {
+                    struct call_entry *entry = &cache->entries[cache->next];
+                    *entry = cache->pending_entry;
+                    memcpy(entry->response, response, response_len + 1);
+                    entry->valid = true;
+                    cache->next = (cache->next + 1) % CALL_CACHE_ENTRIES;
+                }
+                else {
+                    syslog(LOG_DEBUG, "%s: resposta massa llarga, no es guarda: %zu bytes", __func__, response_len);
+                }
+                cache->pending = false;
+            }
+            pthread_mutex_unlock(&cache->lock);
+            return;
+        }
+        pthread_mutex_unlock(&cache->lock);
+    }
+}
+
+/*
+ *  NAME
+ *      get_cache - Retorna l'anell de respostes d'un carregador
+ *  SYNOPSIS
+ *      static struct call_cache *get_cache(const ChargerVars *vars);
+ *  DESCRIPTION
+ *      Retorna l'anell de respostes del carregador.
+ *  RETURN VALUE
+ *      L'anell (NULL si el carregador no és vàlid).
+ */
+static struct call_cache *get_cache(const ChargerVars *vars)
+{
+    if (vars == NULL || vars->charger_id < 0 || vars->charger_id > MAX_CHARGERS)
+        return NULL;
+
+    return &caches[vars->charger_id];
+}
+
+/*
+ *  NAME
+ *      hash_payload - Calcula el hash del payload d'una petició
+ *  SYNOPSIS
+ *      static uint32_t hash_payload(const char *payload);
+ *  DESCRIPTION
+ *      Calcula el hash FNV-1a del payload.
+ *  RETURN VALUE
+ *      El hash.
+ */
+static uint32_t hash_payload(const char *payload)
+{
+    uint32_t hash = 2166136261u;
+
+    for (; payload != NULL && *payload; payload++) {
+        hash ^= (unsigned char)*payload;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
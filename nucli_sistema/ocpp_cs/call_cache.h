@@ -0,0 +1,31 @@
+/*
+ *  FILE
+ *      call_cache.h - header de call_cache.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header de la memòria cau de respostes de les peticions retransmeses.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _CALL_CACHE_H_
+#define _CALL_CACHE_H_
+
+#include <stdbool.h>
+#include <ws.h>
+#include "ocpp_cs.h"
+#include "utils.h"
+
+#define CALL_CACHE_ENTRIES 8        // respostes recents que es guarden per carregador
+#define CALL_CACHE_ID_LEN 48        // mida màxima del uniqueId (36 caràcters i les cometes)
+#define CALL_CACHE_ACTION_LEN 32    // mida màxima de l'acció
+#define CALL_CACHE_RESPONSE_LEN 512 // mida màxima d'una resposta guardada
+
+void call_cache_reset(const ChargerVars *vars);
+bool call_cache_replay(const ChargerVars *vars, const struct header_st *header, const char *payload);
+void call_cache_store(ws_cli_conn_t client, const char *response);
+
+#endif
@@ -0,0 +1,523 @@
+/*
+ *  FILE
+ *      config_store.c - magatzem de claus de configuració dels carregadors
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Cada clau de configuració té un identificador numèric. Les claus conegudes del protocol es
+ *      troben amb un hash perfecte (la llavor CONF_HASH_SEED fa que no hi hagi col·lisions), de manera
+ *      que només cal un strcmp per clau; les claus de fabricant s'afegeixen a una taula a part la
+ *      primera vegada que arriben.
+ *      Els valors de cada carregador es guarden seguits en un slab de CONF_SLAB_SIZE bytes. Si el valor
+ *      rebut és el mateix que el guardat no es toca res, si hi cap es sobreescriu al mateix lloc i si no
+ *      s'afegeix al final (compactant l'slab si cal). Cada canvi incrementa la versió del carregador i
+ *      es guarda amb quina versió ha canviat cada clau, per saber què ha canviat entre dos GetConfiguration.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <syslog.h>
+#include "ocpp_cs.h"
+#include "ws_server.h"
+#include "config_store.h"
+
+// noms de les claus conegudes, en el mateix ordre que enum config_key_id
+static const char *known_keys[CONF_KNOWN_KEYS] = {
+    "AllowOfflineTxForUnknownId",
+    "AuthorizationCacheEnabled",
+    "AuthorizeRemoteTxRequests",
+    "BlinkRepeat",
+    "ClockAlignedDataInterval",
+    "ConnectionTimeOut",
+    "ConnectorPhaseRotation",
+    "ConnectorPhaseRotationMaxLength",
+    "GetConfigurationMaxKeys",
+    "HeartbeatInterval",
+    "LightIntensity",
+    "LocalAuthorizeOffline",
+    "LocalPreAuthorize",
+    "MaxEnergyOnInvalidId",
+    "MeterValuesAlignedData",
+    "MeterValuesAlignedDataMaxLength",
+    "MeterValuesSampledData",
+    "MeterValuesSampledDataMaxLength",
+    "MeterValueSampleInterval",
+    "MinimumStatusDuration",
+    "NumberOfConnectors",
+    "ResetRetries",
+    "StopTransactionOnEVSideDisconnect",
+    "StopTransactionOnInvalidId",
+    "StopTxnAlignedData",
+    "StopTxnAlignedDataMaxLength",
+    "StopTxnSampledData",
+    "StopTxnSampledDataMaxLength",
+    "SupportedFeatureProfiles",
+    "SupportedFeatureProfilesMaxLength",
+    "TransactionMessageAttempts",
+    "TransactionMessageRetryInterval",
+    "UnlockConnectorOnEVSideDisconnect",
+    "WebSocketPingInterval",
+    "LocalAuthListEnabled",
+    "LocalAuthListMaxLength",
+    "SendLocalListMaxLength",
+    "ReserveConnectorZeroSupported",
+    "ChargeProfileMaxStackLevel",
+    "ChargingScheduleAllowedChargingRateUnit",
+    "ChargingScheduleMaxPeriods",
+    "ConnectorSwitch3to1PhaseSupported",
+    "MaxChargingProfilesInstalled"
+};
+
+// posició de la taula de hash -> identificador de la clau coneguda (-1 si està buida)
+static int8_t key_slots[1 << CONF_HASH_BITS];
+
+// claus de fabricant
+static char vendor_keys[CONF_MAX_VENDOR_KEYS][CONF_KEY_LEN + 1];
+static int num_vendor_keys = 0;
+static pthread_mutex_t vendor_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// valor d'una clau dins de l'slab
+struct config_value {
+    uint16_t offset;    // posició a l'slab
+    uint16_t len;       // llargada del valor (sense el '\0')
+    uint16_t cap;       // bytes reservats a l'slab
+    bool present;       // el carregador ha enviat la clau
+    bool readonly;
+    uint32_t hash;      // hash del valor per comparar-lo ràpidament
+    uint64_t version;   // versió en la qual ha canviat
+};
+
+// claus de configuració d'un carregador
+struct config_store {
+    pthread_mutex_t lock;
+    uint64_t version;                           // s'incrementa cada vegada que canvia una clau
+    uint16_t used;                              // bytes ocupats de l'slab
+    struct config_value values[CONF_MAX_KEYS];
+    char slab[CONF_SLAB_SIZE];
+};
+
+static struct config_store stores[MAX_CHARGERS + 1];
+
+// Prototips de les funcions
+static uint32_t hash_string(const char *s, size_t len);
+static unsigned int get_slot(const char *key);
+static struct config_store *get_store(const ChargerVars *vars);
+static void compact_slab(struct config_store *store);
+
+/*
+ *  NAME
+ *      config_init - Inicialitza el magatzem de claus de configuració
+ *  SYNOPSIS
+ *      void config_init(void);
+ *  DESCRIPTION
+ *      Omple la taula de hash de les claus conegudes i inicialitza els magatzems dels carregadors.
+ *      Si s'afegeix una clau i la llavor deixa de ser un hash perfecte, es deixa al log.
+ *  RETURN VALUE
+ *      Res.
+ */
+void config_init(void)
+{
+    memset(key_slots, -1, sizeof(key_slots));
+
+    for (int id = 0; id < CONF_KNOWN_KEYS; id++) {
+        unsigned int slot = get_slot(known_keys[id]);
+        if (key_slots[slot] != -1)
+            syslog(LOG_ERR, "%s: col·lisió entre %s i %s, s'ha de canviar CONF_HASH_SEED", __func__,
+                known_keys[key_slots[slot]], known_keys[id]);
+        else
+            key_slots[slot] = id;
+    }
+
+    for (int i = 0; i <= MAX_CHARGERS; i++)
+        pthread_mutex_init(&stores[i].lock, NULL);
+}
+
+/*
+ *  NAME
+ *      config_reset - Esborra les claus de configuració d'un carregador
+ *  SYNOPSIS
+ *      void config_reset(const ChargerVars *vars);
+ *  DESCRIPTION
+ *      Esborra totes les claus de configuració del carregador. La versió no torna a començar,
+ *      perquè qui hagi guardat una versió anterior vegi que tot ha canviat.
+ *  RETURN VALUE
+ *      Res.
+ */
+void config_reset(const ChargerVars *vars)
+{
+    struct config_store *store = get_store(vars);
+
+    if (store == NULL)
+        return;
+
+    pthread_mutex_lock(&store->lock);
+    memset(store->values, 0, sizeof(store->values));
+    store->used = 0;
+    store->version++;
+    pthread_mutex_unlock(&store->lock);
+}
+
+/*
+ *  NAME
+ *      config_key_id - Retorna l'identificador d'una clau
+ *  SYNOPSIS
+ *      int config_key_id(const char *key);
+ *  DESCRIPTION
+ *      Busca una clau entre les conegudes i les de fabricant que ja s'han vist.
+ *  RETURN VALUE
+ *      L'identificador de la clau (-1 si no es coneix).
+ */
+int config_key_id(const char *key)
+{
+    int id = -1;
+
+    if (key == NULL)
+        return -1;
+
+    int known = key_slots[get_slot(key)];
+    if (known != -1 && strcmp(known_keys[known], key) == 0)
+        return known;
+
+    pthread_mutex_lock(&vendor_lock);
+    for (int i = 0; i < num_vendor_keys; i++) {
+        if (strcmp(vendor_keys[i], key) == 0) {
+            id = CONF_KNOWN_KEYS + i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&vendor_lock);
+
+    return id;
+}
+
+/*
+ *  NAME
+ *      config_key_intern - Retorna l'identificador d'una clau, afegint-la si és nova
+ *  SYNOPSIS
+ *      int config_key_intern(const char *key);
+ *  DESCRIPTION
+ *      Com config_key_id(), però si la clau no es coneix l'afegeix a les claus de fabricant.
+ *  RETURN VALUE
+ *      L'identificador de la clau (-1 si no hi ha espai per a més claus o la clau no és vàlida).
+ */
+int config_key_intern(const char *key)
+{
+    int id = config_key_id(key);
+
+    if (id != -1 || key == NULL || strlen(key) > CONF_KEY_LEN)
+        return id;
+
+    pthread_mutex_lock(&vendor_lock);
+
+    for (int i = 0; i < num_vendor_keys; i++) { // un altre thread la pot haver afegit mentrestant
+        if (strcmp(vendor_keys[i], key) == 0) {
+            id = CONF_KNOWN_KEYS + i;
+            break;
+        }
+    }
+
+    if (id == -1 && num_vendor_keys < CONF_MAX_VENDOR_KEYS) {
+        snprintf(vendor_keys[num_vendor_keys], sizeof(vendor_keys[num_vendor_keys]), "%s", key);
+        id = CONF_KNOWN_KEYS + num_vendor_keys;
+        __atomic_store_n(&num_vendor_keys, num_vendor_keys + 1, __ATOMIC_RELEASE);
+    }
+    else if (id == -1) {
+        syslog(LOG_WARNING, "%s: no hi ha espai per a la clau %s", __func__, key);
+    }
+
+    pthread_mutex_unlock(&vendor_lock);
+
+    return id;
+}
+
+/*
+ *  NAME
+ *      config_key_name - Retorna el nom d'una clau
+ *  SYNOPSIS
+ *      const char *config_key_name(int id);
+ *  DESCRIPTION
+ *      Retorna el nom de la clau amb identificador id.
+ *  RETURN VALUE
+ *      El nom de la clau ("" si l'identificador no és vàlid).
+ */
+const char *config_key_name(int id)
+{
+    if (id >= 0 && id < CONF_KNOWN_KEYS)
+        return known_keys[id];
+    if (id >= CONF_KNOWN_KEYS && id < CONF_KNOWN_KEYS + __atomic_load_n(&num_vendor_keys, __ATOMIC_ACQUIRE))
+        return vendor_keys[id - CONF_KNOWN_KEYS];
+
+    return "";
+}
+
+/*
+ *  NAME
+ *      config_set - Guarda el valor d'una clau d'un carregador
+ *  SYNOPSIS
+ *      int config_set(const ChargerVars *vars, int id, const char *value, bool readonly);
+ *  DESCRIPTION
+ *      Guarda el valor d'una clau de configuració del carregador. Si és el mateix que ja hi havia no
+ *      es modifica res; si no, s'incrementa la versió del carregador. Un valor NULL es guarda com "".
+ *  RETURN VALUE
+ *      Retorna 1 si la clau ha canviat.
+ *      Retorna 0 si la clau ja tenia aquest valor.
+ *      Retorna -1 si no s'ha pogut guardar.
+ */
+int config_set(const ChargerVars *vars, int id, const char *value, bool readonly)
+{
+    struct config_store *store = get_store(vars);
+
+    if (store == NULL || id < 0 || id >= CONF_MAX_KEYS)
+        return -1;
+
+    if (value == NULL)
+        value = "";
+
+    size_t len = strlen(value);
+    uint32_t hash = hash_string(value, len);
+
+    if (len >= CONF_SLAB_SIZE)
+        return -1;
+
+    pthread_mutex_lock(&store->lock);
+
+    struct config_value *v = &store->values[id];
+
+    if (v->present && v->len == len && v->hash == hash && v->readonly == readonly &&
+        memcmp(&store->slab[v->offset], value, len) == 0) { // no ha canviat
+        pthread_mutex_unlock(&store->lock);
+        return 0;
+    }
+
+    if (!v->present || len + 1 > v->cap) { // no hi cap -> la poso al final de l'slab
+        v->present = false;
+        if (store->used + len + 1 > CONF_SLAB_SIZE)
+            compact_slab(store);
+
+        if (store->used + len + 1 > CONF_SLAB_SIZE) {
+            pthread_mutex_unlock(&store->lock);
+            syslog(LOG_ERR, "%s: no hi ha espai per a la clau %s del carregador %d", __func__, config_key_name(id), vars->charger_id);
+            return -1;
+        }
+
+        v->offset = store->used;
+        v->cap = len + 1;
+        store->used += len + 1;
+    }
+
+    memcpy(&store->slab[v->offset], value, len + 1);
+    v->len = len;
+    v->hash = hash;
+    v->readonly = readonly;
+    v->present = true;
+    v->version = ++store->version;
+
+    pthread_mutex_unlock(&store->lock);
+
+    return 1;
+}
+
+/*
+ *  NAME
+ *      config_get - Retorna el valor d'una clau d'un carregador
+ *  SYNOPSIS
+ *      bool config_get(const ChargerVars *vars, int id, char *value, size_t len);
+ *  DESCRIPTION
+ *      Copia a value (de mida len) el valor de la clau de configuració del carregador.
+ *  RETURN VALUE
+ *      Retorna true si el carregador ha enviat la clau.
+ *      Retorna false en cas contrari.
+ */
+bool config_get(const ChargerVars *vars, int id, char *value, size_t len)
+{
+    struct config_store *store = get_store(vars);
+    bool found = false;
+
+    if (store == NULL || id < 0 || id >= CONF_MAX_KEYS)
+        return false;
+
+    pthread_mutex_lock(&store->lock);
+    if (store->values[id].present) {
+        snprintf(value, len, "%s", &store->slab[store->values[id].offset]);
+        found = true;
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    return found;
+}
+
+/*
+ *  NAME
+ *      config_get_int - Retorna el valor numèric d'una clau d'un carregador
+ *  SYNOPSIS
+ *      int64_t config_get_int(const ChargerVars *vars, int id, int64_t def);
+ *  DESCRIPTION
+ *      Retorna el valor de la clau de configuració del carregador com a enter.
+ *  RETURN VALUE
+ *      El valor (def si el carregador no ha enviat la clau o no és un número).
+ */
+int64_t config_get_int(const ChargerVars *vars, int id, int64_t def)
+{
+    char value[32];
+    char *end;
+
+    if (!config_get(vars, id, value, sizeof(value)))
+        return def;
+
+    int64_t n = strtoll(value, &end, 10);
+
+    return (end == value || *end != '\0') ? def : n;
+}
+
+/*
+ *  NAME
+ *      config_version - Retorna la versió de les claus d'un carregador
+ *  SYNOPSIS
+ *      uint64_t config_version(const ChargerVars *vars);
+ *  DESCRIPTION
+ *      Retorna la versió de les claus de configuració del carregador, que s'incrementa a cada canvi.
+ *  RETURN VALUE
+ *      La versió.
+ */
+uint64_t config_version(const ChargerVars *vars)
+{
+    struct config_store *store = get_store(vars);
+    uint64_t version;
+
+    if (store == NULL)
+        return 0;
+
+    pthread_mutex_lock(&store->lock);
+    version = store->version;
+    pthread_mutex_unlock(&store->lock);
+
+    return version;
+}
+
+/*
+ *  NAME
+ *      config_changed_since - Retorna les claus que han canviat des d'una versió
+ *  SYNOPSIS
+ *      int config_changed_since(const ChargerVars *vars, uint64_t version, int *ids, int max_ids);
+ *  DESCRIPTION
+ *      Guarda a ids (com a màxim max_ids) els identificadors de les claus del carregador que han
+ *      canviat després de la versió version.
+ *  RETURN VALUE
+ *      El nombre de claus que han canviat (pot ser més gran que max_ids).
+ */
+int config_changed_since(const ChargerVars *vars, uint64_t version, int *ids, int max_ids)
+{
+    struct config_store *store = get_store(vars);
+    int count = 0;
+
+    if (store == NULL)
+        return 0;
+
+    pthread_mutex_lock(&store->lock);
+    for (int id = 0; id < CONF_MAX_KEYS; id++) {
+        if (store->values[id].present && store->values[id].version > version) {
+            if (count < max_ids)
+                ids[count] = id;
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    return count;
+}
+
+/*
+ *  NAME
+ *      hash_string - Hash FNV-1a
+ *  SYNOPSIS
+ *      static uint32_t hash_string(const char *s, size_t len);
+ *  DESCRIPTION
+ *      Calcula el hash FNV-1a de 32 bits dels len primers bytes de s.
+ *  RETURN VALUE
+ *      El hash.
+ */
+static uint32_t hash_string(const char *s, size_t len)
+{
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)s[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/*
+ *  NAME
+ *      get_slot - Retorna la posició d'una clau a la taula de hash
+ *  SYNOPSIS
+ *      static unsigned int get_slot(const char *key);
+ *  DESCRIPTION
+ *      Barreja el hash de la clau amb CONF_HASH_SEED i en agafa els CONF_HASH_BITS bits de dalt.
+ *  RETURN VALUE
+ *      La posició a key_slots.
+ */
+static unsigned int get_slot(const char *key)
+{
+    uint32_t hash = (hash_string(key, strlen(key)) ^ CONF_HASH_SEED) * 0x9E3779B1u;
+
+    return hash >> (32 - CONF_HASH_BITS);
+}
+
+/*
+ *  NAME
+ *      get_store - Retorna el magatzem d'un carregador
+ *  SYNOPSIS
+ *      static struct config_store *get_store(const ChargerVars *vars);
+ *  DESCRIPTION
+ *      Retorna el magatzem de claus de configuració del carregador.
+ *  RETURN VALUE
+ *      El magatzem (NULL si el carregador no és vàlid).
+ */
+static struct config_store *get_store(const ChargerVars *vars)
+{
+    if (vars == NULL || vars->charger_id < 0 || vars->charger_id > MAX_CHARGERS)
+        return NULL;
+
+    return &stores[vars->charger_id];
+}
+
+/*
+ *  NAME
+ *      compact_slab - Compacta l'slab d'un carregador
+ *  SYNOPSIS
+ *      static void compact_slab(struct config_store *store);
+ *  DESCRIPTION
+ *      Torna a posar seguits els valors de les claus presents, alliberant l'espai dels valors
+ *      que s'han mogut. S'ha de cridar amb el lock del magatzem agafat.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void compact_slab(struct config_store *store)
+{
+    char tmp[CONF_SLAB_SIZE];
+    uint16_t used = 0;
+
+    for (int id = 0; id < CONF_MAX_KEYS; id++) {
+        struct config_value *v = &store->values[id];
+        if (!v->present)
+            continue;
+
+        memcpy(&tmp[used], &store->slab[v->offset], v->len + 1);
+        v->offset = used;
+        v->cap = v->len + 1;
+        used += v->cap;
+    }
+
+    memcpy(store->slab, tmp, used);
+    store->used = used;
+}
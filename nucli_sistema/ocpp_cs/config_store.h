@@ -0,0 +1,90 @@
+/*
+ *  FILE
+ *      config_store.h - header de config_store.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header del magatzem de claus de configuració dels carregadors.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _CONFIG_STORE_H_
+#define _CONFIG_STORE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ocpp_cs.h"
+
+#define CONF_HASH_BITS 7            // la taula de hash de les claus conegudes té 2^CONF_HASH_BITS posicions
+#define CONF_HASH_SEED 2848u        // llavor amb la qual el hash de les claus conegudes no té col·lisions
+#define CONF_MAX_VENDOR_KEYS 32     // màxim de claus de fabricant diferents de tot el sistema
+#define CONF_SLAB_SIZE 8192         // bytes per guardar els valors de les claus de cada carregador
+#define CONF_KEY_LEN 50             // mida màxima d'una clau establerta pel protocol
+
+// claus de configuració conegudes (OCPP 1.6: Core, Local Auth List Management, Reservation i Smart Charging)
+enum config_key_id {
+    CONF_ALLOW_OFFLINE_TX_FOR_UNKNOWN_ID,
+    CONF_AUTHORIZATION_CACHE_ENABLED,
+    CONF_AUTHORIZE_REMOTE_TX_REQUESTS,
+    CONF_BLINK_REPEAT,
+    CONF_CLOCK_ALIGNED_DATA_INTERVAL,
+    CONF_CONNECTION_TIME_OUT,
+    CONF_CONNECTOR_PHASE_ROTATION,
+    CONF_CONNECTOR_PHASE_ROTATION_MAX_LENGTH,
+    CONF_GET_CONFIGURATION_MAX_KEYS,
+    CONF_HEARTBEAT_INTERVAL,
+    CONF_LIGHT_INTENSITY,
+    CONF_LOCAL_AUTHORIZE_OFFLINE,
+    CONF_LOCAL_PRE_AUTHORIZE,
+    CONF_MAX_ENERGY_ON_INVALID_ID,
+    CONF_METER_VALUES_ALIGNED_DATA,
+    CONF_METER_VALUES_ALIGNED_DATA_MAX_LENGTH,
+    CONF_METER_VALUES_SAMPLED_DATA,
+    CONF_METER_VALUES_SAMPLED_DATA_MAX_LENGTH,
+    CONF_METER_VALUE_SAMPLE_INTERVAL,
+    CONF_MINIMUM_STATUS_DURATION,
+    CONF_NUMBER_OF_CONNECTORS,
+    CONF_RESET_RETRIES,
+    CONF_STOP_TRANSACTION_ON_EV_SIDE_DISCONNECT,
+    CONF_STOP_TRANSACTION_ON_INVALID_ID,
+    CONF_STOP_TXN_ALIGNED_DATA,
+    CONF_STOP_TXN_ALIGNED_DATA_MAX_LENGTH,
+    CONF_STOP_TXN_SAMPLED_DATA,
+    CONF_STOP_TXN_SAMPLED_DATA_MAX_LENGTH,
+    CONF_SUPPORTED_FEATURE_PROFILES,
+    CONF_SUPPORTED_FEATURE_PROFILES_MAX_LENGTH,
+    CONF_TRANSACTION_MESSAGE_ATTEMPTS,
+    CONF_TRANSACTION_MESSAGE_RETRY_INTERVAL,
+    CONF_UNLOCK_CONNECTOR_ON_EV_SIDE_DISCONNECT,
+    CONF_WEB_SOCKET_PING_INTERVAL,
+    CONF_LOCAL_AUTH_LIST_ENABLED,
+    CONF_LOCAL_AUTH_LIST_MAX_LENGTH,
+    CONF_SEND_LOCAL_LIST_MAX_LENGTH,
+    CONF_RESERVE_CONNECTOR_ZERO_SUPPORTED,
+    CONF_CHARGE_PROFILE_MAX_STACK_LEVEL,
+    CONF_CHARGING_SCHEDULE_ALLOWED_CHARGING_RATE_UNIT,
+    CONF_CHARGING_SCHEDULE_MAX_PERIODS,
+    CONF_CONNECTOR_SWITCH_3_TO_1_PHASE_SUPPORTED,
+    CONF_MAX_CHARGING_PROFILES_INSTALLED,
+    CONF_KNOWN_KEYS                 // nombre de claus conegudes, les de fabricant van a continuació
+};
+
+#define CONF_MAX_KEYS (CONF_KNOWN_KEYS + CONF_MAX_VENDOR_KEYS)
+
+void config_init(void);
+void config_reset(const ChargerVars *vars);
+int config_key_id(const char *key);
+int config_key_intern(const char *key);
+const char *config_key_name(int id);
+
+int config_set(const ChargerVars *vars, int id, const char *value, bool readonly);
+bool config_get(const ChargerVars *vars, int id, char *value, size_t len);
+int64_t config_get_int(const ChargerVars *vars, int id, int64_t def);
+uint64_t config_version(const ChargerVars *vars);
+int config_changed_since(const ChargerVars *vars, uint64_t version, int *ids, int max_ids);
+
+#endif
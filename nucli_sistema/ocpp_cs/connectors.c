@@ -0,0 +1,731 @@
+/*
+ *  FILE
+ *      connectors.c - taula d'estat dels connectors dels carregadors
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      L'estat dels connectors de tots els carregadors es guarda en una sola taula d'arrays
+ *      (status, transactionId i idTag per separat) repartida en CONN_POOL_SLOTS slots. Cada carregador
+ *      té un bloc de slots consecutius (el connector 0 i un per connector), de la mida del seu
+ *      NumberOfConnectors, que es reserva amb un bitmap. Els estats d'un carregador ocupen pocs bytes
+ *      seguits, de manera que consultar l'estat de tots els carregadors toca molt poques línies de
+ *      memòria cau, i els idTags, que només es fan servir en iniciar i acabar transaccions, queden a part.
+ *      A més, per cada estat hi ha un bitset amb un bit per slot, que s'actualitza cada vegada que canvia
+ *      l'estat d'un connector. Així es pot saber quants connectors hi ha en cada estat amb un popcount
+ *      i buscar el connector lliure més proper amb clz i ctz, recorrent els bitsets d'una paraula de
+ *      64 bits (CONN_POOL_WORDS per bitset) a la vegada.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <strings.h>
+#include <pthread.h>
+#include <syslog.h>
+#include "ocpp_cs.h"
+#include "transaction_index.h"
+#include "session_ledger.h"
+#include "connectors.h"
+
+// taula dels connectors (estructura d'arrays)
+static struct {
+    int8_t status[CONN_POOL_SLOTS];                 // estat del connector, CONN_<>
+    int64_t transaction_id[CONN_POOL_SLOTS];        // transacció activa del connector, -1 si no n'hi ha
+    int8_t error_code[CONN_POOL_SLOTS];             // errorCode de l'últim StatusNotification, -1 si no se sap
+    char id_tag[CONN_POOL_SLOTS][ID_TAG_LEN];       // idTag de la transacció activa, "no_charging" si no n'hi ha
+} pool;
+
+static uint64_t slot_bitmap[CONN_POOL_WORDS];                   // slots reservats
+static uint64_t zero_bitmap[CONN_POOL_WORDS];                   // slots que són el connector 0 d'un carregador
+static uint64_t status_bits[CONN_NUM_STATUSES][CONN_POOL_WORDS]; // slots reservats que estan en cada estat
+static int16_t slot_charger[CONN_POOL_SLOTS];                   // carregador de cada slot reservat
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;   // els canvis de conn_run es fan amb pool_lock agafat
+
+// camps de conn_run
+#define RUN_BASE(run) ((int)((run) >> 16))              // primer slot (el del connector 0)
+#define RUN_CONNECTORS(run) ((int)((run) & 0xffff))     // nombre de connectors, sense el 0
+
+// noms dels estats, en el mateix ordre que els defines CONN_<>
+static const char *status_names[CONN_NUM_STATUSES] = {
+    "Available", "Charging", "Faulted", "Finishing", "Preparing",
+    "Reserved", "SuspendedEV", "SuspendedEVSE", "Unavailable", "Unknown"
+};
+
+// Prototips de les funcions
+static uint32_t load_run(const ChargerVars *vars);
+static void store_run(ChargerVars *vars, int base, int num_connectors);
+static int find_slot(const ChargerVars *vars, int connector);
+static uint64_t run_mask(int word, int base, int len);
+static bool run_free(int base, int len);
+static void mark_run(int base, int len, bool reserved);
+static void mark_status(int slot, int old_status, int new_status);
+static int last_bit(const uint64_t bits[CONN_POOL_WORDS], int pos);
+static int next_bit(const uint64_t bits[CONN_POOL_WORDS], int pos);
+static int nearest_bit(const uint64_t bits[CONN_POOL_WORDS], int pos);
+
+/*
+ *  NAME
+ *      connectors_alloc - Reserva els connectors d'un carregador
+ *  SYNOPSIS
+ *      bool connectors_alloc(ChargerVars *vars, int num_connectors);
+ *  DESCRIPTION
+ *      Reserva num_connectors connectors (més el connector 0) per al carregador. Si el carregador
+ *      ja en tenia, es conserva l'estat dels connectors que continuen existint i s'alliberen els antics.
+ *      Els connectors nous comencen amb l'estat CONN_UNKNOWN i sense transacció. Les transaccions
+ *      actives dels connectors que deixen d'existir es tanquen (motiu Other) i s'esborren de l'índex.
+ *  RETURN VALUE
+ *      Retorna true si s'han pogut reservar.
+ *      Retorna false en cas contrari (el carregador es queda amb els connectors que tenia).
+ */
+bool connectors_alloc(ChargerVars *vars, int num_connectors)
+{
+    int len = num_connectors + 1;
+    int base = -1;
+    int64_t dropped[MAX_CONNECTORS + 1]; // transaccions actives dels connectors que deixen d'existir
+    int num_dropped = 0;
+
+    if (num_connectors < 1 || num_connectors > MAX_CONNECTORS) {
+        syslog(LOG_WARNING, "%s: nombre de connectors no vàlid: %d", __func__, num_connectors);
+        return false;
+    }
+
+    if (num_connectors == RUN_CONNECTORS(load_run(vars)))
+        return true;
+
+    pthread_mutex_lock(&pool_lock);
+    uint32_t run = load_run(vars);
+
+    for (int i = 0; i + len <= CONN_POOL_SLOTS; i++) {
+        if (run_free(i, len)) {
+            base = i;
+            break;
+        }
+    }
+
+    if (base == -1) {
+        pthread_mutex_unlock(&pool_lock);
+        syslog(LOG_ERR, "%s: no queden slots per als %d connectors del carregador %d", __func__, num_connectors, vars->charger_id);
+        return false;
+    }
+
+    mark_run(base, len, true);
+
+    int old_base = RUN_BASE(run);
+    int old_len = RUN_CONNECTORS(run) + 1;
+    bool had_slots = RUN_CONNECTORS(run) > 0;
+
+    for (int i = 0; i < len; i++) {
+        if (had_slots && i < old_len) { // el connector ja existia -> en conservo l'estat
+            pool.status[base + i] = pool.status[old_base + i];
+            pool.transaction_id[base + i] = pool.transaction_id[old_base + i];
+            pool.error_code[base + i] = pool.error_code[old_base + i];
+            memcpy(pool.id_tag[base + i], pool.id_tag[old_base + i], ID_TAG_LEN);
+        }
+        else {
+            pool.status[base + i] = CONN_UNKNOWN;
+            pool.transaction_id[base + i] = -1;
+            pool.error_code[base + i] = -1;
+            snprintf(pool.id_tag[base + i], ID_TAG_LEN, "%s", "no_charging");
+        }
+        slot_charger[base + i] = vars->charger_id;
+        mark_status(base + i, -1, pool.status[base + i]);
+    }
+    __atomic_fetch_or(&zero_bitmap[base / 64], 1ULL << (base % 64), __ATOMIC_RELAXED);
+
+    store_run(vars, base, num_connectors); // a partir d'aquí els altres threads llegeixen els slots nous
+
+    if (had_slots) {
+        for (int i = 0; i < old_len; i++) {
+            if (i >= len && pool.transaction_id[old_base + i] != -1)
+                dropped[num_dropped++] = pool.transaction_id[old_base + i];
+            mark_status(old_base + i, pool.status[old_base + i], -1);
+        }
+        __atomic_fetch_and(&zero_bitmap[old_base / 64], ~(1ULL << (old_base % 64)), __ATOMIC_RELAXED);
+        mark_run(old_base, old_len, false);
+    }
+
+    pthread_mutex_unlock(&pool_lock);
+
+    syslog(LOG_DEBUG, "%s: carregador %d amb %d connectors (slots %d-%d)", __func__, vars->charger_id, num_connectors,
+        base, base + num_connectors);
+
+    for (int i = 0; i < num_dropped; i++) {
+        struct tx_info tx;
+
+        syslog(LOG_WARNING, "%s: el carregador %d ja no té el connector de la transacció %ld, es tanca", __func__,
+            vars->charger_id, dropped[i]);
+        if (tx_index_remove(dropped[i], &tx))
+            session_ledger_close(&tx, -1, "Other");
+    }
+
+    return true;
+}
+
+/*
+ *  NAME
+ *      connectors_free - Allibera els connectors d'un carregador
+ *  SYNOPSIS
+ *      void connectors_free(ChargerVars *vars);
+ *  DESCRIPTION
+ *      Allibera els slots dels connectors del carregador.
+ *  RETURN VALUE
+ *      Res.
+ */
+void connectors_free(ChargerVars *vars)
+{
+    pthread_mutex_lock(&pool_lock);
+
+    uint32_t run = load_run(vars);
+    int base = RUN_BASE(run);
+    int num_connectors = RUN_CONNECTORS(run);
+    store_run(vars, 0, 0);
+
+    if (num_connectors > 0) {
+        for (int i = 0; i <= num_connectors; i++)
+            mark_status(base + i, pool.status[base + i], -1);
+        __atomic_fetch_and(&zero_bitmap[base / 64], ~(1ULL << (base % 64)), __ATOMIC_RELAXED);
+        mark_run(base, num_connectors + 1, false);
+    }
+
+    pthread_mutex_unlock(&pool_lock);
+}
+
+/*
+ *  NAME
+ *      connectors_count - Retorna el nombre de connectors d'un carregador
+ *  SYNOPSIS
+ *      int connectors_count(const ChargerVars *vars);
+ *  DESCRIPTION
+ *      Retorna el nombre de connectors del carregador, sense comptar el connector 0.
+ *  RETURN VALUE
+ *      El nombre de connectors (0 si no en té de reservats).
+ */
+int connectors_count(const ChargerVars *vars)
+{
+    return RUN_CONNECTORS(load_run(vars));
+}
+
+/*
+ *  NAME
+ *      connector_status - Retorna l'estat d'un connector
+ *  SYNOPSIS
+ *      int64_t connector_status(const ChargerVars *vars, int connector);
+ *  DESCRIPTION
+ *      Retorna l'estat d'un connector del carregador.
+ *  RETURN VALUE
+ *      Un dels defines CONN_<> (CONN_UNKNOWN si el connector no existeix).
+ */
+int64_t connector_status(const ChargerVars *vars, int connector)
+{
+    int slot = find_slot(vars, connector);
+
+    return slot < 0 ? CONN_UNKNOWN : pool.status[slot];
+}
+
+/*
+ *  NAME
+ *      connector_set_status - Canvia l'estat d'un connector
+ *  SYNOPSIS
+ *      void connector_set_status(ChargerVars *vars, int connector, int64_t status);
+ *  DESCRIPTION
+ *      Canvia l'estat d'un connector del carregador i dels bitsets d'estats.
+ *      Si el connector o l'estat no existeixen no fa res.
+ *  RETURN VALUE
+ *      Res.
+ */
+void connector_set_status(ChargerVars *vars, int connector, int64_t status)
+{
+    int slot = find_slot(vars, connector);
+
+    if (slot >= 0 && status >= 0 && status < CONN_NUM_STATUSES && pool.status[slot] != status) {
+        mark_status(slot, pool.status[slot], status);
+        pool.status[slot] = (int8_t)status;
+    }
+}
+
+/*
+ *  NAME
+ *      connector_error_code - Retorna l'errorCode d'un connector
+ *  SYNOPSIS
+ *      int connector_error_code(const ChargerVars *vars, int connector);
+ *  DESCRIPTION
+ *      Retorna l'errorCode de l'últim StatusNotification d'un connector del carregador.
+ *  RETURN VALUE
+ *      L'errorCode (-1 si no se sap o el connector no existeix).
+ */
+int connector_error_code(const ChargerVars *vars, int connector)
+{
+    int slot = find_slot(vars, connector);
+
+    return slot < 0 ? -1 : pool.error_code[slot];
+}
+
+/*
+ *  NAME
+ *      connector_set_error_code - Canvia l'errorCode d'un connector
+ *  SYNOPSIS
+ *      void connector_set_error_code(ChargerVars *vars, int connector, int error_code);
+ *  DESCRIPTION
+ *      Guarda l'errorCode de l'últim StatusNotification d'un connector del carregador.
+ *  RETURN VALUE
+ *      Res.
+ */
+void connector_set_error_code(ChargerVars *vars, int connector, int error_code)
+{
+    int slot = find_slot(vars, connector);
+
+    if (slot >= 0)
+        pool.error_code[slot] = (int8_t)error_code;
+}
+
+/*
+ *  NAME
+ *      connector_transaction - Retorna la transacció activa d'un connector
+ *  SYNOPSIS
+ *      int64_t connector_transaction(const ChargerVars *vars, int connector);
+ *  DESCRIPTION
+ *      Retorna el transactionId de la transacció activa d'un connector del carregador.
+ *  RETURN VALUE
+ *      El transactionId (-1 si no n'hi ha o el connector no existeix).
+ */
+int64_t connector_transaction(const ChargerVars *vars, int connector)
+{
+    int slot = find_slot(vars, connector);
+
+    return slot < 0 ? -1 : pool.transaction_id[slot];
+}
+
+/*
+ *  NAME
+ *      connector_set_transaction - Canvia la transacció activa d'un connector
+ *  SYNOPSIS
+ *      void connector_set_transaction(ChargerVars *vars, int connector, int64_t transaction_id);
+ *  DESCRIPTION
+ *      Canvia el transactionId de la transacció activa d'un connector del carregador (-1 si no n'hi ha).
+ *  RETURN VALUE
+ *      Res.
+ */
+void connector_set_transaction(ChargerVars *vars, int connector, int64_t transaction_id)
+{
+    int slot = find_slot(vars, connector);
+
+    if (slot >= 0)
+        pool.transaction_id[slot] = transaction_id;
+}
+
+/*
+ *  NAME
+ *      connector_id_tag - Retorna l'idTag de la transacció d'un connector
+ *  SYNOPSIS
+ *      const char *connector_id_tag(const ChargerVars *vars, int connector);
+ *  DESCRIPTION
+ *      Retorna l'idTag amb el qual s'ha iniciat la transacció activa d'un connector del carregador.
+ *  RETURN VALUE
+ *      L'idTag ("no_charging" si no hi ha transacció o el connector no existeix).
+ */
+const char *connector_id_tag(const ChargerVars *vars, int connector)
+{
+    int slot = find_slot(vars, connector);
+
+    return slot < 0 ? "no_charging" : pool.id_tag[slot];
+}
+
+/*
+ *  NAME
+ *      connector_set_id_tag - Canvia l'idTag de la transacció d'un connector
+ *  SYNOPSIS
+ *      void connector_set_id_tag(ChargerVars *vars, int connector, const char *id_tag);
+ *  DESCRIPTION
+ *      Canvia l'idTag de la transacció activa d'un connector del carregador ("no_charging" si no n'hi ha).
+ *  RETURN VALUE
+ *      Res.
+ */
+void connector_set_id_tag(ChargerVars *vars, int connector, const char *id_tag)
+{
+    int slot = find_slot(vars, connector);
+
+    if (slot >= 0)
+        snprintf(pool.id_tag[slot], ID_TAG_LEN, "%s", id_tag);
+}
+
+/*
+ *  NAME
+ *      connector_find_transaction - Busca el connector d'una transacció
+ *  SYNOPSIS
+ *      int connector_find_transaction(const ChargerVars *vars, int64_t transaction_id);
+ *  DESCRIPTION
+ *      Busca quin connector del carregador té la transacció activa transaction_id.
+ *  RETURN VALUE
+ *      El connector (-1 si cap connector té la transacció).
+ */
+int connector_find_transaction(const ChargerVars *vars, int64_t transaction_id)
+{
+    uint32_t run = load_run(vars);
+    int base = RUN_BASE(run);
+
+    for (int i = 0; i <= RUN_CONNECTORS(run) && RUN_CONNECTORS(run) > 0; i++) {
+        if (pool.transaction_id[base + i] == transaction_id)
+            return i;
+    }
+
+    return -1;
+}
+
+/*
+ *  NAME
+ *      connector_find_id_tag - Busca el connector que carrega amb un idTag
+ *  SYNOPSIS
+ *      int connector_find_id_tag(const ChargerVars *vars, const char *id_tag);
+ *  DESCRIPTION
+ *      Busca quin connector del carregador té una transacció activa iniciada amb id_tag.
+ *      Si n'hi ha més d'un, retorna l'últim.
+ *  RETURN VALUE
+ *      El connector (-1 si cap connector carrega amb l'idTag).
+ */
+int connector_find_id_tag(const ChargerVars *vars, const char *id_tag)
+{
+    uint32_t run = load_run(vars);
+    int base = RUN_BASE(run);
+
+    for (int i = RUN_CONNECTORS(run); i >= 0 && RUN_CONNECTORS(run) > 0; i--) {
+        if (strcasecmp(pool.id_tag[base + i], id_tag) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/*
+ *  NAME
+ *      connectors_count_status - Compta els connectors que estan en un estat
+ *  SYNOPSIS
+ *      int connectors_count_status(int64_t status);
+ *  DESCRIPTION
+ *      Compta els connectors de tots els carregadors que estan en l'estat status, sense comptar
+ *      els connectors 0.
+ *  RETURN VALUE
+ *      El nombre de connectors.
+ */
+int connectors_count_status(int64_t status)
+{
+    int count = 0;
+
+    if (status < 0 || status >= CONN_NUM_STATUSES)
+        return 0;
+
+    for (int w = 0; w < CONN_POOL_WORDS; w++) {
+        uint64_t bits = __atomic_load_n(&status_bits[status][w], __ATOMIC_RELAXED) &
+                        ~__atomic_load_n(&zero_bitmap[w], __ATOMIC_RELAXED);
+        count += __builtin_popcountll(bits);
+    }
+
+    return count;
+}
+
+/*
+ *  NAME
+ *      connectors_status_counts - Compta els connectors de cada estat
+ *  SYNOPSIS
+ *      void connectors_status_counts(int counts[CONN_NUM_STATUSES]);
+ *  DESCRIPTION
+ *      Guarda a counts quants connectors hi ha en cada estat (índex CONN_<>).
+ *  RETURN VALUE
+ *      Res.
+ */
+void connectors_status_counts(int counts[CONN_NUM_STATUSES])
+{
+    for (int i = 0; i < CONN_NUM_STATUSES; i++)
+        counts[i] = connectors_count_status(i);
+}
+
+/*
+ *  NAME
+ *      connectors_find_nearest - Busca el connector més proper en un estat
+ *  SYNOPSIS
+ *      bool connectors_find_nearest(int64_t status, const ChargerVars *vars, int connector, int *found_charger, int *found_connector);
+ *  DESCRIPTION
+ *      Busca un connector en l'estat status (p.ex. CONN_AVAILABLE), començant pel mateix carregador
+ *      que el connector de referència i, si no n'hi ha cap, pel slot més proper de la resta de carregadors.
+ *      Els connectors 0 no es tenen en compte.
+ *  RETURN VALUE
+ *      Retorna true si l'ha trobat, i guarda el carregador i el connector a found_charger i found_connector.
+ *      Retorna false en cas contrari.
+ */
+bool connectors_find_nearest(int64_t status, const ChargerVars *vars, int connector, int *found_charger, int *found_connector)
+{
+    if (status < 0 || status >= CONN_NUM_STATUSES)
+        return false;
+
+    pthread_mutex_lock(&pool_lock); // els slots no es poden moure mentre es busca
+
+    uint64_t bits[CONN_POOL_WORDS];
+    uint64_t own = 0; // connectors en l'estat status del mateix carregador
+    uint32_t run = load_run(vars);
+    int pos = find_slot(vars, connector);
+    int slot = -1;
+
+    for (int w = 0; w < CONN_POOL_WORDS; w++) {
+        bits[w] = __atomic_load_n(&status_bits[status][w], __ATOMIC_RELAXED) & ~zero_bitmap[w];
+        if (pos >= 0)
+            own |= bits[w] & run_mask(w, RUN_BASE(run), RUN_CONNECTORS(run) + 1);
+    }
+
+    if (pos < 0) // el connector de referència no existeix -> busco des del principi
+        pos = 0;
+    else if (own != 0) { // primer al mateix carregador
+        for (int w = 0; w < CONN_POOL_WORDS; w++)
+            bits[w] &= run_mask(w, RUN_BASE(run), RUN_CONNECTORS(run) + 1);
+    }
+
+    slot = nearest_bit(bits, pos);
+    if (slot >= 0) {
+        int base = last_bit(zero_bitmap, slot); // connector 0 del carregador del slot
+        *found_charger = slot_charger[slot];
+        *found_connector = slot - base;
+    }
+
+    pthread_mutex_unlock(&pool_lock);
+
+    return slot >= 0;
+}
+
+/*
+ *  NAME
+ *      connectors_fleet_json - Estat de tots els connectors en JSON
+ *  SYNOPSIS
+ *      int connectors_fleet_json(char *buf, size_t len);
+ *  DESCRIPTION
+ *      Escriu a buf el missatge per a la web amb quants connectors hi ha en cada estat.
+ *  RETURN VALUE
+ *      El nombre de caràcters escrits (com snprintf).
+ */
+int connectors_fleet_json(char *buf, size_t len)
+{
+    int counts[CONN_NUM_STATUSES];
+    int n;
+
+    connectors_status_counts(counts);
+
+    n = snprintf(buf, len, "{\"type\": \"fleetStatus\", \"counts\": {");
+    for (int i = 0; i < CONN_NUM_STATUSES && n < (int)len; i++)
+        n += snprintf(buf + n, len - n, "%s\"%s\": %d", i ? ", " : "", status_names[i], counts[i]);
+    if (n < (int)len)
+        n += snprintf(buf + n, len - n, "}}");
+
+    return n;
+}
+
+/*
+ *  NAME
+ *      find_slot - Retorna el slot d'un connector
+ *  SYNOPSIS
+ *      static int find_slot(const ChargerVars *vars, int connector);
+ *  DESCRIPTION
+ *      Calcula la posició d'un connector del carregador a la taula, a partir d'una sola lectura de conn_run.
+ *  RETURN VALUE
+ *      La posició (-1 si el connector no existeix).
+ */
+static int find_slot(const ChargerVars *vars, int connector)
+{
+    uint32_t run = load_run(vars);
+
+    if (RUN_CONNECTORS(run) == 0 || connector < 0 || connector > RUN_CONNECTORS(run))
+        return -1;
+
+    return RUN_BASE(run) + connector;
+}
+
+/*
+ *  NAME
+ *      load_run - Llegeix els connectors d'un carregador a la taula
+ *  SYNOPSIS
+ *      static uint32_t load_run(const ChargerVars *vars);
+ *  DESCRIPTION
+ *      Llegeix atòmicament conn_run (primer slot i nombre de connectors), de manera que tots dos
+ *      valors són del mateix bloc encara que un altre thread el mogui alhora.
+ *  RETURN VALUE
+ *      El valor de conn_run (es llegeix amb RUN_BASE i RUN_CONNECTORS).
+ */
+static uint32_t load_run(const ChargerVars *vars)
+{
+    return __atomic_load_n(&vars->conn_run, __ATOMIC_ACQUIRE);
+}
+
+/*
+ *  NAME
+ *      store_run - Publica els connectors d'un carregador a la taula
+ *  SYNOPSIS
+ *      static void store_run(ChargerVars *vars, int base, int num_connectors);
+ *  DESCRIPTION
+ *      Guarda atòmicament el primer slot i el nombre de connectors del carregador a conn_run, després
+ *      que l'estat dels slots ja estigui escrit. S'ha de cridar amb pool_lock agafat.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void store_run(ChargerVars *vars, int base, int num_connectors)
+{
+    __atomic_store_n(&vars->conn_run, (uint32_t)base << 16 | (uint32_t)num_connectors, __ATOMIC_RELEASE);
+}
+
+/*
+ *  NAME
+ *      run_mask - Màscara d'un bloc de slots dins d'una paraula
+ *  SYNOPSIS
+ *      static uint64_t run_mask(int word, int base, int len);
+ *  DESCRIPTION
+ *      Retorna la màscara de la paraula word d'un bitmap amb els bits dels len slots que comencen a base.
+ *  RETURN VALUE
+ *      La màscara (0 si cap slot del bloc és a la paraula).
+ */
+static uint64_t run_mask(int word, int base, int len)
+{
+    int low = base - word * 64;     // primer bit del bloc dins de la paraula
+    int high = low + len;           // bit següent a l'últim
+
+    if (low < 0)
+        low = 0;
+    if (high > 64)
+        high = 64;
+    if (high <= low)
+        return 0;
+
+    return (high - low == 64 ? ~0ULL : (1ULL << (high - low)) - 1) << low;
+}
+
+/*
+ *  NAME
+ *      run_free - Comprova si un bloc de slots està lliure
+ *  SYNOPSIS
+ *      static bool run_free(int base, int len);
+ *  DESCRIPTION
+ *      Comprova si cap dels len slots que comencen a base està reservat. S'ha de cridar amb pool_lock agafat.
+ *  RETURN VALUE
+ *      Retorna true si tots estan lliures.
+ *      Retorna false en cas contrari.
+ */
+static bool run_free(int base, int len)
+{
+    for (int w = base / 64; w <= (base + len - 1) / 64; w++) {
+        if ((slot_bitmap[w] & run_mask(w, base, len)) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ *  NAME
+ *      mark_run - Reserva o allibera un bloc de slots
+ *  SYNOPSIS
+ *      static void mark_run(int base, int len, bool reserved);
+ *  DESCRIPTION
+ *      Marca els len slots que comencen a base com a reservats o lliures al bitmap dels slots.
+ *      S'ha de cridar amb pool_lock agafat.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void mark_run(int base, int len, bool reserved)
+{
+    for (int w = base / 64; w <= (base + len - 1) / 64; w++) {
+        if (reserved)
+            slot_bitmap[w] |= run_mask(w, base, len);
+        else
+            slot_bitmap[w] &= ~run_mask(w, base, len);
+    }
+}
+
+/*
+ *  NAME
+ *      mark_status - Mou un slot d'un bitset d'estat a un altre
+ *  SYNOPSIS
+ *      static void mark_status(int slot, int old_status, int new_status);
+ *  DESCRIPTION
+ *      Treu el slot del bitset de old_status i el posa al de new_status (-1 per no fer-ne res).
+ *      Es fa amb operacions atòmiques perquè diversos carregadors comparteixen les mateixes paraules.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void mark_status(int slot, int old_status, int new_status)
+{
+    uint64_t bit = 1ULL << (slot % 64);
+
+    if (old_status >= 0 && old_status < CONN_NUM_STATUSES)
+        __atomic_fetch_and(&status_bits[old_status][slot / 64], ~bit, __ATOMIC_RELAXED);
+    if (new_status >= 0 && new_status < CONN_NUM_STATUSES)
+        __atomic_fetch_or(&status_bits[new_status][slot / 64], bit, __ATOMIC_RELAXED);
+}
+
+/*
+ *  NAME
+ *      last_bit - Busca l'últim bit a 1 fins a una posició
+ *  SYNOPSIS
+ *      static int last_bit(const uint64_t bits[CONN_POOL_WORDS], int pos);
+ *  DESCRIPTION
+ *      Busca el bit a 1 de bits més alt que no passa de pos, amb clz, d'una paraula a la vegada.
+ *  RETURN VALUE
+ *      La posició del bit (-1 si no n'hi ha cap).
+ */
+static int last_bit(const uint64_t bits[CONN_POOL_WORDS], int pos)
+{
+    for (int w = pos / 64; w >= 0; w--) {
+        uint64_t word = bits[w];
+        if (w == pos / 64)
+            word &= run_mask(0, 0, pos % 64 + 1); // bits de la paraula fins a pos
+        if (word != 0)
+            return w * 64 + 63 - __builtin_clzll(word);
+    }
+
+    return -1;
+}
+
+/*
+ *  NAME
+ *      next_bit - Busca el primer bit a 1 després d'una posició
+ *  SYNOPSIS
+ *      static int next_bit(const uint64_t bits[CONN_POOL_WORDS], int pos);
+ *  DESCRIPTION
+ *      Busca el bit a 1 de bits més baix per sobre de pos, amb ctz, d'una paraula a la vegada.
+ *  RETURN VALUE
+ *      La posició del bit (-1 si no n'hi ha cap).
+ */
+static int next_bit(const uint64_t bits[CONN_POOL_WORDS], int pos)
+{
+    for (int w = pos / 64; w < CONN_POOL_WORDS; w++) {
+        uint64_t word = bits[w];
+        if (w == pos / 64)
+            word &= ~run_mask(0, 0, pos % 64 + 1); // bits de la paraula per sobre de pos
+        if (word != 0)
+            return w * 64 + __builtin_ctzll(word);
+    }
+
+    return -1;
+}
+
+/*
+ *  NAME
+ *      nearest_bit - Busca el bit a 1 més proper a una posició
+ *  SYNOPSIS
+ *      static int nearest_bit(const uint64_t bits[CONN_POOL_WORDS], int pos);
+ *  DESCRIPTION
+ *      Busca el bit a 1 de bits més proper a pos, mirant a banda i banda amb clz i ctz.
+ *      Si n'hi ha dos a la mateixa distància, es queda amb el de sota.
+ *  RETURN VALUE
+ *      La posició del bit (-1 si tots els bits són 0).
+ */
+static int nearest_bit(const uint64_t bits[CONN_POOL_WORDS], int pos)
+{
+    int low = last_bit(bits, pos);
+    int high = next_bit(bits, pos);
+
+    if (low < 0)
+        return high;
+    if (high < 0 || pos - low <= high - pos)
+        return low;
+
+    return high;
+}
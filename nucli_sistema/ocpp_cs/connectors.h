@@ -0,0 +1,55 @@
+/*
+ *  FILE
+ *      connectors.h - header de connectors.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header de la taula d'estat dels connectors dels carregadors.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _CONNECTORS_H_
+#define _CONNECTORS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ocpp_cs.h"
+#include "ws_server.h"
+
+#define CONN_POOL_SLOTS 1024 // slots de connector de tot el sistema (un bit del bitmap per slot)
+#define CONN_POOL_WORDS ((CONN_POOL_SLOTS + 63) / 64) // paraules de 64 bits de cada bitmap
+
+#if (MAX_CHARGERS + 1) * (MAX_CONNECTORS + 1) > CONN_POOL_SLOTS
+#error "CONN_POOL_SLOTS no és suficient per a MAX_CHARGERS carregadors de MAX_CONNECTORS connectors"
+#endif
+
+#if CONN_POOL_SLOTS > 65536
+#error "el primer slot de cada carregador es guarda en els 16 bits alts de conn_run"
+#endif
+
+bool connectors_alloc(ChargerVars *vars, int num_connectors);
+void connectors_free(ChargerVars *vars);
+int connectors_count(const ChargerVars *vars);
+
+int64_t connector_status(const ChargerVars *vars, int connector);
+void connector_set_status(ChargerVars *vars, int connector, int64_t status);
+int connector_error_code(const ChargerVars *vars, int connector);
+void connector_set_error_code(ChargerVars *vars, int connector, int error_code);
+int64_t connector_transaction(const ChargerVars *vars, int connector);
+void connector_set_transaction(ChargerVars *vars, int connector, int64_t transaction_id);
+const char *connector_id_tag(const ChargerVars *vars, int connector);
+void connector_set_id_tag(ChargerVars *vars, int connector, const char *id_tag);
+
+int connector_find_transaction(const ChargerVars *vars, int64_t transaction_id);
+int connector_find_id_tag(const ChargerVars *vars, const char *id_tag);
+
+int connectors_count_status(int64_t status);
+void connectors_status_counts(int counts[CONN_NUM_STATUSES]);
+bool connectors_find_nearest(int64_t status, const ChargerVars *vars, int connector, int *found_charger, int *found_connector);
+int connectors_fleet_json(char *buf, size_t len);
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ *  FILE
+ *      control_socket.c - socket de control local per als clients web
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Els clients web que s'executen a la mateixa màquina que el nucli (el servidor Flask) es poden
+ *      connectar pel socket local CONTROL_SOCKET_PATH (AF_UNIX, SOCK_SEQPACKET) en lloc de passar pel
+ *      servidor WebSocket, el proxy i TLS. Cada missatge del socket és un missatge sencer, amb les
+ *      mateixes ordres i els mateixos esdeveniments que els del WebSocket: els missatges rebuts es
+ *      gestionen amb web_on_receive() i els esdeveniments s'envien pel repartidor (web_hub).
+ *      Als clients del socket de control se'ls assigna un identificador de client amb el bit
+ *      CONTROL_CLIENT_FLAG a 1, de manera que la resta del sistema els tracta com un client web més.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <ws.h>
+#include "ws_server.h"
+#include "web_hub.h"
+#include "control_socket.h"
+
+static int listen_fd = -1;
+
+// Prototips de les funcions
+static void *accept_thread(void *arg);
+static void *connection_thread(void *arg);
+
+/*
+ *  NAME
+ *      control_socket_init - Crea el socket de control
+ *  SYNOPSIS
+ *      void control_socket_init(void);
+ *  DESCRIPTION
+ *      Crea el socket de control a CONTROL_SOCKET_PATH (esborrant el d'una execució anterior si
+ *      n'hi ha) i el thread que n'accepta les connexions. Només hi poden accedir els usuaris del
+ *      grup del procés. Si no es pot crear, els clients web s'han de connectar pel WebSocket.
+ *  RETURN VALUE
+ *      Res.
+ */
+void control_socket_init(void)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    pthread_t thread;
+
+    if (strlen(CONTROL_SOCKET_PATH) >= sizeof(addr.sun_path)) {
+        syslog(LOG_ERR, "%s: ERROR: el camí del socket de control és massa llarg\n", __func__);
+        return;
+    }
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", CONTROL_SOCKET_PATH);
+
+    listen_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (listen_fd < 0) {
+        syslog(LOG_ERR, "%s: ERROR creating socket: %s\n", __func__, strerror(errno));
+        return;
+    }
+
+    unlink(CONTROL_SOCKET_PATH); // socket d'una execució anterior
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || chmod(CONTROL_SOCKET_PATH, 0660) < 0
+        || listen(listen_fd, CONTROL_BACKLOG) < 0) {
+        syslog(LOG_ERR, "%s: ERROR opening %s: %s\n", __func__, CONTROL_SOCKET_PATH, strerror(errno));
+        close(listen_fd);
+        listen_fd = -1;
+        return;
+    }
+
+    if (pthread_create(&thread, NULL, accept_thread, NULL) != 0) {
+        syslog(LOG_ERR, "%s: ERROR creating thread\n", __func__);
+        close(listen_fd);
+        listen_fd = -1;
+        return;
+    }
+    pthread_detach(thread);
+
+    syslog(LOG_NOTICE, "Socket de control a %s\n", CONTROL_SOCKET_PATH);
+}
+
+/*
+ *  NAME
+ *      control_is_client - Indica si un client és del socket de control
+ *  SYNOPSIS
+ *      bool control_is_client(ws_cli_conn_t client);
+ *  DESCRIPTION
+ *      Indica si client és un client del socket de control o del servidor WebSocket.
+ *  RETURN VALUE
+ *      Retorna true si client és un client del socket de control.
+ *      Retorna false en cas contrari.
+ */
+bool control_is_client(ws_cli_conn_t client)
+{
+    return client != (ws_cli_conn_t)-1 && (client & CONTROL_CLIENT_FLAG);
+}
+
+/*
+ *  NAME
+ *      control_send - Envia un missatge a un client del socket de control
+ *  SYNOPSIS
+ *      int control_send(ws_cli_conn_t client, const char *text);
+ *  DESCRIPTION
+ *      Envia text al client com un sol missatge del socket. Pot bloquejar si el client no llegeix.
+ *  RETURN VALUE
+ *      Retorna el nombre de bytes enviats.
+ *      Retorna -1 en cas d'error.
+ */
+int control_send(ws_cli_conn_t client, const char *text)
+{
+    return send((int)(client & ~CONTROL_CLIENT_FLAG), text, strlen(text), MSG_NOSIGNAL);
+}
+
+/*
+ *  NAME
+ *      control_close - Tanca la connexió d'un client del socket de control
+ *  SYNOPSIS
+ *      void control_close(ws_cli_conn_t client);
+ *  DESCRIPTION
+ *      Tanca el socket del client. El crida el repartidor (web_hub) quan el client subscrit es
+ *      dona de baixa i ja no li ha d'enviar cap més missatge, per tal que el descriptor no es
+ *      pugui reutilitzar per un altre client mentre encara s'hi envien missatges.
+ *  RETURN VALUE
+ *      Res.
+ */
+void control_close(ws_cli_conn_t client)
+{
+    close((int)(client & ~CONTROL_CLIENT_FLAG));
+    syslog(LOG_NOTICE, "Client del socket de control desconnectat\n");
+}
+
+/*
+ *  NAME
+ *      accept_thread - Accepta les connexions del socket de control
+ *  SYNOPSIS
+ *      static void *accept_thread(void *arg);
+ *  DESCRIPTION
+ *      Accepta les connexions al socket de control i crea un thread per cadascuna.
+ *  RETURN VALUE
+ *      NULL.
+ */
+static void *accept_thread(void *arg)
+{
+    pthread_t thread;
+
+    while (1) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EINTR && errno != ECONNABORTED) {
+                syslog(LOG_ERR, "%s: ERROR accepting connection: %s\n", __func__, strerror(errno));
+                sleep(1); // p. ex. s'han acabat els descriptors, s'espera abans de tornar-ho a provar
+            }
+            continue;
+        }
+
+        if (pthread_create(&thread, NULL, connection_thread, (void *)(intptr_t)fd) != 0) {
+            syslog(LOG_ERR, "%s: ERROR creating thread\n", __func__);
+            close(fd);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+
+    return NULL;
+}
+
+/*
+ *  NAME
+ *      connection_thread - Rep els missatges d'un client del socket de control
+ *  SYNOPSIS
+ *      static void *connection_thread(void *arg);
+ *  DESCRIPTION
+ *      Rep els missatges del client connectat al socket arg i els gestiona igual que els dels
+ *      clients web del WebSocket. Quan el client tanca la connexió el dona de baixa del repartidor.
+ *  RETURN VALUE
+ *      NULL.
+ */
+static void *connection_thread(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+    ws_cli_conn_t client = CONTROL_CLIENT_FLAG | (ws_cli_conn_t)fd;
+    char *buf = malloc(CONTROL_MSG_LEN);
+    ssize_t len;
+
+    if (buf == NULL) {
+        syslog(LOG_ERR, "%s: ERROR allocating memory\n", __func__);
+        close(fd);
+        return NULL;
+    }
+
+    syslog(LOG_NOTICE, "Client del socket de control connectat\n");
+
+    while ((len = recv(fd, buf, CONTROL_MSG_LEN - 1, MSG_TRUNC)) != 0) {
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            syslog(LOG_ERR, "%s: ERROR receiving message: %s\n", __func__, strerror(errno));
+            break;
+        }
+        if (len >= CONTROL_MSG_LEN) { // amb MSG_TRUNC recv() retorna la mida real del missatge
+            syslog(LOG_WARNING, "%s: Warning: missatge massa llarg (%zd bytes), es descarta\n", __func__, len);
+            continue;
+        }
+
+        buf[len] = '\0';
+        if (!web_on_receive(client, buf, len))
+            syslog(LOG_WARNING, "%s: Warning: missatge desconegut: %s\n", __func__, buf);
+    }
+
+    free(buf);
+
+    // si estava subscrit, el thread del repartidor que li envia els missatges tanca el socket en acabar
+    if (!web_hub_unsubscribe(client))
+        control_close(client);
+
+    return NULL;
+}
@@ -0,0 +1,30 @@
+/*
+ *  FILE
+ *      control_socket.h - header de control_socket.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header del socket de control local per als clients web de la mateixa màquina.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _CONTROL_SOCKET_H_
+#define _CONTROL_SOCKET_H_
+
+#include <stdbool.h>
+#include <ws.h>
+
+#define CONTROL_SOCKET_PATH "../../servidor_web/ocpp_cs.sock"
+#define CONTROL_MSG_LEN 65536       // mida màxima d'un missatge rebut pel socket de control
+#define CONTROL_BACKLOG 4           // connexions pendents d'acceptar
+#define CONTROL_CLIENT_FLAG ((ws_cli_conn_t)1 << 63) // distingeix els clients del socket de control dels de wsServer
+
+void control_socket_init(void);
+bool control_is_client(ws_cli_conn_t client);
+int control_send(ws_cli_conn_t client, const char *text);
+void control_close(ws_cli_conn_t client);
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ *  FILE
+ *      epoch_time.c - hores en mil·lisegons des de l'epoch
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Les taules de l'historial guarden l'hora de cada fila a la columna ts com a mil·lisegons des
+ *      de l'epoch en UTC (a més del text de la columna hora per mostrar-la). Així les files s'ordenen
+ *      i es filtren per interval de temps amb els índexs, sigui quina sigui la zona horària amb què
+ *      el carregador ha enviat l'hora.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <time.h>
+#include "utils.h"
+#include "epoch_time.h"
+
+/*
+ *  NAME
+ *      epoch_ms_now - Retorna l'hora actual
+ *  SYNOPSIS
+ *      int64_t epoch_ms_now(void);
+ *  DESCRIPTION
+ *      Retorna l'hora del rellotge del sistema en mil·lisegons des de l'epoch.
+ *  RETURN VALUE
+ *      L'hora en mil·lisegons.
+ */
+int64_t epoch_ms_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ *  NAME
+ *      epoch_ms_parse - Llegeix una hora del protocol OCPP
+ *  SYNOPSIS
+ *      int64_t epoch_ms_parse(const char *timestamp);
+ *  DESCRIPTION
+ *      Passa timestamp (p. ex. "2025-01-01T10:00:00.123+01:00" o "...Z") a mil·lisegons des de
+ *      l'epoch en UTC. Les fraccions de segon són opcionals.
+ *  RETURN VALUE
+ *      L'hora en mil·lisegons.
+ *      Retorna -1 si timestamp no és correcte.
+ */
+int64_t epoch_ms_parse(const char *timestamp)
+{
+    struct tm tm;
+    int64_t ms = 0;
+
+    if (timestamp == NULL || strlen(timestamp) < 19 || strlen(timestamp) >= EPOCH_TIME_LEN ||
+        ocpp_strptime(timestamp, "%Y-%m-%dT%H:%M:%S%z", &tm, 19) == NULL)
+        return -1;
+
+    // mil·lisegons de la fracció de segon (la resta de xifres s'ignoren)
+    if (timestamp[19] == '.') {
+        const char *digit = timestamp + 20;
+        for (int i = 0; i < 3; i++) {
+            ms *= 10;
+            if (isdigit((unsigned char)*digit))
+                ms += *digit++ - '0';
+        }
+    }
+
+    long offset = tm.tm_gmtoff; // timegm() el posa a 0
+    return ((int64_t)timegm(&tm) - offset) * 1000 + ms;
+}
+
+/*
+ *  NAME
+ *      epoch_ms_format - Escriu una hora en el format del protocol OCPP
+ *  SYNOPSIS
+ *      void epoch_ms_format(int64_t ts, char *buf, size_t len);
+ *  DESCRIPTION
+ *      Escriu a buf l'hora ts (mil·lisegons des de l'epoch) en UTC, amb el format de la columna hora
+ *      ("2025-01-01T09:00:00Z").
+ *  RETURN VALUE
+ *      Res.
+ */
+void epoch_ms_format(int64_t ts, char *buf, size_t len)
+{
+    time_t t = (time_t)(ts / 1000);
+    struct tm tm;
+
+    gmtime_r(&t, &tm);
+    strftime(buf, len, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
@@ -0,0 +1,29 @@
+/*
+ *  FILE
+ *      epoch_time.h - header de epoch_time.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header de les hores en mil·lisegons des de l'epoch (UTC).
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _EPOCH_TIME_H_
+#define _EPOCH_TIME_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EPOCH_TIME_LEN 32   // mida del text d'una hora (format del protocol OCPP, en UTC)
+
+// expressió SQL que passa la columna de text col a mil·lisegons des de l'epoch (NULL si no és una hora)
+#define EPOCH_MS_SQL(col) "CAST(round((julianday(" col ") - 2440587.5) * 86400000) AS INTEGER)"
+
+int64_t epoch_ms_now(void);
+int64_t epoch_ms_parse(const char *timestamp);
+void epoch_ms_format(int64_t ts, char *buf, size_t len);
+
+#endif
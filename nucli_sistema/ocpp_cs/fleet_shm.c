@@ -0,0 +1,197 @@
+/*
+ *  FILE
+ *      fleet_shm.c - instantània de l'estat de la flota en memòria compartida
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      El nucli publica l'estat de cada carregador i dels seus connectors (estat, transacció activa,
+ *      idTag, estat del BootNotification i l'hora de l'últim missatge) a la memòria compartida
+ *      FLEET_SHM_NAME (struct fleet_shm). Els processos de la mateixa màquina (el servidor Flask,
+ *      exportadors o eines d'administració) la poden mapar només de lectura i consultar l'estat sense
+ *      enviar cap missatge al nucli ni fer-lo esperar.
+ *      La memòria està protegida per un seqlock: abans d'escriure el nucli incrementa seq (queda senar)
+ *      i quan acaba el torna a incrementar (queda parell). Per llegir-la, un procés llegeix seq, si és
+ *      senar torna a començar, copia les dades i torna a llegir seq: si no ha canviat la còpia és
+ *      coherent, si ha canviat torna a començar. Els lectors no bloquegen mai el nucli.
+ *      Cada vegada que arrenca, el nucli crea una memòria compartida nova: els lectors que la tinguin
+ *      mapada l'han de tornar a obrir si el nucli es reinicia.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ws.h>
+#include "ocpp_cs.h"
+#include "ws_server.h"
+#include "connectors.h"
+#include "fleet_shm.h"
+
+extern ChargerVars charger_vars[];
+
+static struct fleet_shm *shm = NULL;
+static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER; // només hi pot haver un escriptor alhora
+
+// Prototips de les funcions
+static void write_begin(void);
+static void write_end(void);
+
+/*
+ *  NAME
+ *      fleet_shm_init - Crea la memòria compartida de l'estat de la flota
+ *  SYNOPSIS
+ *      void fleet_shm_init(void);
+ *  DESCRIPTION
+ *      Crea la memòria compartida FLEET_SHM_NAME (esborrant la d'una execució anterior), la mapa i hi
+ *      escriu l'estat inicial dels carregadors. S'ha de cridar després d'inicialitzar charger_vars.
+ *      Si no es pot crear, el nucli continua funcionant sense publicar l'estat.
+ *  RETURN VALUE
+ *      Res.
+ */
+void fleet_shm_init(void)
+{
+    struct fleet_shm *mem;
+    int fd;
+
+    shm_unlink(FLEET_SHM_NAME); // els lectors que tinguin mapada l'anterior no veuen com es buida
+    fd = shm_open(FLEET_SHM_NAME, O_RDWR | O_CREAT | O_EXCL, 0660);
+    if (fd < 0) {
+        syslog(LOG_ERR, "%s: ERROR opening %s: %s\n", __func__, FLEET_SHM_NAME, strerror(errno));
+        return;
+    }
+
+    // els mateixos permisos que el socket de control, sense dependre de la umask
+    if (fchmod(fd, 0660) < 0)
+        syslog(LOG_WARNING, "%s: ERROR changing mode of %s: %s\n", __func__, FLEET_SHM_NAME, strerror(errno));
+
+    if (ftruncate(fd, sizeof(struct fleet_shm)) < 0) {
+        syslog(LOG_ERR, "%s: ERROR resizing %s: %s\n", __func__, FLEET_SHM_NAME, strerror(errno));
+        close(fd);
+        return;
+    }
+
+    mem = mmap(NULL, sizeof(struct fleet_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // el mapatge es manté encara que es tanqui el descriptor
+    if (mem == MAP_FAILED) {
+        syslog(LOG_ERR, "%s: ERROR mapping %s: %s\n", __func__, FLEET_SHM_NAME, strerror(errno));
+        return;
+    }
+
+    // ftruncate() ja l'omple de zeros
+    mem->max_chargers = MAX_CHARGERS;
+    mem->max_connectors = MAX_CONNECTORS;
+    mem->version = FLEET_SHM_VERSION;
+    __atomic_store_n(&mem->magic, FLEET_SHM_MAGIC, __ATOMIC_RELEASE); // l'últim, indica que la capçalera és vàlida
+    shm = mem;
+
+    for (int i = 1; i <= MAX_CHARGERS; i++)
+        fleet_shm_update(&charger_vars[i]);
+}
+
+/*
+ *  NAME
+ *      fleet_shm_update - Actualitza l'estat d'un carregador a la memòria compartida
+ *  SYNOPSIS
+ *      void fleet_shm_update(const ChargerVars *vars);
+ *  DESCRIPTION
+ *      Llegeix l'estat actual del carregador i dels seus connectors i el copia a la memòria compartida.
+ *      L'estat es llegeix abans d'entrar al seqlock, de manera que els lectors només han de repetir
+ *      la lectura si coincideixen amb la còpia.
+ *  RETURN VALUE
+ *      Res.
+ */
+void fleet_shm_update(const ChargerVars *vars)
+{
+    struct fleet_shm_charger charger;
+    int id = vars->charger_id;
+
+    if (shm == NULL || id < 1 || id > MAX_CHARGERS)
+        return;
+
+    memset(&charger, 0, sizeof(charger));
+    charger.connected = vars->client != (ws_cli_conn_t)-1;
+    charger.boot_status = charger.connected ? (int32_t)vars->boot.status : -1;
+    charger.num_connectors = connectors_count(vars);
+    for (int c = 1; c <= MAX_CONNECTORS; c++) {
+        charger.connectors[c].status = connector_status(vars, c);
+        if (c <= charger.num_connectors) {
+            int64_t transaction_id = connector_transaction(vars, c); // -1 si no n'hi ha, a la memòria compartida és 0
+            charger.connectors[c].transaction_id = transaction_id > 0 ? transaction_id : 0;
+            snprintf(charger.connectors[c].id_tag, FLEET_SHM_ID_TAG_LEN, "%s", connector_id_tag(vars, c));
+        }
+    }
+
+    write_begin();
+    charger.last_seen = shm->chargers[id].last_seen; // només el canvia fleet_shm_seen()
+    memcpy(&shm->chargers[id], &charger, sizeof(charger));
+    write_end();
+}
+
+/*
+ *  NAME
+ *      fleet_shm_seen - Apunta que s'ha rebut un missatge d'un carregador
+ *  SYNOPSIS
+ *      void fleet_shm_seen(const ChargerVars *vars);
+ *  DESCRIPTION
+ *      Posa l'hora actual com a hora de l'últim missatge del carregador a la memòria compartida.
+ *      Es crida per cada missatge rebut del carregador.
+ *  RETURN VALUE
+ *      Res.
+ */
+void fleet_shm_seen(const ChargerVars *vars)
+{
+    int id = vars->charger_id;
+
+    if (shm == NULL || id < 1 || id > MAX_CHARGERS)
+        return;
+
+    write_begin();
+    shm->chargers[id].last_seen = time(NULL);
+    write_end();
+}
+
+/*
+ *  NAME
+ *      write_begin - Comença una escriptura a la memòria compartida
+ *  SYNOPSIS
+ *      static void write_begin(void);
+ *  DESCRIPTION
+ *      Agafa write_lock i deixa seq senar. La barrera fa que els lectors no puguin veure cap dada
+ *      nova abans que seq sigui senar.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void write_begin(void)
+{
+    pthread_mutex_lock(&write_lock);
+    __atomic_store_n(&shm->seq, shm->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/*
+ *  NAME
+ *      write_end - Acaba una escriptura a la memòria compartida
+ *  SYNOPSIS
+ *      static void write_end(void);
+ *  DESCRIPTION
+ *      Torna a deixar seq parell, després de totes les dades escrites, i allibera write_lock.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void write_end(void)
+{
+    __atomic_store_n(&shm->seq, shm->seq + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&write_lock);
+}
@@ -0,0 +1,58 @@
+/*
+ *  FILE
+ *      fleet_shm.h - header de fleet_shm.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header de la instantània de l'estat de la flota en memòria compartida. Les estructures
+ *      d'aquest fitxer són el format de la memòria compartida que llegeixen els altres processos.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _FLEET_SHM_H_
+#define _FLEET_SHM_H_
+
+#include <stdint.h>
+#include "ocpp_cs.h"
+#include "ws_server.h"
+
+#define FLEET_SHM_NAME "/ocpp_cs_fleet"    // nom per shm_open(), a Linux és el fitxer /dev/shm/ocpp_cs_fleet
+#define FLEET_SHM_MAGIC 0x5050434f          // "OCPP" en little endian
+#define FLEET_SHM_VERSION 1                 // s'incrementa si canvia el format
+#define FLEET_SHM_ID_TAG_LEN 24             // ID_TAG_LEN més el '\0', arrodonit a 8 bytes
+
+// connector d'un carregador
+struct fleet_shm_connector {
+    int64_t status;                         // un dels defines CONN_<>
+    int64_t transaction_id;                 // transactionId de la transacció activa, 0 si no n'hi ha
+    char id_tag[FLEET_SHM_ID_TAG_LEN];      // idTag de la transacció activa
+};
+
+// carregador
+struct fleet_shm_charger {
+    int32_t connected;                      // 1 si el carregador està connectat
+    int32_t boot_status;                    // enum Status_Boot de l'últim BootNotification, -1 si no està connectat
+    int64_t last_seen;                      // temps (time()) de l'últim missatge rebut, 0 si encara no n'ha enviat cap
+    int32_t num_connectors;                 // connectors del carregador (sense el 0)
+    int32_t reserved;
+    struct fleet_shm_connector connectors[MAX_CONNECTORS + 1]; // connectors[i] és el connector i, el 0 no es fa servir
+};
+
+// contingut de la memòria compartida
+struct fleet_shm {
+    uint32_t magic;                         // FLEET_SHM_MAGIC
+    uint32_t version;                       // FLEET_SHM_VERSION
+    uint32_t max_chargers;                  // MAX_CHARGERS
+    uint32_t max_connectors;                // MAX_CONNECTORS
+    uint64_t seq;                           // seqlock: és senar mentre s'està escrivint
+    struct fleet_shm_charger chargers[MAX_CHARGERS + 1]; // chargers[i] és el carregador i, el 0 no es fa servir
+};
+
+void fleet_shm_init(void);
+void fleet_shm_update(const ChargerVars *vars);
+void fleet_shm_seen(const ChargerVars *vars);
+
+#endif
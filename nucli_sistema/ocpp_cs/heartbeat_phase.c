@@ -0,0 +1,235 @@
+/*
+ *  FILE
+ *      heartbeat_phase.c - repartiment dels Heartbeat dels carregadors
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Tots els carregadors fan servir el mateix HEARTBEAT_INTERVAL, i els que s'han connectat alhora
+ *      envien el Heartbeat alhora. Per repartir-los, a cada carregador acceptat se li assigna una fase
+ *      dins de l'interval (els carregadors connectats es reparteixen l'interval a parts iguals). Quan
+ *      arriba un Heartbeat fora de la seva fase, s'envia un ChangeConfiguration de HeartbeatInterval
+ *      perquè el següent arribi a la fase que li toca, i quan hi arriba es torna a posar l'interval
+ *      normal. Si es connecten o desconnecten carregadors, les fases es recalculen i es van corregint
+ *      a mesura que arriben els Heartbeat.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <syslog.h>
+#include "ocpp_cs.h"
+#include "ws_server.h"
+#include "config_store.h"
+#include "ChangeConfigurationConfJSON.h"
+#include "heartbeat_phase.h"
+
+// estat del repartiment d'un carregador
+struct phase_state {
+    bool registered;    // el carregador està acceptat i té una fase assignada
+    bool adjusted;      // el carregador té un interval diferent de HEARTBEAT_INTERVAL per moure la fase
+    bool busy;          // s'està enviant un ChangeConfiguration
+    bool disabled;      // el carregador no accepta canviar el HeartbeatInterval
+};
+
+// ChangeConfiguration que s'envia en segon pla
+struct phase_job {
+    ChargerVars *vars;
+    int interval;
+};
+
+static pthread_mutex_t phase_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct phase_state phases[MAX_CHARGERS + 1];
+
+// Prototips de les funcions
+static time_t get_phase(int charger_id);
+static void *phase_thread(void *arg);
+
+/*
+ *  NAME
+ *      heartbeat_phase_register - Assigna una fase a un carregador
+ *  SYNOPSIS
+ *      int heartbeat_phase_register(const ChargerVars *vars);
+ *  DESCRIPTION
+ *      S'ha de cridar quan s'accepta el BootNotification del carregador. A partir d'aquest moment
+ *      el carregador compta per repartir l'interval.
+ *  RETURN VALUE
+ *      L'interval de Heartbeat que s'ha d'enviar al BootNotification.
+ */
+int heartbeat_phase_register(const ChargerVars *vars)
+{
+    if (vars->charger_id < 1 || vars->charger_id > MAX_CHARGERS)
+        return HEARTBEAT_INTERVAL;
+
+    pthread_mutex_lock(&phase_lock);
+    phases[vars->charger_id].registered = true;
+    phases[vars->charger_id].adjusted = false; // el BootNotification torna a posar l'interval normal
+    phases[vars->charger_id].disabled = false;
+    pthread_mutex_unlock(&phase_lock);
+
+    return HEARTBEAT_INTERVAL;
+}
+
+/*
+ *  NAME
+ *      heartbeat_phase_unregister - Treu la fase d'un carregador
+ *  SYNOPSIS
+ *      void heartbeat_phase_unregister(const ChargerVars *vars);
+ *  DESCRIPTION
+ *      S'ha de cridar quan el carregador es desconnecta, perquè la resta es reparteixin l'interval.
+ *  RETURN VALUE
+ *      Res.
+ */
+void heartbeat_phase_unregister(const ChargerVars *vars)
+{
+    if (vars->charger_id < 1 || vars->charger_id > MAX_CHARGERS)
+        return;
+
+    pthread_mutex_lock(&phase_lock);
+    phases[vars->charger_id].registered = false;
+    pthread_mutex_unlock(&phase_lock);
+}
+
+/*
+ *  NAME
+ *      heartbeat_phase_check - Comprova la fase d'un Heartbeat
+ *  SYNOPSIS
+ *      void heartbeat_phase_check(ChargerVars *vars);
+ *  DESCRIPTION
+ *      S'ha de cridar quan arriba un Heartbeat. Si ha arribat fora de la fase del carregador, s'envia
+ *      en segon pla un ChangeConfiguration amb l'interval que falta fins a la fase (com a mínim
+ *      HEARTBEAT_MIN_ADJUST). Si ha arribat a la fase i el carregador tenia l'interval canviat, es
+ *      torna a posar HEARTBEAT_INTERVAL.
+ *  RETURN VALUE
+ *      Res.
+ */
+void heartbeat_phase_check(ChargerVars *vars)
+{
+    time_t now = time(NULL);
+    int interval = 0;
+
+    if (vars->charger_id < 1 || vars->charger_id > MAX_CHARGERS)
+        return;
+
+    pthread_mutex_lock(&phase_lock);
+    struct phase_state *state = &phases[vars->charger_id];
+    if (state->registered && !state->busy && !state->disabled) {
+        time_t delay = (get_phase(vars->charger_id) - now % HEARTBEAT_INTERVAL + HEARTBEAT_INTERVAL) % HEARTBEAT_INTERVAL;
+        if (delay < HEARTBEAT_MIN_ADJUST)
+            delay += HEARTBEAT_INTERVAL;
+
+        if (delay >= HEARTBEAT_INTERVAL - HEARTBEAT_PHASE_TOLERANCE && delay <= HEARTBEAT_INTERVAL + HEARTBEAT_PHASE_TOLERANCE) {
+            if (state->adjusted) // ja és a la seva fase -> torno a l'interval normal
+                interval = HEARTBEAT_INTERVAL;
+        }
+        else {
+            interval = (int)delay;
+        }
+
+        if (interval > 0)
+            state->busy = true;
+    }
+    pthread_mutex_unlock(&phase_lock);
+
+    if (interval == 0)
+        return;
+
+    struct phase_job *job = malloc(sizeof(struct phase_job));
+    pthread_t thread;
+    if (job != NULL) {
+        job->vars = vars;
+        job->interval = interval;
+        if (pthread_create(&thread, NULL, phase_thread, job) == 0) {
+            pthread_detach(thread);
+            return;
+        }
+        syslog(LOG_ERR, "%s: pthread_create failed", __func__);
+        free(job);
+    }
+
+    pthread_mutex_lock(&phase_lock);
+    state->busy = false;
+    pthread_mutex_unlock(&phase_lock);
+}
+
+/*
+ *  NAME
+ *      get_phase - Retorna la fase d'un carregador
+ *  SYNOPSIS
+ *      static time_t get_phase(int charger_id);
+ *  DESCRIPTION
+ *      Els carregadors registrats es reparteixen HEARTBEAT_INTERVAL a parts iguals per ordre de
+ *      charger_id. S'ha de cridar amb phase_lock agafat.
+ *  RETURN VALUE
+ *      La fase, en segons des de l'inici de l'interval.
+ */
+static time_t get_phase(int charger_id)
+{
+    int rank = 0, count = 0;
+
+    for (int i = 1; i <= MAX_CHARGERS; i++) {
+        if (!phases[i].registered)
+            continue;
+        if (i < charger_id)
+            rank++;
+        count++;
+    }
+
+    return count > 0 ? (time_t)HEARTBEAT_INTERVAL * rank / count : 0;
+}
+
+/*
+ *  NAME
+ *      phase_thread - Envia el ChangeConfiguration del HeartbeatInterval
+ *  SYNOPSIS
+ *      static void *phase_thread(void *arg);
+ *  DESCRIPTION
+ *      Envia el ChangeConfiguration sense bloquejar el thread que rep els missatges del carregador
+ *      (la resposta arriba per aquest thread). Si el carregador l'accepta es guarda el nou valor
+ *      de HeartbeatInterval; si no el suporta no se li torna a enviar fins al següent BootNotification.
+ *  RETURN VALUE
+ *      NULL.
+ */
+static void *phase_thread(void *arg)
+{
+    struct phase_job *job = arg;
+    char payload[64], value[16], response[256];
+    bool accepted = false, disabled = false;
+
+    snprintf(value, sizeof(value), "%d", job->interval);
+    snprintf(payload, sizeof(payload), "{\"key\": \"HeartbeatInterval\", \"value\": \"%s\"}", value);
+
+    if (send_request_timeout('B', payload, job->vars, HEARTBEAT_PHASE_TIMEOUT, response, sizeof(response)) == tx_result_ok) {
+        struct ChangeConfigurationConf *conf = cJSON_ParseChangeConfigurationConf(response);
+        if (conf != NULL) {
+            accepted = conf->status == STATUS_CHANGE_CONFIGURATION_ACCEPTED;
+            disabled = conf->status == STATUS_CHANGE_CONFIGURATION_NOT_SUPPORTED || conf->status == STATUS_CHANGE_CONFIGURATION_REJECTED;
+            free(conf);
+        }
+    }
+
+    if (accepted) {
+        config_set(job->vars, CONF_HEARTBEAT_INTERVAL, value, false);
+        syslog(LOG_DEBUG, "%s: HeartbeatInterval del carregador %d: %s", __func__, job->vars->charger_id, value);
+    }
+
+    pthread_mutex_lock(&phase_lock);
+    struct phase_state *state = &phases[job->vars->charger_id];
+    if (accepted)
+        state->adjusted = job->interval != HEARTBEAT_INTERVAL;
+    if (disabled)
+        state->disabled = true;
+    state->busy = false;
+    pthread_mutex_unlock(&phase_lock);
+
+    free(job);
+
+    return NULL;
+}
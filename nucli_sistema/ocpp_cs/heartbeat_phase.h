@@ -0,0 +1,27 @@
+/*
+ *  FILE
+ *      heartbeat_phase.h - header de heartbeat_phase.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header del repartiment dels Heartbeat dels carregadors.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _HEARTBEAT_PHASE_H_
+#define _HEARTBEAT_PHASE_H_
+
+#include "ocpp_cs.h"
+
+#define HEARTBEAT_PHASE_TOLERANCE 60                    // segons de marge respecte a la fase assignada
+#define HEARTBEAT_MIN_ADJUST (HEARTBEAT_INTERVAL / 4)   // interval mínim per moure la fase d'un carregador
+#define HEARTBEAT_PHASE_TIMEOUT 10                      // temps de timeout del ChangeConfiguration
+
+int heartbeat_phase_register(const ChargerVars *vars);
+void heartbeat_phase_unregister(const ChargerVars *vars);
+void heartbeat_phase_check(ChargerVars *vars);
+
+#endif
@@ -0,0 +1,447 @@
+/*
+ *  FILE
+ *      history_query.c - consultes a l'historial de la base de dades
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Els clients web consulten l'historial (meter_values, estats, transaccions, sessions i els
+ *      agregats meter_rollups) amb una ordre JSON:
+ *          {"query": "meter_values", "id": "q1", "charger": 1, "connector": 1, "measurand": "...",
+ *           "from": "2025-01-01T00:00:00Z", "to": "...", "limit": 100, "cursor": "..."}
+ *      Tots els filtres són opcionals, excepte "resolution" (amplada dels intervals en segons) per
+ *      als agregats. Les files s'ordenen de la més recent a la més antiga i es
+ *      retornen per pàgines de com a molt HISTORY_MAX_ROWS files, de manera que el cost de cada
+ *      consulta no depèn de la mida de l'historial. La resposta és un queryResult amb les files i el
+ *      cursor de la pàgina següent ("next", null si és l'última), que s'ha de passar a "cursor" per
+ *      demanar-la. El cursor és el ts i l'id de l'última fila retornada, així les pàgines no es
+ *      desplacen encara que s'afegeixin files noves mentre es consulta.
+ *      Les files s'ordenen i es filtren per la columna ts (mil·lisegons des de l'epoch en UTC, vegeu
+ *      epoch_time): "from" i "to" s'hi passen abans de consultar, sigui quina sigui la seva zona
+ *      horària. Les consultes es fan amb índexs per carregador, connector i ts, i per ts, que es
+ *      creen a history_init() (l'índex per ts també serveix per esborrar les files més antigues).
+ *      El measurand, les unitats i el context es guarden amb el seu codi (meter_codes): les respostes
+ *      porten el nom de cada codi i el filtre "measurand" es passa a codi abans de consultar.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <syslog.h>
+#include <sqlite3.h>
+#include <cJSON.h>
+#include "ws_server.h"
+#include "web_hub.h"
+#include "meter_codes.h"
+#include "epoch_time.h"
+#include "history_query.h"
+
+// taula que es pot consultar
+struct history_table {
+    const char *name;
+    const char *columns;        // columnes que es retornen
+    bool measurand;             // la taula té la columna measurand
+    bool resolution;            // la taula té la columna resolucio (s'ha de filtrar per ella)
+};
+
+static const struct history_table tables[] = {
+    {"meter_values", "id, charger_id, connector, transaccio, hora, ts, valor, "
+        "(SELECT nom FROM unitats WHERE codi = unit) AS unit, (SELECT nom FROM measurands WHERE codi = measurand) "
+        "AS measurand, (SELECT nom FROM contexts WHERE codi = context) AS context", true, false},
+    {"estats", "id, charger_id, connector, estat, hora, ts, error_code", false, false},
+    {"transaccions", "id, charger_id, connector, estat, hora, ts, motiu", false, false},
+    {"sessions", "id, transaction_id, charger_id, connector, id_tag, hora_inici, hora_fi, ts, durada, meter_start, "
+        "meter_stop, energia, motiu", false, false},
+    {"meter_rollups", "id, resolucio, charger_id, connector, (SELECT nom FROM measurands WHERE codi = measurand) "
+        "AS measurand, hora, ts, (SELECT nom FROM unitats WHERE codi = unit) AS unit, mostres, minim, maxim, "
+        "suma / mostres AS mitjana, ultim, energia", true, true}
+};
+
+#define NUM_TABLES (sizeof(tables) / sizeof(tables[0]))
+
+// paràmetres de la consulta, en l'ordre dels ?N de la sentència SQL
+enum query_param {
+    PARAM_CHARGER = 1,
+    PARAM_CONNECTOR,
+    PARAM_MEASURAND,
+    PARAM_FROM,
+    PARAM_TO,
+    PARAM_CURSOR_TS,
+    PARAM_CURSOR_ID,
+    PARAM_LIMIT,
+    PARAM_RESOLUTION
+};
+
+// Prototips de les funcions
+static const struct history_table *find_table(const char *name);
+static bool add_ts_column(sqlite3 *db, const char *table);
+static bool parse_cursor(const char *cursor, int64_t *ts, int64_t *id);
+static cJSON *read_row(sqlite3_stmt *stmt);
+static void send_query_error(ws_cli_conn_t client, const char *id, const char *error);
+
+/*
+ *  NAME
+ *      history_init - Prepara les taules de l'historial
+ *  SYNOPSIS
+ *      void history_init(void);
+ *  DESCRIPTION
+ *      Afegeix la columna ts a les taules de l'historial que encara no la tenen i l'omple a partir
+ *      de l'hora de les files que no en tenen (les que es van guardar abans). Crea, si no existeixen,
+ *      els índexs per carregador, connector i ts i per ts (i esborra els antics per hora), i fa que
+ *      els triggers que limiten la mida de les taules esborrin la fila més antiga per ts.
+ *  RETURN VALUE
+ *      Res.
+ */
+void history_init(void)
+{
+    static const char *const history_tables[] = {"meter_values", "estats", "transaccions"};
+    sqlite3 *db;
+    int rc;
+    char *errmsg;
+    char sql[1024];
+
+    rc = sqlite3_open(DATABASE_PATH, &db);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: ERROR opening SQLite DB: %s\n", __func__, sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return;
+    }
+
+    for (size_t i = 0; i < sizeof(history_tables) / sizeof(history_tables[0]); i++) {
+        const char *table = history_tables[i];
+        if (!add_ts_column(db, table))
+            continue;
+
+        snprintf(sql, sizeof(sql),
+            "UPDATE %s SET ts = coalesce(" EPOCH_MS_SQL("hora") ", 0) WHERE ts = 0;"
+            "DROP INDEX IF EXISTS %s_charger_hora;"
+            "DROP INDEX IF EXISTS %s_hora;"
+            "CREATE INDEX IF NOT EXISTS %s_charger_connector_ts ON %s(charger_id, connector, ts);"
+            "CREATE INDEX IF NOT EXISTS %s_ts ON %s(ts);"
+            "DROP TRIGGER IF EXISTS max_%s;"
+            "CREATE TRIGGER max_%s BEFORE INSERT ON %s BEGIN DELETE FROM %s WHERE "
+            "id = (SELECT id FROM %s ORDER BY ts, id LIMIT 1) and (SELECT COUNT(*) FROM %s) >= 30; END;",
+            table, table, table, table, table, table, table, table, table, table, table, table, table);
+        rc = sqlite3_exec(db, sql, 0, 0, &errmsg);
+        if (rc != SQLITE_OK) {
+            syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+            sqlite3_free(errmsg);
+        }
+    }
+    sqlite3_close(db); // tanca la base de dades correctament
+}
+
+/*
+ *  NAME
+ *      history_query - Respon una consulta a l'historial d'un client web
+ *  SYNOPSIS
+ *      bool history_query(ws_cli_conn_t client, const char *text, size_t len);
+ *  DESCRIPTION
+ *      Si l'ordre JSON text (de len bytes) és una consulta ("query"), la fa i envia a client un
+ *      queryResult amb una pàgina de files, o un queryError si la consulta no és correcta.
+ *  RETURN VALUE
+ *      Retorna true si text és una consulta.
+ *      Retorna false en cas contrari (és una altra ordre JSON).
+ */
+bool history_query(ws_cli_conn_t client, const char *text, size_t len)
+{
+    char id[HISTORY_ID_LEN] = "";
+    int64_t cursor_ts = 0;
+    int64_t cursor_id = 0;
+    int64_t from_ts = -1, to_ts = -1;
+    int limit = HISTORY_DEFAULT_ROWS;
+    char sql[768];
+    int n;
+
+    cJSON *json = cJSON_ParseWithLength(text, len);
+    const cJSON *query = cJSON_GetObjectItemCaseSensitive(json, "query");
+    if (query == NULL) {
+        cJSON_Delete(json);
+        return false;
+    }
+
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(json, "id");
+    if (cJSON_IsString(item) && strpbrk(item->valuestring, "\"\\") == NULL) // l'id es torna dins dels missatges JSON
+        snprintf(id, sizeof(id), "%s", item->valuestring);
+    else if (cJSON_IsNumber(item))
+        snprintf(id, sizeof(id), "%ld", (int64_t)item->valuedouble);
+
+    const struct history_table *table = find_table(cJSON_IsString(query) ? query->valuestring : NULL);
+    if (table == NULL) {
+        send_query_error(client, id, "NotSupported");
+        cJSON_Delete(json);
+        return true;
+    }
+
+    const cJSON *charger = cJSON_GetObjectItemCaseSensitive(json, "charger");
+    const cJSON *connector = cJSON_GetObjectItemCaseSensitive(json, "connector");
+    const cJSON *measurand = cJSON_GetObjectItemCaseSensitive(json, "measurand");
+    const cJSON *from = cJSON_GetObjectItemCaseSensitive(json, "from");
+    const cJSON *to = cJSON_GetObjectItemCaseSensitive(json, "to");
+    const cJSON *cursor = cJSON_GetObjectItemCaseSensitive(json, "cursor");
+    const cJSON *rows = cJSON_GetObjectItemCaseSensitive(json, "limit");
+    const cJSON *resolution = cJSON_GetObjectItemCaseSensitive(json, "resolution");
+
+    if ((charger != NULL && !cJSON_IsNumber(charger)) || (connector != NULL && !cJSON_IsNumber(connector))
+        || (measurand != NULL && (!cJSON_IsString(measurand) || !table->measurand))
+        || (from != NULL && (!cJSON_IsString(from) || (from_ts = epoch_ms_parse(from->valuestring)) < 0))
+        || (to != NULL && (!cJSON_IsString(to) || (to_ts = epoch_ms_parse(to->valuestring)) < 0))
+        || (rows != NULL && !cJSON_IsNumber(rows))
+        || (table->resolution ? !cJSON_IsNumber(resolution) : resolution != NULL)
+        || (cursor != NULL && !cJSON_IsNull(cursor) && (!cJSON_IsString(cursor)
+            || !parse_cursor(cursor->valuestring, &cursor_ts, &cursor_id)))) {
+        send_query_error(client, id, "TypeConstraintViolation");
+        cJSON_Delete(json);
+        return true;
+    }
+    if (rows != NULL)
+        limit = rows->valuedouble < 1 ? 1 : rows->valuedouble > HISTORY_MAX_ROWS ? HISTORY_MAX_ROWS : (int)rows->valuedouble;
+    if (cJSON_IsNull(cursor))
+        cursor = NULL;
+
+    // Formo la consulta només amb els filtres que s'han indicat
+    n = snprintf(sql, sizeof(sql), "SELECT %s FROM %s WHERE 1", table->columns, table->name);
+    if (resolution != NULL)
+        n += snprintf(sql + n, sizeof(sql) - n, " AND resolucio = ?%d", PARAM_RESOLUTION);
+    if (charger != NULL)
+        n += snprintf(sql + n, sizeof(sql) - n, " AND charger_id = ?%d", PARAM_CHARGER);
+    if (connector != NULL)
+        n += snprintf(sql + n, sizeof(sql) - n, " AND connector = ?%d", PARAM_CONNECTOR);
+    if (measurand != NULL)
+        n += snprintf(sql + n, sizeof(sql) - n, " AND measurand = ?%d", PARAM_MEASURAND);
+    if (from != NULL)
+        n += snprintf(sql + n, sizeof(sql) - n, " AND ts >= ?%d", PARAM_FROM);
+    if (to != NULL)
+        n += snprintf(sql + n, sizeof(sql) - n, " AND ts < ?%d", PARAM_TO);
+    if (cursor != NULL)
+        n += snprintf(sql + n, sizeof(sql) - n, " AND (ts < ?%d OR (ts = ?%d AND id < ?%d))",
+            PARAM_CURSOR_TS, PARAM_CURSOR_TS, PARAM_CURSOR_ID);
+    snprintf(sql + n, sizeof(sql) - n, " ORDER BY ts DESC, id DESC LIMIT ?%d;", PARAM_LIMIT);
+
+    sqlite3 *db;
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_open_v2(DATABASE_PATH, &db, SQLITE_OPEN_READONLY, NULL);
+    if (rc == SQLITE_OK) {
+        sqlite3_busy_timeout(db, HISTORY_BUSY_MS);
+        rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    }
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, sqlite3_errmsg(db));
+        send_query_error(client, id, "InternalError");
+        sqlite3_close(db);
+        cJSON_Delete(json);
+        return true;
+    }
+
+    if (resolution != NULL)
+        sqlite3_bind_int64(stmt, PARAM_RESOLUTION, (int64_t)resolution->valuedouble);
+    if (charger != NULL)
+        sqlite3_bind_int64(stmt, PARAM_CHARGER, (int64_t)charger->valuedouble);
+    if (connector != NULL)
+        sqlite3_bind_int64(stmt, PARAM_CONNECTOR, (int64_t)connector->valuedouble);
+    if (measurand != NULL)
+        sqlite3_bind_int(stmt, PARAM_MEASURAND, meter_measurand_code(measurand->valuestring)); // -1: cap fila
+    if (from != NULL)
+        sqlite3_bind_int64(stmt, PARAM_FROM, from_ts);
+    if (to != NULL)
+        sqlite3_bind_int64(stmt, PARAM_TO, to_ts);
+    if (cursor != NULL) {
+        sqlite3_bind_int64(stmt, PARAM_CURSOR_TS, cursor_ts);
+        sqlite3_bind_int64(stmt, PARAM_CURSOR_ID, cursor_id);
+    }
+    sqlite3_bind_int(stmt, PARAM_LIMIT, limit + 1); // una fila més per saber si hi ha una pàgina següent
+
+    cJSON_Delete(json);
+
+    // Formo la resposta
+    cJSON *result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "type", "queryResult");
+    cJSON_AddStringToObject(result, "id", id);
+    cJSON_AddStringToObject(result, "query", table->name);
+    cJSON *array = cJSON_AddArrayToObject(result, "rows");
+
+    char next[HISTORY_CURSOR_LEN] = "";
+    int count = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (count == limit) { // hi ha una pàgina següent, comença després de l'última fila retornada
+            const cJSON *last = cJSON_GetArrayItem(array, count - 1);
+            snprintf(next, sizeof(next), "%ld,%ld", (int64_t)cJSON_GetNumberValue(cJSON_GetObjectItemCaseSensitive(last, "ts")),
+                (int64_t)cJSON_GetNumberValue(cJSON_GetObjectItemCaseSensitive(last, "id")));
+            break;
+        }
+        cJSON_AddItemToArray(array, read_row(stmt));
+        count++;
+    }
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, sqlite3_errmsg(db));
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db); // tanca la base de dades correctament
+
+    if (*next != '\0')
+        cJSON_AddStringToObject(result, "next", next);
+    else
+        cJSON_AddNullToObject(result, "next");
+
+    char *information = cJSON_PrintUnformatted(result);
+    cJSON_Delete(result);
+    if (information == NULL) {
+        syslog(LOG_ERR, "%s: ERROR allocating memory\n", __func__);
+        send_query_error(client, id, "InternalError");
+        return true;
+    }
+    web_hub_send(client, information);
+    free(information);
+
+    return true;
+}
+
+/*
+ *  NAME
+ *      find_table - Busca una taula de l'historial
+ *  SYNOPSIS
+ *      static const struct history_table *find_table(const char *name);
+ *  DESCRIPTION
+ *      Busca la taula name entre les que es poden consultar.
+ *  RETURN VALUE
+ *      Retorna la taula.
+ *      Retorna NULL si no existeix o no es pot consultar.
+ */
+static const struct history_table *find_table(const char *name)
+{
+    for (size_t i = 0; name != NULL && i < NUM_TABLES; i++) {
+        if (strcmp(tables[i].name, name) == 0)
+            return &tables[i];
+    }
+
+    return NULL;
+}
+
+/*
+ *  NAME
+ *      add_ts_column - Afegeix la columna ts a una taula de l'historial
+ *  SYNOPSIS
+ *      static bool add_ts_column(sqlite3 *db, const char *table);
+ *  DESCRIPTION
+ *      Si la taula table no té la columna ts, l'afegeix (a 0, history_init() l'omple després).
+ *  RETURN VALUE
+ *      Retorna true si la taula té la columna ts.
+ *      Retorna false en cas contrari (la taula no existeix o no s'ha pogut afegir).
+ */
+static bool add_ts_column(sqlite3 *db, const char *table)
+{
+    sqlite3_stmt *stmt;
+    char sql[128];
+    char *errmsg;
+    int columns = 0;
+    bool found = false;
+
+    if (sqlite3_prepare_v2(db, "SELECT name FROM pragma_table_info(?1);", -1, &stmt, NULL) != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, sqlite3_errmsg(db));
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        columns++;
+        if (strcmp((const char *)sqlite3_column_text(stmt, 0), "ts") == 0)
+            found = true;
+    }
+    sqlite3_finalize(stmt);
+
+    if (found || columns == 0)
+        return found;
+
+    snprintf(sql, sizeof(sql), "ALTER TABLE %s ADD COLUMN ts INTEGER NOT NULL DEFAULT 0;", table);
+    if (sqlite3_exec(db, sql, 0, 0, &errmsg) != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+        sqlite3_free(errmsg);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ *  NAME
+ *      parse_cursor - Llegeix el cursor d'una pàgina
+ *  SYNOPSIS
+ *      static bool parse_cursor(const char *cursor, int64_t *ts, int64_t *id);
+ *  DESCRIPTION
+ *      Separa el cursor ("<ts>,<id>") en el ts i l'id de l'última fila de la pàgina anterior.
+ *  RETURN VALUE
+ *      Retorna true si el cursor és correcte.
+ *      Retorna false en cas contrari.
+ */
+static bool parse_cursor(const char *cursor, int64_t *ts, int64_t *id)
+{
+    char *end;
+
+    *ts = strtoll(cursor, &end, 10);
+    if (end == cursor || *end != ',')
+        return false;
+
+    const char *next = end + 1;
+    *id = strtoll(next, &end, 10);
+    return end != next && *end == '\0';
+}
+
+/*
+ *  NAME
+ *      read_row - Passa una fila de la consulta a JSON
+ *  SYNOPSIS
+ *      static cJSON *read_row(sqlite3_stmt *stmt);
+ *  DESCRIPTION
+ *      Forma un objecte JSON amb les columnes de la fila actual de stmt, amb el tipus de cada valor.
+ *  RETURN VALUE
+ *      Retorna l'objecte JSON.
+ */
+static cJSON *read_row(sqlite3_stmt *stmt)
+{
+    cJSON *row = cJSON_CreateObject();
+
+    for (int i = 0; i < sqlite3_column_count(stmt); i++) {
+        const char *name = sqlite3_column_name(stmt, i);
+        switch (sqlite3_column_type(stmt, i)) {
+            case SQLITE_INTEGER:
+                cJSON_AddNumberToObject(row, name, (double)sqlite3_column_int64(stmt, i));
+                break;
+
+            case SQLITE_FLOAT:
+                cJSON_AddNumberToObject(row, name, sqlite3_column_double(stmt, i));
+                break;
+
+            case SQLITE_NULL:
+                cJSON_AddNullToObject(row, name);
+                break;
+
+            default:
+                cJSON_AddStringToObject(row, name, (const char *)sqlite3_column_text(stmt, i));
+                break;
+        }
+    }
+
+    return row;
+}
+
+/*
+ *  NAME
+ *      send_query_error - Envia un error de consulta
+ *  SYNOPSIS
+ *      static void send_query_error(ws_cli_conn_t client, const char *id, const char *error);
+ *  DESCRIPTION
+ *      Envia a client un queryError amb l'identificador de la consulta i el motiu.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void send_query_error(ws_cli_conn_t client, const char *id, const char *error)
+{
+    char information[HISTORY_ID_LEN + 128];
+
+    snprintf(information, sizeof(information), "{\"type\": \"queryError\", \"id\": \"%s\", \"error\": \"%s\"}", id, error);
+    web_hub_send(client, information);
+}
@@ -0,0 +1,30 @@
+/*
+ *  FILE
+ *      history_query.h - header de history_query.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header de les consultes a l'historial de la base de dades per als clients web.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _HISTORY_QUERY_H_
+#define _HISTORY_QUERY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <ws.h>
+
+#define HISTORY_DEFAULT_ROWS 100    // files per pàgina si no s'indica
+#define HISTORY_MAX_ROWS 500        // màxim de files per pàgina
+#define HISTORY_ID_LEN 64           // mida màxima de l'identificador d'una consulta
+#define HISTORY_CURSOR_LEN 96       // mida màxima del cursor d'una pàgina
+#define HISTORY_BUSY_MS 2000        // temps màxim d'espera si la base de dades està bloquejada
+
+void history_init(void);
+bool history_query(ws_cli_conn_t client, const char *text, size_t len);
+
+#endif
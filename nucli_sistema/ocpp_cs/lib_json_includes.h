@@ -18,17 +18,25 @@
 #include "BootNotificationConfJSON.h"
 #include "ChangeAvailabilityReqJSON.h"
 #include "ChangeAvailabilityConfJSON.h"
+#include "ChangeConfigurationReqJSON.h"
+#include "ChangeConfigurationConfJSON.h"
+#include "TriggerMessageReqJSON.h"
+#include "TriggerMessageConfJSON.h"
 #include "ClearCacheConfJSON.h"
 #include "DataTransferReqJSON.h"
 #include "DataTransferConfJSON.h"
 #include "GetConfigurationReqJSON.h"
 #include "GetConfigurationConfJSON.h"
+#include "GetLocalListVersionReqJSON.h"
+#include "GetLocalListVersionConfJSON.h"
 #include "RemoteStartTransactionReqJSON.h"
 #include "RemoteStartTransactionConfJSON.h"
 #include "RemoteStopTransactionReqJSON.h"
 #include "RemoteStopTransactionConfJSON.h"
 #include "ResetReqJSON.h"
 #include "ResetConfJSON.h"
+#include "SendLocalListReqJSON.h"
+#include "SendLocalListConfJSON.h"
 #include "StatusNotificationReqJSON.h"
 #include "StatusNotificationConfJSON.h"
 #include "UnlockConnectorReqJSON.h"
@@ -0,0 +1,496 @@
+/*
+ *  FILE
+ *      meter_codes.c - codis i normalització de les unitats dels MeterValues
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Cada valor d'un MeterValues es llegeix una sola vegada, quan arriba: el text del valor es passa
+ *      a número i a les unitats canòniques (kWh -> Wh, kW -> W, kvar -> var, kVA -> VA, K i Fahrenheit
+ *      -> Celsius...), i el measurand, les unitats i el context es guarden com el codi de l'enum
+ *      corresponent de MeterValuesReqJSON.h. Així les taules meter_values i meter_rollups només tenen
+ *      números i els agregats no han de tornar a llegir ni convertir cap text.
+ *      Els noms de cada codi es guarden a les taules measurands, unitats i contexts per poder-los
+ *      mostrar a la web. Si el measurand, les unitats o el context no s'indiquen es fan servir els
+ *      valors per defecte del protocol (Energy.Active.Import.Register, Wh per a l'energia i
+ *      Sample.Periodic). Els valors que no són un número (p. ex. SignedData) es guarden tal com arriben.
+ *      Si la base de dades encara té les taules amb els textos, es passen al format nou a l'inici.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <math.h>
+#include <syslog.h>
+#include <sqlite3.h>
+#include "ws_server.h"
+#include "epoch_time.h"
+#include "meter_rollup.h"
+#include "meter_codes.h"
+
+// noms de cada codi, en l'ordre dels enums de MeterValuesReqJSON.h
+static const char *const measurand_names[] = {
+    [MEASURAND_CURRENT_EXPORT] = "Current.Export",
+    [MEASURAND_CURRENT_IMPORT] = "Current.Import",
+    [MEASURAND_CURRENT_OFFERED] = "Current.Offered",
+    [MEASURAND_ENERGY_ACTIVE_EXPORT_INTERVAL] = "Energy.Active.Export.Interval",
+    [MEASURAND_ENERGY_ACTIVE_EXPORT_REGISTER] = "Energy.Active.Export.Register",
+    [MEASURAND_ENERGY_ACTIVE_IMPORT_INTERVAL] = "Energy.Active.Import.Interval",
+    [MEASURAND_ENERGY_ACTIVE_IMPORT_REGISTER] = "Energy.Active.Import.Register",
+    [MEASURAND_ENERGY_REACTIVE_EXPORT_INTERVAL] = "Energy.Reactive.Export.Interval",
+    [MEASURAND_ENERGY_REACTIVE_EXPORT_REGISTER] = "Energy.Reactive.Export.Register",
+    [MEASURAND_ENERGY_REACTIVE_IMPORT_INTERVAL] = "Energy.Reactive.Import.Interval",
+    [MEASURAND_ENERGY_REACTIVE_IMPORT_REGISTER] = "Energy.Reactive.Import.Register",
+    [MEASURAND_FREQUENCY] = "Frequency",
+    [MEASURAND_POWER_ACTIVE_EXPORT] = "Power.Active.Export",
+    [MEASURAND_POWER_ACTIVE_IMPORT] = "Power.Active.Import",
+    [MEASURAND_POWER_FACTOR] = "Power.Factor",
+    [MEASURAND_POWER_OFFERED] = "Power.Offered",
+    [MEASURAND_POWER_REACTIVE_EXPORT] = "Power.Reactive.Export",
+    [MEASURAND_POWER_REACTIVE_IMPORT] = "Power.Reactive.Import",
+    [MEASURAND_RPM] = "RPM",
+    [MEASURAND_SO_C] = "SoC",
+    [MEASURAND_TEMPERATURE] = "Temperature",
+    [MEASURAND_VOLTAGE] = "Voltage"
+};
+
+static const char *const unit_names[] = {
+    [UNIT_A] = "A",
+    [UNIT_CELCIUS] = "Celcius",
+    [UNIT_CELSIUS] = "Celsius",
+    [UNIT_FAHRENHEIT] = "Fahrenheit",
+    [UNIT_K] = "K",
+    [UNIT_KVAR] = "kvar",
+    [UNIT_KVARH] = "kvarh",
+    [UNIT_K_VA] = "kVA",
+    [UNIT_K_W] = "kW",
+    [UNIT_K_WH] = "kWh",
+    [UNIT_PERCENT] = "Percent",
+    [UNIT_V] = "V",
+    [UNIT_VA] = "VA",
+    [UNIT_VAR] = "var",
+    [UNIT_VARH] = "varh",
+    [UNIT_W] = "W",
+    [UNIT_WH] = "Wh"
+};
+
+static const char *const context_names[] = {
+    [CONTEXT_INTERRUPTION_BEGIN] = "Interruption.Begin",
+    [CONTEXT_INTERRUPTION_END] = "Interruption.End",
+    [CONTEXT_OTHER] = "Other",
+    [CONTEXT_SAMPLE_CLOCK] = "Sample.Clock",
+    [CONTEXT_SAMPLE_PERIODIC] = "Sample.Periodic",
+    [CONTEXT_TRANSACTION_BEGIN] = "Transaction.Begin",
+    [CONTEXT_TRANSACTION_END] = "Transaction.End",
+    [CONTEXT_TRIGGER] = "Trigger"
+};
+
+#define NUM_MEASURANDS (int)(sizeof(measurand_names) / sizeof(measurand_names[0]))
+#define NUM_UNITS (int)(sizeof(unit_names) / sizeof(unit_names[0]))
+#define NUM_CONTEXTS (int)(sizeof(context_names) / sizeof(context_names[0]))
+
+// pas de cada unitat a la canònica: valor canònic = valor * factor + offset
+struct unit_conversion {
+    int canonical;
+    double factor;
+    double offset;
+};
+
+static const struct unit_conversion conversions[] = {
+    [UNIT_A] = {UNIT_A, 1, 0},
+    [UNIT_CELCIUS] = {UNIT_CELSIUS, 1, 0},
+    [UNIT_CELSIUS] = {UNIT_CELSIUS, 1, 0},
+    [UNIT_FAHRENHEIT] = {UNIT_CELSIUS, 5.0 / 9, -160.0 / 9},
+    [UNIT_K] = {UNIT_CELSIUS, 1, -273.15},
+    [UNIT_KVAR] = {UNIT_VAR, 1000, 0},
+    [UNIT_KVARH] = {UNIT_VARH, 1000, 0},
+    [UNIT_K_VA] = {UNIT_VA, 1000, 0},
+    [UNIT_K_W] = {UNIT_W, 1000, 0},
+    [UNIT_K_WH] = {UNIT_WH, 1000, 0},
+    [UNIT_PERCENT] = {UNIT_PERCENT, 1, 0},
+    [UNIT_V] = {UNIT_V, 1, 0},
+    [UNIT_VA] = {UNIT_VA, 1, 0},
+    [UNIT_VAR] = {UNIT_VAR, 1, 0},
+    [UNIT_VARH] = {UNIT_VARH, 1, 0},
+    [UNIT_W] = {UNIT_W, 1, 0},
+    [UNIT_WH] = {UNIT_WH, 1, 0}
+};
+
+// taula meter_values amb els codis (la mateixa que a base_dades.sql)
+#define METER_VALUES_TABLE "CREATE TABLE IF NOT EXISTS meter_values (id INTEGER PRIMARY KEY AUTOINCREMENT, " \
+    "charger_id INT NOT NULL, connector INT NOT NULL, transaccio INT, hora TEXT NOT NULL, valor REAL NOT NULL, " \
+    "unit INT, measurand INT NOT NULL, context INT NOT NULL, ts INTEGER NOT NULL DEFAULT 0);"
+
+// Prototips de les funcions
+static void normalise(struct meter_sample *sample, const char *value, bool signed_data, int measurand, int unit,
+    int context);
+static int default_unit(int measurand);
+static int find_code(const char *const names[], int count, const char *name);
+static void fill_codes(sqlite3 *db, const char *table, const char *const names[], int count);
+static bool text_columns(sqlite3 *db, const char *table);
+static bool migrate_meter_values(sqlite3 *db);
+static bool migrate_rollups(sqlite3 *db);
+
+/*
+ *  NAME
+ *      meter_codes_init - Crea les taules dels codis dels MeterValues
+ *  SYNOPSIS
+ *      void meter_codes_init(void);
+ *  DESCRIPTION
+ *      Crea i omple les taules measurands, unitats i contexts amb el nom de cada codi. Si les taules
+ *      meter_values o meter_rollups encara guarden el measurand en text, les passa als codis (els
+ *      meter_values també es passen a les unitats canòniques). S'ha de cridar abans de history_init()
+ *      i de meter_rollup_init(), que creen els índexs de les taules noves.
+ *  RETURN VALUE
+ *      Res.
+ */
+void meter_codes_init(void)
+{
+    sqlite3 *db;
+    int rc;
+    char *errmsg;
+
+    rc = sqlite3_open(DATABASE_PATH, &db);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: ERROR opening SQLite DB: %s\n", __func__, sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return;
+    }
+
+    rc = sqlite3_exec(db, "BEGIN;"
+        "CREATE TABLE IF NOT EXISTS measurands (codi INTEGER PRIMARY KEY, nom TEXT NOT NULL);"
+        "CREATE TABLE IF NOT EXISTS unitats (codi INTEGER PRIMARY KEY, nom TEXT NOT NULL);"
+        "CREATE TABLE IF NOT EXISTS contexts (codi INTEGER PRIMARY KEY, nom TEXT NOT NULL);", 0, 0, &errmsg);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+        sqlite3_free(errmsg);
+    }
+    fill_codes(db, "measurands", measurand_names, NUM_MEASURANDS);
+    fill_codes(db, "unitats", unit_names, NUM_UNITS);
+    fill_codes(db, "contexts", context_names, NUM_CONTEXTS);
+
+    // si la migració falla es desfà tota la transacció i es torna a provar a la propera arrencada
+    bool ok = true;
+    if (text_columns(db, "meter_values"))
+        ok = migrate_meter_values(db);
+    if (ok && text_columns(db, "meter_rollups"))
+        ok = migrate_rollups(db);
+
+    rc = sqlite3_exec(db, ok ? "COMMIT;" : "ROLLBACK;", 0, 0, &errmsg);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+        sqlite3_free(errmsg);
+    }
+    sqlite3_close(db); // tanca la base de dades correctament
+}
+
+/*
+ *  NAME
+ *      meter_sample_parse - Llegeix el valor d'un MeterValues
+ *  SYNOPSIS
+ *      void meter_sample_parse(struct meter_sample *sample, const struct SampledValue *sampled_value);
+ *  DESCRIPTION
+ *      Guarda a sample el valor de sampled_value passat a número i a les unitats canòniques, i els
+ *      codis del measurand, les unitats i el context (amb els valors per defecte del protocol si no
+ *      s'indiquen). Si el valor no és un número, sample->text apunta al text de sampled_value.
+ *  RETURN VALUE
+ *      Res.
+ */
+void meter_sample_parse(struct meter_sample *sample, const struct SampledValue *sampled_value)
+{
+    normalise(sample, sampled_value->value, sampled_value->format && *sampled_value->format == FORMAT_SIGNED_DATA,
+        sampled_value->measurand ? (int)*sampled_value->measurand : -1,
+        sampled_value->unit ? (int)*sampled_value->unit : -1,
+        sampled_value->context ? (int)*sampled_value->context : -1);
+}
+
+/*
+ *  NAME
+ *      meter_measurand_code - Retorna el codi d'un measurand
+ *  SYNOPSIS
+ *      int meter_measurand_code(const char *name);
+ *  DESCRIPTION
+ *      Busca el measurand amb el nom name (sense distingir majúscules i minúscules).
+ *  RETURN VALUE
+ *      El codi del measurand (enum Measurand).
+ *      Retorna -1 si no existeix.
+ */
+int meter_measurand_code(const char *name)
+{
+    return find_code(measurand_names, NUM_MEASURANDS, name);
+}
+
+/*
+ *  NAME
+ *      normalise - Passa un valor a les unitats canòniques
+ *  SYNOPSIS
+ *      static void normalise(struct meter_sample *sample, const char *value, bool signed_data, int measurand,
+ *                            int unit, int context);
+ *  DESCRIPTION
+ *      Omple sample amb el valor value (text) passat a les unitats canòniques. measurand, unit i context
+ *      són els codis dels enums, o -1 si no s'indiquen. Els valors signats (signed_data) no es llegeixen.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void normalise(struct meter_sample *sample, const char *value, bool signed_data, int measurand, int unit,
+    int context)
+{
+    char *end;
+
+    sample->measurand = measurand >= 0 && measurand < NUM_MEASURANDS ? measurand : MEASURAND_ENERGY_ACTIVE_IMPORT_REGISTER;
+    sample->context = context >= 0 && context < NUM_CONTEXTS ? context : CONTEXT_SAMPLE_PERIODIC;
+    if (unit < 0 || unit >= NUM_UNITS)
+        unit = default_unit(sample->measurand);
+    sample->unit = unit == METER_NO_UNIT ? METER_NO_UNIT : conversions[unit].canonical;
+    sample->text = value;
+    sample->valor = 0;
+
+    if (value == NULL || signed_data)
+        return;
+
+    double number = strtod(value, &end);
+    if (end == value || *end != '\0' || !isfinite(number))
+        return;
+
+    sample->text = NULL;
+    sample->valor = unit == METER_NO_UNIT ? number : number * conversions[unit].factor + conversions[unit].offset;
+}
+
+/*
+ *  NAME
+ *      default_unit - Retorna les unitats per defecte d'un measurand
+ *  SYNOPSIS
+ *      static int default_unit(int measurand);
+ *  DESCRIPTION
+ *      Segons el protocol, si no s'indiquen les unitats d'una energia són Wh (varh si és reactiva).
+ *      La resta de measurands sense unitats es guarden sense unitats.
+ *  RETURN VALUE
+ *      El codi de les unitats o METER_NO_UNIT.
+ */
+static int default_unit(int measurand)
+{
+    switch (measurand) {
+        case MEASURAND_ENERGY_ACTIVE_EXPORT_INTERVAL:
+        case MEASURAND_ENERGY_ACTIVE_EXPORT_REGISTER:
+        case MEASURAND_ENERGY_ACTIVE_IMPORT_INTERVAL:
+        case MEASURAND_ENERGY_ACTIVE_IMPORT_REGISTER:
+            return UNIT_WH;
+        case MEASURAND_ENERGY_REACTIVE_EXPORT_INTERVAL:
+        case MEASURAND_ENERGY_REACTIVE_EXPORT_REGISTER:
+        case MEASURAND_ENERGY_REACTIVE_IMPORT_INTERVAL:
+        case MEASURAND_ENERGY_REACTIVE_IMPORT_REGISTER:
+            return UNIT_VARH;
+        default:
+            return METER_NO_UNIT;
+    }
+}
+
+/*
+ *  NAME
+ *      find_code - Busca el codi d'un nom
+ *  SYNOPSIS
+ *      static int find_code(const char *const names[], int count, const char *name);
+ *  DESCRIPTION
+ *      Busca name entre els count noms de names sense distingir majúscules i minúscules (la base de
+ *      dades antiga guardava "kwH" i "kVa").
+ *  RETURN VALUE
+ *      El codi (posició dins de names).
+ *      Retorna -1 si no hi és.
+ */
+static int find_code(const char *const names[], int count, const char *name)
+{
+    for (int i = 0; name != NULL && i < count; i++) {
+        if (strcasecmp(names[i], name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/*
+ *  NAME
+ *      fill_codes - Omple una taula de codis
+ *  SYNOPSIS
+ *      static void fill_codes(sqlite3 *db, const char *table, const char *const names[], int count);
+ *  DESCRIPTION
+ *      Guarda a la taula table el codi i el nom de cadascun dels count noms de names.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void fill_codes(sqlite3 *db, const char *table, const char *const names[], int count)
+{
+    sqlite3_stmt *stmt;
+    char query[100];
+
+    snprintf(query, sizeof(query), "INSERT OR REPLACE INTO %s(codi, nom) VALUES(?1, ?2);", table);
+    if (sqlite3_prepare_v2(db, query, -1, &stmt, NULL) != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, sqlite3_errmsg(db));
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        sqlite3_bind_int(stmt, 1, i);
+        sqlite3_bind_text(stmt, 2, names[i], -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, sqlite3_errmsg(db));
+        sqlite3_reset(stmt);
+    }
+
+    sqlite3_finalize(stmt);
+}
+
+/*
+ *  NAME
+ *      text_columns - Comprova si una taula guarda els codis en text
+ *  SYNOPSIS
+ *      static bool text_columns(sqlite3 *db, const char *table);
+ *  DESCRIPTION
+ *      Mira el tipus de la columna measurand de la taula table.
+ *  RETURN VALUE
+ *      Retorna true si la taula existeix i la columna és de text.
+ *      Retorna false en cas contrari.
+ */
+static bool text_columns(sqlite3 *db, const char *table)
+{
+    sqlite3_stmt *stmt;
+    bool text = false;
+
+    if (sqlite3_prepare_v2(db, "SELECT type FROM pragma_table_info(?1) WHERE name = 'measurand';", -1, &stmt, NULL)
+        != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, sqlite3_errmsg(db));
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        text = strcasecmp((const char *)sqlite3_column_text(stmt, 0), "TEXT") == 0;
+    sqlite3_finalize(stmt);
+
+    return text;
+}
+
+/*
+ *  NAME
+ *      migrate_meter_values - Passa la taula meter_values als codis
+ *  SYNOPSIS
+ *      static bool migrate_meter_values(sqlite3 *db);
+ *  DESCRIPTION
+ *      Crea la taula meter_values nova i hi copia cada fila de l'antiga llegint-la igual que els
+ *      MeterValues que arriben. Es crida dins d'una transacció.
+ *  RETURN VALUE
+ *      Retorna true si s'ha pogut passar.
+ *      Retorna false en cas contrari.
+ */
+static bool migrate_meter_values(sqlite3 *db)
+{
+    sqlite3_stmt *select, *insert;
+    char *errmsg;
+    int rc;
+    int rows = 0;
+
+    rc = sqlite3_exec(db, "DROP TRIGGER IF EXISTS max_meter_values;"
+        "ALTER TABLE meter_values RENAME TO meter_values_text;" METER_VALUES_TABLE, 0, 0, &errmsg);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+        sqlite3_free(errmsg);
+        return false;
+    }
+
+    if (sqlite3_prepare_v2(db, "SELECT id, charger_id, connector, transaccio, hora, valor, unit, measurand, context "
+        "FROM meter_values_text ORDER BY id;", -1, &select, NULL) != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, sqlite3_errmsg(db));
+        return false;
+    }
+    if (sqlite3_prepare_v2(db, "INSERT INTO meter_values(id, charger_id, connector, transaccio, hora, valor, unit, "
+        "measurand, context) VALUES(?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9);", -1, &insert, NULL) != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, sqlite3_errmsg(db));
+        sqlite3_finalize(select);
+        return false;
+    }
+
+    while ((rc = sqlite3_step(select)) == SQLITE_ROW) {
+        struct meter_sample sample;
+        normalise(&sample, (const char *)sqlite3_column_text(select, 5), false,
+            find_code(measurand_names, NUM_MEASURANDS, (const char *)sqlite3_column_text(select, 7)),
+            find_code(unit_names, NUM_UNITS, (const char *)sqlite3_column_text(select, 6)),
+            find_code(context_names, NUM_CONTEXTS, (const char *)sqlite3_column_text(select, 8)));
+
+        for (int i = 0; i < 5; i++)
+            sqlite3_bind_value(insert, i + 1, sqlite3_column_value(select, i));
+        if (sample.text == NULL)
+            sqlite3_bind_double(insert, 6, sample.valor);
+        else
+            sqlite3_bind_value(insert, 6, sqlite3_column_value(select, 5));
+        if (sample.unit == METER_NO_UNIT)
+            sqlite3_bind_null(insert, 7);
+        else
+            sqlite3_bind_int(insert, 7, sample.unit);
+        sqlite3_bind_int(insert, 8, sample.measurand);
+        sqlite3_bind_int(insert, 9, sample.context);
+
+        if (sqlite3_step(insert) != SQLITE_DONE)
+            break;
+        sqlite3_reset(insert);
+        rows++;
+    }
+
+    bool ok = rc == SQLITE_DONE;
+    if (!ok)
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, sqlite3_errmsg(db));
+    sqlite3_finalize(insert);
+    sqlite3_finalize(select);
+    if (!ok)
+        return false;
+
+    // els índexs de la taula antiga s'esborren amb ella, history_init() els torna a crear (i el trigger,
+    // i omple el ts a partir de l'hora)
+    rc = sqlite3_exec(db, "DROP TABLE meter_values_text;", 0, 0, &errmsg);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+        sqlite3_free(errmsg);
+        return false;
+    }
+
+    syslog(LOG_INFO, "%s: %d meter_values passats als codis", __func__, rows);
+    return true;
+}
+
+/*
+ *  NAME
+ *      migrate_rollups - Passa la taula meter_rollups als codis
+ *  SYNOPSIS
+ *      static bool migrate_rollups(sqlite3 *db);
+ *  DESCRIPTION
+ *      Crea la taula meter_rollups nova i hi copia els agregats canviant el nom del measurand i de
+ *      les unitats pel seu codi (els agregats ja estaven en unitats sense el prefix k). L'índex el
+ *      torna a crear meter_rollup_init(). Es crida dins d'una transacció.
+ *  RETURN VALUE
+ *      Retorna true si s'ha pogut passar.
+ *      Retorna false en cas contrari.
+ */
+static bool migrate_rollups(sqlite3 *db)
+{
+    char *errmsg;
+
+    int rc = sqlite3_exec(db, "ALTER TABLE meter_rollups RENAME TO meter_rollups_text;"
+        "DROP INDEX IF EXISTS meter_rollups_interval;" METER_ROLLUPS_TABLE
+        "INSERT INTO meter_rollups(id, resolucio, charger_id, connector, measurand, hora, unit, mostres, minim, "
+        "maxim, suma, ultim, hora_ultim, energia, ts) SELECT r.id, r.resolucio, r.charger_id, r.connector, m.codi, "
+        "r.hora, u.codi, r.mostres, r.minim, r.maxim, r.suma, r.ultim, r.hora_ultim, r.energia, "
+        "coalesce(" EPOCH_MS_SQL("r.hora") ", 0) "
+        "FROM meter_rollups_text r JOIN measurands m ON m.nom = r.measurand "
+        "LEFT JOIN unitats u ON u.nom = r.unit COLLATE NOCASE;"
+        "DROP TABLE meter_rollups_text;", 0, 0, &errmsg);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+        sqlite3_free(errmsg);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,35 @@
+/*
+ *  FILE
+ *      meter_codes.h - header de meter_codes.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header dels codis i de la normalització de les unitats dels MeterValues.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _METER_CODES_H_
+#define _METER_CODES_H_
+
+#include <list.h>
+#include "MeterValuesReqJSON.h"
+
+#define METER_NO_UNIT -1    // codi d'un valor sense unitats (p. ex. Frequency o Power.Factor)
+
+// valor d'un MeterValues ja llegit i passat a les unitats canòniques
+struct meter_sample {
+    double valor;       // valor en les unitats canòniques
+    const char *text;   // valor tal com ha arribat si no és un número (p. ex. SignedData), NULL si ho és
+    int measurand;      // codi del measurand (enum Measurand)
+    int unit;           // codi de les unitats canòniques (enum Unit) o METER_NO_UNIT
+    int context;        // codi del context (enum Context)
+};
+
+void meter_codes_init(void);
+void meter_sample_parse(struct meter_sample *sample, const struct SampledValue *sampled_value);
+int meter_measurand_code(const char *name);
+
+#endif
@@ -0,0 +1,497 @@
+/*
+ *  FILE
+ *      meter_ingest.c - cua d'entrada dels MeterValues
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Quan els carregadors envien dades alineades amb el rellotge (ClockAlignedDataInterval), tots
+ *      els MeterValues arriben el mateix segon. Per no fer esperar els carregadors mentre es guarden
+ *      a la base de dades, els valors es copien a una cua circular de METER_INGEST_SLOTS registres
+ *      reservada a l'inici (cada registre té el seu propi espai per als textos, de manera que no es
+ *      reserva memòria per cada valor) i es respon de seguida. Un thread buida la cua per lots de
+ *      METER_INGEST_BATCH registres, cada lot en una sola transacció de la base de dades.
+ *      Si la cua és plena, el valor es guarda directament (com abans) per no perdre'l.
+ *      Els valors arriben ja llegits (meter_codes): el registre guarda el número i els codis del
+ *      measurand, les unitats i el context, i només l'hora (i el valor si no és un número) en text.
+ *      En guardar cada valor també s'actualitzen els seus agregats per intervals (meter_rollup).
+ *      Es guarda la profunditat màxima de la cua i el temps que es triga a buidar cada ràfega.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <sqlite3.h>
+#include "ws_server.h"
+#include "meter_ingest.h"
+#include "meter_rollup.h"
+
+#if METER_INGEST_SLOTS & (METER_INGEST_SLOTS - 1)
+#error "METER_INGEST_SLOTS ha de ser potència de 2"
+#endif
+
+#if METER_RECORD_TEXT > 256
+#error "les posicions dels camps dels registres són d'un byte"
+#endif
+
+// camps de text d'un registre, en l'ordre en què es guarden
+enum meter_field {
+    FIELD_HORA,
+    FIELD_VALOR,    // buit si el valor és un número
+    NUM_FIELDS
+};
+
+// valor d'un MeterValues pendent de guardar
+struct meter_record {
+    int charger_id;
+    int64_t connector;
+    int64_t transaccio;
+    int64_t ts;                     // hora en mil·lisegons des de l'epoch
+    double valor;                   // valor en les unitats canòniques
+    bool numeric;                   // el valor és un número (si no, és el text del camp FIELD_VALOR)
+    int8_t measurand;               // codis de meter_codes
+    int8_t unit;
+    int8_t context;
+    uint8_t offset[NUM_FIELDS];     // posició de cada camp dins de text
+    char text[METER_RECORD_TEXT];   // els camps seguits, acabats en '\0'
+};
+
+// estadístiques de la cua
+struct ingest_stats {
+    uint64_t pushed;            // registres que han entrat a la cua
+    uint64_t stored;            // registres guardats pel thread
+    uint64_t overflows;         // registres guardats directament perquè la cua era plena o massa llargs
+    unsigned int max_depth;     // profunditat màxima de la cua
+    unsigned int burst_depth;   // profunditat màxima de la ràfega actual
+    int64_t burst_start_ms;     // hora d'inici de la ràfega actual
+    int64_t last_burst_ms;      // temps que es va trigar a buidar l'última ràfega
+    unsigned int last_burst;    // profunditat màxima de l'última ràfega
+    int64_t last_batch_ms;      // temps que es va trigar a guardar l'últim lot
+    int64_t max_batch_ms;       // temps màxim per guardar un lot
+    unsigned int window_depth;  // profunditat màxima des de l'última crida a meter_ingest_load()
+    int64_t window_batch_ms;    // temps màxim per guardar un lot des de l'última crida a meter_ingest_load()
+};
+
+static struct meter_record ring[METER_INGEST_SLOTS];
+static unsigned int head = 0;   // següent posició on s'escriurà (només amb ingest_lock)
+static unsigned int tail = 0;   // següent posició que guardarà el thread (només l'avança el thread)
+static struct ingest_stats stats;
+static pthread_mutex_t ingest_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ingest_cond = PTHREAD_COND_INITIALIZER;
+
+// Prototips de les funcions
+static void *drain_thread(void *arg);
+static void set_record(struct meter_record *record, int charger_id, int64_t connector, int64_t transaccio,
+    int64_t ts, const struct meter_sample *sample);
+static bool fill_record(struct meter_record *record, const char *fields[NUM_FIELDS]);
+static sqlite3_stmt *prepare_insert(sqlite3 *db);
+static void store_record(sqlite3 *db, sqlite3_stmt *stmt, const struct meter_record *record, const char *hora,
+    const char *text);
+static void store_records(sqlite3 *db, unsigned int start, unsigned int count);
+static void store_direct(const struct meter_record *record, const char *fields[NUM_FIELDS]);
+static int64_t now_ms(void);
+
+/*
+ *  NAME
+ *      meter_ingest_init - Inicialitza la cua d'entrada dels MeterValues
+ *  SYNOPSIS
+ *      void meter_ingest_init(void);
+ *  DESCRIPTION
+ *      Crea el thread que buida la cua a la base de dades.
+ *  RETURN VALUE
+ *      Res.
+ */
+void meter_ingest_init(void)
+{
+    pthread_t thread;
+
+    if (pthread_create(&thread, NULL, drain_thread, NULL) == 0)
+        pthread_detach(thread);
+    else
+        syslog(LOG_ERR, "%s: pthread_create failed", __func__);
+}
+
+/*
+ *  NAME
+ *      meter_ingest_push - Afegeix un valor a la cua
+ *  SYNOPSIS
+ *      bool meter_ingest_push(int charger_id, int64_t connector, int64_t transaccio, const char *hora, int64_t ts,
+ *                             const struct meter_sample *sample);
+ *  DESCRIPTION
+ *      Copia el valor sample, amb l'hora hora tal com l'ha enviat el carregador i ts (la mateixa hora en
+ *      mil·lisegons des de l'epoch), a la cua perquè el thread el guardi a la taula meter_values. Si la
+ *      cua és plena o els textos no hi caben, el valor es guarda directament a la base de dades.
+ *  RETURN VALUE
+ *      Retorna true si el valor s'ha afegit a la cua.
+ *      Retorna false si s'ha guardat directament.
+ */
+bool meter_ingest_push(int charger_id, int64_t connector, int64_t transaccio, const char *hora, int64_t ts,
+    const struct meter_sample *sample)
+{
+    const char *fields[NUM_FIELDS] = {hora, sample->text};
+    struct meter_record *record = NULL;
+    bool queued = false;
+
+    pthread_mutex_lock(&ingest_lock);
+    unsigned int depth = head - tail;
+    if (depth < METER_INGEST_SLOTS) {
+        record = &ring[head & (METER_INGEST_SLOTS - 1)];
+        set_record(record, charger_id, connector, transaccio, ts, sample);
+        queued = fill_record(record, fields);
+    }
+
+    if (queued) {
+        head++;
+        depth++;
+        stats.pushed++;
+        if (depth > stats.max_depth)
+            stats.max_depth = depth;
+        if (depth > stats.window_depth)
+            stats.window_depth = depth;
+        if (depth > stats.burst_depth) {
+            if (stats.burst_depth == 0)
+                stats.burst_start_ms = now_ms();
+            stats.burst_depth = depth;
+        }
+        pthread_cond_signal(&ingest_cond);
+    }
+    else {
+        stats.overflows++;
+    }
+    pthread_mutex_unlock(&ingest_lock);
+
+    if (!queued) {
+        struct meter_record direct;
+        set_record(&direct, charger_id, connector, transaccio, ts, sample);
+        store_direct(&direct, fields);
+    }
+
+    return queued;
+}
+
+/*
+ *  NAME
+ *      meter_ingest_stats_json - Escriu les estadístiques de la cua
+ *  SYNOPSIS
+ *      int meter_ingest_stats_json(char *buf, size_t len);
+ *  DESCRIPTION
+ *      Escriu a buf el missatge per a la web amb la profunditat de la cua i el temps de buidat.
+ *  RETURN VALUE
+ *      El nombre de caràcters escrits (com snprintf).
+ */
+int meter_ingest_stats_json(char *buf, size_t len)
+{
+    pthread_mutex_lock(&ingest_lock);
+    int n = snprintf(buf, len, "{\"type\": \"ingestStats\", \"depth\": %u, \"maxDepth\": %u, \"pushed\": %lu, \"stored\": %lu, "
+        "\"overflows\": %lu, \"lastBurst\": %u, \"lastBurstMs\": %ld, \"lastBatchMs\": %ld, \"maxBatchMs\": %ld}",
+        head - tail, stats.max_depth, stats.pushed, stats.stored, stats.overflows, stats.last_burst,
+        stats.last_burst_ms, stats.last_batch_ms, stats.max_batch_ms);
+    pthread_mutex_unlock(&ingest_lock);
+
+    return n;
+}
+
+/*
+ *  NAME
+ *      meter_ingest_load - Retorna la càrrega de la cua
+ *  SYNOPSIS
+ *      void meter_ingest_load(unsigned int *max_depth, int64_t *max_batch_ms);
+ *  DESCRIPTION
+ *      Guarda a max_depth la profunditat màxima de la cua i a max_batch_ms el temps màxim per guardar
+ *      un lot des de l'última crida, i torna a començar a comptar.
+ *  RETURN VALUE
+ *      Res.
+ */
+void meter_ingest_load(unsigned int *max_depth, int64_t *max_batch_ms)
+{
+    pthread_mutex_lock(&ingest_lock);
+    *max_depth = stats.window_depth > head - tail ? stats.window_depth : head - tail;
+    *max_batch_ms = stats.window_batch_ms;
+    stats.window_depth = head - tail;
+    stats.window_batch_ms = 0;
+    pthread_mutex_unlock(&ingest_lock);
+}
+
+/*
+ *  NAME
+ *      drain_thread - Buida la cua a la base de dades
+ *  SYNOPSIS
+ *      static void *drain_thread(void *arg);
+ *  DESCRIPTION
+ *      Espera que hi hagi registres a la cua i els guarda per lots. Els registres entre tail i head
+ *      només els llegeix aquest thread, i no es poden sobreescriure fins que no s'avança tail.
+ *  RETURN VALUE
+ *      NULL.
+ */
+static void *drain_thread(void *arg)
+{
+    struct timespec pause = {0, METER_INGEST_PAUSE_MS * 1000000L};
+
+    while (1) {
+        pthread_mutex_lock(&ingest_lock);
+        while (head == tail)
+            pthread_cond_wait(&ingest_cond, &ingest_lock);
+        unsigned int start = tail;
+        unsigned int count = head - tail;
+        pthread_mutex_unlock(&ingest_lock);
+
+        if (count > METER_INGEST_BATCH)
+            count = METER_INGEST_BATCH;
+
+        int64_t batch_start = now_ms();
+        sqlite3 *db;
+        if (sqlite3_open(DATABASE_PATH, &db) != SQLITE_OK) {
+            syslog(LOG_ERR, "%s: ERROR opening SQLite DB: %s\n", __func__, sqlite3_errmsg(db));
+        }
+        else {
+            sqlite3_busy_timeout(db, METER_INGEST_BUSY_MS);
+            store_records(db, start, count);
+        }
+        sqlite3_close(db); // tanca la base de dades correctament
+        int64_t batch_end = now_ms();
+
+        pthread_mutex_lock(&ingest_lock);
+        tail += count; // els registres ja es poden tornar a fer servir
+        stats.stored += count;
+        stats.last_batch_ms = batch_end - batch_start;
+        if (stats.last_batch_ms > stats.max_batch_ms)
+            stats.max_batch_ms = stats.last_batch_ms;
+        if (stats.last_batch_ms > stats.window_batch_ms)
+            stats.window_batch_ms = stats.last_batch_ms;
+        bool empty = head == tail;
+        unsigned int burst = 0;
+        int64_t burst_ms = 0;
+        if (empty) { // s'ha acabat la ràfega
+            burst = stats.last_burst = stats.burst_depth;
+            burst_ms = stats.last_burst_ms = batch_end - stats.burst_start_ms;
+            stats.burst_depth = 0;
+        }
+        pthread_mutex_unlock(&ingest_lock);
+
+        syslog(LOG_DEBUG, "%s: %u valors guardats en %ld ms", __func__, count, batch_end - batch_start);
+        if (burst >= METER_INGEST_BURST)
+            syslog(LOG_INFO, "%s: ràfega de %u valors buidada en %ld ms", __func__, burst, burst_ms);
+
+        if (!empty)
+            nanosleep(&pause, NULL); // deixo treballar la resta d'escriptures de la base de dades
+    }
+
+    return NULL;
+}
+
+/*
+ *  NAME
+ *      set_record - Copia els números d'un valor a un registre
+ *  SYNOPSIS
+ *      static void set_record(struct meter_record *record, int charger_id, int64_t connector, int64_t transaccio,
+ *                             int64_t ts, const struct meter_sample *sample);
+ *  DESCRIPTION
+ *      Guarda al registre el carregador, el connector, la transacció, l'hora, el valor i els codis.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void set_record(struct meter_record *record, int charger_id, int64_t connector, int64_t transaccio,
+    int64_t ts, const struct meter_sample *sample)
+{
+    record->charger_id = charger_id;
+    record->connector = connector;
+    record->transaccio = transaccio;
+    record->ts = ts;
+    record->valor = sample->valor;
+    record->numeric = sample->text == NULL;
+    record->measurand = (int8_t)sample->measurand;
+    record->unit = (int8_t)sample->unit;
+    record->context = (int8_t)sample->context;
+}
+
+/*
+ *  NAME
+ *      fill_record - Copia els textos d'un valor a un registre
+ *  SYNOPSIS
+ *      static bool fill_record(struct meter_record *record, const char *fields[NUM_FIELDS]);
+ *  DESCRIPTION
+ *      Copia els camps seguits a l'espai de text del registre.
+ *  RETURN VALUE
+ *      Retorna true si hi caben.
+ *      Retorna false en cas contrari.
+ */
+static bool fill_record(struct meter_record *record, const char *fields[NUM_FIELDS])
+{
+    size_t used = 0;
+
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        const char *field = fields[i] ? fields[i] : "";
+        size_t field_len = strlen(field) + 1;
+        if (used + field_len > METER_RECORD_TEXT)
+            return false;
+        record->offset[i] = (uint8_t)used;
+        memcpy(record->text + used, field, field_len);
+        used += field_len;
+    }
+
+    return true;
+}
+
+/*
+ *  NAME
+ *      prepare_insert - Prepara la sentència per guardar els valors
+ *  SYNOPSIS
+ *      static sqlite3_stmt *prepare_insert(sqlite3 *db);
+ *  DESCRIPTION
+ *      Prepara la inserció d'un valor a la taula meter_values.
+ *  RETURN VALUE
+ *      Retorna la sentència.
+ *      Retorna NULL en cas d'error.
+ */
+static sqlite3_stmt *prepare_insert(sqlite3 *db)
+{
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(db, "INSERT INTO meter_values(charger_id, connector, transaccio, hora, valor, unit, "
+        "measurand, context, ts) VALUES(?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9);", -1, &stmt, NULL) != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, sqlite3_errmsg(db));
+        return NULL;
+    }
+
+    return stmt;
+}
+
+/*
+ *  NAME
+ *      store_record - Guarda un valor
+ *  SYNOPSIS
+ *      static void store_record(sqlite3 *db, sqlite3_stmt *stmt, const struct meter_record *record, const char *hora,
+ *                               const char *text);
+ *  DESCRIPTION
+ *      Guarda el valor del registre (amb l'hora hora, i el text text si no és un número) a la taula
+ *      meter_values amb la sentència stmt de prepare_insert(), i l'afegeix als agregats.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void store_record(sqlite3 *db, sqlite3_stmt *stmt, const struct meter_record *record, const char *hora,
+    const char *text)
+{
+    sqlite3_bind_int(stmt, 1, record->charger_id);
+    sqlite3_bind_int64(stmt, 2, record->connector);
+    sqlite3_bind_int64(stmt, 3, record->transaccio);
+    sqlite3_bind_text(stmt, 4, hora, -1, SQLITE_STATIC);
+    if (record->numeric)
+        sqlite3_bind_double(stmt, 5, record->valor);
+    else
+        sqlite3_bind_text(stmt, 5, text, -1, SQLITE_STATIC);
+    if (record->unit == METER_NO_UNIT)
+        sqlite3_bind_null(stmt, 6);
+    else
+        sqlite3_bind_int(stmt, 6, record->unit);
+    sqlite3_bind_int(stmt, 7, record->measurand);
+    sqlite3_bind_int(stmt, 8, record->context);
+    sqlite3_bind_int64(stmt, 9, record->ts);
+
+    if (sqlite3_step(stmt) != SQLITE_DONE)
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, sqlite3_errmsg(db));
+    sqlite3_reset(stmt);
+
+    struct meter_sample sample = {
+        .valor = record->valor,
+        .text = record->numeric ? NULL : text,
+        .measurand = record->measurand,
+        .unit = record->unit,
+        .context = record->context
+    };
+    meter_rollup_add(db, record->charger_id, record->connector, record->ts, &sample);
+}
+
+/*
+ *  NAME
+ *      store_records - Guarda un lot de registres
+ *  SYNOPSIS
+ *      static void store_records(sqlite3 *db, unsigned int start, unsigned int count);
+ *  DESCRIPTION
+ *      Guarda count registres de la cua a partir de start a la taula meter_values i als agregats,
+ *      dins d'una sola transacció.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void store_records(sqlite3 *db, unsigned int start, unsigned int count)
+{
+    char *errmsg;
+
+    sqlite3_stmt *stmt = prepare_insert(db);
+    if (stmt == NULL)
+        return;
+
+    if (sqlite3_exec(db, "BEGIN;", 0, 0, &errmsg) != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+        sqlite3_free(errmsg);
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        const struct meter_record *record = &ring[(start + i) & (METER_INGEST_SLOTS - 1)];
+        store_record(db, stmt, record, record->text + record->offset[FIELD_HORA],
+            record->text + record->offset[FIELD_VALOR]);
+    }
+
+    if (sqlite3_exec(db, "COMMIT;", 0, 0, &errmsg) != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+        sqlite3_free(errmsg);
+    }
+    sqlite3_finalize(stmt);
+}
+
+/*
+ *  NAME
+ *      store_direct - Guarda un valor sense passar per la cua
+ *  SYNOPSIS
+ *      static void store_direct(const struct meter_record *record, const char *fields[NUM_FIELDS]);
+ *  DESCRIPTION
+ *      Guarda el valor directament a la taula meter_values i als agregats.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void store_direct(const struct meter_record *record, const char *fields[NUM_FIELDS])
+{
+    sqlite3 *db;
+    int rc;
+
+    rc = sqlite3_open(DATABASE_PATH, &db);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: ERROR opening SQLite DB: %s\n", __func__, sqlite3_errmsg(db));
+    }
+    else {
+        sqlite3_busy_timeout(db, METER_INGEST_BUSY_MS);
+
+        sqlite3_stmt *stmt = prepare_insert(db);
+        if (stmt != NULL) {
+            store_record(db, stmt, record, fields[FIELD_HORA] ? fields[FIELD_HORA] : "",
+                fields[FIELD_VALOR] ? fields[FIELD_VALOR] : "");
+            sqlite3_finalize(stmt);
+        }
+    }
+    sqlite3_close(db); // tanca la base de dades correctament
+}
+
+/*
+ *  NAME
+ *      now_ms - Retorna l'hora actual
+ *  SYNOPSIS
+ *      static int64_t now_ms(void);
+ *  DESCRIPTION
+ *      Retorna l'hora del rellotge monòton en mil·lisegons.
+ *  RETURN VALUE
+ *      L'hora en mil·lisegons.
+ */
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
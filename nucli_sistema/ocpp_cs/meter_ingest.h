@@ -0,0 +1,35 @@
+/*
+ *  FILE
+ *      meter_ingest.h - header de meter_ingest.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header de la cua d'entrada dels MeterValues.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _METER_INGEST_H_
+#define _METER_INGEST_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "meter_codes.h"
+
+#define METER_INGEST_SLOTS 4096     // registres que caben a la cua (ha de ser potència de 2)
+#define METER_RECORD_TEXT 128       // bytes de text de cada registre (hora i el valor si no és un número)
+#define METER_INGEST_BATCH 256      // registres que es guarden en una mateixa transacció de la base de dades
+#define METER_INGEST_PAUSE_MS 20    // pausa entre lots mentre la cua no està buida, per no acaparar la base de dades
+#define METER_INGEST_BURST 64       // a partir d'aquesta profunditat es registra la ràfega al log
+#define METER_INGEST_BUSY_MS 5000   // temps màxim d'espera si la base de dades està bloquejada per una altra escriptura
+
+void meter_ingest_init(void);
+bool meter_ingest_push(int charger_id, int64_t connector, int64_t transaccio, const char *hora, int64_t ts,
+    const struct meter_sample *sample);
+int meter_ingest_stats_json(char *buf, size_t len);
+void meter_ingest_load(unsigned int *max_depth, int64_t *max_batch_ms);
+
+#endif
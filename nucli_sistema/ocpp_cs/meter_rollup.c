@@ -0,0 +1,191 @@
+/*
+ *  FILE
+ *      meter_rollup.c - agregats dels MeterValues per intervals de temps
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      A mesura que es guarden els MeterValues s'actualitzen els agregats de la taula meter_rollups
+ *      per intervals d'1 minut, 15 minuts i 1 hora: nombre de mostres, mínim, màxim, suma (la mitjana
+ *      és suma / mostres) i últim valor de cada measurand, i l'energia consumida dins de l'interval.
+ *      Hi ha una fila per connector i una per tot el carregador (connector ROLLUP_ALL_CONNECTORS), que
+ *      agrega les mostres dels connectors 1..n (el connector 0 és el comptador general del carregador
+ *      i ja té les seves pròpies files). Així una gràfica de 30 dies llegeix uns quants milers de
+ *      punts en lloc de tots els MeterValues.
+ *      Cada fila té l'inici de l'interval en mil·lisegons des de l'epoch (ts, que és part de la clau
+ *      de l'interval) i en text UTC (hora), de manera que es pot consultar amb les consultes a
+ *      l'historial (history_query).
+ *      Els valors arriben ja en les unitats canòniques (meter_codes), i el measurand i les unitats es
+ *      guarden amb el seu codi. L'energia de l'interval és la suma de l'increment de
+ *      l'Energy.Active.Import.Register entre cada mostra i l'anterior del connector.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <sqlite3.h>
+#include "ocpp_cs.h"
+#include "ws_server.h"
+#include "epoch_time.h"
+#include "meter_rollup.h"
+
+// amplada dels intervals dels agregats, en segons
+static const int resolutions[] = {60, 900, 3600};
+
+#define NUM_RESOLUTIONS (sizeof(resolutions) / sizeof(resolutions[0]))
+
+// última lectura de l'Energy.Active.Import.Register de cada connector i la seva hora, per calcular l'increment
+static double last_register[MAX_CHARGERS + 1][MAX_CONNECTORS + 1];
+static int64_t last_register_ts[MAX_CHARGERS + 1][MAX_CONNECTORS + 1];
+static bool register_known[MAX_CHARGERS + 1][MAX_CONNECTORS + 1];
+static pthread_mutex_t register_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Prototips de les funcions
+static double energy_delta(int charger_id, int64_t connector, int64_t ts, double value);
+
+/*
+ *  NAME
+ *      meter_rollup_init - Crea la taula dels agregats
+ *  SYNOPSIS
+ *      void meter_rollup_init(void);
+ *  DESCRIPTION
+ *      Crea la taula meter_rollups i el seu índex si no existeixen. Si la taula és d'abans que
+ *      tingués la columna ts, l'afegeix a partir de l'hora i canvia l'índex per hora per l'índex per ts.
+ *  RETURN VALUE
+ *      Res.
+ */
+void meter_rollup_init(void)
+{
+    sqlite3 *db;
+    int rc;
+    char *errmsg;
+
+    rc = sqlite3_open(DATABASE_PATH, &db);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: ERROR opening SQLite DB: %s\n", __func__, sqlite3_errmsg(db));
+    }
+    else {
+        // si la taula ja té la columna ts, l'ALTER TABLE falla i no es fa res més
+        if (sqlite3_exec(db, METER_ROLLUPS_TABLE "ALTER TABLE meter_rollups ADD COLUMN ts INTEGER NOT NULL DEFAULT 0;",
+            0, 0, NULL) == SQLITE_OK) {
+            syslog(LOG_INFO, "%s: afegida la columna ts a meter_rollups", __func__);
+            sqlite3_exec(db, "UPDATE meter_rollups SET ts = coalesce(" EPOCH_MS_SQL("hora") ", 0);", 0, 0, NULL);
+        }
+        rc = sqlite3_exec(db, "DROP INDEX IF EXISTS meter_rollups_interval;"
+            "CREATE UNIQUE INDEX IF NOT EXISTS meter_rollups_ts "
+            "ON meter_rollups(resolucio, charger_id, connector, measurand, ts);", 0, 0, &errmsg);
+        if (rc != SQLITE_OK) {
+            syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+            sqlite3_free(errmsg);
+        }
+    }
+    sqlite3_close(db); // tanca la base de dades correctament
+}
+
+/*
+ *  NAME
+ *      meter_rollup_add - Afegeix una mostra als agregats
+ *  SYNOPSIS
+ *      void meter_rollup_add(sqlite3 *db, int charger_id, int64_t connector, int64_t ts,
+ *                            const struct meter_sample *sample);
+ *  DESCRIPTION
+ *      Afegeix el valor sample d'un MeterValues als agregats de cada interval (del connector i del
+ *      carregador) on cau ts (mil·lisegons des de l'epoch). Es crida amb la base de dades db oberta,
+ *      dins de la mateixa transacció que guarda el valor. Els valors que no són numèrics (p. ex.
+ *      SignedData) o sense hora s'ignoren.
+ *  RETURN VALUE
+ *      Res.
+ */
+void meter_rollup_add(sqlite3 *db, int charger_id, int64_t connector, int64_t ts, const struct meter_sample *sample)
+{
+    sqlite3_stmt *stmt;
+    char interval[EPOCH_TIME_LEN];
+
+    if (charger_id < 1 || charger_id > MAX_CHARGERS || connector < 0 || connector > MAX_CONNECTORS ||
+        sample->text != NULL || ts < 0)
+        return;
+
+    double energy = sample->measurand == MEASURAND_ENERGY_ACTIVE_IMPORT_REGISTER && sample->unit == UNIT_WH ?
+        energy_delta(charger_id, connector, ts, sample->valor) : 0;
+
+    if (sqlite3_prepare_v2(db, "INSERT INTO meter_rollups(resolucio, charger_id, connector, measurand, hora, unit, "
+        "mostres, minim, maxim, suma, ultim, hora_ultim, energia, ts) "
+        "VALUES(?1, ?2, ?3, ?4, ?5, ?6, 1, ?7, ?7, ?7, ?7, ?8, ?9, ?10) "
+        "ON CONFLICT(resolucio, charger_id, connector, measurand, ts) DO UPDATE SET mostres = mostres + 1, "
+        "minim = min(minim, excluded.minim), maxim = max(maxim, excluded.maxim), suma = suma + excluded.suma, "
+        "ultim = CASE WHEN excluded.hora_ultim >= hora_ultim THEN excluded.ultim ELSE ultim END, "
+        "hora_ultim = max(hora_ultim, excluded.hora_ultim), unit = excluded.unit, energia = energia + excluded.energia;",
+        -1, &stmt, NULL) != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, sqlite3_errmsg(db));
+        return;
+    }
+
+    sqlite3_bind_int(stmt, 2, charger_id);
+    sqlite3_bind_int(stmt, 4, sample->measurand);
+    if (sample->unit != METER_NO_UNIT)
+        sqlite3_bind_int(stmt, 6, sample->unit); // si no, es queda a NULL
+    sqlite3_bind_double(stmt, 7, sample->valor);
+    sqlite3_bind_int64(stmt, 8, ts / 1000);
+    sqlite3_bind_double(stmt, 9, energy);
+
+    for (size_t i = 0; i < NUM_RESOLUTIONS; i++) {
+        int64_t start = ts - ts % (resolutions[i] * 1000);
+        epoch_ms_format(start, interval, sizeof(interval));
+
+        sqlite3_bind_int(stmt, 1, resolutions[i]);
+        sqlite3_bind_text(stmt, 5, interval, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 10, start);
+
+        // una fila pel connector i una per tot el carregador (només amb els connectors 1..n)
+        for (int all = 0; all <= (connector > 0); all++) {
+            sqlite3_bind_int64(stmt, 3, all ? ROLLUP_ALL_CONNECTORS : connector);
+            if (sqlite3_step(stmt) != SQLITE_DONE)
+                syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, sqlite3_errmsg(db));
+            sqlite3_reset(stmt);
+        }
+    }
+
+    sqlite3_finalize(stmt);
+}
+
+/*
+ *  NAME
+ *      energy_delta - Calcula l'energia consumida des de l'última lectura
+ *  SYNOPSIS
+ *      static double energy_delta(int charger_id, int64_t connector, int64_t ts, double value);
+ *  DESCRIPTION
+ *      Retorna l'increment de l'Energy.Active.Import.Register (en Wh) del connector respecte de
+ *      l'última lectura i guarda value, llegit a l'hora ts, com a última lectura. La primera lectura
+ *      d'un connector des que ha arrencat el nucli no suma energia. Les lectures que no són
+ *      posteriors a l'última (p. ex. valors endarrerits que el carregador reenvia) s'ignoren. Si una
+ *      lectura posterior és més petita que l'última, s'ha reiniciat el comptador i suma value.
+ *  RETURN VALUE
+ *      L'energia en Wh.
+ */
+static double energy_delta(int charger_id, int64_t connector, int64_t ts, double value)
+{
+    double delta = 0;
+
+    pthread_mutex_lock(&register_lock);
+    if (register_known[charger_id][connector] && ts <= last_register_ts[charger_id][connector]) {
+        pthread_mutex_unlock(&register_lock);
+        return 0;
+    }
+
+    if (register_known[charger_id][connector])
+        delta = value >= last_register[charger_id][connector] ? value - last_register[charger_id][connector] : value;
+    last_register[charger_id][connector] = value;
+    last_register_ts[charger_id][connector] = ts;
+    register_known[charger_id][connector] = true;
+    pthread_mutex_unlock(&register_lock);
+
+    return delta;
+}
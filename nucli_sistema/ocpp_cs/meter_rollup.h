@@ -0,0 +1,32 @@
+/*
+ *  FILE
+ *      meter_rollup.h - header de meter_rollup.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header dels agregats dels MeterValues per intervals de temps.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _METER_ROLLUP_H_
+#define _METER_ROLLUP_H_
+
+#include <stdint.h>
+#include <sqlite3.h>
+#include "meter_codes.h"
+
+#define ROLLUP_ALL_CONNECTORS -1    // connector dels agregats de tot el carregador
+
+// taula dels agregats (measurand i unit són els codis de meter_codes)
+#define METER_ROLLUPS_TABLE "CREATE TABLE IF NOT EXISTS meter_rollups (id INTEGER PRIMARY KEY, " \
+    "resolucio INT NOT NULL, charger_id INT NOT NULL, connector INT NOT NULL, measurand INT NOT NULL, " \
+    "hora TEXT NOT NULL, ts INTEGER NOT NULL, unit INT, mostres INT NOT NULL, minim REAL NOT NULL, maxim REAL NOT NULL, " \
+    "suma REAL NOT NULL, ultim REAL NOT NULL, hora_ultim INT NOT NULL, energia REAL NOT NULL);"
+
+void meter_rollup_init(void);
+void meter_rollup_add(sqlite3 *db, int charger_id, int64_t connector, int64_t ts, const struct meter_sample *sample);
+
+#endif
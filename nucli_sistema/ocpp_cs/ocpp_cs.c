@@ -28,6 +28,10 @@
 #include "error_messages.h"
 #include "missatges_includes.h"
 #include "lib_json_includes.h"
+#include "auth_store.h"
+#include "connectors.h"
+#include "config_store.h"
+#include "call_cache.h"
 
 #define TIMEOUT_TIME 10 // temps de timeout per missatges sense resposta
 
@@ -39,6 +43,7 @@ char *auth_list[] = {
     "idTag_Charger",
     "100"
 };
+const size_t auth_list_len = sizeof(auth_list) / sizeof(auth_list[0]);
 
 // llista de chargePointModels
 char *cp_models[] = {
@@ -79,7 +84,12 @@ void init_system(ChargerVars *vars)
 
     vars->tx_state = ready_to_send; // es permet enviar peticions
 
-    memset(&vars->conf_keys, 0, sizeof(vars->conf_keys)); // es netegen les claus
+    config_reset(vars); // es netegen les claus
+
+    // la versió de la llista local del carregador no es coneix fins que no es consulta o s'envia
+    vars->local_list_version = 0;
+    vars->pending_list_version = 0;
+    vars->pending_config_key = -1;
 
     // netejo el vendor i el model
     snprintf(vars->current_vendor, sizeof(vars->current_vendor), "%s", "");
@@ -87,19 +97,10 @@ void init_system(ChargerVars *vars)
 
     memset(vars->current_id_tag, 0, sizeof(vars->current_id_tag)); // inicialitzo el idTag per evitar errors
 
-    memset(vars->transaction_list, -1, sizeof(vars->transaction_list)); // Inicializto la llista de transaccions a -1 inidicant que no n'hi ha cap
-
-    for (int i = 0; i < (NUM_CONNECTORS + 1); i++) // Inicialitzo la llista dels idTags dels connectors a "no_charging", indicant que no estan carregant
-        snprintf(vars->current_id_tags[i], ID_TAG_LEN, "%s", "no_charging");
-
-    for (int i = 0; i < NUM_CONNECTORS + 1; i++)
-        syslog(LOG_DEBUG, "idTag%d: %s", i, vars->current_id_tags[i]);
-
-    for (int i = 0; i < (NUM_CONNECTORS + 1); i++) // Inicialitzo la llista dels status dels connectors a CONN_UNKNOWN, indicant que l'estat no és conegut
-        vars->connectors_status[i] = CONN_UNKNOWN;
-
-    for (int i = 0; i < NUM_CONNECTORS + 1; i++)
-        syslog(LOG_DEBUG, "conn%d: %ld", i, vars->connectors_status[i]);
+    // Reservo els connectors per defecte, sense transaccions ("no_charging") i amb l'estat CONN_UNKNOWN;
+    // quan se sàpiga el NumberOfConnectors del carregador es tornaran a reservar
+    connectors_free(vars);
+    connectors_alloc(vars, DEFAULT_NUM_CONNECTORS);
 }
 
 /*
@@ -167,13 +168,14 @@ void system_on_receive(char *req, ChargerVars *vars)
  */
 static void proc_call(struct header_st *header, char *payload, ChargerVars *vars)
 {
-    if (vars->boot.status == STATUS_BOOT_REJECTED && strcmp(header->action, "\"BootNotification\"") != 0) // carregador no incialitzat -> Error
+    if (vars->boot.status != STATUS_BOOT_ACCEPTED && strcmp(header->action, "\"BootNotification\"") != 0) // carregador no incialitzat o Pending -> Error
         send_generic_error(header->unique_id, vars->client);
     else {
         if (strcmp(header->action, "\"Authorize\"") == 0) {
             proc_authorize(header, payload, vars);
         }
         else if (strcmp(header->action, "\"BootNotification\"") == 0) {
+            call_cache_reset(vars); // el carregador s'ha reiniciat i pot tornar a fer servir els mateixos uniqueIds
             proc_boot_notification(header, payload, vars);
         }
         else if (strcmp(header->action, "\"DataTransfer\"") == 0) {
@@ -183,13 +185,16 @@ static void proc_call(struct header_st *header, char *payload, ChargerVars *vars
             proc_heartbeat(header, payload, vars);
         }
         else if (strcmp(header->action, "\"MeterValues\"") == 0) {
-            proc_meter_values(header, payload, vars);
+            if (!call_cache_replay(vars, header, payload)) // si és una retransmissió es respon sense tornar-la a processar
+                proc_meter_values(header, payload, vars);
         }
         else if (strcmp(header->action, "\"StartTransaction\"") == 0) {
-            proc_start_transaction(header, payload, vars);
+            if (!call_cache_replay(vars, header, payload))
+                proc_start_transaction(header, payload, vars);
         }
         else if (strcmp(header->action, "\"StopTransaction\"") == 0) {
-            proc_stop_transaction(header, payload, vars);
+            if (!call_cache_replay(vars, header, payload))
+                proc_stop_transaction(header, payload, vars);
         }
         else if (strcmp(header->action, "\"StatusNotification\"") == 0) {
             proc_status_notification(header, payload, vars);
@@ -210,17 +215,43 @@ static void proc_call(struct header_st *header, char *payload, ChargerVars *vars
  *  SYNOPSIS
  *      void send_request(int option, char *payload, ChargerVars *vars)
  *  DESCRIPTION
- *      Gestiona l'enviament de peticions, filtrant pel tipus de petició
- *      que s'ha d'enviar. Controla els errors dels missatges abans d'enviar-los,
- *      i en cas que no hi hagi envia la petició.
+ *      Envia una petició al carregador amb el temps de timeout per defecte.
+ *      Veure send_request_timeout().
  *  RETURN VALUE
  *      Res.
  */
 void send_request(int option, char *payload, ChargerVars *vars)
 {
+    send_request_timeout(option, payload, vars, TIMEOUT_TIME, NULL, 0);
+}
+
+/*
+ *  NAME
+ *      send_request_timeout - Gestiona l'enviament de peticions amb un timeout concret
+ *  SYNOPSIS
+ *      enum tx_result_t send_request_timeout(int option, char *payload, ChargerVars *vars, int timeout, char *response, size_t response_len);
+ *  DESCRIPTION
+ *      Gestiona l'enviament de peticions, filtrant pel tipus de petició
+ *      que s'ha d'enviar. Controla els errors dels missatges abans d'enviar-los,
+ *      i en cas que no hi hagi envia la petició. Espera la resposta com a màxim
+ *      timeout segons. Si response no és NULL s'hi copia el payload de la resposta.
+ *  RETURN VALUE
+ *      Retorna el resultat de la petició.
+ */
+enum tx_result_t send_request_timeout(int option, char *payload, ChargerVars *vars, int timeout, char *response, size_t response_len)
+{
+    pthread_mutex_lock(&vars->request_lock); // només una petició alhora per carregador
+    vars->last_tx_result = tx_result_pending;
+    memset(vars->last_tx_response, 0, sizeof(vars->last_tx_response));
+
     time_t start = time(NULL); // aquí anirà l'hora a la que s'ha enviat la request
     char message[256];
     memset(message, 0, sizeof(message));
+    bool force_full = false; // SendLocalList: s'envia la llista completa encara que es pugui fer un diferencial
+    int64_t list_version = 0; // SendLocalList: versió de la llista enviada
+    char *list_payload = NULL; // SendLocalList: payload amb la llista
+    char *list_message = NULL; // SendLocalList: missatge complet
+    size_t list_message_len = 0;
     switch (option) {
         case '1': // ChangeAvailability
             // Comprovo si el missatge que s'ha passat no està buit
@@ -366,21 +397,147 @@ void send_request(int option, char *payload, ChargerVars *vars)
 
             break;
 
+        case '9': // SendLocalList
+            // El payload és opcional: {"updateType": "Full"} força l'enviament de la llista completa
+            if (payload && strlen(payload) > 1) { // S'ha pogut llegir
+                struct SendLocalListReq *request = cJSON_ParseSendLocalListReq(payload); // Ho passo a struct per comprovar si els camps són correctes
+
+                if (request == NULL || (int)request->update_type < 0) { // Error sintàctic o updateType no vàlid -> Error
+                    syslog(LOG_WARNING, "Payload for Action is syntactically incorrect or not conform the PDU structure for Action");
+                    break;
+                }
+                force_full = (request->update_type == UPDATETYPE_FULL);
+            }
+
+            // Formo la llista a partir de la versió que té el carregador: diferencial si és possible, completa si no
+            list_payload = auth_store_build_update(vars->local_list_version, force_full, &list_version);
+            if (list_payload == NULL) {
+                syslog(LOG_INFO, "SendLocalList: charger%d already has list version %ld", vars->charger_id, vars->local_list_version);
+                break;
+            }
+
+            // La llista pot ser més gran que el buffer del missatge
+            list_message_len = strlen(list_payload) + 64;
+            list_message = malloc(list_message_len);
+            if (list_message == NULL) {
+                syslog(LOG_ERR, "%s: malloc failed", __func__);
+                free(list_payload);
+                break;
+            }
+            snprintf(list_message, list_message_len, "[2,\"%lu\",\"SendLocalList\",%s]", ++vars->current_unique_id, remove_spaces(list_payload));
+            ws_send("CALL", list_message, vars->client);
+            snprintf(vars->current_tx_request, sizeof(vars->current_tx_request), "\"SendLocalList\""); // actualitzo el tipus de missatge del qual espero la resposta
+            vars->pending_list_version = list_version; // si el carregador l'accepta passarà a tenir aquesta versió
+            vars->tx_state = sent; // canvio l'estat a sent
+            free(list_message);
+            free(list_payload);
+            break;
+
+        case 'A': // GetLocalListVersion
+            // En aquest cas no cal formar cap struct perquè el missatge és buit, es respon directament
+            snprintf(message, sizeof(message), "[2,\"%lu\",\"GetLocalListVersion\",{}]", ++vars->current_unique_id);
+            ws_send("CALL", message, vars->client);
+            snprintf(vars->current_tx_request, sizeof(vars->current_tx_request), "\"GetLocalListVersion\""); // actualitzo el tipus de missatge del qual espero la resposta
+            vars->tx_state = sent; // canvio l'estat a sent
+            break;
+
+        case 'B': // ChangeConfiguration
+            // Comprovo si el missatge que s'ha passat no està buit
+            if (payload && strlen(payload) > 1) { // S'ha pogut llegir
+                struct ChangeConfigurationReq *request = cJSON_ParseChangeConfigurationReq(payload); // Ho passo a struct per comprovar si els camps són correctes
+
+                if (request == NULL || request->key == NULL || request->value == NULL || strcmp(request->key, "") == 0 ||
+                    strlen(request->key) > CONF_KEY_LEN || strlen(request->value) > CONFIG_VALUE_LEN) { // Falta un camp obligatori o és massa llarg -> Error
+                    syslog(LOG_WARNING, "Payload for Action is syntactically incorrect or not conform the PDU structure for Action");
+                }
+                else { // Missatge escrit correctament -> Formo missatge complet i l'envio al carregador
+                    // El payload es torna a generar a partir de la clau i el valor llegits (sense treure els espais del valor),
+                    // de manera que el carregador rep exactament el valor que es guardarà a config_store
+                    char *config_payload = NULL;
+                    cJSON *config = cJSON_CreateObject();
+                    if (config != NULL && cJSON_AddStringToObject(config, "key", request->key) != NULL &&
+                        cJSON_AddStringToObject(config, "value", request->value) != NULL)
+                        config_payload = cJSON_PrintUnformatted(config);
+                    cJSON_Delete(config);
+
+                    // El valor pot ser més gran que el buffer del missatge
+                    size_t config_message_len = config_payload != NULL ? strlen(config_payload) + 64 : 0;
+                    char *config_message = config_payload != NULL ? malloc(config_message_len) : NULL;
+                    if (config_message == NULL) {
+                        syslog(LOG_ERR, "%s: malloc failed", __func__);
+                        free(config_payload);
+                        break;
+                    }
+                    snprintf(config_message, config_message_len, "[2,\"%lu\",\"ChangeConfiguration\",%s]", ++vars->current_unique_id, config_payload);
+                    ws_send("CALL", config_message, vars->client);
+                    snprintf(vars->current_tx_request, sizeof(vars->current_tx_request), "\"ChangeConfiguration\""); // actualitzo el tipus de missatge del qual espero la resposta
+                    vars->pending_config_key = config_key_intern(request->key); // si el carregador l'accepta es guardarà a config_store
+                    snprintf(vars->pending_config_value, sizeof(vars->pending_config_value), "%s", request->value);
+                    vars->tx_state = sent; // canvio l'estat a sent
+                    free(config_message);
+                    free(config_payload);
+                }
+            }
+            else // No s'ha pogut llegir -> Error
+                syslog(LOG_WARNING, "Payload for Action is syntactically incorrect or not conform the PDU structure for Action");
+
+            break;
+
+        case 'C': // TriggerMessage
+            // Comprovo si el missatge que s'ha passat no està buit
+            if (payload && strlen(payload) > 1) { // S'ha pogut llegir
+                struct TriggerMessageReq *request = cJSON_ParseTriggerMessageReq(payload); // Ho passo a struct per comprovar si els camps són correctes
+
+                if (request == NULL || (int)request->requested_message < 0 || (request->connector_id != NULL &&
+                    (*request->connector_id <= 0 || *request->connector_id > connectors_count(vars)))) { // Falta un camp obligatori o el connector no existeix -> Error
+                    syslog(LOG_WARNING, "Payload for Action is syntactically incorrect or not conform the PDU structure for Action");
+                }
+                else { // Missatge escrit correctament -> Formo missatge complet i l'envio al carregador
+                    snprintf(message, sizeof(message), "[2,\"%lu\",\"TriggerMessage\",%s]", ++vars->current_unique_id, remove_spaces(payload));
+                    ws_send("CALL", message, vars->client);
+                    snprintf(vars->current_tx_request, sizeof(vars->current_tx_request), "\"TriggerMessage\""); // actualitzo el tipus de missatge del qual espero la resposta
+                    vars->tx_state = sent; // canvio l'estat a sent
+                }
+            }
+            else // No s'ha pogut llegir -> Error
+                syslog(LOG_WARNING, "Payload for Action is syntactically incorrect or not conform the PDU structure for Action");
+
+            break;
+
         default:
             syslog(LOG_WARNING, "Invalid option");
     }
 
+    if (vars->tx_state != sent && vars->last_tx_result == tx_result_pending) // no s'ha enviat res
+        vars->last_tx_result = tx_result_not_sent;
+
     // Timeout després d'enviar una petició
     struct timespec request = {0, 10000000}; // defineix un sleep de 10 ms per anar comprovant el temps de timeout
     // comprovo si ha passat el temps de timeout
     while (vars->tx_state == sent) { // si l'estat torna a ser ready_to_send, surt, sinó es posa a ready_to_send aquí després del temps de timeout
+        if (vars->last_tx_result == tx_result_error) { // la resposta tenia errors -> no cal esperar el timeout
+            vars->tx_state = ready_to_send;
+            break;
+        }
         time_t now = time(NULL); // temps actual
-        if (difftime(now, start) >= TIMEOUT_TIME) { // ja ha passat el temps de timeout -> surto del bucle i deixo enviar una altra petició
+        if (difftime(now, start) >= timeout) { // ja ha passat el temps de timeout -> surto del bucle i deixo enviar una altra petició
+            vars->last_tx_result = tx_result_timeout;
             vars->tx_state = ready_to_send;
             syslog(LOG_WARNING, "Timeout");
         }
         nanosleep(&request, NULL); // deixo un temps de sleep per deixar treballar l'altre thread
     }
+
+    if (vars->last_tx_result == tx_result_pending) // proc_call_result() ha acceptat la resposta
+        vars->last_tx_result = tx_result_ok;
+
+    enum tx_result_t result = vars->last_tx_result;
+    if (response != NULL && response_len > 0)
+        snprintf(response, response_len, "%s", vars->last_tx_response);
+
+    pthread_mutex_unlock(&vars->request_lock);
+
+    return result;
 }
 
 /*
@@ -402,9 +559,12 @@ static void proc_call_result(const struct header_st *header, char *payload, Char
 
     if (strtol(remove_quotes(unique_id), NULL, 10) != vars->current_unique_id) { // el uniqueId de la resposta no és el mateix que el de la petició -> Error
         syslog(LOG_WARNING, "The uniqueId of this response is not in accordance with the uniqueId of the request");
+        vars->last_tx_result = tx_result_error;
         vars->tx_state = ready_to_send; // canvio l'estat a disponible per enviar, ja que ha arribat la resposta -> es para el timeout i deixa enviar una altra petició
     }
     else { // el tipus de missatge i el uniqueId de la resposta corresponen amb el de la petició -> ara miro quin tipus de missatge és i el processo
+        snprintf(vars->last_tx_response, sizeof(vars->last_tx_response), "%s", payload); // per qui ha enviat la petició
+
         if (strcmp(vars->current_tx_request, "\"ChangeAvailability\"") == 0) {
             // Passo el string a struct JSON
             struct ChangeAvailabilityConf *change_availability_conf_payload = cJSON_ParseChangeAvailabilityConf(payload);
@@ -477,6 +637,8 @@ static void proc_call_result(const struct header_st *header, char *payload, Char
                 return;
             }
 
+            uint64_t config_prev_version = config_version(vars); // per saber quines claus canvien amb aquesta resposta
+
             if (get_configuration_conf_payload->configuration_key &&
                 list_get_count(get_configuration_conf_payload->configuration_key)) {
 
@@ -502,111 +664,10 @@ static void proc_call_result(const struct header_st *header, char *payload, Char
                         return;
                     }
                     else { // No errors
-                        if (strcmp(configuration_key->key, "AuthorizeRemoteTxRequests") == 0) {
-                            free(vars->conf_keys.AuthorizeRemoteTxRequests);
-                            vars->conf_keys.AuthorizeRemoteTxRequests = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.AuthorizeRemoteTxRequests, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "ClockAlignedDataInterval") == 0) {
-                            free(vars->conf_keys.ClockAlignedDataInterval);
-                            vars->conf_keys.ClockAlignedDataInterval = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.ClockAlignedDataInterval, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "ConnectionTimeOut") == 0) {
-                            free(vars->conf_keys.ConnectionTimeOut);
-                            vars->conf_keys.ConnectionTimeOut = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.ConnectionTimeOut, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "ConnectorPhaseRotation") == 0) {
-                            free(vars->conf_keys.ConnectorPhaseRotation);
-                            vars->conf_keys.ConnectorPhaseRotation = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.ConnectorPhaseRotation, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "GetConfigurationMaxKeys") == 0) {
-                            free(vars->conf_keys.GetConfigurationMaxKeys);
-                            vars->conf_keys.GetConfigurationMaxKeys = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.GetConfigurationMaxKeys, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "HeartbeatInterval") == 0) {
-                            free(vars->conf_keys.HeartbeatInterval);
-                            vars->conf_keys.HeartbeatInterval = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.HeartbeatInterval, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "LocalAuthorizeOffline") == 0) {
-                            free(vars->conf_keys.LocalAuthorizeOffline);
-                            vars->conf_keys.LocalAuthorizeOffline = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.LocalAuthorizeOffline, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "LocalPreAuthorize") == 0) {
-                            free(vars->conf_keys.LocalPreAuthorize);
-                            vars->conf_keys.LocalPreAuthorize = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.LocalPreAuthorize, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "MeterValuesAlignedData") == 0) {
-                            free(vars->conf_keys.MeterValuesAlignedData);
-                            vars->conf_keys.MeterValuesAlignedData = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.MeterValuesAlignedData, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "MeterValuesSampledData") == 0) {
-                            free(vars->conf_keys.MeterValuesSampledData);
-                            vars->conf_keys.MeterValuesSampledData = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.MeterValuesSampledData, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "MeterValueSampleInterval") == 0) {
-                            free(vars->conf_keys.MeterValueSampleInterval);
-                            vars->conf_keys.MeterValueSampleInterval = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.MeterValueSampleInterval, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "NumberOfConnectors") == 0) {
-                            free(vars->conf_keys.NumberOfConnectors);
-                            vars->conf_keys.NumberOfConnectors = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.NumberOfConnectors, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "ResetRetries") == 0) {
-                            free(vars->conf_keys.ResetRetries);
-                            vars->conf_keys.ResetRetries = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.ResetRetries, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "StopTransactionOnEVSideDisconnect") == 0) {
-                            free(vars->conf_keys.StopTransactionOnEVSideDisconnect);
-                            vars->conf_keys.StopTransactionOnEVSideDisconnect = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.StopTransactionOnEVSideDisconnect, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "StopTransactionOnInvalidId") == 0) {
-                            free(vars->conf_keys.StopTransactionOnInvalidId);
-                            vars->conf_keys.StopTransactionOnInvalidId = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.StopTransactionOnInvalidId, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "StopTxnAligneData") == 0) {
-                            free(vars->conf_keys.StopTxnAligneData);
-                            vars->conf_keys.StopTxnAligneData = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.StopTxnAligneData, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "StopTxnSampledData") == 0) {
-                            free(vars->conf_keys.StopTxnSampledData);
-                            vars->conf_keys.StopTxnSampledData = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.StopTxnSampledData, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "SupportedFeatureProfiles") == 0) {
-                            free(vars->conf_keys.SupportedFeatureProfiles);
-                            vars->conf_keys.SupportedFeatureProfiles = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.SupportedFeatureProfiles, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "TransactionMessageAtempts") == 0) {
-                            free(vars->conf_keys.TransactionMessageAtempts);
-                            vars->conf_keys.TransactionMessageAtempts = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.TransactionMessageAtempts, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "TransactionMessageRetryInterval") == 0) {
-                            free(vars->conf_keys.TransactionMessageRetryInterval);
-                            vars->conf_keys.TransactionMessageRetryInterval = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.TransactionMessageRetryInterval, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
-                        else if (strcmp(configuration_key->key, "UnlockConnectorOnEVSideDisconnect") == 0) {
-                            free(vars->conf_keys.UnlockConnectorOnEVSideDisconnect);
-                            vars->conf_keys.UnlockConnectorOnEVSideDisconnect = malloc(strlen(configuration_key->value) + 1);
-                            snprintf(vars->conf_keys.UnlockConnectorOnEVSideDisconnect, strlen(configuration_key->value) + 1, "%s", configuration_key->value);
-                        }
+                        int id = config_key_intern(configuration_key->key);
+                        if (id != -1 && config_set(vars, id, configuration_key->value, configuration_key->readonly) == 1)
+                            syslog(LOG_DEBUG, "GetConfiguration: %s = %s", configuration_key->key,
+                                configuration_key->value ? configuration_key->value : "");
                     }
                 }
             }
@@ -626,6 +687,14 @@ static void proc_call_result(const struct header_st *header, char *payload, Char
                 }
             }
 
+            // miro quines claus han canviat respecte a l'últim GetConfiguration
+            int changed[CONF_MAX_KEYS];
+            int num_changed = config_changed_since(vars, config_prev_version, changed, CONF_MAX_KEYS);
+            for (int i = 0; i < num_changed; i++) {
+                if (changed[i] == CONF_NUMBER_OF_CONNECTORS) // ajusto els connectors al carregador real
+                    connectors_alloc(vars, config_get_int(vars, CONF_NUMBER_OF_CONNECTORS, DEFAULT_NUM_CONNECTORS));
+            }
+
             // No errors
             syslog(LOG_DEBUG, "GetConfiguration: No errors");
             vars->tx_state = ready_to_send; // canvio l'estat a disponible per enviar, ja que ha arribat la resposta -> es para el timeout i deixa enviar una altra petició
@@ -706,6 +775,100 @@ static void proc_call_result(const struct header_st *header, char *payload, Char
                 vars->tx_state = ready_to_send; // canvio l'estat a disponible per enviar, ja que ha arribat la resposta -> es para el timeout i deixa enviar una altra petició
             }
         }
+        else if (strcmp(vars->current_tx_request, "\"SendLocalList\"") == 0) {
+            // Passo el string a struct JSON
+            struct SendLocalListConf *send_local_list_conf_payload = cJSON_ParseSendLocalListConf(payload);
+
+            // Comprovo errors abans d'enviar la resposta
+            if (send_local_list_conf_payload == NULL) { // Error: FormationViolation
+                send_formation_violation(header->unique_id, vars->client);
+            }
+            else if (send_local_list_conf_payload->status == -1) { // Error: ProtocolError
+                send_protocol_error(header->unique_id, vars->client);
+            }
+            else if (send_local_list_conf_payload->status == -2) { // Error: TypeConstraintViolation
+                send_type_constraint_violation(header->unique_id, vars->client);
+            }
+            else { // No errors
+                switch (send_local_list_conf_payload->status) {
+                    case STATUS_SEND_LOCAL_LIST_ACCEPTED: // el carregador ja té la versió enviada
+                        vars->local_list_version = vars->pending_list_version;
+                        break;
+                    case STATUS_SEND_LOCAL_LIST_VERSION_MISMATCH: // la versió no és la que es pensava -> la següent serà completa
+                        vars->local_list_version = 0;
+                        break;
+                    case STATUS_SEND_LOCAL_LIST_NOT_SUPPORTED: // el carregador no té llista local
+                        vars->local_list_version = -1;
+                        break;
+                    default: // Failed: es manté la versió anterior
+                        break;
+                }
+                syslog(LOG_DEBUG, "SendLocalList: No errors, list version %ld", vars->local_list_version);
+                vars->tx_state = ready_to_send; // canvio l'estat a disponible per enviar, ja que ha arribat la resposta -> es para el timeout i deixa enviar una altra petició
+            }
+        }
+        else if (strcmp(vars->current_tx_request, "\"GetLocalListVersion\"") == 0) {
+            // Passo el string a struct JSON
+            struct GetLocalListVersionConf *get_local_list_version_conf_payload = cJSON_ParseGetLocalListVersionConf(payload);
+
+            // Comprovo errors abans d'enviar la resposta
+            if (get_local_list_version_conf_payload == NULL) { // Error: FormationViolation
+                send_formation_violation(header->unique_id, vars->client);
+            }
+            else if (get_local_list_version_conf_payload->list_version == -2) { // Error: ProtocolError
+                send_protocol_error(header->unique_id, vars->client);
+            }
+            else if (get_local_list_version_conf_payload->list_version < -1) { // Error: PropertyConstraintViolation
+                send_property_constraint_violation(header->unique_id, vars->client);
+            }
+            else { // No errors
+                vars->local_list_version = get_local_list_version_conf_payload->list_version;
+                syslog(LOG_DEBUG, "GetLocalListVersion: No errors, list version %ld", vars->local_list_version);
+                vars->tx_state = ready_to_send; // canvio l'estat a disponible per enviar, ja que ha arribat la resposta -> es para el timeout i deixa enviar una altra petició
+            }
+        }
+        else if (strcmp(vars->current_tx_request, "\"ChangeConfiguration\"") == 0) {
+            // Passo el string a struct JSON
+            struct ChangeConfigurationConf *change_configuration_conf_payload = cJSON_ParseChangeConfigurationConf(payload);
+
+            // Comprovo errors abans d'enviar la resposta
+            if (change_configuration_conf_payload == NULL) { // Error: FormationViolation
+                send_formation_violation(header->unique_id, vars->client);
+            }
+            else if (change_configuration_conf_payload->status == -1) { // Error: ProtocolError
+                send_protocol_error(header->unique_id, vars->client);
+            }
+            else if (change_configuration_conf_payload->status == -2) { // Error: TypeConstraintViolation
+                send_type_constraint_violation(header->unique_id, vars->client);
+            }
+            else { // No errors
+                // si l'ha acceptat, el carregador té el nou valor
+                if (change_configuration_conf_payload->status == STATUS_CHANGE_CONFIGURATION_ACCEPTED && vars->pending_config_key != -1)
+                    config_set(vars, vars->pending_config_key, vars->pending_config_value, false);
+                vars->pending_config_key = -1;
+                syslog(LOG_DEBUG, "ChangeConfiguration: No errors");
+                vars->tx_state = ready_to_send; // canvio l'estat a disponible per enviar, ja que ha arribat la resposta -> es para el timeout i deixa enviar una altra petició
+            }
+        }
+        else if (strcmp(vars->current_tx_request, "\"TriggerMessage\"") == 0) {
+            // Passo el string a struct JSON
+            struct TriggerMessageConf *trigger_message_conf_payload = cJSON_ParseTriggerMessageConf(payload);
+
+            // Comprovo errors abans d'enviar la resposta
+            if (trigger_message_conf_payload == NULL) { // Error: FormationViolation
+                send_formation_violation(header->unique_id, vars->client);
+            }
+            else if (trigger_message_conf_payload->status == -1) { // Error: ProtocolError
+                send_protocol_error(header->unique_id, vars->client);
+            }
+            else if (trigger_message_conf_payload->status == -2) { // Error: TypeConstraintViolation
+                send_type_constraint_violation(header->unique_id, vars->client);
+            }
+            else { // No errors
+                syslog(LOG_DEBUG, "TriggerMessage: No errors");
+                vars->tx_state = ready_to_send; // canvio l'estat a disponible per enviar, ja que ha arribat la resposta -> es para el timeout i deixa enviar una altra petició
+            }
+        }
         // Not supported
         else { // Error: NotSupported
             char message[256];
@@ -714,6 +877,10 @@ static void proc_call_result(const struct header_st *header, char *payload, Char
             // Envio el missatge al carregador
             ws_send("CALL ERROR", message, vars->client);
         }
+
+        // si la resposta tenia errors no s'ha tornat a ready_to_send -> ho indico a send_request_timeout()
+        if (vars->tx_state == sent && strtol(unique_id, NULL, 10) == vars->current_unique_id)
+            vars->last_tx_result = tx_result_error;
     }
 }
 
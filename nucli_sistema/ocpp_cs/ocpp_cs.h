@@ -15,10 +15,14 @@
 #define _SISTEMA_CONTROL_H_
 
 #define HEARTBEAT_INTERVAL 86400
-#define RESEND_BOOT_NOTIFICATION_INTERVAL 300
-#define NUM_CONNECTORS 2
+#define RESEND_BOOT_NOTIFICATION_INTERVAL 300 // interval màxim per tornar a enviar un BootNotification Pending
+#define BOOT_ADMISSION_RATE 1 // BootNotification acceptats per segon
+#define BOOT_ADMISSION_BURST 2 // BootNotification que es poden acceptar seguits
+#define DEFAULT_NUM_CONNECTORS 2 // connectors que es reserven fins que se sap el NumberOfConnectors del carregador
+#define MAX_CONNECTORS 8
 
 #define ID_TAG_LEN 20 // mida establerta pel protocol
+#define CONFIG_VALUE_LEN 500 // mida màxima del valor d'un ChangeConfiguration establerta pel protocol
 
 // possibles estats dels connectors
 #define CONN_AVAILABLE 0
@@ -31,8 +35,11 @@
 #define CONN_SUSPENDED_EVSE 7
 #define CONN_UNAVAILABLE 8
 #define CONN_UNKNOWN 9
+#define CONN_NUM_STATUSES 10
 
+#include <stddef.h>
 #include <stdint.h>
+#include <pthread.h>
 #include <ws.h>
 #include "BootNotificationConfJSON.h"
 
@@ -45,51 +52,44 @@ enum tx_state_t {
     sent
 };
 
-// claus de configuració del punt de càrrega
-typedef struct {
-    char *AuthorizeRemoteTxRequests;
-    char *ClockAlignedDataInterval;
-    char *ConnectionTimeOut;
-    char *ConnectorPhaseRotation;
-    char *GetConfigurationMaxKeys;
-    char *HeartbeatInterval;
-    char *LocalAuthorizeOffline;
-    char *LocalPreAuthorize;
-    char *MeterValuesAlignedData;
-    char *MeterValuesSampledData;
-    char *MeterValueSampleInterval;
-    char *NumberOfConnectors;
-    char *ResetRetries;
-    char *StopTransactionOnEVSideDisconnect;
-    char *StopTransactionOnInvalidId;
-    char *StopTxnAligneData;
-    char *StopTxnSampledData;
-    char *SupportedFeatureProfiles;
-    char *TransactionMessageAtempts;
-    char *TransactionMessageRetryInterval;
-    char *UnlockConnectorOnEVSideDisconnect;
-} ConfigurationKeys;
+// resultat de l'última petició enviada al carregador
+enum tx_result_t {
+    tx_result_not_sent, // la petició no s'ha enviat (payload incorrecte o opció desconeguda)
+    tx_result_pending,  // s'ha enviat i s'espera la resposta
+    tx_result_ok,       // la resposta no tenia errors
+    tx_result_error,    // la resposta tenia errors
+    tx_result_timeout   // no ha arribat la resposta a temps
+};
 
 // estrcutura amb les variables de cada punt de càrrega
+// primer hi ha les variables que es consulten a cada missatge i després les que es fan servir poc;
+// l'estat dels connectors es guarda a la taula de connectors.c
 typedef struct {
     int charger_id;                                       // identificador del carregador
     ws_cli_conn_t client;                                 // identifiador del client ws
-    int64_t connectors_status[NUM_CONNECTORS + 1];        // aqui aniran els status de cada connector, els quals poden ser qualsevol dels defines CONN_<>
-    char current_id_tags[NUM_CONNECTORS + 1][ID_TAG_LEN]; // idTag de les transaccions actives
+    enum tx_state_t tx_state;                             // estat del sistema
+    uint32_t conn_run;                                    // connectors a la taula de connectors.c: primer slot (16 bits alts) i
+                                                          // nombre de connectors sense el 0 (16 bits baixos), en una sola paraula
+                                                          // perquè els altres threads no vegin mai un primer slot i un nombre barrejats
     struct BootNotificationConf boot;                     // per veure el status general del carregador
+    int64_t current_transaction_id;                       // l'últim transactionId que s'ha utilitzat
+    uint64_t current_unique_id;                           // unique_id actual que va incrementant cada vegada que el sistema envia una request
+    enum tx_result_t last_tx_result;                      // resultat de l'última petició enviada
+    char current_tx_request[32];                          // la request activa que s'ha transmès al carregador per verificar la respectiva resposta
     char current_id_tag[ID_TAG_LEN];                      // idTag rebut en l'autentificació per acceptar o no transaccions
     char current_vendor[20];                              // per veure el vendor qual está connectat
     char current_model[20];                               // per veure el model qual está connectat
-    int64_t transaction_list[NUM_CONNECTORS + 1];         // aqui aniran els trasnactionId dels connectors que estan en una transacció activa
-    int64_t current_transaction_id;                       // l'últim transactionId que s'ha utilitzat
-    char current_tx_request[32];                          // la request activa que s'ha transmès al carregador per verificar la respectiva resposta
-    uint64_t current_unique_id;                           // unique_id actual que va incrementant cada vegada que el sistema envia una request
-    enum tx_state_t tx_state;                             // estat del sistema
-    ConfigurationKeys conf_keys;                          // claus de configuració del punt de càrrega
+    int64_t local_list_version;                           // versió de la llista local del carregador (0 desconeguda, -1 no suportada)
+    int64_t pending_list_version;                         // versió de la llista local enviada en l'últim SendLocalList
+    int pending_config_key;                               // clau enviada en l'últim ChangeConfiguration (-1 si no se'n guarda)
+    char pending_config_value[CONFIG_VALUE_LEN + 1];      // valor enviat en l'últim ChangeConfiguration
+    char last_tx_response[256];                           // payload de l'última resposta rebuda (pot estar truncat)
+    pthread_mutex_t request_lock;                         // evita enviar dues peticions alhora al mateix carregador
 } ChargerVars;
 
 // llista d'idTags, els quals es podran autoritzar
 extern char *auth_list[];
+extern const size_t auth_list_len;
 
 // llista de chargePointModels, els quals podran fer bootNotification
 extern char *cp_models[];
@@ -100,5 +100,6 @@ extern char *cp_vendors[];
 void init_system(ChargerVars *vars);
 void system_on_receive(char *req, ChargerVars *vars);
 void send_request(int option, char *payload, ChargerVars *vars);
+enum tx_result_t send_request_timeout(int option, char *payload, ChargerVars *vars, int timeout, char *response, size_t response_len);
 
 #endif
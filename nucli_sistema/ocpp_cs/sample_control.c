@@ -0,0 +1,367 @@
+/*
+ *  FILE
+ *      sample_control.c - control de l'interval de mostreig dels MeterValues
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Cada SAMPLE_CONTROL_PERIOD segons es mira la càrrega de la cua d'entrada dels MeterValues
+ *      (profunditat màxima i temps per guardar un lot). Si la base de dades no dona l'abast, es dobla
+ *      el MeterValueSampleInterval dels carregadors (com a màxim fins al límit superior), i quan la
+ *      càrrega torna a ser baixa es va reduint de SAMPLE_INTERVAL_STEP en SAMPLE_INTERVAL_STEP segons
+ *      fins al límit inferior. Els límits els pot canviar l'operador des de la web.
+ *      Cada carregador té el seu propi MeterValueSampleInterval (el que té a config_store abans que se
+ *      li canviï), que fa de límit inferior: només se li envia l'interval de la càrrega si és més gran
+ *      que el seu, i quan la càrrega torna al límit inferior se li torna a posar el seu. Si l'operador
+ *      el canvia mentre està augmentat, el nou valor passa a ser el seu. L'interval s'envia amb un
+ *      ChangeConfiguration als carregadors acceptats que encara no el tenen.
+ *      L'interval propi de cada carregador es guarda a la base de dades (taula sample_intervals) abans
+ *      d'augmentar-lo, de manera que si el nucli es reinicia mentre un carregador té l'interval
+ *      augmentat, no el pren com a propi i el torna a baixar quan la càrrega ho permet.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <sqlite3.h>
+#include "ocpp_cs.h"
+#include "ws_server.h"
+#include "config_store.h"
+#include "meter_ingest.h"
+#include "ChangeConfigurationConfJSON.h"
+#include "sample_control.h"
+
+extern ChargerVars charger_vars[];
+
+static pthread_mutex_t control_lock = PTHREAD_MUTEX_INITIALIZER;
+static int min_interval = SAMPLE_INTERVAL_MIN;      // límit inferior (interval normal)
+static int max_interval = SAMPLE_INTERVAL_MAX;      // límit superior
+static int target_interval = SAMPLE_INTERVAL_MIN;   // interval segons la càrrega de la cua
+static unsigned int last_depth = 0;                 // càrrega de l'última revisió
+static int64_t last_batch_ms = 0;
+
+// per cada carregador: el seu interval (0 si no se sap), l'interval augmentat que té (0 si té el seu),
+// l'augmentat que tenia abans de reconnectar-se, l'interval que ha rebutjat, la connexió i si el seu
+// interval s'ha llegit de la base de dades i encara no s'ha comparat amb el que té el carregador
+static int own[MAX_CHARGERS + 1];
+static int applied[MAX_CHARGERS + 1];
+static int previous[MAX_CHARGERS + 1];
+static int refused[MAX_CHARGERS + 1];
+static ws_cli_conn_t clients[MAX_CHARGERS + 1];
+static bool restored[MAX_CHARGERS + 1];
+
+// Prototips de les funcions
+static void *control_thread(void *arg);
+static int charger_interval(ChargerVars *vars, int index, int interval, int lower);
+static void apply_interval(ChargerVars *vars, int index, int interval);
+static void set_own(int index, int interval);
+static int read_own(void *arg, int argc, char **argv, char **col_names);
+
+/*
+ *  NAME
+ *      sample_control_init - Inicialitza el control de l'interval de mostreig
+ *  SYNOPSIS
+ *      void sample_control_init(void);
+ *  DESCRIPTION
+ *      Crea la taula sample_intervals si no existeix, llegeix l'interval propi de cada carregador
+ *      que s'hi va guardar i crea el thread que revisa la càrrega i ajusta l'interval dels carregadors.
+ *  RETURN VALUE
+ *      Res.
+ */
+void sample_control_init(void)
+{
+    pthread_t thread;
+    sqlite3 *db;
+    int rc;
+    char *errmsg;
+
+    for (int i = 0; i <= MAX_CHARGERS; i++)
+        clients[i] = (ws_cli_conn_t)-1;
+
+    rc = sqlite3_open(DATABASE_PATH, &db);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: ERROR opening SQLite DB: %s\n", __func__, sqlite3_errmsg(db));
+    }
+    else {
+        rc = sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS sample_intervals (charger_id INTEGER PRIMARY KEY, "
+            "interval INTEGER NOT NULL);"
+            "SELECT charger_id, interval FROM sample_intervals;", read_own, NULL, &errmsg);
+        if (rc != SQLITE_OK) {
+            syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+            sqlite3_free(errmsg);
+        }
+    }
+    sqlite3_close(db); // tanca la base de dades correctament
+
+    if (pthread_create(&thread, NULL, control_thread, NULL) == 0)
+        pthread_detach(thread);
+    else
+        syslog(LOG_ERR, "%s: pthread_create failed", __func__);
+}
+
+/*
+ *  NAME
+ *      sample_control_set_bounds - Canvia els límits de l'interval de mostreig
+ *  SYNOPSIS
+ *      bool sample_control_set_bounds(int min_interval, int max_interval);
+ *  DESCRIPTION
+ *      Canvia els límits entre els quals es pot moure el MeterValueSampleInterval. L'interval actual
+ *      es retalla als nous límits i s'aplica a la següent revisió.
+ *  RETURN VALUE
+ *      Retorna true si els límits són vàlids.
+ *      Retorna false en cas contrari.
+ */
+bool sample_control_set_bounds(int new_min, int new_max)
+{
+    if (new_min <= 0 || new_max < new_min)
+        return false;
+
+    pthread_mutex_lock(&control_lock);
+    min_interval = new_min;
+    max_interval = new_max;
+    if (target_interval < min_interval)
+        target_interval = min_interval;
+    if (target_interval > max_interval)
+        target_interval = max_interval;
+    pthread_mutex_unlock(&control_lock);
+
+    syslog(LOG_NOTICE, "%s: MeterValueSampleInterval entre %d i %d s", __func__, new_min, new_max);
+
+    return true;
+}
+
+/*
+ *  NAME
+ *      sample_control_json - Escriu l'estat del control
+ *  SYNOPSIS
+ *      int sample_control_json(char *buf, size_t len);
+ *  DESCRIPTION
+ *      Escriu a buf el missatge per a la web amb els límits, l'interval actual i la càrrega.
+ *  RETURN VALUE
+ *      El nombre de caràcters escrits (com snprintf).
+ */
+int sample_control_json(char *buf, size_t len)
+{
+    pthread_mutex_lock(&control_lock);
+    int n = snprintf(buf, len, "{\"type\": \"sampleControl\", \"min\": %d, \"max\": %d, \"interval\": %d, "
+        "\"depth\": %u, \"batchMs\": %ld}", min_interval, max_interval, target_interval, last_depth, last_batch_ms);
+    pthread_mutex_unlock(&control_lock);
+
+    return n;
+}
+
+/*
+ *  NAME
+ *      control_thread - Revisa la càrrega periòdicament
+ *  SYNOPSIS
+ *      static void *control_thread(void *arg);
+ *  DESCRIPTION
+ *      Cada SAMPLE_CONTROL_PERIOD segons calcula el nou interval (augment multiplicatiu si hi ha massa
+ *      càrrega, reducció additiva si n'hi ha poca) i envia a cada carregador que no el té l'interval
+ *      que li correspon (vegeu charger_interval()).
+ *  RETURN VALUE
+ *      NULL.
+ */
+static void *control_thread(void *arg)
+{
+    while (1) {
+        sleep(SAMPLE_CONTROL_PERIOD);
+
+        unsigned int depth;
+        int64_t batch_ms;
+        meter_ingest_load(&depth, &batch_ms);
+
+        pthread_mutex_lock(&control_lock);
+        int previous = target_interval;
+        if (depth >= SAMPLE_DEPTH_HIGH || batch_ms >= SAMPLE_LATENCY_HIGH_MS)
+            target_interval *= 2;
+        else if (depth <= SAMPLE_DEPTH_LOW && batch_ms <= SAMPLE_LATENCY_LOW_MS)
+            target_interval -= SAMPLE_INTERVAL_STEP;
+        if (target_interval > max_interval)
+            target_interval = max_interval;
+        if (target_interval < min_interval)
+            target_interval = min_interval;
+        int interval = target_interval;
+        int lower = min_interval;
+        last_depth = depth;
+        last_batch_ms = batch_ms;
+        pthread_mutex_unlock(&control_lock);
+
+        if (interval != previous)
+            syslog(LOG_NOTICE, "%s: MeterValueSampleInterval %d -> %d s (cua %u, lot %ld ms)", __func__,
+                previous, interval, depth, batch_ms);
+
+        for (int i = 1; i <= MAX_CHARGERS; i++) {
+            ChargerVars *vars = &charger_vars[i];
+            if (vars->client == -1 || vars->boot.status != STATUS_BOOT_ACCEPTED)
+                continue;
+
+            int wanted = charger_interval(vars, i, interval, lower);
+            if (wanted > 0)
+                apply_interval(vars, i, wanted);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ *  NAME
+ *      charger_interval - Calcula l'interval d'un carregador
+ *  SYNOPSIS
+ *      static int charger_interval(ChargerVars *vars, int index, int interval, int lower);
+ *  DESCRIPTION
+ *      Actualitza l'interval propi del carregador index a partir del valor que té a config_store i
+ *      calcula el que hauria de tenir amb l'interval de la càrrega interval: el seu si la càrrega és
+ *      al límit inferior lower, i si no el més gran dels dos. Si el carregador s'ha reconnectat, es
+ *      torna a mirar quin interval té i se li pot tornar a enviar el que havia rebutjat. Si l'interval
+ *      propi es va llegir de la base de dades (el nucli s'ha reiniciat) i el carregador en té un de més
+ *      gran, és l'augmentat d'abans del reinici.
+ *  RETURN VALUE
+ *      L'interval que s'ha d'enviar al carregador.
+ *      Retorna 0 si ja el té, l'ha rebutjat o encara no se sap quin té.
+ */
+static int charger_interval(ChargerVars *vars, int index, int interval, int lower)
+{
+    if (vars->client != clients[index]) { // s'ha (re)connectat: no se sap si conserva l'interval augmentat
+        clients[index] = vars->client;
+        if (applied[index] != 0)
+            previous[index] = applied[index];
+        applied[index] = 0;
+        refused[index] = 0;
+    }
+
+    int current = (int)config_get_int(vars, CONF_METER_VALUE_SAMPLE_INTERVAL, 0);
+    if (current <= 0) // encara no se sap (GetConfiguration pendent)
+        return 0;
+
+    if (applied[index] == 0) {
+        if (restored[index] && current > own[index])
+            applied[index] = current; // té l'interval augmentat d'abans de reiniciar el nucli
+        else if (previous[index] != 0 && current == previous[index] && own[index] != 0)
+            applied[index] = current; // ha conservat l'interval augmentat d'abans de reconnectar-se
+        else
+            set_own(index, current);
+        previous[index] = 0;
+        restored[index] = false;
+    }
+    else if (current != applied[index]) { // l'operador l'ha canviat mentre estava augmentat
+        set_own(index, current);
+        applied[index] = 0;
+    }
+
+    int wanted = (interval > lower && interval > own[index]) ? interval : own[index];
+
+    if (wanted == current || wanted == refused[index])
+        return 0;
+
+    return wanted;
+}
+
+/*
+ *  NAME
+ *      apply_interval - Envia el MeterValueSampleInterval a un carregador
+ *  SYNOPSIS
+ *      static void apply_interval(ChargerVars *vars, int index, int interval);
+ *  DESCRIPTION
+ *      Envia el ChangeConfiguration al carregador index i, si l'accepta, guarda el nou valor. Si el
+ *      rebutja no se li torna a enviar el mateix interval fins que es reconnecti.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void apply_interval(ChargerVars *vars, int index, int interval)
+{
+    char payload[80], value[16], response[256];
+    bool accepted = false;
+
+    snprintf(value, sizeof(value), "%d", interval);
+    snprintf(payload, sizeof(payload), "{\"key\": \"MeterValueSampleInterval\", \"value\": \"%s\"}", value);
+
+    if (send_request_timeout('B', payload, vars, SAMPLE_CONTROL_TIMEOUT, response, sizeof(response)) == tx_result_ok) {
+        struct ChangeConfigurationConf *conf = cJSON_ParseChangeConfigurationConf(response);
+        if (conf != NULL) {
+            accepted = conf->status == STATUS_CHANGE_CONFIGURATION_ACCEPTED;
+            if (!accepted)
+                refused[index] = interval;
+            free(conf);
+        }
+    }
+
+    if (accepted) {
+        applied[index] = interval == own[index] ? 0 : interval; // 0: torna a tenir el seu
+        config_set(vars, CONF_METER_VALUE_SAMPLE_INTERVAL, value, false);
+        syslog(LOG_DEBUG, "%s: MeterValueSampleInterval del carregador %d: %s", __func__, vars->charger_id, value);
+    }
+}
+
+/*
+ *  NAME
+ *      set_own - Canvia l'interval propi d'un carregador
+ *  SYNOPSIS
+ *      static void set_own(int index, int interval);
+ *  DESCRIPTION
+ *      Canvia l'interval propi del carregador index i, si és diferent de l'anterior, el guarda a la
+ *      taula sample_intervals abans que se li pugui enviar un interval augmentat.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void set_own(int index, int interval)
+{
+    sqlite3 *db;
+    int rc;
+    char *errmsg;
+
+    if (own[index] == interval)
+        return;
+    own[index] = interval;
+
+    rc = sqlite3_open(DATABASE_PATH, &db);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: ERROR opening SQLite DB: %s\n", __func__, sqlite3_errmsg(db));
+    }
+    else {
+        char query[160];
+        snprintf(query, sizeof(query), "INSERT INTO sample_intervals(charger_id, interval) VALUES(%d, %d) "
+            "ON CONFLICT(charger_id) DO UPDATE SET interval = excluded.interval;", index, interval);
+        rc = sqlite3_exec(db, query, 0, 0, &errmsg);
+        if (rc != SQLITE_OK) {
+            syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+            sqlite3_free(errmsg);
+        }
+    }
+    sqlite3_close(db); // tanca la base de dades correctament
+}
+
+/*
+ *  NAME
+ *      read_own - Callback per llegir l'interval propi guardat d'un carregador
+ *  SYNOPSIS
+ *      static int read_own(void *arg, int argc, char **argv, char **col_names);
+ *  DESCRIPTION
+ *      Callback de sqlite3_exec() que guarda l'interval (segona columna) del carregador (primera
+ *      columna) com a interval propi, pendent de comparar amb el que té el carregador.
+ *  RETURN VALUE
+ *      0.
+ */
+static int read_own(void *arg, int argc, char **argv, char **col_names)
+{
+    if (argc < 2 || argv[0] == NULL || argv[1] == NULL)
+        return 0;
+
+    int index = atoi(argv[0]);
+    int interval = atoi(argv[1]);
+    if (index >= 1 && index <= MAX_CHARGERS && interval > 0) {
+        own[index] = interval;
+        restored[index] = true;
+    }
+
+    return 0;
+}
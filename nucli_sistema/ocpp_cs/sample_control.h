@@ -0,0 +1,35 @@
+/*
+ *  FILE
+ *      sample_control.h - header de sample_control.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header del control de l'interval de mostreig dels MeterValues.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _SAMPLE_CONTROL_H_
+#define _SAMPLE_CONTROL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "meter_ingest.h"
+
+#define SAMPLE_CONTROL_PERIOD 30                            // segons entre cada revisió de la càrrega
+#define SAMPLE_INTERVAL_MIN 60                              // límit inferior per defecte de l'interval segons la càrrega
+#define SAMPLE_INTERVAL_MAX 900                             // MeterValueSampleInterval màxim (límit superior per defecte)
+#define SAMPLE_INTERVAL_STEP 30                             // segons que es redueix l'interval quan la càrrega baixa
+#define SAMPLE_DEPTH_HIGH (METER_INGEST_SLOTS / 2)          // profunditat de la cua a partir de la qual s'augmenta l'interval
+#define SAMPLE_DEPTH_LOW (METER_INGEST_SLOTS / 16)          // profunditat de la cua per sota de la qual es redueix l'interval
+#define SAMPLE_LATENCY_HIGH_MS 500                          // temps per lot a partir del qual s'augmenta l'interval
+#define SAMPLE_LATENCY_LOW_MS 100                           // temps per lot per sota del qual es redueix l'interval
+#define SAMPLE_CONTROL_TIMEOUT 10                           // temps de timeout del ChangeConfiguration
+
+void sample_control_init(void);
+bool sample_control_set_bounds(int min_interval, int max_interval);
+int sample_control_json(char *buf, size_t len);
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ *  FILE
+ *      session_ledger.c - registre de sessions de càrrega
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Mentre una transacció està oberta, el meterStart, l'última lectura del comptador
+ *      (Energy.Active.Import.Register) i l'hora d'inici es guarden a l'índex global de transaccions,
+ *      i s'actualitzen a mesura que arriben els MeterValues. En rebre el StopTransaction es guarda
+ *      una sola fila amb el resum de la sessió a la taula sessions, de manera que per saber l'energia
+ *      i la durada de cada sessió no cal recórrer la taula meter_values.
+ *      Com a les altres taules de l'historial, les hores es guarden en UTC i cada fila té a la columna
+ *      ts l'hora de fi de la sessió en mil·lisegons des de l'epoch (epoch_time), indexada per
+ *      carregador, connector i ts.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <syslog.h>
+#include <sqlite3.h>
+#include "ws_server.h"
+#include "transaction_index.h"
+#include "epoch_time.h"
+#include "session_ledger.h"
+
+/*
+ *  NAME
+ *      session_ledger_init - Inicialitza el registre de sessions
+ *  SYNOPSIS
+ *      void session_ledger_init(void);
+ *  DESCRIPTION
+ *      Crea la taula sessions i els seus índexs si no existeixen. Si la taula és d'abans que tingués
+ *      la columna ts, l'afegeix a partir de l'hora de fi.
+ *  RETURN VALUE
+ *      Res.
+ */
+void session_ledger_init(void)
+{
+    sqlite3 *db;
+    int rc;
+    char *errmsg;
+
+    rc = sqlite3_open(DATABASE_PATH, &db);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: ERROR opening SQLite DB: %s\n", __func__, sqlite3_errmsg(db));
+    }
+    else {
+        rc = sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS sessions (id INTEGER PRIMARY KEY AUTOINCREMENT, "
+            "transaction_id INT NOT NULL, charger_id INT NOT NULL, connector INT NOT NULL, id_tag TEXT NOT NULL, "
+            "hora_inici TEXT NOT NULL, hora_fi TEXT NOT NULL, durada INT NOT NULL, meter_start INT NOT NULL, "
+            "meter_stop INT NOT NULL, energia INT NOT NULL, motiu TEXT NOT NULL, ts INTEGER NOT NULL DEFAULT 0);",
+            0, 0, &errmsg);
+        if (rc != SQLITE_OK) {
+            syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+            sqlite3_free(errmsg);
+        }
+
+        // si la taula ja té la columna ts, l'ALTER TABLE falla i no es fa res més
+        if (sqlite3_exec(db, "ALTER TABLE sessions ADD COLUMN ts INTEGER NOT NULL DEFAULT 0;", 0, 0, NULL) == SQLITE_OK) {
+            syslog(LOG_INFO, "%s: afegida la columna ts a sessions", __func__);
+            sqlite3_exec(db, "UPDATE sessions SET ts = coalesce(" EPOCH_MS_SQL("hora_fi") ", 0);", 0, 0, NULL);
+        }
+
+        rc = sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS sessions_charger_connector_ts ON sessions(charger_id, connector, ts);"
+            "CREATE INDEX IF NOT EXISTS sessions_ts ON sessions(ts);", 0, 0, &errmsg);
+        if (rc != SQLITE_OK) {
+            syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+            sqlite3_free(errmsg);
+        }
+    }
+    sqlite3_close(db); // tanca la base de dades correctament
+}
+
+/*
+ *  NAME
+ *      session_ledger_sample - Actualitza l'energia d'una sessió oberta
+ *  SYNOPSIS
+ *      bool session_ledger_sample(int64_t transaction_id, double energy, time_t sample_time);
+ *  DESCRIPTION
+ *      Guarda una lectura de l'Energy.Active.Import.Register d'un MeterValues a la transacció.
+ *      energy és el valor ja passat a Wh (meter_codes).
+ *  RETURN VALUE
+ *      Retorna true si la transacció està oberta i el valor és correcte.
+ *      Retorna false en cas contrari.
+ */
+bool session_ledger_sample(int64_t transaction_id, double energy, time_t sample_time)
+{
+    if (transaction_id <= 0)
+        return false;
+
+    if (energy < 0) {
+        syslog(LOG_DEBUG, "%s: valor d'energia no vàlid: %f", __func__, energy);
+        return false;
+    }
+
+    return tx_index_update_energy(transaction_id, (int64_t)(energy + 0.5), sample_time);
+}
+
+/*
+ *  NAME
+ *      session_ledger_close - Tanca una sessió
+ *  SYNOPSIS
+ *      void session_ledger_close(const struct tx_info *tx, int64_t meter_stop, const char *motiu);
+ *  DESCRIPTION
+ *      Guarda a la taula sessions el resum de la transacció tx: hora d'inici i de fi (en UTC, i la de fi
+ *      també a ts), durada en segons, meterStart, meterStop i energia consumida en Wh. Si el carregador no ha enviat el meterStop
+ *      es fa servir l'última lectura rebuda als MeterValues.
+ *  RETURN VALUE
+ *      Res.
+ */
+void session_ledger_close(const struct tx_info *tx, int64_t meter_stop, const char *motiu)
+{
+    int64_t ts = epoch_ms_now();
+    char hora_inici[EPOCH_TIME_LEN], hora_fi[EPOCH_TIME_LEN];
+    int64_t energia = -1;
+
+    if (meter_stop < 0)
+        meter_stop = tx->last_energy_wh;
+    if (tx->meter_start >= 0 && meter_stop >= tx->meter_start)
+        energia = meter_stop - tx->meter_start;
+
+    epoch_ms_format((int64_t)tx->start_time * 1000, hora_inici, sizeof(hora_inici));
+    epoch_ms_format(ts, hora_fi, sizeof(hora_fi));
+
+    // guardo la informació a la base de dades
+    sqlite3 *db;
+    int rc;
+    char *errmsg;
+
+    rc = sqlite3_open(DATABASE_PATH, &db);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: ERROR opening SQLite DB: %s\n", __func__, sqlite3_errmsg(db));
+    }
+    else {
+        char query[640];
+        snprintf(query, sizeof(query), "INSERT INTO sessions(transaction_id, charger_id, connector, id_tag, hora_inici, "
+            "hora_fi, durada, meter_start, meter_stop, energia, motiu, ts) VALUES(%ld, %d, %d, '%s', '%s', '%s', %ld, %ld, "
+            "%ld, %ld, '%s', %ld);", tx->transaction_id, tx->charger, tx->connector, tx->id_tag, hora_inici, hora_fi,
+            ts / 1000 - (int64_t)tx->start_time, tx->meter_start, meter_stop, energia, motiu ? motiu : "", ts);
+        rc = sqlite3_exec(db, query, 0, 0, &errmsg);
+        if (rc != SQLITE_OK) {
+            syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+            sqlite3_free(errmsg);
+        }
+        else {
+            syslog(LOG_DEBUG, "%s: sessió %ld tancada: %ld Wh", __func__, tx->transaction_id, energia);
+        }
+    }
+    sqlite3_close(db); // tanca la base de dades correctament
+}
@@ -0,0 +1,26 @@
+/*
+ *  FILE
+ *      session_ledger.h - header de session_ledger.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header del registre de sessions de càrrega.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _SESSION_LEDGER_H_
+#define _SESSION_LEDGER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "transaction_index.h"
+
+void session_ledger_init(void);
+bool session_ledger_sample(int64_t transaction_id, double energy, time_t sample_time);
+void session_ledger_close(const struct tx_info *tx, int64_t meter_stop, const char *motiu);
+
+#endif
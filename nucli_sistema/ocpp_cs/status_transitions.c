@@ -0,0 +1,174 @@
+/*
+ *  FILE
+ *      status_transitions.c - màquina d'estats dels connectors
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Taula de les transicions d'estat dels connectors permeses per OCPP 1.6. Serveix per saber si
+ *      un StatusNotification canvia realment l'estat del connector: els carregadors tornen a enviar
+ *      el mateix estat quan es reconnecten o amb un TriggerMessage, i en aquest cas no cal guardar-lo
+ *      a la taula estats ni enviar-lo a la web.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <syslog.h>
+#include <sqlite3.h>
+#include "ocpp_cs.h"
+#include "ws_server.h"
+#include "status_transitions.h"
+
+#define BIT(status) (1u << (status))
+#define ALL_STATUSES (BIT(CONN_UNKNOWN) - 1)
+
+// Prototips de les funcions
+static int read_last_status(void *arg, int argc, char **argv, char **col_names);
+
+// estats als quals es pot passar des de cada estat (una fila per estat, un bit per estat destí)
+static const uint16_t allowed[CONN_NUM_STATUSES] = {
+    [CONN_AVAILABLE] = BIT(CONN_PREPARING) | BIT(CONN_CHARGING) | BIT(CONN_SUSPENDED_EV) | BIT(CONN_SUSPENDED_EVSE) |
+                       BIT(CONN_RESERVED) | BIT(CONN_UNAVAILABLE) | BIT(CONN_FAULTED),
+    [CONN_PREPARING] = BIT(CONN_AVAILABLE) | BIT(CONN_CHARGING) | BIT(CONN_SUSPENDED_EV) | BIT(CONN_SUSPENDED_EVSE) |
+                       BIT(CONN_FINISHING) | BIT(CONN_FAULTED),
+    [CONN_CHARGING] = BIT(CONN_AVAILABLE) | BIT(CONN_SUSPENDED_EV) | BIT(CONN_SUSPENDED_EVSE) | BIT(CONN_FINISHING) |
+                      BIT(CONN_UNAVAILABLE) | BIT(CONN_FAULTED),
+    [CONN_SUSPENDED_EV] = BIT(CONN_AVAILABLE) | BIT(CONN_CHARGING) | BIT(CONN_SUSPENDED_EVSE) | BIT(CONN_FINISHING) |
+                          BIT(CONN_UNAVAILABLE) | BIT(CONN_FAULTED),
+    [CONN_SUSPENDED_EVSE] = BIT(CONN_AVAILABLE) | BIT(CONN_CHARGING) | BIT(CONN_SUSPENDED_EV) | BIT(CONN_FINISHING) |
+                            BIT(CONN_UNAVAILABLE) | BIT(CONN_FAULTED),
+    [CONN_FINISHING] = BIT(CONN_AVAILABLE) | BIT(CONN_PREPARING) | BIT(CONN_UNAVAILABLE) | BIT(CONN_FAULTED),
+    [CONN_RESERVED] = BIT(CONN_AVAILABLE) | BIT(CONN_PREPARING) | BIT(CONN_UNAVAILABLE) | BIT(CONN_FAULTED),
+    [CONN_UNAVAILABLE] = BIT(CONN_AVAILABLE) | BIT(CONN_PREPARING) | BIT(CONN_CHARGING) | BIT(CONN_SUSPENDED_EV) |
+                         BIT(CONN_SUSPENDED_EVSE) | BIT(CONN_FAULTED),
+    [CONN_FAULTED] = ALL_STATUSES,
+    [CONN_UNKNOWN] = ALL_STATUSES
+};
+
+// estats que pot tenir el connector 0 (el carregador sencer)
+static const uint16_t allowed_connector_zero = BIT(CONN_AVAILABLE) | BIT(CONN_UNAVAILABLE) | BIT(CONN_FAULTED);
+
+// noms dels estats tal com es guarden a la base de dades
+static const char *status_names[CONN_NUM_STATUSES] = {
+    "Available", "Charging", "Faulted", "Finishing", "Preparing", "Reserved",
+    "SuspendedEV", "SuspendedEVSE", "Unavailable", ""
+};
+
+/*
+ *  NAME
+ *      status_transition_check - Classifica un canvi d'estat d'un connector
+ *  SYNOPSIS
+ *      enum status_transition status_transition_check(int connector, int64_t from_status, int from_error,
+ *                                                     int64_t to_status, int to_error);
+ *  DESCRIPTION
+ *      Mira si passar de from_status/from_error a to_status/to_error és un StatusNotification repetit,
+ *      una transició permesa per la taula d'OCPP 1.6 o una transició no permesa.
+ *  RETURN VALUE
+ *      TRANSITION_NOOP si l'estat i l'errorCode no canvien.
+ *      TRANSITION_VALID si la transició és permesa.
+ *      TRANSITION_INVALID en cas contrari.
+ */
+enum status_transition status_transition_check(int connector, int64_t from_status, int from_error, int64_t to_status, int to_error)
+{
+    if (to_status < 0 || to_status >= CONN_UNKNOWN)
+        return TRANSITION_INVALID;
+
+    if (connector == 0 && !(allowed_connector_zero & BIT(to_status)))
+        return TRANSITION_INVALID;
+
+    if (from_status < 0 || from_status >= CONN_NUM_STATUSES)
+        from_status = CONN_UNKNOWN;
+
+    if (from_status == to_status)
+        return from_error == to_error ? TRANSITION_NOOP : TRANSITION_VALID; // només canvia l'errorCode
+
+    return (allowed[from_status] & BIT(to_status)) ? TRANSITION_VALID : TRANSITION_INVALID;
+}
+
+/*
+ *  NAME
+ *      status_transition_name - Retorna el nom d'un estat
+ *  SYNOPSIS
+ *      const char *status_transition_name(int64_t status);
+ *  DESCRIPTION
+ *      Retorna el nom de l'estat tal com es guarda a la base de dades.
+ *  RETURN VALUE
+ *      El nom de l'estat ("" si no és un estat conegut).
+ */
+const char *status_transition_name(int64_t status)
+{
+    if (status < 0 || status >= CONN_NUM_STATUSES)
+        return "";
+
+    return status_names[status];
+}
+
+/*
+ *  NAME
+ *      status_last_stored - Mira si l'últim estat guardat d'un connector és el mateix
+ *  SYNOPSIS
+ *      bool status_last_stored(int charger_id, int connector, const char *estat, const char *error);
+ *  DESCRIPTION
+ *      Llegeix l'última fila de la taula estats del connector. Es fa servir quan el sistema de control
+ *      encara no sap l'estat del connector (després d'una reconnexió) per no tornar a guardar l'estat
+ *      que el carregador ja havia enviat abans de desconnectar-se.
+ *  RETURN VALUE
+ *      Retorna true si l'última fila té el mateix estat i errorCode.
+ *      Retorna false en cas contrari.
+ */
+bool status_last_stored(int charger_id, int connector, const char *estat, const char *error)
+{
+    char last[2][32] = {"", ""};
+    bool found = false;
+    sqlite3 *db;
+    int rc;
+    char *errmsg;
+
+    rc = sqlite3_open(DATABASE_PATH, &db);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: ERROR opening SQLite DB: %s\n", __func__, sqlite3_errmsg(db));
+    }
+    else {
+        char query[256];
+        snprintf(query, sizeof(query), "SELECT estat, error_code FROM estats WHERE charger_id = %d AND connector = %d "
+            "ORDER BY id DESC LIMIT 1;", charger_id, connector);
+        rc = sqlite3_exec(db, query, read_last_status, last, &errmsg);
+        if (rc != SQLITE_OK) {
+            syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+            sqlite3_free(errmsg);
+        }
+        else {
+            found = strcmp(last[0], estat) == 0 && strcmp(last[1], error) == 0;
+        }
+    }
+    sqlite3_close(db); // tanca la base de dades correctament
+
+    return found;
+}
+
+/*
+ *  NAME
+ *      read_last_status - Callback per llegir l'últim estat guardat
+ *  SYNOPSIS
+ *      static int read_last_status(void *arg, int argc, char **argv, char **col_names);
+ *  DESCRIPTION
+ *      Callback de sqlite3_exec() que copia l'estat i l'errorCode de la fila a arg.
+ *  RETURN VALUE
+ *      0.
+ */
+static int read_last_status(void *arg, int argc, char **argv, char **col_names)
+{
+    char (*last)[32] = arg;
+
+    if (argc > 1) {
+        snprintf(last[0], 32, "%s", argv[0] ? argv[0] : "");
+        snprintf(last[1], 32, "%s", argv[1] ? argv[1] : "");
+    }
+
+    return 0;
+}
@@ -0,0 +1,34 @@
+/*
+ *  FILE
+ *      status_transitions.h - header de status_transitions.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header de la màquina d'estats dels connectors.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _STATUS_TRANSITIONS_H_
+#define _STATUS_TRANSITIONS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* enum per indicar el tipus de transició d'un StatusNotification:
+ * TRANSITION_NOOP: l'estat i l'errorCode són els mateixos que ja tenia el connector
+ * TRANSITION_VALID: transició permesa pel protocol
+ * TRANSITION_INVALID: transició no permesa pel protocol (s'accepta igualment, però es registra) */
+enum status_transition {
+    TRANSITION_NOOP,
+    TRANSITION_VALID,
+    TRANSITION_INVALID
+};
+
+enum status_transition status_transition_check(int connector, int64_t from_status, int from_error, int64_t to_status, int to_error);
+const char *status_transition_name(int64_t status);
+bool status_last_stored(int charger_id, int connector, const char *estat, const char *error);
+
+#endif
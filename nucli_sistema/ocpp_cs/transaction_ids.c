@@ -0,0 +1,234 @@
+/*
+ *  FILE
+ *      transaction_ids.c - generador global de transactionIds
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Genera transactionIds únics per a tot el sistema de control i que no es repeteixen
+ *      entre reinicis. A la base de dades (taula tx_id_alloc) es guarda el límit superior dels
+ *      ids que s'han pogut repartir, reservant-los en blocs de TX_ID_LEASE_CHUNK. Dins del bloc
+ *      reservat cada id s'obté amb un increment atòmic, sense esperar la base de dades; quan en
+ *      queden menys de TX_ID_LOW_WATERMARK es reserva el següent bloc en un thread a part.
+ *      En reiniciar es continua a partir del límit guardat, de manera que els ids no utilitzats
+ *      de l'últim bloc es perden però mai es repeteixen.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <sqlite3.h>
+#include "ws_server.h"
+#include "transaction_ids.h"
+
+static int64_t next_id = 1;         // següent transactionId a repartir
+static int64_t lease_end = 1;       // primer transactionId fora del bloc reservat
+static bool refilling = false;      // hi ha una reserva en segon pla en curs
+static pthread_mutex_t lease_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Prototips de les funcions
+static int read_high_water(void *arg, int argc, char **argv, char **col_names);
+static bool persist_high_water(int64_t high_water);
+static void extend_lease(int64_t min_end);
+static void *refill_thread(void *arg);
+
+/*
+ *  NAME
+ *      tx_id_init - Inicialitza el generador de transactionIds
+ *  SYNOPSIS
+ *      void tx_id_init(void);
+ *  DESCRIPTION
+ *      Crea la taula tx_id_alloc si no existeix, llegeix el límit guardat i
+ *      reserva el primer bloc de transactionIds a partir d'aquest límit.
+ *  RETURN VALUE
+ *      Res.
+ */
+void tx_id_init(void)
+{
+    sqlite3 *db;
+    int rc;
+    char *errmsg;
+    int64_t high_water = 1;
+
+    rc = sqlite3_open(DATABASE_PATH, &db);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: ERROR opening SQLite DB: %s\n", __func__, sqlite3_errmsg(db));
+    }
+    else {
+        rc = sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS tx_id_alloc (id INTEGER PRIMARY KEY CHECK (id = 0), "
+            "high_water INTEGER NOT NULL);", 0, 0, &errmsg);
+        if (rc != SQLITE_OK) {
+            syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+            sqlite3_free(errmsg);
+        }
+
+        rc = sqlite3_exec(db, "SELECT high_water FROM tx_id_alloc WHERE id = 0;", read_high_water, &high_water, &errmsg);
+        if (rc != SQLITE_OK) {
+            syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+            sqlite3_free(errmsg);
+        }
+    }
+    sqlite3_close(db); // tanca la base de dades correctament
+
+    if (high_water < 1)
+        high_water = 1;
+
+    pthread_mutex_lock(&lease_lock);
+    __atomic_store_n(&next_id, high_water, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&lease_end, high_water, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&lease_lock);
+
+    extend_lease(high_water + 1);
+
+    syslog(LOG_INFO, "%s: transactionIds a partir de %ld", __func__, high_water);
+}
+
+/*
+ *  NAME
+ *      tx_id_next - Retorna un transactionId nou
+ *  SYNOPSIS
+ *      int64_t tx_id_next(void);
+ *  DESCRIPTION
+ *      Retorna el següent transactionId del bloc reservat. Només s'espera la base de dades
+ *      si el bloc s'ha esgotat abans que s'hagi pogut reservar el següent.
+ *  RETURN VALUE
+ *      Un transactionId únic.
+ */
+int64_t tx_id_next(void)
+{
+    int64_t id = __atomic_fetch_add(&next_id, 1, __ATOMIC_SEQ_CST);
+    int64_t end = __atomic_load_n(&lease_end, __ATOMIC_SEQ_CST);
+
+    if (id >= end) { // bloc esgotat -> s'ha de reservar abans de retornar l'id
+        extend_lease(id + 1);
+    }
+    else if (end - id <= TX_ID_LOW_WATERMARK &&
+             !__atomic_exchange_n(&refilling, true, __ATOMIC_SEQ_CST)) { // en queden pocs -> reservo el següent bloc en segon pla
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, refill_thread, NULL) == 0)
+            pthread_detach(thread);
+        else
+            __atomic_store_n(&refilling, false, __ATOMIC_SEQ_CST);
+    }
+
+    return id;
+}
+
+/*
+ *  NAME
+ *      read_high_water - Callback per llegir el límit guardat
+ *  SYNOPSIS
+ *      static int read_high_water(void *arg, int argc, char **argv, char **col_names);
+ *  DESCRIPTION
+ *      Callback de sqlite3_exec() que guarda el valor de high_water a arg.
+ *  RETURN VALUE
+ *      0.
+ */
+static int read_high_water(void *arg, int argc, char **argv, char **col_names)
+{
+    if (argc > 0 && argv[0] != NULL)
+        *(int64_t *)arg = strtoll(argv[0], NULL, 10);
+
+    return 0;
+}
+
+/*
+ *  NAME
+ *      persist_high_water - Guarda el límit a la base de dades
+ *  SYNOPSIS
+ *      static bool persist_high_water(int64_t high_water);
+ *  DESCRIPTION
+ *      Guarda a la taula tx_id_alloc el primer transactionId que encara no s'ha reservat.
+ *  RETURN VALUE
+ *      Retorna true si s'ha guardat.
+ *      Retorna false en cas contrari.
+ */
+static bool persist_high_water(int64_t high_water)
+{
+    sqlite3 *db;
+    int rc;
+    char *errmsg;
+    bool ok = false;
+
+    rc = sqlite3_open(DATABASE_PATH, &db);
+    if (rc != SQLITE_OK) {
+        syslog(LOG_ERR, "%s: ERROR opening SQLite DB: %s\n", __func__, sqlite3_errmsg(db));
+    }
+    else {
+        char query[128];
+        snprintf(query, sizeof(query), "INSERT OR REPLACE INTO tx_id_alloc(id, high_water) VALUES(0, %ld);", high_water);
+        rc = sqlite3_exec(db, query, 0, 0, &errmsg);
+        if (rc != SQLITE_OK) {
+            syslog(LOG_ERR, "%s: SQL error: %s\n", __func__, errmsg);
+            sqlite3_free(errmsg);
+        }
+        else
+            ok = true;
+    }
+    sqlite3_close(db); // tanca la base de dades correctament
+
+    return ok;
+}
+
+/*
+ *  NAME
+ *      extend_lease - Reserva un nou bloc de transactionIds
+ *  SYNOPSIS
+ *      static void extend_lease(int64_t min_end);
+ *  DESCRIPTION
+ *      Reserva blocs de TX_ID_LEASE_CHUNK fins que el límit del bloc és com a mínim min_end
+ *      i una mica més enllà dels ids ja repartits. Primer es guarda el límit a la base de dades
+ *      i després es publica, de manera que mai es reparteix un id que no estigui reservat.
+ *      Si no es pot guardar, es publica igualment perquè el carregador rebi un id, però després
+ *      d'un reinici es podria repetir.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void extend_lease(int64_t min_end)
+{
+    pthread_mutex_lock(&lease_lock);
+
+    int64_t end = __atomic_load_n(&lease_end, __ATOMIC_SEQ_CST);
+    int64_t issued = __atomic_load_n(&next_id, __ATOMIC_SEQ_CST);
+    if (min_end < issued + TX_ID_LOW_WATERMARK)
+        min_end = issued + TX_ID_LOW_WATERMARK;
+
+    if (end < min_end) {
+        int64_t new_end = end;
+        while (new_end < min_end)
+            new_end += TX_ID_LEASE_CHUNK;
+
+        if (!persist_high_water(new_end))
+            syslog(LOG_ERR, "%s: no s'ha pogut guardar el límit %ld, els transactionIds es podrien repetir després d'un reinici",
+                __func__, new_end);
+
+        __atomic_store_n(&lease_end, new_end, __ATOMIC_SEQ_CST);
+        syslog(LOG_DEBUG, "%s: bloc reservat fins a %ld", __func__, new_end);
+    }
+
+    pthread_mutex_unlock(&lease_lock);
+}
+
+/*
+ *  NAME
+ *      refill_thread - Reserva el següent bloc en segon pla
+ *  SYNOPSIS
+ *      static void *refill_thread(void *arg);
+ *  DESCRIPTION
+ *      Reserva el següent bloc de transactionIds sense bloquejar qui l'ha demanat.
+ *  RETURN VALUE
+ *      NULL.
+ */
+static void *refill_thread(void *arg)
+{
+    extend_lease(__atomic_load_n(&lease_end, __ATOMIC_SEQ_CST) + 1);
+    __atomic_store_n(&refilling, false, __ATOMIC_SEQ_CST);
+
+    return NULL;
+}
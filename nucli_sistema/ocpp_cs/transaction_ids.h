@@ -0,0 +1,25 @@
+/*
+ *  FILE
+ *      transaction_ids.h - header de transaction_ids.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header del generador global de transactionIds.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _TRANSACTION_IDS_H_
+#define _TRANSACTION_IDS_H_
+
+#include <stdint.h>
+
+#define TX_ID_LEASE_CHUNK 1000      // transactionIds que es reserven a la base de dades de cop
+#define TX_ID_LOW_WATERMARK 100     // quan en queden menys es reserva el següent bloc en segon pla
+
+void tx_id_init(void);
+int64_t tx_id_next(void);
+
+#endif
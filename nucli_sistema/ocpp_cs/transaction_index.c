@@ -0,0 +1,303 @@
+/*
+ *  FILE
+ *      transaction_index.c - índex global de transaccions actives
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Taula de hash de transactionId a (carregador, connector, idTag, meterStart, hora d'inici,
+ *      última lectura d'energia) de totes les transaccions actives del sistema de control. Els buckets estan repartits
+ *      entre TX_INDEX_STRIPES locks perquè els carregadors no s'esperin entre ells.
+ *      A més es guarda quina transacció té cada connector, de manera que en iniciar-ne una de nova
+ *      en un connector s'esborra l'anterior si no s'ha rebut el StopTransaction.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <syslog.h>
+#include "ocpp_cs.h"
+#include "ws_server.h"
+#include "transaction_index.h"
+
+// node de la taula de hash
+struct tx_node {
+    struct tx_info info;
+    struct tx_node *next;
+};
+
+static struct tx_node *buckets[TX_INDEX_BUCKETS];
+static pthread_mutex_t stripes[TX_INDEX_STRIPES] = {[0 ... TX_INDEX_STRIPES - 1] = PTHREAD_MUTEX_INITIALIZER};
+
+// transacció activa de cada connector de cada carregador (-1 si no n'hi ha)
+static int64_t connector_tx[MAX_CHARGERS + 1][MAX_CONNECTORS + 1] = {[0 ... MAX_CHARGERS] = {[0 ... MAX_CONNECTORS] = -1}};
+static pthread_mutex_t connector_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Prototips de les funcions
+static unsigned int get_bucket(int64_t transaction_id);
+static int64_t swap_connector_tx(int charger, int connector, int64_t transaction_id);
+static void clear_connector_tx(int charger, int connector, int64_t transaction_id);
+
+/*
+ *  NAME
+ *      tx_index_add - Afegeix una transacció a l'índex
+ *  SYNOPSIS
+ *      void tx_index_add(int64_t transaction_id, int charger, int connector, const char *id_tag, int64_t meter_start, time_t start_time);
+ *  DESCRIPTION
+ *      Afegeix o actualitza una transacció a l'índex. Si el connector tenia una altra transacció
+ *      que no s'ha tancat, s'esborra.
+ *  RETURN VALUE
+ *      Res.
+ */
+void tx_index_add(int64_t transaction_id, int charger, int connector, const char *id_tag, int64_t meter_start, time_t start_time)
+{
+    unsigned int bucket = get_bucket(transaction_id);
+    pthread_mutex_t *lock = &stripes[bucket % TX_INDEX_STRIPES];
+
+    pthread_mutex_lock(lock);
+
+    int prev_charger = -1, prev_connector = -1; // si ja hi era, on estava
+    struct tx_node *node = buckets[bucket];
+    while (node != NULL && node->info.transaction_id != transaction_id)
+        node = node->next;
+
+    if (node != NULL) {
+        prev_charger = node->info.charger;
+        prev_connector = node->info.connector;
+    }
+    else if ((node = calloc(1, sizeof(struct tx_node))) != NULL) {
+        node->info.last_energy_wh = meter_start; // encara no hi ha cap MeterValues
+        node->info.last_sample_time = 0;
+        node->next = buckets[bucket];
+        buckets[bucket] = node;
+    }
+    else {
+        pthread_mutex_unlock(lock);
+        syslog(LOG_ERR, "%s: calloc failed", __func__);
+        return;
+    }
+
+    node->info.transaction_id = transaction_id;
+    node->info.charger = charger;
+    node->info.connector = connector;
+    snprintf(node->info.id_tag, sizeof(node->info.id_tag), "%s", id_tag ? id_tag : "");
+    node->info.meter_start = meter_start;
+    node->info.start_time = start_time;
+
+    pthread_mutex_unlock(lock);
+
+    if (prev_charger != charger || prev_connector != connector)
+        clear_connector_tx(prev_charger, prev_connector, transaction_id);
+
+    // la transacció anterior del connector ja no està activa
+    int64_t old = swap_connector_tx(charger, connector, transaction_id);
+    if (old != -1 && old != transaction_id) {
+        syslog(LOG_DEBUG, "%s: transactionId %ld del connector %d del carregador %d sense StopTransaction", __func__,
+            old, connector, charger);
+        tx_index_remove(old, NULL);
+    }
+}
+
+/*
+ *  NAME
+ *      tx_index_lookup - Busca una transacció a l'índex
+ *  SYNOPSIS
+ *      bool tx_index_lookup(int64_t transaction_id, struct tx_info *info);
+ *  DESCRIPTION
+ *      Busca una transacció a l'índex i, si la troba i info no és NULL, en copia la informació a info.
+ *  RETURN VALUE
+ *      Retorna true si la troba.
+ *      Retorna false en cas contrari.
+ */
+bool tx_index_lookup(int64_t transaction_id, struct tx_info *info)
+{
+    unsigned int bucket = get_bucket(transaction_id);
+    pthread_mutex_t *lock = &stripes[bucket % TX_INDEX_STRIPES];
+    bool found = false;
+
+    pthread_mutex_lock(lock);
+
+    for (struct tx_node *node = buckets[bucket]; node != NULL; node = node->next) {
+        if (node->info.transaction_id == transaction_id) {
+            if (info != NULL)
+                *info = node->info;
+            found = true;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(lock);
+
+    return found;
+}
+
+/*
+ *  NAME
+ *      tx_index_remove - Esborra una transacció de l'índex
+ *  SYNOPSIS
+ *      bool tx_index_remove(int64_t transaction_id, struct tx_info *info);
+ *  DESCRIPTION
+ *      Esborra una transacció de l'índex i, si info no és NULL, en copia la informació a info.
+ *  RETURN VALUE
+ *      Retorna true si la transacció hi era.
+ *      Retorna false en cas contrari.
+ */
+bool tx_index_remove(int64_t transaction_id, struct tx_info *info)
+{
+    unsigned int bucket = get_bucket(transaction_id);
+    pthread_mutex_t *lock = &stripes[bucket % TX_INDEX_STRIPES];
+    struct tx_node *removed = NULL;
+
+    pthread_mutex_lock(lock);
+
+    for (struct tx_node **node = &buckets[bucket]; *node != NULL; node = &(*node)->next) {
+        if ((*node)->info.transaction_id == transaction_id) {
+            removed = *node;
+            *node = removed->next;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(lock);
+
+    if (removed == NULL)
+        return false;
+
+    clear_connector_tx(removed->info.charger, removed->info.connector, transaction_id);
+
+    if (info != NULL)
+        *info = removed->info;
+    free(removed);
+
+    return true;
+}
+
+/*
+ *  NAME
+ *      tx_index_bind_connector - Assigna una transacció a un connector
+ *  SYNOPSIS
+ *      void tx_index_bind_connector(int64_t transaction_id, int charger, int connector);
+ *  DESCRIPTION
+ *      Actualitza el carregador i el connector d'una transacció de l'índex (StatusNotification Charging).
+ *  RETURN VALUE
+ *      Res.
+ */
+void tx_index_bind_connector(int64_t transaction_id, int charger, int connector)
+{
+    struct tx_info info;
+
+    if (transaction_id <= 0)
+        return;
+
+    if (!tx_index_lookup(transaction_id, &info)) // només les transaccions acceptades són a l'índex
+        return;
+
+    if (info.charger != charger || info.connector != connector)
+        tx_index_add(transaction_id, charger, connector, info.id_tag, info.meter_start, info.start_time);
+}
+
+/*
+ *  NAME
+ *      tx_index_update_energy - Actualitza l'energia d'una transacció
+ *  SYNOPSIS
+ *      bool tx_index_update_energy(int64_t transaction_id, int64_t energy_wh, time_t sample_time);
+ *  DESCRIPTION
+ *      Guarda l'última lectura del comptador (Energy.Active.Import.Register, en Wh) d'una transacció
+ *      de l'índex. Les mostres més antigues que l'última que s'ha guardat s'ignoren.
+ *  RETURN VALUE
+ *      Retorna true si la transacció és a l'índex.
+ *      Retorna false en cas contrari.
+ */
+bool tx_index_update_energy(int64_t transaction_id, int64_t energy_wh, time_t sample_time)
+{
+    unsigned int bucket = get_bucket(transaction_id);
+    pthread_mutex_t *lock = &stripes[bucket % TX_INDEX_STRIPES];
+    bool found = false;
+
+    pthread_mutex_lock(lock);
+
+    for (struct tx_node *node = buckets[bucket]; node != NULL; node = node->next) {
+        if (node->info.transaction_id == transaction_id) {
+            if (sample_time >= node->info.last_sample_time) {
+                node->info.last_energy_wh = energy_wh;
+                node->info.last_sample_time = sample_time;
+            }
+            found = true;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(lock);
+
+    return found;
+}
+
+/*
+ *  NAME
+ *      get_bucket - Retorna el bucket d'un transactionId
+ *  SYNOPSIS
+ *      static unsigned int get_bucket(int64_t transaction_id);
+ *  DESCRIPTION
+ *      Hash multiplicatiu del transactionId. Els transactionIds són consecutius,
+ *      així que es barregen els bits per repartir-los entre els buckets i els locks.
+ *  RETURN VALUE
+ *      L'índex del bucket.
+ */
+static unsigned int get_bucket(int64_t transaction_id)
+{
+    uint64_t hash = (uint64_t)transaction_id * 0x9E3779B97F4A7C15ULL;
+
+    return (unsigned int)(hash >> 32) & (TX_INDEX_BUCKETS - 1);
+}
+
+/*
+ *  NAME
+ *      swap_connector_tx - Canvia la transacció activa d'un connector
+ *  SYNOPSIS
+ *      static int64_t swap_connector_tx(int charger, int connector, int64_t transaction_id);
+ *  DESCRIPTION
+ *      Guarda transaction_id com a transacció activa del connector.
+ *  RETURN VALUE
+ *      Retorna la transacció que hi havia abans (-1 si no n'hi havia o el connector no és vàlid).
+ */
+static int64_t swap_connector_tx(int charger, int connector, int64_t transaction_id)
+{
+    int64_t old = -1;
+
+    if (charger < 0 || charger > MAX_CHARGERS || connector < 0 || connector > MAX_CONNECTORS)
+        return -1;
+
+    pthread_mutex_lock(&connector_lock);
+    old = connector_tx[charger][connector];
+    connector_tx[charger][connector] = transaction_id;
+    pthread_mutex_unlock(&connector_lock);
+
+    return old;
+}
+
+/*
+ *  NAME
+ *      clear_connector_tx - Esborra la transacció activa d'un connector
+ *  SYNOPSIS
+ *      static void clear_connector_tx(int charger, int connector, int64_t transaction_id);
+ *  DESCRIPTION
+ *      Esborra la transacció activa del connector si és transaction_id.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void clear_connector_tx(int charger, int connector, int64_t transaction_id)
+{
+    if (charger < 0 || charger > MAX_CHARGERS || connector < 0 || connector > MAX_CONNECTORS)
+        return;
+
+    pthread_mutex_lock(&connector_lock);
+    if (connector_tx[charger][connector] == transaction_id)
+        connector_tx[charger][connector] = -1;
+    pthread_mutex_unlock(&connector_lock);
+}
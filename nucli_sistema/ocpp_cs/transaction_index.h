@@ -0,0 +1,43 @@
+/*
+ *  FILE
+ *      transaction_index.h - header de transaction_index.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header de l'índex global de transaccions actives.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _TRANSACTION_INDEX_H_
+#define _TRANSACTION_INDEX_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "ocpp_cs.h"
+
+#define TX_INDEX_BUCKETS 1024   // nombre de buckets de la taula de hash (potència de 2)
+#define TX_INDEX_STRIPES 16     // nombre de locks, cadascun protegeix TX_INDEX_BUCKETS / TX_INDEX_STRIPES buckets
+
+// informació d'una transacció activa
+struct tx_info {
+    int64_t transaction_id;
+    int charger;                    // índex del carregador a charger_vars
+    int connector;
+    char id_tag[ID_TAG_LEN + 1];
+    int64_t meter_start;            // Wh, -1 si no es coneix
+    time_t start_time;
+    int64_t last_energy_wh;         // últim Energy.Active.Import.Register rebut (Wh), -1 si no es coneix
+    time_t last_sample_time;        // timestamp (del carregador) de l'última mostra d'energia
+};
+
+void tx_index_add(int64_t transaction_id, int charger, int connector, const char *id_tag, int64_t meter_start, time_t start_time);
+bool tx_index_lookup(int64_t transaction_id, struct tx_info *info);
+bool tx_index_remove(int64_t transaction_id, struct tx_info *info);
+void tx_index_bind_connector(int64_t transaction_id, int charger, int connector);
+bool tx_index_update_energy(int64_t transaction_id, int64_t energy_wh, time_t sample_time);
+
+#endif
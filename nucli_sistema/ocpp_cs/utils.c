@@ -21,6 +21,8 @@
 #include <time.h>
 #include "utils.h"
 #include "ocpp_cs.h"
+#include "auth_store.h"
+#include "connectors.h"
 
 /*
  *  NAME
@@ -38,7 +40,8 @@ struct req_rx *split_message(struct req_rx *dest, char *src)
     snprintf(tmp, sizeof(tmp), "%s", src + 1);
 
     // Obtinc el Header
-    char* header = strtok(tmp, "{");
+    char *saveptr = NULL;
+    char* header = strtok_r(tmp, "{", &saveptr);
     size_t len = strlen(header);
     header[len - 1] = 0;
     dest->header = malloc(len + 1);
@@ -74,7 +77,8 @@ struct header_st *split_header(struct req_rx *src, struct header_st *dest)
     snprintf(tmp, sizeof(tmp), "%s", src->header + 2);
 
     // Obtinc el uniqueId
-    char *unique_id = strtok(tmp, ",");
+    char *saveptr = NULL;
+    char *unique_id = strtok_r(tmp, ",", &saveptr);
     dest->unique_id = malloc(strlen(unique_id) + 1);
     snprintf(dest->unique_id, strlen(unique_id) + 1, "%s", unique_id);
 
@@ -138,23 +142,19 @@ char *remove_quotes(char *str)
 
 /*
  *  NAME
- *      check_id_tag - Comprova si un idTag es troba a la auth_list
+ *      check_id_tag - Comprova si un idTag es troba al magatzem d'idTags
  *  SYNOPSIS
  *      bool check_id_tag(char *id_tag);
  *  DESCRIPTION
- *      Comprova si un idTag es troba a la auth_list del sistema de control, indicant si és vàlid o no.
+ *      Comprova si un idTag es troba al magatzem central d'idTags del sistema de control amb estat Accepted,
+ *      indicant si és vàlid o no.
  *  RETURN VALUE
  *      Retorna true si és vàlid.
  *      Retorna false en cas contrari.
  */
 bool check_id_tag(char *id_tag)
 {
-    for (int i = 0; i < (strlen((char *)auth_list) - 1); i++) {
-        if (strcasecmp(auth_list[i], id_tag) == 0)
-            return true;
-    }
-
-    return false;
+    return auth_store_check(id_tag);
 }
 
 /*
@@ -170,12 +170,7 @@ bool check_id_tag(char *id_tag)
  */
 bool check_concurrent_tx_id_tag(char *id_tag, ChargerVars *vars)
 {
-    for (int i = 0; i < (strlen((char *)vars->current_id_tags) - 1); i++) {
-        if (strcasecmp(vars->current_id_tags[i], id_tag) == 0)
-            return true;
-    }
-
-    return false;
+    return connector_find_id_tag(vars, id_tag) > 0;
 }
 
 /*
@@ -222,23 +217,18 @@ bool check_cp_vendor(const char *charge_point_vendor)
 
 /*
  *  NAME
- *      check_transaction_id - Comprova si un transactionId es troba a la transaction_list.
+ *      check_transaction_id - Comprova si un transactionId és la transacció activa d'algun connector.
  *  SYNOPSIS
  *      bool check_transaction_id(int64_t transaction_id, const ChargerVars *vars)
  *  DESCRIPTION
- *      Comprova si un transactionId es troba a la transaction_list del sistema de control.
+ *      Comprova si un transactionId és la transacció activa d'algun connector del carregador.
  *  RETURN VALUE
  *      Retorna true si és vàlid.
  *      Retorna false en cas contrari.
  */
 bool check_transaction_id(int64_t transaction_id, const ChargerVars *vars)
 {
-    for (int i = 0; i <= NUM_CONNECTORS; i++) {
-        if (vars->transaction_list[i] == transaction_id)
-            return true;
-    }
-
-    return false;
+    return connector_find_transaction(vars, transaction_id) != -1;
 }
 
 /*
@@ -253,9 +243,9 @@ bool check_transaction_id(int64_t transaction_id, const ChargerVars *vars)
  */
 void delete_transaction_id(int64_t transaction_id, ChargerVars *vars)
 {
-    for (int i = 0; i <= NUM_CONNECTORS; i++) {
-        if (vars->transaction_list[i] == transaction_id)
-            vars->transaction_list[i] = -1;
+    for (int i = 0; i <= connectors_count(vars); i++) {
+        if (connector_transaction(vars, i) == transaction_id)
+            connector_set_transaction(vars, i, -1);
     }
 }
 
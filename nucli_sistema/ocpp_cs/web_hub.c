@@ -0,0 +1,382 @@
+/*
+ *  FILE
+ *      web_hub.c - repartidor de missatges cap als clients web
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Hi poden haver fins a WEB_HUB_SUBSCRIBERS clients web connectats alhora (el servidor Flask,
+ *      altres taulers o programes d'anàlisi), cadascun subscrit a un subconjunt dels carregadors.
+ *      Els missatges per a la web no s'envien des del thread del carregador: es copien a la cua de
+ *      cada client subscrit al carregador (o a tots si són de tota la flota) i un thread per client
+ *      els envia. Si un client és lent i la seva cua de WEB_HUB_QUEUE_LEN missatges s'omple, es
+ *      descarten els missatges més antics, de manera que mai es fa esperar cap carregador.
+ *      Els clients poden estar connectats pel servidor WebSocket o pel socket de control local.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <ws.h>
+#include "ws_server.h"
+#include "web_hub.h"
+#include "control_socket.h"
+
+// estat d'una posició de la taula de clients
+enum subscriber_state {
+    SUBSCRIBER_FREE,
+    SUBSCRIBER_ACTIVE,
+    SUBSCRIBER_CLOSING      // el client s'ha desconnectat i el seu thread està alliberant la cua
+};
+
+// client web subscrit
+struct web_subscriber {
+    enum subscriber_state state;
+    ws_cli_conn_t client;
+    uint32_t chargers;                      // bit i a 1 si està subscrit al carregador i
+    unsigned int head;                      // posició del missatge més antic de la cua
+    unsigned int count;                     // missatges pendents d'enviar
+    uint64_t dropped;                       // missatges descartats perquè la cua era plena
+    char *queue[WEB_HUB_QUEUE_LEN];
+    pthread_cond_t ready;                   // avisa el thread del client que hi ha missatges o que ha de sortir
+};
+
+static pthread_mutex_t hub_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct web_subscriber subscribers[WEB_HUB_SUBSCRIBERS] = {
+    [0 ... WEB_HUB_SUBSCRIBERS - 1] = { .ready = PTHREAD_COND_INITIALIZER }
+};
+
+// Prototips de les funcions
+static struct web_subscriber *find_subscriber(ws_cli_conn_t client);
+static void enqueue(struct web_subscriber *sub, const char *text);
+static void *subscriber_thread(void *arg);
+
+/*
+ *  NAME
+ *      web_hub_parse_chargers - Llegeix una llista de carregadors
+ *  SYNOPSIS
+ *      uint32_t web_hub_parse_chargers(const char *list);
+ *  DESCRIPTION
+ *      Passa una llista de carregadors separats per comes ("1,3") a la màscara de subscripció.
+ *      Els carregadors que no existeixen s'ignoren. Si la llista és buida, el client se subscriu
+ *      a tots els carregadors.
+ *  RETURN VALUE
+ *      Retorna la màscara de subscripció.
+ */
+uint32_t web_hub_parse_chargers(const char *list)
+{
+    uint32_t chargers = 0;
+    char copy[64];
+    char *rest, *token, *end;
+
+    if (list == NULL || *list == '\0')
+        return WEB_HUB_ALL_CHARGERS;
+
+    snprintf(copy, sizeof(copy), "%s", list);
+    rest = copy;
+    while ((token = strtok_r(rest, ",", &rest)) != NULL) {
+        long id = strtol(token, &end, 10);
+        if (end != token && id >= 1 && id <= MAX_CHARGERS)
+            chargers |= 1u << id;
+        else
+            syslog(LOG_WARNING, "%s: el carregador %s no existeix\n", __func__, token);
+    }
+
+    return chargers;
+}
+
+/*
+ *  NAME
+ *      web_hub_subscribe - Subscriu un client web
+ *  SYNOPSIS
+ *      bool web_hub_subscribe(ws_cli_conn_t client, uint32_t chargers);
+ *  DESCRIPTION
+ *      Subscriu client als missatges dels carregadors de la màscara chargers (i als de tota la flota).
+ *      Si el client ja estava subscrit només se li canvia la subscripció. Si no, se li assigna una
+ *      posició de la taula i es crea el thread que li envia els missatges.
+ *  RETURN VALUE
+ *      Retorna true si el client queda subscrit.
+ *      Retorna false si no hi ha espai per més clients o no s'ha pogut crear el thread.
+ */
+bool web_hub_subscribe(ws_cli_conn_t client, uint32_t chargers)
+{
+    struct web_subscriber *sub;
+    pthread_t thread;
+    int i;
+
+    pthread_mutex_lock(&hub_lock);
+
+    sub = find_subscriber(client);
+    if (sub != NULL) { // ja estava subscrit
+        sub->chargers = chargers;
+        pthread_mutex_unlock(&hub_lock);
+        return true;
+    }
+
+    for (i = 0; i < WEB_HUB_SUBSCRIBERS && subscribers[i].state != SUBSCRIBER_FREE; i++)
+        ;
+    if (i == WEB_HUB_SUBSCRIBERS) {
+        pthread_mutex_unlock(&hub_lock);
+        syslog(LOG_WARNING, "%s: Warning: No hi ha espai per més clients web\n", __func__);
+        return false;
+    }
+
+    sub = &subscribers[i];
+    sub->state = SUBSCRIBER_ACTIVE;
+    sub->client = client;
+    sub->chargers = chargers;
+    sub->head = 0;
+    sub->count = 0;
+    sub->dropped = 0;
+
+    if (pthread_create(&thread, NULL, subscriber_thread, sub) != 0) {
+        sub->state = SUBSCRIBER_FREE;
+        pthread_mutex_unlock(&hub_lock);
+        syslog(LOG_ERR, "%s: ERROR creating thread\n", __func__);
+        return false;
+    }
+    pthread_detach(thread);
+
+    pthread_mutex_unlock(&hub_lock);
+    return true;
+}
+
+/*
+ *  NAME
+ *      web_hub_unsubscribe - Dona de baixa un client web
+ *  SYNOPSIS
+ *      bool web_hub_unsubscribe(ws_cli_conn_t client);
+ *  DESCRIPTION
+ *      S'ha de cridar quan es tanca la connexió del client. Els missatges pendents es descarten
+ *      i el thread del client allibera la seva posició de la taula.
+ *  RETURN VALUE
+ *      Retorna true si client era un client web.
+ *      Retorna false en cas contrari.
+ */
+bool web_hub_unsubscribe(ws_cli_conn_t client)
+{
+    struct web_subscriber *sub;
+
+    pthread_mutex_lock(&hub_lock);
+    sub = find_subscriber(client);
+    if (sub != NULL) {
+        sub->state = SUBSCRIBER_CLOSING;
+        pthread_cond_signal(&sub->ready);
+    }
+    pthread_mutex_unlock(&hub_lock);
+
+    return sub != NULL;
+}
+
+/*
+ *  NAME
+ *      web_hub_publish - Envia un missatge als clients web
+ *  SYNOPSIS
+ *      void web_hub_publish(int charger_id, const char *text);
+ *  DESCRIPTION
+ *      Copia el missatge a la cua dels clients subscrits al carregador charger_id. Si charger_id és
+ *      WEB_HUB_FLEET el missatge és de tota la flota i es copia a la cua de tots els clients.
+ *      No espera que s'enviï.
+ *  RETURN VALUE
+ *      Res.
+ */
+void web_hub_publish(int charger_id, const char *text)
+{
+    if (charger_id < 0 || charger_id > MAX_CHARGERS)
+        charger_id = WEB_HUB_FLEET;
+
+    pthread_mutex_lock(&hub_lock);
+    for (int i = 0; i < WEB_HUB_SUBSCRIBERS; i++) {
+        struct web_subscriber *sub = &subscribers[i];
+        if (sub->state == SUBSCRIBER_ACTIVE && (charger_id == WEB_HUB_FLEET || (sub->chargers & (1u << charger_id))))
+            enqueue(sub, text);
+    }
+    pthread_mutex_unlock(&hub_lock);
+}
+
+/*
+ *  NAME
+ *      web_hub_send - Envia un missatge a un sol client web
+ *  SYNOPSIS
+ *      bool web_hub_send(ws_cli_conn_t client, const char *text);
+ *  DESCRIPTION
+ *      Copia el missatge a la cua de client, per exemple per enviar-li l'estat dels carregadors
+ *      quan se subscriu.
+ *  RETURN VALUE
+ *      Retorna true si client és un client web.
+ *      Retorna false en cas contrari.
+ */
+bool web_hub_send(ws_cli_conn_t client, const char *text)
+{
+    struct web_subscriber *sub;
+
+    pthread_mutex_lock(&hub_lock);
+    sub = find_subscriber(client);
+    if (sub != NULL)
+        enqueue(sub, text);
+    pthread_mutex_unlock(&hub_lock);
+
+    return sub != NULL;
+}
+
+/*
+ *  NAME
+ *      web_hub_chargers - Retorna la subscripció d'un client web
+ *  SYNOPSIS
+ *      uint32_t web_hub_chargers(ws_cli_conn_t client);
+ *  DESCRIPTION
+ *      Retorna la màscara dels carregadors als quals està subscrit client.
+ *  RETURN VALUE
+ *      La màscara de subscripció (0 si client no és un client web).
+ */
+uint32_t web_hub_chargers(ws_cli_conn_t client)
+{
+    struct web_subscriber *sub;
+    uint32_t chargers = 0;
+
+    pthread_mutex_lock(&hub_lock);
+    sub = find_subscriber(client);
+    if (sub != NULL)
+        chargers = sub->chargers;
+    pthread_mutex_unlock(&hub_lock);
+
+    return chargers;
+}
+
+/*
+ *  NAME
+ *      web_hub_subscribed - Comprova si un client està subscrit
+ *  SYNOPSIS
+ *      bool web_hub_subscribed(ws_cli_conn_t client);
+ *  DESCRIPTION
+ *      Comprova si client és un client web subscrit, és a dir, si pot rebre missatges de web_hub_send().
+ *  RETURN VALUE
+ *      Retorna true si està subscrit.
+ *      Retorna false en cas contrari.
+ */
+bool web_hub_subscribed(ws_cli_conn_t client)
+{
+    bool subscribed;
+
+    pthread_mutex_lock(&hub_lock);
+    subscribed = find_subscriber(client) != NULL;
+    pthread_mutex_unlock(&hub_lock);
+
+    return subscribed;
+}
+
+/*
+ *  NAME
+ *      find_subscriber - Busca un client web
+ *  SYNOPSIS
+ *      static struct web_subscriber *find_subscriber(ws_cli_conn_t client);
+ *  DESCRIPTION
+ *      Busca client entre els clients subscrits. S'ha de cridar amb hub_lock agafat.
+ *  RETURN VALUE
+ *      Retorna el client si està subscrit.
+ *      Retorna NULL en cas contrari.
+ */
+static struct web_subscriber *find_subscriber(ws_cli_conn_t client)
+{
+    for (int i = 0; i < WEB_HUB_SUBSCRIBERS; i++) {
+        if (subscribers[i].state == SUBSCRIBER_ACTIVE && subscribers[i].client == client)
+            return &subscribers[i];
+    }
+
+    return NULL;
+}
+
+/*
+ *  NAME
+ *      enqueue - Afegeix un missatge a la cua d'un client
+ *  SYNOPSIS
+ *      static void enqueue(struct web_subscriber *sub, const char *text);
+ *  DESCRIPTION
+ *      Afegeix una còpia del missatge a la cua del client i avisa el seu thread. Si la cua és plena
+ *      es descarta el missatge més antic. S'ha de cridar amb hub_lock agafat.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void enqueue(struct web_subscriber *sub, const char *text)
+{
+    char *copy = strdup(text);
+
+    if (copy == NULL) {
+        syslog(LOG_ERR, "%s: ERROR allocating memory\n", __func__);
+        return;
+    }
+
+    if (sub->count == WEB_HUB_QUEUE_LEN) { // cua plena -> descarto el missatge més antic
+        free(sub->queue[sub->head]);
+        sub->head = (sub->head + 1) % WEB_HUB_QUEUE_LEN;
+        sub->count--;
+        if (sub->dropped++ % WEB_HUB_QUEUE_LEN == 0)
+            syslog(LOG_WARNING, "%s: el client web %lu no llegeix prou ràpid, %lu missatges descartats\n",
+                __func__, sub->client, sub->dropped);
+    }
+
+    sub->queue[(sub->head + sub->count) % WEB_HUB_QUEUE_LEN] = copy;
+    sub->count++;
+    pthread_cond_signal(&sub->ready);
+}
+
+/*
+ *  NAME
+ *      subscriber_thread - Envia els missatges d'un client web
+ *  SYNOPSIS
+ *      static void *subscriber_thread(void *arg);
+ *  DESCRIPTION
+ *      Treu els missatges de la cua del client (arg) i els hi envia, pel WebSocket o pel socket de
+ *      control segons com estigui connectat. Quan el client es dona de baixa descarta els missatges
+ *      pendents, allibera la posició de la taula i surt. Si el client era del socket de control,
+ *      en tanca la connexió.
+ *  RETURN VALUE
+ *      NULL.
+ */
+static void *subscriber_thread(void *arg)
+{
+    struct web_subscriber *sub = arg;
+    ws_cli_conn_t client = sub->client;
+
+    pthread_mutex_lock(&hub_lock);
+    while (1) {
+        while (sub->state == SUBSCRIBER_ACTIVE && sub->count == 0)
+            pthread_cond_wait(&sub->ready, &hub_lock);
+
+        if (sub->state != SUBSCRIBER_ACTIVE)
+            break;
+
+        char *text = sub->queue[sub->head];
+        sub->head = (sub->head + 1) % WEB_HUB_QUEUE_LEN;
+        sub->count--;
+
+        // l'enviament pot bloquejar si el client és lent, no es fa amb hub_lock agafat
+        pthread_mutex_unlock(&hub_lock);
+        int sent = control_is_client(client) ? control_send(client, text) : ws_sendframe_txt(client, text);
+        if (sent < 0)
+            syslog(LOG_DEBUG, "%s: no s'ha pogut enviar el missatge al client web %lu\n", __func__, client);
+        free(text);
+        pthread_mutex_lock(&hub_lock);
+    }
+
+    // el client s'ha desconnectat -> allibero els missatges pendents i la posició
+    while (sub->count > 0) {
+        free(sub->queue[sub->head]);
+        sub->head = (sub->head + 1) % WEB_HUB_QUEUE_LEN;
+        sub->count--;
+    }
+    sub->state = SUBSCRIBER_FREE;
+    pthread_mutex_unlock(&hub_lock);
+
+    syslog(LOG_DEBUG, "%s: client web %lu donat de baixa\n", __func__, client);
+    if (control_is_client(client))
+        control_close(client);
+    return NULL;
+}
@@ -0,0 +1,39 @@
+/*
+ *  FILE
+ *      web_hub.h - header de web_hub.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header del repartidor de missatges cap als clients web.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _WEB_HUB_H_
+#define _WEB_HUB_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <ws.h>
+#include "ws_server.h"
+
+#define WEB_HUB_SUBSCRIBERS 8       // màxim de clients web connectats alhora
+#define WEB_HUB_QUEUE_LEN 256       // missatges pendents d'enviar per client, si n'hi ha més es descarten els més antics
+#define WEB_HUB_FLEET 0             // els missatges de tota la flota (no d'un carregador) s'envien a tots els clients
+#define WEB_HUB_ALL_CHARGERS ((uint32_t)((1ul << (MAX_CHARGERS + 1)) - 1))
+
+#if MAX_CHARGERS >= 32
+#error "les subscripcions dels clients web són d'una sola paraula de 32 bits"
+#endif
+
+uint32_t web_hub_parse_chargers(const char *list);
+bool web_hub_subscribe(ws_cli_conn_t client, uint32_t chargers);
+bool web_hub_unsubscribe(ws_cli_conn_t client);
+void web_hub_publish(int charger_id, const char *text);
+bool web_hub_send(ws_cli_conn_t client, const char *text);
+uint32_t web_hub_chargers(ws_cli_conn_t client);
+bool web_hub_subscribed(ws_cli_conn_t client);
+
+#endif
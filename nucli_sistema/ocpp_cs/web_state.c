@@ -0,0 +1,394 @@
+/*
+ *  FILE
+ *      web_state.c - estat dels carregadors per a la web
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Quan canvia l'estat d'un carregador (BootNotification, StatusNotification, Start i
+ *      StopTransaction o desconnexió) no s'envia el missatge a la web en aquell moment: només es
+ *      marca quina part de l'estat ha canviat. Un thread compara com a molt WEB_STATE_RATE cops per
+ *      segon l'estat actual dels carregadors marcats amb l'últim que s'ha enviat i envia només els
+ *      camps que han canviat (stateDelta), numerats amb un número de seqüència per carregador, de
+ *      manera que un client web subscrit només a alguns carregadors rep tots els números de cadascun.
+ *      Els últims WEB_STATE_HISTORY canvis de cada carregador es guarden, i un client web que s'ha
+ *      perdut canvis d'un carregador pot demanar els posteriors a l'últim número que n'ha rebut. Si ja
+ *      no hi són, rep l'estat complet del carregador (stateSnapshot). L'estat complet només inclou els
+ *      carregadors als quals està subscrit el client.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <syslog.h>
+#include "ocpp_cs.h"
+#include "ws_server.h"
+#include "connectors.h"
+#include "web_hub.h"
+#include "web_state.h"
+#include "fleet_shm.h"
+
+// camps de l'estat d'un carregador
+enum state_field {
+    FIELD_GENERAL,
+    FIELD_VENDOR,
+    FIELD_MODEL,
+    FIELD_CONNECTORS,   // estat, idTag i transactionId de cada connector del carregador, en un array
+    NUM_FIELDS
+};
+
+// noms dels camps als missatges de la web
+static const char *field_names[NUM_FIELDS] = {
+    "general", "vendor", "model", "connectors"
+};
+
+// estat d'un carregador, cada camp ja en format JSON
+struct charger_state {
+    char value[NUM_FIELDS][WEB_STATE_VALUE_LEN];
+};
+
+extern ChargerVars charger_vars[];
+
+static pthread_mutex_t state_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t state_changed = PTHREAD_COND_INITIALIZER;
+static unsigned int dirty[MAX_CHARGERS + 1];        // parts marcades de cada carregador, la posició 0 és la flota
+static const char *connectors_type[MAX_CHARGERS + 1]; // tipus de l'últim missatge que ha canviat els connectors
+
+// l'estat enviat, els números de seqüència i l'historial només es toquen amb table_lock agafat
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct charger_state sent_state[MAX_CHARGERS + 1];
+static uint64_t state_seq[MAX_CHARGERS + 1];        // número de seqüència de l'últim canvi enviat de cada carregador
+static char history[MAX_CHARGERS + 1][WEB_STATE_HISTORY][WEB_STATE_DELTA_LEN]; // últims canvis enviats de cada carregador,
+                                                    // el canvi seq és a la posició seq % WEB_STATE_HISTORY
+
+// Prototips de les funcions
+static void *flush_thread(void *arg);
+static void read_state(const ChargerVars *vars, struct charger_state *state);
+static void flush_charger(const ChargerVars *vars, const char *type);
+static int format_fields(char *buf, size_t len, const struct charger_state *state, const struct charger_state *old);
+static void publish(int charger_id, const char *text);
+static void send_snapshot(ws_cli_conn_t client, uint32_t chargers);
+
+/*
+ *  NAME
+ *      web_state_init - Inicialitza l'estat dels carregadors per a la web
+ *  SYNOPSIS
+ *      void web_state_init(void);
+ *  DESCRIPTION
+ *      Llegeix l'estat inicial dels carregadors i crea el thread que envia els canvis a la web.
+ *      S'ha de cridar després d'inicialitzar charger_vars.
+ *  RETURN VALUE
+ *      Res.
+ */
+void web_state_init(void)
+{
+    pthread_t thread;
+
+    pthread_mutex_lock(&table_lock);
+    for (int i = 1; i <= MAX_CHARGERS; i++)
+        read_state(&charger_vars[i], &sent_state[i]);
+    pthread_mutex_unlock(&table_lock);
+
+    if (pthread_create(&thread, NULL, flush_thread, NULL) != 0) {
+        syslog(LOG_ERR, "%s: ERROR creating thread\n", __func__);
+        return;
+    }
+    pthread_detach(thread);
+}
+
+/*
+ *  NAME
+ *      web_state_mark - Marca que ha canviat l'estat d'un carregador
+ *  SYNOPSIS
+ *      void web_state_mark(const ChargerVars *vars, unsigned int parts, const char *type);
+ *  DESCRIPTION
+ *      Marca les parts (WEB_STATE_BOOT, WEB_STATE_CONNECTORS i WEB_STATE_FLEET) de l'estat del
+ *      carregador que han canviat. type és el missatge que ha canviat els connectors
+ *      ("statusNotification", "startTransaction" o "stopTransaction"), ha de ser una constant.
+ *      L'estat s'envia més tard, amb els valors que tingui en aquell moment. La instantània de
+ *      la memòria compartida (fleet_shm) en canvi s'actualitza de seguida.
+ *  RETURN VALUE
+ *      Res.
+ */
+void web_state_mark(const ChargerVars *vars, unsigned int parts, const char *type)
+{
+    if (vars->charger_id < 1 || vars->charger_id > MAX_CHARGERS)
+        return;
+
+    if (parts & (WEB_STATE_BOOT | WEB_STATE_CONNECTORS))
+        fleet_shm_update(vars);
+
+    pthread_mutex_lock(&state_lock);
+    dirty[vars->charger_id] |= parts & (WEB_STATE_BOOT | WEB_STATE_CONNECTORS);
+    if (parts & WEB_STATE_CONNECTORS)
+        connectors_type[vars->charger_id] = type;
+    if (parts & WEB_STATE_FLEET)
+        dirty[0] |= WEB_STATE_FLEET;
+    pthread_cond_signal(&state_changed);
+    pthread_mutex_unlock(&state_lock);
+}
+
+/*
+ *  NAME
+ *      web_state_snapshot - Envia l'estat complet dels carregadors a un client web
+ *  SYNOPSIS
+ *      void web_state_snapshot(ws_cli_conn_t client);
+ *  DESCRIPTION
+ *      Envia a client l'últim estat enviat dels carregadors als quals està subscrit (stateSnapshot),
+ *      amb el número de seqüència de l'últim canvi de cada carregador que inclou, i quants connectors
+ *      hi ha en cada estat.
+ *  RETURN VALUE
+ *      Res.
+ */
+void web_state_snapshot(ws_cli_conn_t client)
+{
+    char information[WEB_STATE_DELTA_LEN * (MAX_CHARGERS + 1)];
+
+    send_snapshot(client, web_hub_chargers(client));
+
+    // Envio a la web quants connectors hi ha en cada estat
+    connectors_fleet_json(information, sizeof(information));
+    web_hub_send(client, information);
+}
+
+/*
+ *  NAME
+ *      web_state_sync - Posa al dia un client web
+ *  SYNOPSIS
+ *      void web_state_sync(ws_cli_conn_t client, int charger_id, uint64_t seq);
+ *  DESCRIPTION
+ *      Envia a client els canvis del carregador charger_id posteriors al número de seqüència seq.
+ *      Si alguns d'aquests canvis ja no són a l'historial, li envia l'estat complet del carregador.
+ *      Si el client no està subscrit al carregador no li envia res.
+ *  RETURN VALUE
+ *      Res.
+ */
+void web_state_sync(ws_cli_conn_t client, int charger_id, uint64_t seq)
+{
+    if (charger_id < 1 || charger_id > MAX_CHARGERS || !(web_hub_chargers(client) & (1u << charger_id))) {
+        syslog(LOG_WARNING, "%s: el client no està subscrit al carregador %d\n", __func__, charger_id);
+        return;
+    }
+
+    pthread_mutex_lock(&table_lock);
+    uint64_t last = state_seq[charger_id];
+    if (seq > last || last - seq > WEB_STATE_HISTORY) { // el client no té un número vàlid o s'ha perdut massa canvis
+        pthread_mutex_unlock(&table_lock);
+        send_snapshot(client, 1u << charger_id);
+        return;
+    }
+
+    for (uint64_t s = seq + 1; s <= last; s++)
+        web_hub_send(client, history[charger_id][s % WEB_STATE_HISTORY]);
+    pthread_mutex_unlock(&table_lock);
+}
+
+/*
+ *  NAME
+ *      flush_thread - Envia els canvis de l'estat a la web
+ *  SYNOPSIS
+ *      static void *flush_thread(void *arg);
+ *  DESCRIPTION
+ *      Espera que es marqui algun canvi, envia els canvis de tots els carregadors marcats i
+ *      s'espera 1/WEB_STATE_RATE segons abans de tornar a enviar res. Els canvis que arriben
+ *      mentrestant s'envien tots junts a la següent passada.
+ *  RETURN VALUE
+ *      NULL.
+ */
+static void *flush_thread(void *arg)
+{
+    struct timespec tick = {0, 1000000000L / WEB_STATE_RATE};
+    unsigned int parts[MAX_CHARGERS + 1];
+    const char *types[MAX_CHARGERS + 1];
+    bool pending;
+
+    (void)arg;
+
+    while (1) {
+        pthread_mutex_lock(&state_lock);
+        do {
+            pending = false;
+            for (int i = 0; i <= MAX_CHARGERS; i++)
+                pending |= dirty[i] != 0;
+            if (!pending)
+                pthread_cond_wait(&state_changed, &state_lock);
+        } while (!pending);
+
+        // agafo les parts marcades i les desmarco, els canvis que arribin ara es marquen per a la següent passada
+        memcpy(parts, dirty, sizeof(parts));
+        memcpy(types, connectors_type, sizeof(types));
+        memset(dirty, 0, sizeof(dirty));
+        pthread_mutex_unlock(&state_lock);
+
+        for (int i = 1; i <= MAX_CHARGERS; i++) {
+            if (parts[i] != 0)
+                flush_charger(&charger_vars[i], (parts[i] & WEB_STATE_CONNECTORS) ? types[i] : NULL);
+        }
+
+        if (parts[0] & WEB_STATE_FLEET) { // Envio a la web quants connectors hi ha en cada estat
+            char information[1024];
+            connectors_fleet_json(information, sizeof(information));
+            publish(WEB_HUB_FLEET, information);
+        }
+
+        nanosleep(&tick, NULL);
+    }
+
+    return NULL;
+}
+
+/*
+ *  NAME
+ *      read_state - Llegeix l'estat actual d'un carregador
+ *  SYNOPSIS
+ *      static void read_state(const ChargerVars *vars, struct charger_state *state);
+ *  DESCRIPTION
+ *      Escriu a state l'estat actual del carregador, amb el mateix format que els missatges de la web.
+ *      Si el carregador no està connectat, l'estat general és 2 (no connectat). Els connectors són un array
+ *      amb l'estat, l'idTag i el transactionId de cadascun, tants com connectors_count().
+ *  RETURN VALUE
+ *      Res.
+ */
+static void read_state(const ChargerVars *vars, struct charger_state *state)
+{
+    snprintf(state->value[FIELD_GENERAL], WEB_STATE_VALUE_LEN, "%d", vars->client == (ws_cli_conn_t)-1 ? 2 : (int)vars->boot.status);
+    snprintf(state->value[FIELD_VENDOR], WEB_STATE_VALUE_LEN, "\"%s\"", vars->current_vendor);
+    snprintf(state->value[FIELD_MODEL], WEB_STATE_VALUE_LEN, "\"%s\"", vars->current_model);
+
+    // un objecte per cada connector, del 1 al nombre de connectors del carregador
+    char *connectors = state->value[FIELD_CONNECTORS];
+    int n = snprintf(connectors, WEB_STATE_VALUE_LEN, "[");
+    int num_connectors = connectors_count(vars);
+    for (int c = 1; c <= num_connectors && n < WEB_STATE_VALUE_LEN; c++)
+        n += snprintf(connectors + n, WEB_STATE_VALUE_LEN - n, "%s{\"status\": %ld, \"idTag\": \"%s\", \"transactionId\": %ld}",
+            c > 1 ? ", " : "", connector_status(vars, c), connector_id_tag(vars, c), connector_transaction(vars, c));
+    if (n < WEB_STATE_VALUE_LEN)
+        snprintf(connectors + n, WEB_STATE_VALUE_LEN - n, "]");
+}
+
+/*
+ *  NAME
+ *      flush_charger - Envia els canvis de l'estat d'un carregador a la web
+ *  SYNOPSIS
+ *      static void flush_charger(const ChargerVars *vars, const char *type);
+ *  DESCRIPTION
+ *      Compara l'estat actual del carregador amb l'últim enviat i, si algun camp ha canviat, envia
+ *      a la web un stateDelta amb els camps que han canviat i el guarda a l'historial.
+ *      type és el missatge que ha canviat els connectors, NULL si no n'hi ha cap.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void flush_charger(const ChargerVars *vars, const char *type)
+{
+    struct charger_state state;
+    char text[WEB_STATE_DELTA_LEN];
+    int n, fields;
+
+    read_state(vars, &state);
+
+    pthread_mutex_lock(&table_lock);
+
+    // Formo el missatge per enviar a la web
+    n = snprintf(text, sizeof(text), "{\"type\": \"stateDelta\", \"seq\": %lu, \"charger\": \"%d\", ",
+        state_seq[vars->charger_id] + 1, vars->charger_id);
+    if (type != NULL)
+        n += snprintf(text + n, sizeof(text) - n, "\"event\": \"%s\", ", type);
+    n += snprintf(text + n, sizeof(text) - n, "\"fields\": {");
+    fields = format_fields(text + n, sizeof(text) - n, &state, &sent_state[vars->charger_id]);
+    if (fields == 0) { // no ha canviat res des de l'últim missatge
+        pthread_mutex_unlock(&table_lock);
+        return;
+    }
+    snprintf(text + n + fields, sizeof(text) - n - fields, "}}");
+
+    // el guardo a l'historial (en substitució del més antic)
+    uint64_t seq = ++state_seq[vars->charger_id];
+    memcpy(history[vars->charger_id][seq % WEB_STATE_HISTORY], text, sizeof(text));
+    sent_state[vars->charger_id] = state;
+
+    // Envio el missatge a la web, amb table_lock agafat perquè els canvis arribin en ordre
+    publish(vars->charger_id, text);
+    pthread_mutex_unlock(&table_lock);
+}
+
+/*
+ *  NAME
+ *      format_fields - Escriu els camps de l'estat d'un carregador
+ *  SYNOPSIS
+ *      static int format_fields(char *buf, size_t len, const struct charger_state *state, const struct charger_state *old);
+ *  DESCRIPTION
+ *      Escriu a buf els camps de state en format JSON ("nom": valor, separats per comes). Si old no és NULL
+ *      només s'escriuen els camps que són diferents a old.
+ *  RETURN VALUE
+ *      Retorna el nombre de caràcters escrits (0 si no s'ha escrit cap camp).
+ */
+static int format_fields(char *buf, size_t len, const struct charger_state *state, const struct charger_state *old)
+{
+    int n = 0;
+
+    for (int i = 0; i < NUM_FIELDS && n < (int)len; i++) {
+        if (old != NULL && strcmp(state->value[i], old->value[i]) == 0)
+            continue;
+        n += snprintf(buf + n, len - n, "%s\"%s\": %s", n > 0 ? ", " : "", field_names[i], state->value[i]);
+    }
+
+    return n < (int)len ? n : (int)len - 1;
+}
+
+/*
+ *  NAME
+ *      publish - Envia un missatge a la web
+ *  SYNOPSIS
+ *      static void publish(int charger_id, const char *text);
+ *  DESCRIPTION
+ *      Passa el missatge al repartidor perquè l'enviï als clients web subscrits al carregador.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void publish(int charger_id, const char *text)
+{
+    web_hub_publish(charger_id, text);
+    syslog(LOG_INFO, "SENDING TO WEB: %s\n", text);
+}
+
+/*
+ *  NAME
+ *      send_snapshot - Envia l'estat complet d'alguns carregadors a un client web
+ *  SYNOPSIS
+ *      static void send_snapshot(ws_cli_conn_t client, uint32_t chargers);
+ *  DESCRIPTION
+ *      Envia a client un stateSnapshot amb l'últim estat enviat dels carregadors de la màscara
+ *      chargers i el número de seqüència de l'últim canvi de cadascun.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void send_snapshot(ws_cli_conn_t client, uint32_t chargers)
+{
+    char information[WEB_STATE_DELTA_LEN * (MAX_CHARGERS + 1)];
+    bool first = true;
+    int n;
+
+    pthread_mutex_lock(&table_lock);
+    n = snprintf(information, sizeof(information), "{\"type\": \"stateSnapshot\", \"chargers\": [");
+    for (int i = 1; i <= MAX_CHARGERS && n < (int)sizeof(information); i++) {
+        if (!(chargers & (1u << i)))
+            continue;
+        n += snprintf(information + n, sizeof(information) - n, "%s{\"charger\": \"%d\", \"seq\": %lu, ",
+            first ? "" : ", ", i, state_seq[i]);
+        if (n < (int)sizeof(information))
+            n += format_fields(information + n, sizeof(information) - n, &sent_state[i], NULL);
+        if (n < (int)sizeof(information))
+            n += snprintf(information + n, sizeof(information) - n, "}");
+        first = false;
+    }
+    if (n < (int)sizeof(information))
+        snprintf(information + n, sizeof(information) - n, "]}");
+    web_hub_send(client, information);
+    pthread_mutex_unlock(&table_lock);
+}
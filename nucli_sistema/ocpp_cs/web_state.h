@@ -0,0 +1,37 @@
+/*
+ *  FILE
+ *      web_state.h - header de web_state.c
+ *  PROJECT
+ *      TFG - Implementació d'un Sistema de Control per Punts de Càrrega de Vehicles Elèctrics.
+ *  DESCRIPTION
+ *      Header de l'agrupador d'actualitzacions de l'estat dels carregadors per a la web.
+ *  AUTHOR
+ *      Sergio Abate
+ *  OPERATING SYSTEM
+ *      Linux
+ */
+
+#ifndef _WEB_STATE_H_
+#define _WEB_STATE_H_
+
+#include <stdint.h>
+#include <ws.h>
+#include "ocpp_cs.h"
+
+#define WEB_STATE_RATE 4            // màxim d'actualitzacions per segon que s'envien a la web
+#define WEB_STATE_HISTORY 64        // canvis recents de cada carregador que es guarden per posar al dia els clients web
+#define WEB_STATE_DELTA_LEN 1280    // mida màxima del missatge d'un canvi
+#define WEB_STATE_CONNECTOR_LEN 96  // mida màxima d'un connector dins del camp connectors (ja en format JSON)
+#define WEB_STATE_VALUE_LEN (MAX_CONNECTORS * WEB_STATE_CONNECTOR_LEN + 2) // mida màxima del valor d'un camp de l'estat
+
+// parts de l'estat que han canviat
+#define WEB_STATE_BOOT 0x1          // estat general, vendor i model del carregador
+#define WEB_STATE_CONNECTORS 0x2    // estat, idTag i transactionId dels connectors del carregador
+#define WEB_STATE_FLEET 0x4         // connectors de tota la flota en cada estat
+
+void web_state_init(void);
+void web_state_mark(const ChargerVars *vars, unsigned int parts, const char *type);
+void web_state_snapshot(ws_cli_conn_t client);
+void web_state_sync(ws_cli_conn_t client, int charger_id, uint64_t seq);
+
+#endif
@@ -21,6 +21,25 @@
 #include <ws.h>
 #include "ws_server.h"
 #include "ocpp_cs.h"
+#include "auth_store.h"
+#include "bulk.h"
+#include "transaction_ids.h"
+#include "transaction_index.h"
+#include "session_ledger.h"
+#include "connectors.h"
+#include "config_store.h"
+#include "call_cache.h"
+#include "heartbeat_phase.h"
+#include "meter_ingest.h"
+#include "sample_control.h"
+#include "web_hub.h"
+#include "web_state.h"
+#include "control_socket.h"
+#include "fleet_shm.h"
+#include "history_query.h"
+#include "meter_codes.h"
+#include "meter_rollup.h"
+#include "RemoteStopTransactionReqJSON.h"
 #include "BootNotificationConfJSON.h"
 
 #define RESET   "\e[0m"
@@ -38,6 +57,9 @@ static void onclose(ws_cli_conn_t client);
 static void onmessage(ws_cli_conn_t client, const unsigned char *msg, uint64_t size, int type);
 static void select_request(ChargerVars *vars, const char *operation);
 static int get_charger_index(int charger_id);
+static ChargerVars *get_transaction_owner(const char *payload, ChargerVars *vars);
+static void fleet_query(ws_cli_conn_t client, char *query);
+static void subscribe_web(ws_cli_conn_t client, uint32_t chargers);
 
 /*
  *  NAME
@@ -66,12 +88,43 @@ int main(int argc, char* argv[])
         charger_vars[i].current_transaction_id = 0;
         charger_vars[i].current_unique_id = 0;
         charger_vars[i].charger_id = i;
-
-        for (int index = 1; index < (NUM_CONNECTORS + 1); index++) {
-            charger_vars[i].connectors_status[index] = CONN_UNKNOWN;
-        }
+        pthread_mutex_init(&charger_vars[i].request_lock, NULL);
     }
 
+    // Inicialitzo el magatzem de claus de configuració dels carregadors
+    config_init();
+
+    // Inicialitzo el magatzem central d'idTags
+    auth_store_init();
+
+    // Inicialitzo el generador de transactionIds
+    tx_id_init();
+
+    // Inicialitzo el registre de sessions de càrrega
+    session_ledger_init();
+
+    // Creo les taules dels codis dels MeterValues (i passo les taules antigues als codis)
+    meter_codes_init();
+
+    // Creo els índexs de les consultes a l'historial
+    history_init();
+
+    // Creo la taula dels agregats dels MeterValues
+    meter_rollup_init();
+
+    // Inicialitzo la cua d'entrada dels MeterValues i el control de l'interval de mostreig
+    meter_ingest_init();
+    sample_control_init();
+
+    // Inicialitzo l'enviament de l'estat dels carregadors a la web
+    web_state_init();
+
+    // Creo el socket de control per als clients web de la mateixa màquina
+    control_socket_init();
+
+    // Creo la instantània de l'estat de la flota en memòria compartida
+    fleet_shm_init();
+
     // crea un thread per cada connexió, aquest s'encarrega de rebre les peticions del carregador i els missatges de la web
     ws_socket(&(struct ws_server){
         .host = "localhost",
@@ -125,6 +178,11 @@ static void onopen(ws_cli_conn_t client)
  */
 static void onclose(ws_cli_conn_t client)
 {
+    if (web_hub_unsubscribe(client)) { // era un client web
+        syslog(LOG_NOTICE, "Client web desconnectat\n");
+        return;
+    }
+
     int index = get_charger_index(client);
     if (index != -1) {
         syslog(LOG_DEBUG, "%s: index = %d\n", __func__, index);
@@ -135,29 +193,11 @@ static void onclose(ws_cli_conn_t client)
         charger_vars[index].client = -1;
         snprintf(charger_vars[index].current_vendor, 20, "%s", "");
         snprintf(charger_vars[index].current_model, 20, "%s", "");
+        connectors_free(&charger_vars[index]); // allibero els slots dels connectors
+        heartbeat_phase_unregister(&charger_vars[index]); // la resta de carregadors es reparteixen l'interval de Heartbeat
 
-        for (int i = 1; i <= MAX_CHARGERS; i++) {
-            // Formo el missatge per enviar a la web l'estat dels carregadors
-            char information[1024];
-            snprintf(information, sizeof(information), "{\"charger\": \"%d\", \"type\": \"stopTransaction\", \"connector1\": 9,"
-                " \"connector2\": 9, \"idTag1\": \"%s\", \"idTag2\": \"%s\", \"transactionId1\": %ld, \"transactionId2\": %ld}",
-                charger_vars[index].charger_id, charger_vars->current_id_tags[1], charger_vars->current_id_tags[2],
-                charger_vars->transaction_list[1], charger_vars->transaction_list[2]);
-
-            // Envio el missatge a la web
-            ws_send("WEB", information, charger_vars[0].client);
-
-            // Formo el missatge per enviar a la web
-            char information_2[1024];
-            snprintf(information_2, sizeof(information_2), "{\"charger\": \"%d\", \"type\": \"bootNotification\", \"general\": 2, \"vendor\": \"\", "
-                "\"model\": \"\"}", charger_vars[index].charger_id);
-
-            // Envio el missatge a la web
-            ws_send("WEB", information_2, charger_vars[0].client);
-
-            memset(information, 0, 1024);
-            memset(information_2, 0, 1024);
-        }
+        // Marco l'estat del carregador i el de la flota per enviar-los a la web
+        web_state_mark(&charger_vars[index], WEB_STATE_BOOT | WEB_STATE_CONNECTORS | WEB_STATE_FLEET, "stopTransaction");
     }
     else
         syslog(LOG_WARNING, "%s: Warning: no s'ha trobat el carregador\n", __func__);
@@ -170,69 +210,96 @@ static void onclose(ws_cli_conn_t client)
  *      void onmessage(ws_cli_conn_t client, const unsigned char *msg, uint64_t size, int type);
  *  DESCRIPTION
  *      Rep els missatges del carregador i els envia al fitxer del sistema de control per gestionar-los.
+ *      Els missatges dels clients web es gestionen amb web_on_receive().
  *  RETURN VALUE
  *      Res.
  */
 static void onmessage(ws_cli_conn_t client, const unsigned char *msg, uint64_t size, int type)
 {
-    if (strcmp((char *)msg, "Flask client") == 0) { // missatge d'inicialització del servidor web
-        syslog(LOG_NOTICE, "Flask connectat\n");
-
-        int index = get_charger_index(client); // busco el index del client web
-        charger_vars[0].client = client; // assigno el client web al charger_vars[0]
-        if (index != -1)
-            charger_vars[index].client = -1; // resetejo aquest charger_vars per a que si pugui connectar un carregador després
-
-        // Formo el missatge per enviar a la web l'estat dels carregadors
-        char information[1024];
-        for (int i = 1; i <= MAX_CHARGERS; i++) {
-            snprintf(information, sizeof(information), "{\"charger\": \"%d\", \"type\": \"stopTransaction\", \"connector1\": %ld,"
-                " \"connector2\": %ld, \"idTag1\": \"no_charging\", \"idTag2\": \"no_charging\", \"transactionId1\": -1, \"transactionId2\": -1}",
-                charger_vars[i].charger_id, charger_vars[i].connectors_status[1], charger_vars[i].connectors_status[2]);
+    if (web_on_receive(client, (const char *)msg, size))
+        return;
 
-            // Envio el missatge a la web
-            ws_send("WEB", information, charger_vars[0].client);
+    int index = get_charger_index(client); // missatge d'un carregador, busca quin carregador és
+    if (index != -1) {
+        char *cli;
+        cli = ws_getaddress(client);
+        syslog(LOG_INFO, "%sRECEIVED MESSAGE: %s (%lu), from: %s%s\n", BLUE, msg,
+            size, cli, RESET);
 
-            // Formo el missatge per enviar a la web
-            char information_2[1024];
-            snprintf(information_2, sizeof(information_2), "{\"charger\": \"%d\", \"type\": \"bootNotification\", \"general\": %d, \"vendor\": \"%s\", "
-                "\"model\": \"%s\"}", charger_vars[i].charger_id, charger_vars[i].boot.status, charger_vars[i].current_vendor, charger_vars[i].current_model);
+        fleet_shm_seen(&charger_vars[index]);
+        system_on_receive((char *) msg, &charger_vars[index]);
+    }
+    else
+        syslog(LOG_ERR, "%s: Error: no s'ha trobat el carregador\n", __func__);
+}
 
-            // Envio el missatge a la web
-            ws_send("WEB", information, charger_vars[0].client);
+/*
+ *  NAME
+ *      web_on_receive - Gestiona els missatges dels clients web.
+ *  SYNOPSIS
+ *      bool web_on_receive(ws_cli_conn_t client, const char *msg, size_t size);
+ *  DESCRIPTION
+ *      Gestiona el missatge msg (acabat en '\0') d'un client web, ja sigui connectat pel servidor
+ *      WebSocket o pel socket de control: subscripcions ("Flask client", "Web client[:<carregadors>]"),
+ *      consultes a l'historial, ordres JSON i peticions "Flask:...".
+ *  RETURN VALUE
+ *      Retorna true si msg és un missatge d'un client web.
+ *      Retorna false en cas contrari.
+ */
+bool web_on_receive(ws_cli_conn_t client, const char *msg, size_t size)
+{
+    if (strcmp(msg, "Flask client") == 0) { // missatge d'inicialització del servidor web
+        syslog(LOG_NOTICE, "Flask connectat\n");
+        subscribe_web(client, WEB_HUB_ALL_CHARGERS);
+    }
+    else if (strncmp(msg, "Web client", 10) == 0 && (msg[10] == '\0' || msg[10] == ':')) { // altres clients web: Web client[:<carregadors>]
+        syslog(LOG_NOTICE, "Client web connectat: %s\n", msg);
+        subscribe_web(client, web_hub_parse_chargers(msg[10] == ':' ? msg + 11 : NULL));
+    }
+    else if (msg[0] == '{') { // ordre JSON d'un client web: consulta a l'historial o ordre als carregadors
+        syslog(LOG_INFO, "%sRECEIVED COMMAND: %s (%lu)%s\n", BLUE, msg, size, RESET);
+        if (!history_query(client, msg, size))
+            bulk_command(client, msg, size);
+    }
+    else if (strncmp(msg, "Flask:", 6) == 0) { // un usuari vol enviar una petició
+        syslog(LOG_INFO, "%sRECEIVED MESSAGE: %s (%lu)%s\n", BLUE, msg, size, RESET);
 
-            // netejo els continguts
-            memset(information, 0, 1024);
-            memset(information_2, 0, 1024);
+        char *message = strndup(msg + 6, size - 6); // còpia per poder-la partir amb strtok_r
+        if (message == NULL) {
+            syslog(LOG_ERR, "%s: ERROR allocating memory\n", __func__);
+            return true;
         }
-    }
-    else {
-        char message[1024];
-        snprintf(message, sizeof(message), "%s", msg);
         char *rest = message;
 
-        if (strcmp(strtok_r(rest, ":", &rest), "Flask") == 0) { // un usuari vol enviar una petició
-            syslog(LOG_INFO, "%sRECEIVED MESSAGE: %s (%lu), from: %s\n", BLUE, msg, size, RESET);
-
-            char *rest2 = rest;
-            char *charger = strtok_r(rest2, ":", &rest2);
-            char num_charger = charger[7];
-            select_request(&charger_vars[num_charger - '0'], rest2);
+        char *charger = strtok_r(rest, ":", &rest);
+        if (charger != NULL && strcmp(charger, "bulk") == 0) { // operació massiva: Flask:bulk:<acció>:<feina>
+            char *action = strtok_r(rest, ":", &rest);
+            bulk_start(client, action, rest);
         }
-        else { // missatge d'un carregador
-            int index = get_charger_index(client); // busca quin carregador és
-            if (index != -1) {
-                char *cli;
-                cli = ws_getaddress(client);
-                syslog(LOG_INFO, "%sRECEIVED MESSAGE: %s (%lu), from: %s%s\n", BLUE, msg,
-                    size, cli, RESET);
-
-                system_on_receive((char *) msg, &charger_vars[index]);
-            }
+        else if (charger != NULL && strcmp(charger, "fleet") == 0) { // consulta de l'estat de la flota: Flask:fleet:<consulta>
+            fleet_query(client, rest);
+        }
+        else if (charger != NULL && strcmp(charger, "sync") == 0) { // canvis d'un carregador posteriors a un número de seqüència: Flask:sync:<carregador>:<seq>
+            char *sync_charger = strtok_r(rest, ":", &rest);
+            if (sync_charger != NULL && rest != NULL)
+                web_state_sync(client, atoi(sync_charger), strtoull(rest, NULL, 10));
+            else
+                syslog(LOG_WARNING, "%s: sync incomplet\n", __func__);
+        }
+        else if (charger != NULL && strncmp(charger, "charger", 7) == 0) { // petició a un carregador: Flask:charger<N>:<acció>:<payload>
+            int num_charger = atoi(charger + 7);
+            if (num_charger >= 1 && num_charger <= MAX_CHARGERS)
+                select_request(&charger_vars[num_charger], rest);
             else
-                syslog(LOG_ERR, "%s: Error: no s'ha trobat el carregador\n", __func__);
+                syslog(LOG_WARNING, "%s: el carregador %s no existeix\n", __func__, charger);
         }
+
+        free(message);
     }
+    else
+        return false;
+
+    return true;
 }
 
 /*
@@ -243,6 +310,8 @@ static void onmessage(ws_cli_conn_t client, const unsigned char *msg, uint64_t s
  *  DESCRIPTION
  *      Envia els missatges al carregador o al servidor web. Segons el tipus
  *      de missatge a enviar, s'imprimeix d'un color diferent al terminal.
+ *      Els missatges per a la web es passen al repartidor (web_hub), que els envia als
+ *      clients web subscrits al carregador de client.
  *  RETURN VALUE
  *      Res.
  */
@@ -255,13 +324,22 @@ void ws_send(const char *option, char *text, ws_cli_conn_t client)
     else if (strcmp(option, "CALL RESULT") == 0) {
         ws_sendframe_txt(client, text);
         syslog(LOG_INFO, "%sSENDING CONFIRMATION: %s%s\n\n", YELLOW, text, RESET);
+        call_cache_store(client, text); // es guarda per si el carregador torna a enviar la mateixa petició
     }
     else if (strcmp(option, "CALL ERROR") == 0) {
         ws_sendframe_txt(client, text);
         syslog(LOG_INFO, "%sSENDING ERROR: %s%s\n", RED, text, RESET);
     }
     else if (strcmp(option, "WEB") == 0) {
-        ws_sendframe_txt(charger_vars[0].client, text);
+        // el missatge és del carregador de client, o de tota la flota si client no és cap carregador
+        int charger_id = WEB_HUB_FLEET;
+        for (int i = 1; i <= MAX_CHARGERS; i++) {
+            if (client != (ws_cli_conn_t)-1 && charger_vars[i].client == client) {
+                charger_id = charger_vars[i].charger_id;
+                break;
+            }
+        }
+        web_hub_publish(charger_id, text);
         syslog(LOG_INFO, "%sSENDING TO WEB: %s%s\n", GREEN, text, RESET);
     }
 }
@@ -279,49 +357,76 @@ void ws_send(const char *option, char *text, ws_cli_conn_t client)
  */
 static void select_request(ChargerVars *vars, const char *operation)
 {
-    char message[1024];
-    memset(message, 0, 1024); // netejo el buffer
-    snprintf(message, sizeof(message), "%s", operation);
+    char *message = strdup(operation);
+    if (message == NULL) {
+        syslog(LOG_ERR, "%s: ERROR allocating memory\n", __func__);
+        return;
+    }
 
     // s'analitza el missatge del servidor web per saber quina operació s'ha d'enviar
-    char *action = strtok(message, ":");
-    syslog(LOG_DEBUG, "action: %s\n", action);
-    if (strcmp(action, "changeAvailability") == 0) {
-        char *request = strtok(0, "");
+    // (strtok_r perquè els threads del socket de control hi poden entrar alhora)
+    char *saveptr = NULL;
+    char *action = strtok_r(message, ":", &saveptr);
+    syslog(LOG_DEBUG, "action: %s\n", action != NULL ? action : "");
+    if (action == NULL)
+        syslog(LOG_DEBUG, "buit\n");
+    else if (strcmp(action, "changeAvailability") == 0) {
+        char *request = strtok_r(NULL, "", &saveptr);
         send_request('1', request, vars);
     }
     else if (strcmp(action, "clearCache") == 0) {
-        char *request = strtok(0, "");
+        char *request = strtok_r(NULL, "", &saveptr);
         send_request('2', request, vars);
     }
     else if (strcmp(action, "dataTransfer") == 0) {
-        char *request = strtok(0, "");
+        char *request = strtok_r(NULL, "", &saveptr);
         send_request('3', request, vars);
     }
     else if (strcmp(action, "getConfiguration") == 0) {
-        char *request = strtok(0, "");
+        char *request = strtok_r(NULL, "", &saveptr);
         send_request('4', request, vars);
     }
     else if (strcmp(action, "remoteStartTransaction") == 0) {
-        char *request = strtok(0, "");
+        char *request = strtok_r(NULL, "", &saveptr);
         send_request('5', request, vars);
     }
     else if (strcmp(action, "remoteStopTransaction") == 0) {
-        char *request = strtok(0, "");
-        send_request('6', request, vars);
+        char *request = strtok_r(NULL, "", &saveptr);
+        send_request('6', request, get_transaction_owner(request, vars)); // l'envio al carregador que té la transacció
     }
     else if (strcmp(action, "reset") == 0) {
-        char *request = strtok(0, "");
+        char *request = strtok_r(NULL, "", &saveptr);
         send_request('7', request, vars);
     }
     else if (strcmp(action, "unlockConnector") == 0) {
-        char *request = strtok(0, "");
+        char *request = strtok_r(NULL, "", &saveptr);
         send_request('8', request, vars);
     }
+    else if (strcmp(action, "sendLocalList") == 0) {
+        char *request = strtok_r(NULL, "", &saveptr);
+        send_request('9', request, vars);
+    }
+    else if (strcmp(action, "getLocalListVersion") == 0) {
+        char *request = strtok_r(NULL, "", &saveptr);
+        send_request('A', request, vars);
+    }
+    else if (strcmp(action, "changeConfiguration") == 0) {
+        char *request = strtok_r(NULL, "", &saveptr);
+        send_request('B', request, vars);
+    }
+    else if (strcmp(action, "triggerMessage") == 0) {
+        char *request = strtok_r(NULL, "", &saveptr);
+        send_request('C', request, vars);
+    }
+    else if (strcmp(action, "updateIdTag") == 0) { // modifica el magatzem central d'idTags, no s'envia res al carregador
+        char *request = strtok_r(NULL, "", &saveptr);
+        int64_t version = auth_store_apply(request);
+        syslog(LOG_DEBUG, "updateIdTag: list version %ld\n", version);
+    }
     else
         syslog(LOG_DEBUG, "desconegut\n");
 
-    memset(message, 0, 1024); // netejo el buffer
+    free(message);
 }
 
 
@@ -357,3 +462,129 @@ static int get_charger_index(int client)
 
     return -1; // no hi ha posicions lliures
 }
+
+/*
+ *  NAME
+ *      get_transaction_owner - Retorna el carregador que té una transacció
+ *  SYNOPSIS
+ *      static ChargerVars *get_transaction_owner(const char *payload, ChargerVars *vars);
+ *  DESCRIPTION
+ *      Busca el transactionId del payload d'un RemoteStopTransaction a l'índex global de transaccions.
+ *  RETURN VALUE
+ *      Retorna el carregador que té la transacció si està connectat.
+ *      En cas contrari, retorna vars.
+ */
+static ChargerVars *get_transaction_owner(const char *payload, ChargerVars *vars)
+{
+    if (payload == NULL)
+        return vars;
+
+    struct RemoteStopTransactionReq *request = cJSON_ParseRemoteStopTransactionReq(payload);
+    if (request == NULL)
+        return vars;
+
+    struct tx_info tx;
+    if (tx_index_lookup(request->transaction_id, &tx) && tx.charger >= 1 && tx.charger <= MAX_CHARGERS &&
+        charger_vars[tx.charger].client != -1) {
+
+        if (&charger_vars[tx.charger] != vars)
+            syslog(LOG_DEBUG, "%s: transactionId %ld del carregador %d", __func__, request->transaction_id, tx.charger);
+        vars = &charger_vars[tx.charger];
+    }
+
+    free(request);
+
+    return vars;
+}
+
+/*
+ *  NAME
+ *      fleet_query - Respon una consulta de la web sobre l'estat de la flota
+ *  SYNOPSIS
+ *      static void fleet_query(ws_cli_conn_t client, char *query);
+ *  DESCRIPTION
+ *      Respon al client web client les consultes sobre els connectors de tots els carregadors:
+ *          status                                  -> quants connectors hi ha en cada estat
+ *          nearest:<estat>:<carregador>:<connector> -> connector més proper en l'estat <estat> (CONN_<>)
+ *          ingest                                  -> profunditat i temps de buidat de la cua de MeterValues
+ *          sampling[:<mínim>:<màxim>]              -> límits i valor actual del MeterValueSampleInterval
+ *  RETURN VALUE
+ *      Res.
+ */
+static void fleet_query(ws_cli_conn_t client, char *query)
+{
+    char information[512];
+    char *rest = query;
+    char *type = strtok_r(rest, ":", &rest);
+
+    if (type != NULL && strcmp(type, "status") == 0) {
+        connectors_fleet_json(information, sizeof(information));
+    }
+    else if (type != NULL && strcmp(type, "nearest") == 0) {
+        char *status = strtok_r(rest, ":", &rest);
+        char *charger = strtok_r(rest, ":", &rest);
+        char *connector = strtok_r(rest, ":", &rest);
+        int found_charger = -1, found_connector = -1;
+
+        if (status == NULL || charger == NULL || connector == NULL) {
+            syslog(LOG_WARNING, "%s: consulta incompleta", __func__);
+            return;
+        }
+
+        int index = atoi(charger);
+        if (index < 1 || index > MAX_CHARGERS)
+            index = 0; // sense carregador de referència
+
+        connectors_find_nearest(atoi(status), &charger_vars[index], atoi(connector), &found_charger, &found_connector);
+
+        snprintf(information, sizeof(information), "{\"type\": \"fleetNearest\", \"status\": %d, \"fromCharger\": %d, "
+            "\"fromConnector\": %d, \"charger\": %d, \"connector\": %d}", atoi(status), index, atoi(connector),
+            found_charger, found_connector);
+    }
+    else if (type != NULL && strcmp(type, "ingest") == 0) {
+        meter_ingest_stats_json(information, sizeof(information));
+    }
+    else if (type != NULL && strcmp(type, "sampling") == 0) {
+        char *min_interval = strtok_r(rest, ":", &rest);
+        char *max_interval = strtok_r(rest, ":", &rest);
+
+        if (min_interval != NULL && max_interval != NULL &&
+            !sample_control_set_bounds(atoi(min_interval), atoi(max_interval)))
+            syslog(LOG_WARNING, "%s: límits no vàlids", __func__);
+
+        sample_control_json(information, sizeof(information));
+    }
+    else {
+        syslog(LOG_WARNING, "%s: consulta desconeguda", __func__);
+        return;
+    }
+
+    // Envio la resposta només al client que ha fet la consulta
+    web_hub_send(client, information);
+}
+
+/*
+ *  NAME
+ *      subscribe_web - Subscriu un client web
+ *  SYNOPSIS
+ *      static void subscribe_web(ws_cli_conn_t client, uint32_t chargers);
+ *  DESCRIPTION
+ *      Allibera la posició de carregador que s'havia assignat al client en obrir la connexió,
+ *      el subscriu als carregadors de la màscara chargers i li envia l'estat dels carregadors.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void subscribe_web(ws_cli_conn_t client, uint32_t chargers)
+{
+    int index = get_charger_index(client); // busco el index del client web
+    if (index != -1) {
+        charger_vars[index].client = -1; // resetejo aquest charger_vars per a que si pugui connectar un carregador després
+        connectors_free(&charger_vars[index]);
+    }
+
+    if (!web_hub_subscribe(client, chargers))
+        return;
+
+    // Envio a la web l'estat complet dels carregadors
+    web_state_snapshot(client);
+}
@@ -11,6 +11,8 @@
  *      Linux
  */
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <ws.h>
 
 #ifndef _SERVER_H_
@@ -20,5 +22,6 @@
 #define MAX_CHARGERS 4
 
 void ws_send(const char *option, char *text, ws_cli_conn_t client);
+bool web_on_receive(ws_cli_conn_t client, const char *msg, size_t size);
 
 #endif
@@ -22,6 +22,9 @@
 #include "ws_server.h"
 #include "error_messages.h"
 #include "utils.h"
+#include "boot_admission.h"
+#include "heartbeat_phase.h"
+#include "web_state.h"
 
 /*
  *  NAME
@@ -31,7 +34,8 @@
  *  DESCRIPTION
  *      Controla els possibles errors en la petició i envia el respectiu error en cas que hi hagi.
  *      Si no hi ha errors, es gestiona la petició (es modifiquen les variables globals del
- *      sistema de control que calguin), i s'envia la resposta.
+ *      sistema de control que calguin), i s'envia la resposta. El carregador s'accepta si hi ha
+ *      lloc segons el control d'admissió (boot_admission.c); si no, es respon Pending.
  *  RETURN VALUE
  *      Res.
  */
@@ -114,10 +118,18 @@ void proc_boot_notification(struct header_st *header, char *payload, ChargerVars
         }
         */
 
-        // Interval de Hearbeat i Status
-        boot_conf.interval = HEARTBEAT_INTERVAL;
-        boot_conf.status = STATUS_BOOT_ACCEPTED;
-        vars->boot.status = STATUS_BOOT_ACCEPTED; // actualitzo el status global del carregador
+        // Interval de Hearbeat i Status: si arriben massa BootNotification alhora (per exemple, quan es reinicia
+        // el sistema de control) es respon Pending amb l'interval en què el carregador ho ha de tornar a provar
+        int retry_interval;
+        if (vars->boot.status == STATUS_BOOT_ACCEPTED || boot_admission_take(&retry_interval)) {
+            boot_conf.interval = heartbeat_phase_register(vars); // el carregador passa a tenir una fase per enviar els Heartbeat
+            boot_conf.status = STATUS_BOOT_ACCEPTED;
+        }
+        else {
+            boot_conf.interval = retry_interval;
+            boot_conf.status = STATUS_BOOT_PENDING;
+        }
+        vars->boot.status = boot_conf.status; // actualitzo el status global del carregador
 
         // Formo el missatge
         char message[256];
@@ -134,13 +146,8 @@ void proc_boot_notification(struct header_st *header, char *payload, ChargerVars
         free(boot_conf.current_time);
     }
 
-    // Formo el missatge per enviar a la web
-    char information[1024];
-    snprintf(information, sizeof(information), "{\"charger\": \"%d\", \"type\": \"bootNotification\", \"general\": %d, \"vendor\": \"%s\", "
-        "\"model\": \"%s\"}", vars->charger_id, vars->boot.status, vars->current_vendor, vars->current_model);
-
-    // Envio el missatge a la web
-    ws_send("WEB", information, vars->client);
+    // Marco l'estat general del carregador per enviar-lo a la web
+    web_state_mark(vars, WEB_STATE_BOOT, NULL);
 
     // Allibero la memòria
     free(boot_req_payload);
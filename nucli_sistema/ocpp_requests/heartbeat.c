@@ -22,6 +22,7 @@
 #include "ws_server.h"
 #include "error_messages.h"
 #include "utils.h"
+#include "heartbeat_phase.h"
 
 /*
  *  NAME
@@ -65,6 +66,9 @@ void proc_heartbeat(struct header_st *header, char *payload, ChargerVars *vars)
 
         // Envio el missatge al carregador
         ws_send("CALL RESULT", message, vars->client);
+
+        // Si el Heartbeat no ha arribat a la fase del carregador, es corregeix l'interval
+        heartbeat_phase_check(vars);
     }
 
     // Allibero la memria
@@ -17,7 +17,6 @@
 #include <list.h>
 #include <time.h>
 #include <syslog.h>
-#include <sqlite3.h>
 #include "meter_values.h"
 #include "MeterValuesReqJSON.h"
 #include "MeterValuesConfJSON.h"
@@ -25,6 +24,10 @@
 #include "ws_server.h"
 #include "error_messages.h"
 #include "utils.h"
+#include "session_ledger.h"
+#include "meter_codes.h"
+#include "epoch_time.h"
+#include "meter_ingest.h"
 
 /*
  *  NAME
@@ -95,6 +98,9 @@ void proc_meter_values(struct header_st *header, char *payload, ChargerVars *var
             }
 
             char *hora = meter_value->timestamp; // variable que he de posar a la base de dades
+            int64_t ts = epoch_ms_parse(hora); // la mateixa hora en UTC, per ordenar i filtrar l'historial
+            if (ts < 0)
+                ts = epoch_ms_now(); // l'hora és correcta però massa llarga per llegir-ne les fraccions
 
             if (meter_value->sampled_value && list_get_count(meter_value->sampled_value)) {
                 size_t count = list_get_count(meter_value->sampled_value);
@@ -128,198 +134,20 @@ void proc_meter_values(struct header_st *header, char *payload, ChargerVars *var
                         send_property_constraint_violation(header->unique_id, vars->client);
                         return;
                     }
-                    // guardo les variables que he de posar a la base de dades
-                    char *valor = sampled_value->value;
-                    char unit[16];
-                    char measurand[32];
-                    char context[32];
-                    if (sampled_value->unit) {
-                        switch (*sampled_value->unit) {
-                            case 0:
-                                snprintf(unit, sizeof(unit), "%s", "A");
-                                break;
-                            case 1:
-                                snprintf(unit, sizeof(unit), "%s", "Celcius");
-                                break;
-                            case 2:
-                                snprintf(unit, sizeof(unit), "%s", "Celsius");
-                                break;
-                            case 3:
-                                snprintf(unit, sizeof(unit), "%s", "Fahrenheit");
-                                break;
-                            case 4:
-                                snprintf(unit, sizeof(unit), "%s", "K");
-                                break;
-                            case 5:
-                                snprintf(unit, sizeof(unit), "%s", "kvar");
-                                break;
-                            case 6:
-                                snprintf(unit, sizeof(unit), "%s", "kvarh");
-                                break;
-                            case 7:
-                                snprintf(unit, sizeof(unit), "%s", "kVa");
-                                break;
-                            case 8:
-                                snprintf(unit, sizeof(unit), "%s", "kW");
-                                break;
-                            case 9:
-                                snprintf(unit, sizeof(unit), "%s", "kwH");
-                                break;
-                            case 10:
-                                snprintf(unit, sizeof(unit), "%s", "Percent");
-                                break;
-                            case 11:
-                                snprintf(unit, sizeof(unit), "%s", "V");
-                                break;
-                            case 12:
-                                snprintf(unit, sizeof(unit), "%s", "VA");
-                                break;
-                            case 13:
-                                snprintf(unit, sizeof(unit), "%s", "var");
-                                break;
-                            case 14:
-                                snprintf(unit, sizeof(unit), "%s", "varh");
-                                break;
-                            case 15:
-                                snprintf(unit, sizeof(unit), "%s", "W");
-                                break;
-                            case 16:
-                                snprintf(unit, sizeof(unit), "%s", "Wh");
-                                break;
-                            default:
-                                snprintf(unit, sizeof(unit), "%s", "");
-                                break;
-                        }
-                    }
-
-                    if (sampled_value->measurand) {
-                        switch (*sampled_value->measurand) {
-                            case 0:
-                                snprintf(measurand, sizeof(measurand), "%s", "Current.Export");
-                                break;
-                            case 1:
-                                snprintf(measurand, sizeof(measurand), "%s", "Current.Import");
-                                break;
-                            case 2:
-                                snprintf(measurand, sizeof(measurand), "%s", "Current.Offered");
-                                break;
-                            case 3:
-                                snprintf(measurand, sizeof(measurand), "%s", "Energy.Active.Export.Interval");
-                                break;
-                            case 4:
-                                snprintf(measurand, sizeof(measurand), "%s", "Energy.Active.Export.Register");
-                                break;
-                            case 5:
-                                snprintf(measurand, sizeof(measurand), "%s", "Energy.Active.Import.Interval");
-                                break;
-                            case 6:
-                                snprintf(measurand, sizeof(measurand), "%s", "Energy.Active.Import.Register");
-                                break;
-                            case 7:
-                                snprintf(measurand, sizeof(measurand), "%s", "Energy.Reactive.Export.Interval");
-                                break;
-                            case 8:
-                                snprintf(measurand, sizeof(measurand), "%s", "Energy.Reactive.Export.Register");
-                                break;
-                            case 9:
-                                snprintf(measurand, sizeof(measurand), "%s", "Energy.Reactive.Import.Interval");
-                                break;
-                            case 10:
-                                snprintf(measurand, sizeof(measurand), "%s", "Energy.Reactive.Import.Register");
-                                break;
-                            case 11:
-                                snprintf(measurand, sizeof(measurand), "%s", "Frequency");
-                                break;
-                            case 12:
-                                snprintf(measurand, sizeof(measurand), "%s", "Power.Active.Export");
-                                break;
-                            case 13:
-                                snprintf(measurand, sizeof(measurand), "%s", "Power.Active.Import");
-                                break;
-                            case 14:
-                                snprintf(measurand, sizeof(measurand), "%s", "Power.Factor");
-                                break;
-                            case 15:
-                                snprintf(measurand, sizeof(measurand), "%s", "Power.Offered");
-                                break;
-                            case 16:
-                                snprintf(measurand, sizeof(measurand), "%s", "Power.Reactive.Export");
-                                break;
-                            case 17:
-                                snprintf(measurand, sizeof(measurand), "%s", "Power.Reactive.Import");
-                                break;
-                            case 18:
-                                snprintf(measurand, sizeof(measurand), "%s", "RPM");
-                                break;
-                            case 19:
-                                snprintf(measurand, sizeof(measurand), "%s", "SoC");
-                                break;
-                            case 20:
-                                snprintf(measurand, sizeof(measurand), "%s", "Temperature");
-                                break;
-                            case 21:
-                                snprintf(measurand, sizeof(measurand), "%s", "Voltage");
-                                break;
-                            default:
-                                snprintf(measurand, sizeof(measurand), "%s", "");
-                                break;
-                        }
-                    }
 
-                    if (sampled_value->context) {
-                        switch (*sampled_value->context) {
-                            case 0:
-                                snprintf(context, sizeof(context), "%s", "Interruption.Begin");
-                                break;
-                            case 1:
-                                snprintf(context, sizeof(context), "%s", "Interruption.End");
-                                break;
-                            case 2:
-                                snprintf(context, sizeof(context), "%s", "Other");
-                                break;
-                            case 3:
-                                snprintf(context, sizeof(context), "%s", "Sample.Clock");
-                                break;
-                            case 4:
-                                snprintf(context, sizeof(context), "%s", "Sample.Periodic");
-                                break;
-                            case 5:
-                                snprintf(context, sizeof(context), "%s", "Transaction.Begin");
-                                break;
-                            case 6:
-                                snprintf(context, sizeof(context), "%s", "Transaction.End");
-                                break;
-                            case 7:
-                                snprintf(context, sizeof(context), "%s", "Trigger");
-                                break;
-                            default:
-                                snprintf(context, sizeof(context), "%s", "");
-                                break;
-                        }
-                    }
-
-                    // guardo la informacó a la base de dades
-                    sqlite3 *db;
-                    int rc;
-                    char *errmsg;
+                    // passo el valor a número i a les unitats canòniques, i el measurand, les unitats i el context a codis
+                    struct meter_sample sample;
+                    meter_sample_parse(&sample, sampled_value);
 
-                    rc = sqlite3_open(DATABASE_PATH, &db);
-                    if (rc != SQLITE_OK) {
-                        syslog(LOG_ERR, "%s: ERROR opening SQLite DB in memory: %s\n", __func__, sqlite3_errmsg(db));
-                    }
+                    // actualitzo l'energia de la sessió (el measurand per defecte és Energy.Active.Import.Register)
+                    if (meter_values_req->transaction_id && sample.text == NULL &&
+                        sample.measurand == MEASURAND_ENERGY_ACTIVE_IMPORT_REGISTER && sample.unit == UNIT_WH) {
 
-                    char query[500];
-                    snprintf(query, sizeof(query), "INSERT INTO meter_values(charger_id, connector, transaccio, hora, "
-                        "valor, unit, measurand, context) VALUES(%d, %ld, %ld, '%s', '%s', '%s', "
-                        "'%s', '%s');", vars->charger_id, connector, transaccio, hora, valor, unit, measurand, context);
-                    rc = sqlite3_exec(db, query, 0, 0, &errmsg);
-                    if (rc != SQLITE_OK) {
-                        sqlite3_free(errmsg);
-                    } else {
-                        syslog(LOG_ERR, "%s: SQL statement executed successfully", __func__);
+                        session_ledger_sample(transaccio, sample.valor, timegm(&timestamp_st));
                     }
 
-                    sqlite3_close(db);  // tanca la base de dades correctament
+                    // poso la informació a la cua per guardar-la a la base de dades (es respon sense esperar-la)
+                    meter_ingest_push(vars->charger_id, connector, transaccio, hora, ts, &sample);
                 }
             }
             else { // Error: ProtocolError
@@ -23,6 +23,10 @@
 #include "ws_server.h"
 #include "error_messages.h"
 #include "utils.h"
+#include "transaction_ids.h"
+#include "transaction_index.h"
+#include "connectors.h"
+#include "web_state.h"
 
 /*
  *  NAME
@@ -66,7 +70,7 @@ void proc_start_transaction(struct header_st *header, char *payload, ChargerVars
         send_type_constraint_violation(header->unique_id, vars->client);
     }
     else if ((start_transaction_req->reservation_id && *start_transaction_req->reservation_id == -1) ||
-              start_transaction_req->connector_id > NUM_CONNECTORS ||
+              start_transaction_req->connector_id > connectors_count(vars) ||
               start_transaction_req->connector_id == 0 ||
               ocpp_strptime(start_transaction_req->timestamp, "%Y-%m-%dT%H:%M:%S%z", &timestamp_st, 19) == NULL) { // Error: PropertyConstraintViolation
 
@@ -79,33 +83,36 @@ void proc_start_transaction(struct header_st *header, char *payload, ChargerVars
         struct StartTransactionConf start_transaction_conf;
         struct IdTagInfo_Start info;
 
+        // Obtinc un transactionId únic per a tot el sistema
+        vars->current_transaction_id = tx_id_next();
+
         // Comprovo si el idTag es el del authorize i si es troba a la auth_list
         if (check_id_tag(start_transaction_req->id_tag) &&
             (strcasecmp(start_transaction_req->id_tag, vars->current_id_tag)) == 0) { // idTag vàlid
 
             // comprovo si el connector ja està amb una transacció activa
-            if (vars->transaction_list[start_transaction_req->connector_id] != -1 ||
+            if (connector_transaction(vars, start_transaction_req->connector_id) != -1 ||
                 check_concurrent_tx_id_tag(start_transaction_req->id_tag, vars)) { // connector ja amb una transacció activa -> ConcurrentTx
                 // Afegeixo l'idTagInfo
                 info.status = STATUS_START_CONCURRENT_TX;
                 info.expiry_date = NULL;
                 info.parent_id_tag = NULL;
                 start_transaction_conf.id_tag_info = &info;
-                start_transaction_conf.transaction_id = ++vars->current_transaction_id;
+                start_transaction_conf.transaction_id = vars->current_transaction_id;
                 syslog(LOG_WARNING, "%s: concurrentTx", __func__);
             }
-            else if (vars->connectors_status[0] == CONN_UNAVAILABLE ||
-                vars->connectors_status[start_transaction_req->connector_id] == CONN_FAULTED ||
-                vars->connectors_status[start_transaction_req->connector_id] == CONN_SUSPENDED_EV ||
-                vars->connectors_status[start_transaction_req->connector_id] == CONN_SUSPENDED_EVSE ||
-                vars->connectors_status[start_transaction_req->connector_id] == CONN_UNAVAILABLE) {
+            else if (connector_status(vars, 0) == CONN_UNAVAILABLE ||
+                connector_status(vars, start_transaction_req->connector_id) == CONN_FAULTED ||
+                connector_status(vars, start_transaction_req->connector_id) == CONN_SUSPENDED_EV ||
+                connector_status(vars, start_transaction_req->connector_id) == CONN_SUSPENDED_EVSE ||
+                connector_status(vars, start_transaction_req->connector_id) == CONN_UNAVAILABLE) {
 
                 // Afegeixo l'idTagInfo
                 info.status = STATUS_START_INVALID;
                 info.expiry_date = NULL;
                 info.parent_id_tag = NULL;
                 start_transaction_conf.id_tag_info = &info;
-                start_transaction_conf.transaction_id = ++vars->current_transaction_id;
+                start_transaction_conf.transaction_id = vars->current_transaction_id;
                 syslog(LOG_WARNING, "%s: connector no disponible", __func__);
             }
             else { // connector vàlid per carregar -> Accepted
@@ -114,9 +121,11 @@ void proc_start_transaction(struct header_st *header, char *payload, ChargerVars
                 info.expiry_date = NULL;
                 info.parent_id_tag = NULL;
                 start_transaction_conf.id_tag_info = &info;
-                start_transaction_conf.transaction_id = ++vars->current_transaction_id;
-                snprintf(vars->current_id_tags[start_transaction_req->connector_id], ID_TAG_LEN, "%s", start_transaction_req->id_tag); // Guardo el idTag a la respectiva posicio
-                                                                                                  // del connector a current_id_tags per quan es pari la transacció
+                start_transaction_conf.transaction_id = vars->current_transaction_id;
+                connector_set_id_tag(vars, start_transaction_req->connector_id, start_transaction_req->id_tag); // Guardo el idTag al connector
+                                                                                                // per quan es pari la transacció
+                tx_index_add(vars->current_transaction_id, vars->charger_id, start_transaction_req->connector_id,
+                    start_transaction_req->id_tag, start_transaction_req->meter_start, time(NULL)); // l'afegeixo a l'índex global de transaccions
                 syslog(LOG_DEBUG, "%s: Accepted", __func__);
             }
         }
@@ -126,7 +135,7 @@ void proc_start_transaction(struct header_st *header, char *payload, ChargerVars
             info.expiry_date = NULL;
             info.parent_id_tag = NULL;
             start_transaction_conf.id_tag_info = &info;
-            start_transaction_conf.transaction_id = ++vars->current_transaction_id;
+            start_transaction_conf.transaction_id = vars->current_transaction_id;
             syslog(LOG_WARNING, "%s: idTag no vàlid", __func__);
         }
 
@@ -139,15 +148,8 @@ void proc_start_transaction(struct header_st *header, char *payload, ChargerVars
         ws_send("CALL RESULT", message, vars->client);
     }
 
-    // Formo el missatge per enviar a la web
-    char information[1024];
-    snprintf(information, sizeof(information), "{\"charger\": \"%d\", \"type\": \"startTransaction\", \"connector1\": %ld, \"connector2\": %ld, \"idTag1\": \"%s\", "
-        "\"idTag2\": \"%s\", \"transactionId1\": %ld, \"transactionId2\": %ld}", vars->charger_id, vars->connectors_status[1],
-        vars->connectors_status[2] , vars->current_id_tags[1], vars->current_id_tags[2],
-        vars->transaction_list[1], vars->transaction_list[2]);
-
-    // Envio el missatge a la web
-    ws_send("WEB", information, vars->client);
+    // Marco l'estat dels connectors per enviar-lo a la web
+    web_state_mark(vars, WEB_STATE_CONNECTORS, "startTransaction");
 
     // Allibero la memòria
     free(start_transaction_req);
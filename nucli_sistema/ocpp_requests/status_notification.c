@@ -13,6 +13,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdbool.h>
 #include <string.h>
 #include <list.h>
 #include <time.h>
@@ -25,6 +26,14 @@
 #include "ws_server.h"
 #include "error_messages.h"
 #include "utils.h"
+#include "transaction_index.h"
+#include "connectors.h"
+#include "status_transitions.h"
+#include "web_state.h"
+#include "epoch_time.h"
+
+// Prototips de les funcions
+static void store_status(struct StatusNotificationReq *status_req, int64_t prev_status, ChargerVars *vars);
 
 /*
  *  NAME
@@ -35,6 +44,8 @@
  *      Controla els possibles errors en la petició i envia el respectiu error en cas que hi hagi.
  *      Si no hi ha errors, es gestiona la petició (es modifiquen les variables globals del
  *      sistema de control que calguin), i s'envia la resposta.
+ *      Si l'estat i l'errorCode del connector no canvien només s'envia la resposta: no es guarda
+ *      res a la base de dades ni s'envia res a la web.
  *  RETURN VALUE
  *      Res.
  */
@@ -42,6 +53,7 @@ void proc_status_notification(struct header_st *header, char *payload, ChargerVa
 {
     // Passo el string a struct JSON
     struct StatusNotificationReq *status_req = cJSON_ParseStatusNotificationReq(payload);
+    bool changed = false; // indica si l'estat del connector ha canviat
 
     // Comprovo errors abans d'enviar la resposta
     if (status_req == NULL) { // Error: FormationViolation
@@ -60,7 +72,7 @@ void proc_status_notification(struct header_st *header, char *payload, ChargerVa
 
         send_type_constraint_violation(header->unique_id, vars->client);
     }
-    else if (status_req->connector_id > NUM_CONNECTORS ||
+    else if (status_req->connector_id > MAX_CONNECTORS ||
             (status_req->vendor_error_code && strcmp(status_req->vendor_error_code, "") == 0) ||
             (status_req->info && strcmp(status_req->info, "") == 0) ||
             (status_req->timestamp && strcmp(status_req->timestamp, "") == 0) ||
@@ -75,120 +87,164 @@ void proc_status_notification(struct header_st *header, char *payload, ChargerVa
         send_occurrence_constraint_violation(header->unique_id, vars->client);
     }
     else { // No errors
-        vars->connectors_status[status_req->connector_id] = status_req->status;
-
-        // miro el error code per guardar-lo a la base de dades
-        char error[32];
-        switch (status_req->error_code) {
-            case 0:
-                snprintf(error, sizeof(error), "%s", "ConnectorLockFailure");
-                break;
-            case 1:
-                snprintf(error, sizeof(error), "%s", "EVCommunicationError");
-                break;
-            case 2:
-                snprintf(error, sizeof(error), "%s", "GroundFailure");
-                break;
-            case 3:
-                snprintf(error, sizeof(error), "%s", "HighTemperature");
-                break;
-            case 4:
-                snprintf(error, sizeof(error), "%s", "InternalError");
-                break;
-            case 5:
-                snprintf(error, sizeof(error), "%s", "LocalListConflict");
-                break;
-            case 6:
-                snprintf(error, sizeof(error), "%s", "NoError");
-                break;
-            case 7:
-                snprintf(error, sizeof(error), "%s", "OtherError");
-                break;
-            case 8:
-                snprintf(error, sizeof(error), "%s", "OverCurrentFailure");
-                break;
-            case 9:
-                snprintf(error, sizeof(error), "%s", "OverVoltage");
-                break;
-            case 10:
-                snprintf(error, sizeof(error), "%s", "PowerMeterFailure");
-                break;
-            case 11:
-                snprintf(error, sizeof(error), "%s", "PowerSwitchFailure");
-                break;
-            case 12:
-                snprintf(error, sizeof(error), "%s", "ReaderFailure");
-                break;
-            case 13:
-                snprintf(error, sizeof(error), "%s", "ResetFailure");
-                break;
-            case 14:
-                snprintf(error, sizeof(error), "%s", "UnderVoltage");
-                break;
-            case 15:
-                snprintf(error, sizeof(error), "%s", "WeakSignal");
-                break;
-            default:
-                snprintf(error, sizeof(error), "%s", "");
-                break;
-        }
+        if (status_req->connector_id > connectors_count(vars)) // el carregador té més connectors dels que es sabien
+            connectors_alloc(vars, status_req->connector_id);
 
-        // miro l'estat per guardar-lo a la base de dades
-        char estat[32];
-        switch (status_req->status) {
-            case 0:
-                snprintf(estat, sizeof(estat), "%s", "Available");
-                break;
-            case 1:
-                snprintf(estat, sizeof(estat), "%s", "Charging");
-                break;
-            case 2:
-                snprintf(estat, sizeof(estat), "%s", "Faulted");
-                break;
-            case 3:
-                snprintf(estat, sizeof(estat), "%s", "Finishing");
-                break;
-            case 4:
-                snprintf(estat, sizeof(estat), "%s", "Preparing");
-                break;
-            case 5:
-                snprintf(estat, sizeof(estat), "%s", "Reserved");
-                break;
-            case 6:
-                snprintf(estat, sizeof(estat), "%s", "SuspendedEV");
-                break;
-            case 7:
-                snprintf(estat, sizeof(estat), "%s", "SuspendedEVSE");
-                break;
-            case 8:
-                snprintf(estat, sizeof(estat), "%s", "Unavailable");
-                break;
-            default:
-                snprintf(estat, sizeof(estat), "%s", "");
-                break;
-        }
+        // miro quin canvi d'estat és abans d'actualitzar-lo
+        int64_t prev_status = connector_status(vars, status_req->connector_id);
+        enum status_transition transition = status_transition_check(status_req->connector_id, prev_status,
+            connector_error_code(vars, status_req->connector_id), status_req->status, status_req->error_code);
+        if (transition == TRANSITION_INVALID)
+            syslog(LOG_WARNING, "%s: transició no vàlida al carregador %d, connector %ld: %s -> %s", __func__,
+                vars->charger_id, status_req->connector_id, status_transition_name(prev_status),
+                status_transition_name(status_req->status));
+
+        connector_set_status(vars, status_req->connector_id, status_req->status);
+        connector_set_error_code(vars, status_req->connector_id, status_req->error_code);
+        changed = transition != TRANSITION_NOOP;
+
+        if (changed)
+            store_status(status_req, prev_status, vars);
+
+        // Formo el missatge
+        char message[256];
+        snprintf(message, sizeof(message), "[3,%s,{}]", header->unique_id);
 
-        // guardo l'hora actual per posar-la a la base de dades
-        time_t t = time(NULL);
-        struct tm *currentTime = localtime(&t);
-        char *hora = malloc(64);
-        snprintf(hora, 64, "\%04d-%02d-%02dT%02d:%02d:%02dZ",
-        currentTime->tm_year + 1900, currentTime->tm_mon + 1, currentTime->tm_mday,
-        currentTime->tm_hour, currentTime->tm_min, currentTime->tm_sec);
+        // Envio el missatge al carregador
+        ws_send("CALL RESULT", message, vars->client);
+    }
 
-        // guardo l'estat a la base de dades
-        sqlite3 *db;
-        int rc;
-        char *errmsg;
+    // Marco l'estat dels connectors i el de la flota per enviar-los a la web (si el connector no ha canviat no cal)
+    if (changed)
+        web_state_mark(vars, WEB_STATE_CONNECTORS | WEB_STATE_FLEET, "statusNotification");
 
+    // Allibero la memòria
+    free(status_req);
+}
+
+/*
+ *  NAME
+ *      store_status - Guarda un canvi d'estat d'un connector
+ *  SYNOPSIS
+ *      static void store_status(struct StatusNotificationReq *status_req, int64_t prev_status, ChargerVars *vars);
+ *  DESCRIPTION
+ *      Guarda el nou estat del connector a la taula estats i actualitza l'idTag i la transacció del
+ *      connector segons l'estat. prev_status és l'estat que tenia el connector abans del StatusNotification.
+ *  RETURN VALUE
+ *      Res.
+ */
+static void store_status(struct StatusNotificationReq *status_req, int64_t prev_status, ChargerVars *vars)
+{
+    // miro el error code per guardar-lo a la base de dades
+    char error[32];
+    switch (status_req->error_code) {
+        case 0:
+            snprintf(error, sizeof(error), "%s", "ConnectorLockFailure");
+            break;
+        case 1:
+            snprintf(error, sizeof(error), "%s", "EVCommunicationError");
+            break;
+        case 2:
+            snprintf(error, sizeof(error), "%s", "GroundFailure");
+            break;
+        case 3:
+            snprintf(error, sizeof(error), "%s", "HighTemperature");
+            break;
+        case 4:
+            snprintf(error, sizeof(error), "%s", "InternalError");
+            break;
+        case 5:
+            snprintf(error, sizeof(error), "%s", "LocalListConflict");
+            break;
+        case 6:
+            snprintf(error, sizeof(error), "%s", "NoError");
+            break;
+        case 7:
+            snprintf(error, sizeof(error), "%s", "OtherError");
+            break;
+        case 8:
+            snprintf(error, sizeof(error), "%s", "OverCurrentFailure");
+            break;
+        case 9:
+            snprintf(error, sizeof(error), "%s", "OverVoltage");
+            break;
+        case 10:
+            snprintf(error, sizeof(error), "%s", "PowerMeterFailure");
+            break;
+        case 11:
+            snprintf(error, sizeof(error), "%s", "PowerSwitchFailure");
+            break;
+        case 12:
+            snprintf(error, sizeof(error), "%s", "ReaderFailure");
+            break;
+        case 13:
+            snprintf(error, sizeof(error), "%s", "ResetFailure");
+            break;
+        case 14:
+            snprintf(error, sizeof(error), "%s", "UnderVoltage");
+            break;
+        case 15:
+            snprintf(error, sizeof(error), "%s", "WeakSignal");
+            break;
+        default:
+            snprintf(error, sizeof(error), "%s", "");
+            break;
+    }
+
+    // miro l'estat per guardar-lo a la base de dades
+    char estat[32];
+    switch (status_req->status) {
+        case 0:
+            snprintf(estat, sizeof(estat), "%s", "Available");
+            break;
+        case 1:
+            snprintf(estat, sizeof(estat), "%s", "Charging");
+            break;
+        case 2:
+            snprintf(estat, sizeof(estat), "%s", "Faulted");
+            break;
+        case 3:
+            snprintf(estat, sizeof(estat), "%s", "Finishing");
+            break;
+        case 4:
+            snprintf(estat, sizeof(estat), "%s", "Preparing");
+            break;
+        case 5:
+            snprintf(estat, sizeof(estat), "%s", "Reserved");
+            break;
+        case 6:
+            snprintf(estat, sizeof(estat), "%s", "SuspendedEV");
+            break;
+        case 7:
+            snprintf(estat, sizeof(estat), "%s", "SuspendedEVSE");
+            break;
+        case 8:
+            snprintf(estat, sizeof(estat), "%s", "Unavailable");
+            break;
+        default:
+            snprintf(estat, sizeof(estat), "%s", "");
+            break;
+    }
+
+    // guardo l'hora actual per posar-la a la base de dades (en mil·lisegons des de l'epoch i en text, en UTC)
+    int64_t ts = epoch_ms_now();
+    char hora[EPOCH_TIME_LEN];
+    epoch_ms_format(ts, hora, sizeof(hora));
+
+    // guardo l'estat a la base de dades (si el carregador s'acaba de connectar i ja estava guardat, no cal)
+    sqlite3 *db;
+    int rc;
+    char *errmsg;
+    char query[500];
+
+    if (prev_status != CONN_UNKNOWN || !status_last_stored(vars->charger_id, status_req->connector_id, estat, error)) {
         rc = sqlite3_open(DATABASE_PATH, &db);
         if (rc != SQLITE_OK) {
             syslog(LOG_ERR, "%s: ERROR opening SQLite DB in memory: %s\n", __func__, sqlite3_errmsg(db));
         }
 
-        char query[500];
-        snprintf(query, sizeof(query), "INSERT INTO estats(charger_id, connector, estat, hora, error_code)"
-            "VALUES(%d, %ld, '%s', '%s', '%s');", vars->charger_id, status_req->connector_id, estat, hora, error);
+        snprintf(query, sizeof(query), "INSERT INTO estats(charger_id, connector, estat, hora, error_code, ts)"
+            "VALUES(%d, %ld, '%s', '%s', '%s', %ld);", vars->charger_id, status_req->connector_id, estat, hora, error, ts);
         rc = sqlite3_exec(db, query, 0, 0, &errmsg);
         if (rc != SQLITE_OK) {
             fprintf(stderr, "SQL error: %s\n", errmsg);
@@ -198,53 +254,37 @@ void proc_status_notification(struct header_st *header, char *payload, ChargerVa
         }
 
         sqlite3_close(db);  // tanca la base de dades correctament
+    }
 
-        if (status_req->status == STATUS_STATUS_AVAILABLE) {
-            snprintf(vars->current_id_tags[status_req->connector_id], ID_TAG_LEN, "no_charging"); // actualitzo la current_id_tags
-            vars->transaction_list[status_req->connector_id] = -1;
+    if (status_req->status == STATUS_STATUS_AVAILABLE) {
+        connector_set_id_tag(vars, status_req->connector_id, "no_charging"); // actualitzo l'idTag del connector
+        connector_set_transaction(vars, status_req->connector_id, -1);
+    }
+    else if (status_req->status == STATUS_STATUS_CHARGING) {
+        // Si el connector ja té una transacció (p. ex. torna de SuspendedEV) es manté. Si no, és la de l'últim
+        // StartTransaction, sempre que no sigui d'un altre connector
+        if (connector_transaction(vars, status_req->connector_id) == -1 &&
+            connector_find_transaction(vars, vars->current_transaction_id) == -1) {
+            connector_set_transaction(vars, status_req->connector_id, vars->current_transaction_id); // Guardo el transactionId al connector
+            tx_index_bind_connector(vars->current_transaction_id, vars->charger_id, status_req->connector_id);
         }
-        else if (status_req->status == STATUS_STATUS_CHARGING) {
-            vars->transaction_list[status_req->connector_id] = vars->current_transaction_id; // Guardo el transactionId a la respectiva posicio
-                                                                                             // del connector a transaction_list
-
-            rc = sqlite3_open(DATABASE_PATH, &db);
-            if (rc != SQLITE_OK) {
-                syslog(LOG_ERR, "%s: ERROR opening SQLite DB in memory: %s\n", __func__, sqlite3_errmsg(db));
-            }
-
-            memset(query, 0, sizeof(query));
-            snprintf(query, sizeof(query), "INSERT INTO transaccions(charger_id, estat, connector, hora, motiu)"
-                "VALUES(%d, 'Start', %ld, '%s', '%s');", vars->charger_id, status_req->connector_id, hora, "");
-            rc = sqlite3_exec(db, query, 0, 0, &errmsg);
-            if (rc != SQLITE_OK) {
-                fprintf(stderr, "SQL error: %s\n", errmsg);
-                sqlite3_free(errmsg);
-            } else {
-                syslog(LOG_DEBUG, "%s: SQL statement executed successfully", __func__);
-            }
-
-            sqlite3_close(db); // tanca la base de dades correctament
+
+        rc = sqlite3_open(DATABASE_PATH, &db);
+        if (rc != SQLITE_OK) {
+            syslog(LOG_ERR, "%s: ERROR opening SQLite DB in memory: %s\n", __func__, sqlite3_errmsg(db));
         }
 
-        // Formo el missatge
-        char message[256];
-        snprintf(message, sizeof(message), "[3,%s,{}]", header->unique_id);
+        memset(query, 0, sizeof(query));
+        snprintf(query, sizeof(query), "INSERT INTO transaccions(charger_id, estat, connector, hora, motiu, ts)"
+            "VALUES(%d, 'Start', %ld, '%s', '%s', %ld);", vars->charger_id, status_req->connector_id, hora, "", ts);
+        rc = sqlite3_exec(db, query, 0, 0, &errmsg);
+        if (rc != SQLITE_OK) {
+            fprintf(stderr, "SQL error: %s\n", errmsg);
+            sqlite3_free(errmsg);
+        } else {
+            syslog(LOG_DEBUG, "%s: SQL statement executed successfully", __func__);
+        }
 
-        // Envio el missatge al carregador
-        ws_send("CALL RESULT", message, vars->client);
-        free(hora);
+        sqlite3_close(db); // tanca la base de dades correctament
     }
-
-    // Formo el missatge per enviar a la web
-    char information[1024];
-    snprintf(information, sizeof(information), "{\"charger\": \"%d\", \"type\": \"statusNotification\", \"connector1\": %ld, \"connector2\": %ld, \"idTag1\": \"%s\", "
-        "\"idTag2\": \"%s\", \"transactionId1\": %ld, \"transactionId2\": %ld}", vars->charger_id, vars->connectors_status[1],
-        vars->connectors_status[2] , vars->current_id_tags[1], vars->current_id_tags[2],
-        vars->transaction_list[1], vars->transaction_list[2]);
-
-    // Envio el missatge a la web
-    ws_send("WEB", information, vars->client);
-
-    // Allibero la memòria
-    free(status_req);
 }
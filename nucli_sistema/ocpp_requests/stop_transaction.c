@@ -25,6 +25,11 @@
 #include "ws_server.h"
 #include "error_messages.h"
 #include "utils.h"
+#include "transaction_index.h"
+#include "session_ledger.h"
+#include "connectors.h"
+#include "web_state.h"
+#include "epoch_time.h"
 
 /*
  *  NAME
@@ -159,15 +164,18 @@ void proc_stop_transaction(struct header_st *header, char *payload, ChargerVars
     int connector = -1; // aqui posar el connector d'aquesta transaccci
 
     // busco el connector d'aquesta transacci
-    for (int i = 0; i <= NUM_CONNECTORS; i++) {
-        if (stop_transaction_req->id_tag && (strcasecmp(stop_transaction_req->id_tag, vars->current_id_tags[i]) == 0))
-            connector = i;
-    }
-
-    // busco el si el transactionId s correcte
-    for (int i = 0; i <= NUM_CONNECTORS; i++) {
-        if (stop_transaction_req->transaction_id == vars->transaction_list[i])
-            connector = i;
+    if (stop_transaction_req->id_tag)
+        connector = connector_find_id_tag(vars, stop_transaction_req->id_tag);
+
+    // busco el transactionId a l'ndex global de transaccions
+    struct tx_info tx;
+    bool indexed = tx_index_lookup(stop_transaction_req->transaction_id, &tx) && tx.charger == vars->charger_id;
+    if (indexed)
+        connector = tx.connector;
+    else { // no hi s (p.ex. desprs d'un reinici) -> la busco als connectors
+        int found = connector_find_transaction(vars, stop_transaction_req->transaction_id);
+        if (found != -1)
+            connector = found;
     }
 
     if (connector < 0) // el transactionId no s correcte
@@ -176,7 +184,7 @@ void proc_stop_transaction(struct header_st *header, char *payload, ChargerVars
     // Comprovo si hi ha idTag
     if (stop_transaction_req->id_tag) { // hi ha idTag
         if (check_id_tag(stop_transaction_req->id_tag)) { // idTag a la auth list
-            if (connector > 0 && (strcasecmp(stop_transaction_req->id_tag, vars->current_id_tags[connector]) == 0) &&
+            if (connector > 0 && (strcasecmp(stop_transaction_req->id_tag, connector_id_tag(vars, connector)) == 0) &&
                 (strcasecmp(stop_transaction_req->id_tag, vars->current_id_tag) == 0)) { // idTag vlid
                 info.status = STATUS_STOP_ACCEPTED;
                 info.expiry_date = NULL;
@@ -221,8 +229,8 @@ void proc_stop_transaction(struct header_st *header, char *payload, ChargerVars
     }
 
     if (connector > 0) { // noms en aquest cas guardo a la base de dades per evitar errors
-        snprintf(vars->current_id_tags[connector], ID_TAG_LEN, "no_charging"); // actualitzo la current_id_tags
-        vars->transaction_list[connector] = -1;
+        connector_set_id_tag(vars, connector, "no_charging"); // actualitzo l'idTag del connector
+        connector_set_transaction(vars, connector, -1);
 
         char motiu[32];
         if (stop_transaction_req->reason) {
@@ -268,13 +276,10 @@ void proc_stop_transaction(struct header_st *header, char *payload, ChargerVars
         else
             snprintf(motiu, sizeof(motiu), "%s", "");
 
-        // guardo l'hora actual per posar-la a la base de dades
-        time_t t = time(NULL);
-        struct tm *currentTime = localtime(&t);
-        char *hora = malloc(64);
-        snprintf(hora, 64, "\%04d-%02d-%02dT%02d:%02d:%02dZ",
-        currentTime->tm_year + 1900, currentTime->tm_mon + 1, currentTime->tm_mday,
-        currentTime->tm_hour, currentTime->tm_min, currentTime->tm_sec);
+        // guardo l'hora actual per posar-la a la base de dades (en millisegons des de l'epoch i en text, en UTC)
+        int64_t ts = epoch_ms_now();
+        char hora[EPOCH_TIME_LEN];
+        epoch_ms_format(ts, hora, sizeof(hora));
 
         // guardo la informac a la base de dades
         sqlite3 *db;
@@ -287,8 +292,8 @@ void proc_stop_transaction(struct header_st *header, char *payload, ChargerVars
         }
 
         char query[500];
-        snprintf(query, sizeof(query), "INSERT INTO transaccions(charger_id, estat, connector, hora, motiu)"
-            "VALUES(%d, 'Stop', '%d', '%s', '%s');", vars->charger_id, connector, hora, motiu);
+        snprintf(query, sizeof(query), "INSERT INTO transaccions(charger_id, estat, connector, hora, motiu, ts)"
+            "VALUES(%d, 'Stop', '%d', '%s', '%s', %ld);", vars->charger_id, connector, hora, motiu, ts);
         rc = sqlite3_exec(db, query, 0, 0, &errmsg);
         if (rc != SQLITE_OK) {
             fprintf(stderr, "SQL error: %s\n", errmsg);
@@ -298,22 +303,19 @@ void proc_stop_transaction(struct header_st *header, char *payload, ChargerVars
         }
 
         sqlite3_close(db); // tanca la base de dades correctament
-        free(hora);
-    }
 
-    // Esborro el transactionId de la transaction_list
-    if (stop_transaction_req->transaction_id <= NUM_CONNECTORS)
-        delete_transaction_id(stop_transaction_req->transaction_id, vars);
+        // tanco la sessi i l'esborro de l'ndex global de transaccions
+        if (indexed && tx_index_remove(stop_transaction_req->transaction_id, &tx))
+            session_ledger_close(&tx, stop_transaction_req->meter_stop, motiu);
+    }
 
-    // Formo el missatge per enviar a la web
-    char information[1024];
-    snprintf(information, sizeof(information), "{\"charger\": \"%d\", \"type\": \"stopTransaction\", \"connector1\": %ld, \"connector2\": %ld, \"idTag1\": \"%s\", "
-        "\"idTag2\": \"%s\", \"transactionId1\": %ld, \"transactionId2\": %ld}", vars->charger_id, vars->connectors_status[1],
-        vars->connectors_status[2] , vars->current_id_tags[1], vars->current_id_tags[2],
-        vars->transaction_list[1], vars->transaction_list[2]);
+    // Esborro el transactionId dels connectors i de l'ndex global de transaccions
+    delete_transaction_id(stop_transaction_req->transaction_id, vars);
+    if (indexed)
+        tx_index_remove(stop_transaction_req->transaction_id, NULL);
 
-    // Envio el missatge a la web
-    ws_send("WEB", information, vars->client);
+    // Marco l'estat dels connectors per enviar-lo a la web
+    web_state_mark(vars, WEB_STATE_CONNECTORS, "stopTransaction");
 
     // Allibero la memria
     free(stop_transaction_req);
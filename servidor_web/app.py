@@ -5,8 +5,11 @@ import flask
 import flask_login
 import json
 import hashlib
+import os
+import socket
 import sqlite3
 import threading
+import uuid
 import websocket
 import ssl
 from flask_socketio import SocketIO, emit
@@ -19,6 +22,7 @@ socketio = SocketIO(app,cors_allowed_origins=["https://ocpp-cs.duckdns.org", "ht
 ws_c = None
 
 DATABASE = 'base_dades/base_dades.db'
+CONTROL_SOCKET = 'ocpp_cs.sock' # socket de control local del nucli (CONTROL_SOCKET_PATH), si s'executa a la mateixa màquina
 
 login_manager = flask_login.LoginManager()
 login_manager.init_app(app)
@@ -28,6 +32,33 @@ login_manager.login_view = 'login'
 last_boot_notification_messsage_by_charger = {}
 last_message_by_charger = {}
 
+# estat dels carregadors, es forma amb l'estat complet (stateSnapshot) i els canvis (stateDelta) que envia el nucli
+estat_carregadors = {}
+ultim_seq = {} # número de seqüència de l'últim canvi aplicat de cada carregador, no hi és fins que arriba el seu estat complet
+CAMPS_GENERALS = ("general", "vendor", "model")
+
+# consultes a l'historial enviades al nucli que esperen la resposta, per id
+consultes_pendents = {}
+TEMPS_CONSULTA = 5 # segons que s'espera la resposta d'una consulta
+FILTRES_CONSULTA = {"charger": int, "connector": int, "measurand": str, "from": str, "to": str, "limit": int, "cursor": str,
+                    "resolution": int}
+
+class ControlSocket:
+    """
+    Connexió amb el nucli pel socket de control local (AF_UNIX, SOCK_SEQPACKET). Cada missatge
+    del socket és un missatge sencer, igual que un missatge del WebSocket.
+    """
+    def __init__(self, path):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+        self.sock.connect(path)
+        self.connected = True
+
+    def send(self, text):
+        self.sock.send(text.encode())
+
+    def recv(self):
+        return self.sock.recv(65536).decode() # mida màxima d'un missatge (CONTROL_MSG_LEN)
+
 class User(flask_login.UserMixin):
     """
     Classe genèrica User pels logins/logouts.
@@ -127,40 +158,113 @@ def logout():
 
     return flask.redirect("/login")
 
+def nucli_connectat():
+    """
+    Indica si hi ha connexió amb el nucli del sistema de control.
+    """
+    if isinstance(ws_c, ControlSocket):
+        return ws_c.connected
+    return bool(ws_c and ws_c.sock and ws_c.sock.connected)
+
+def consultar_historial(taula):
+    """
+    Envia al nucli una consulta a la taula de l'historial amb els filtres de la petició (carregador,
+    connector, mesurand, interval d'hores, files i cursor de la pàgina) i n'espera la resposta.
+    Retorna una pàgina de files i el cursor de la següent ("next", null si és l'última).
+    """
+    consulta = {"query": taula, "id": uuid.uuid4().hex}
+    for filtre, tipus in FILTRES_CONSULTA.items():
+        valor = flask.request.args.get(filtre)
+        if valor:
+            try:
+                consulta[filtre] = tipus(valor)
+            except ValueError:
+                return flask.jsonify({"error": "TypeConstraintViolation"}), 400
+
+    if not nucli_connectat():
+        return flask.jsonify({"error": "El sistema en C no està connectat"}), 503
+
+    resposta = {"fet": threading.Event()}
+    consultes_pendents[consulta["id"]] = resposta
+    try:
+        ws_c.send(json.dumps(consulta))
+        if not resposta["fet"].wait(TEMPS_CONSULTA):
+            return flask.jsonify({"error": "El sistema en C no ha respost"}), 504
+    finally:
+        del consultes_pendents[consulta["id"]]
+
+    dades = resposta["dades"]
+    if dades["type"] == "queryError":
+        return flask.jsonify({"error": dades["error"]}), 400
+    return flask.jsonify({"rows": dades["rows"], "next": dades["next"]})
+
 @app.route("/meter_values")
 @flask_login.login_required
 def meter_values():
     """
-    Retorna les dades de la taula meter_values en format JSON.
+    Retorna una pàgina de la taula meter_values en format JSON.
     """
-    db = get_db()
-    cursor = db.execute("SELECT * FROM meter_values ORDER BY hora DESC")
-    dades = [dict(row) for row in cursor.fetchall()]
-    return flask.jsonify(dades)
+    return consultar_historial("meter_values")
 
 @app.route("/estats")
 @flask_login.login_required
 def estats():
     """
-    Retorna les dades de la taula estats en format JSON.
+    Retorna una pàgina de la taula estats en format JSON.
     """
-    db = get_db()
-    cursor = db.execute("SELECT * FROM estats ORDER BY hora DESC")
-    dades = [dict(row) for row in cursor.fetchall()]
-    return flask.jsonify(dades)
+    return consultar_historial("estats")
 
 @app.route("/transaccions")
 @flask_login.login_required
 def transaccions():
     """
-    Retorna les dades de la transaccions meter_values en format JSON.
+    Retorna una pàgina de la taula transaccions en format JSON.
     """
-    db = get_db()
-    cursor = db.execute("SELECT * FROM transaccions ORDER BY hora DESC")
-    dades = [dict(row) for row in cursor.fetchall()]
-    return flask.jsonify(dades)
+    return consultar_historial("transaccions")
+
+@app.route("/meter_rollups")
+@flask_login.login_required
+def meter_rollups():
+    """
+    Retorna una pàgina dels agregats dels meterValues (amb el paràmetre resolution: 60, 900 o 3600 segons)
+    en format JSON, per fer gràfiques de períodes llargs.
+    """
+    return consultar_historial("meter_rollups")
 
 # ho executa un thread que es connecta al servidor WS del sistema de control
+def missatges_carregador(charger_id, camps):
+    """
+    Aplica els camps que han canviat a l'estat del carregador i forma els missatges per a la pàgina web
+    (bootNotification si ha canviat l'estat general i statusNotification si han canviat els connectors).
+    El nucli envia els connectors com un array (connectors), que es passa a la pàgina web com a
+    connector<N>, idTag<N> i transactionId<N> per a cada connector N.
+    """
+    estat = estat_carregadors.setdefault(charger_id, {})
+    generals = {camp: valor for camp, valor in camps.items() if camp in CAMPS_GENERALS}
+    estat.update(generals)
+    connectors = camps.get("connectors")
+    if connectors is not None:
+        # es treuen els connectors anteriors, el carregador pot tenir-ne menys que abans
+        for camp in [camp for camp in estat if camp not in CAMPS_GENERALS]:
+            del estat[camp]
+        for num, connector in enumerate(connectors, start=1):
+            estat["connector%d" % num] = connector["status"]
+            estat["idTag%d" % num] = connector["idTag"]
+            estat["transactionId%d" % num] = connector["transactionId"]
+
+    missatges = []
+    if generals:
+        missatge = {"charger": charger_id, "type": "bootNotification"}
+        missatge.update({camp: valor for camp, valor in estat.items() if camp in CAMPS_GENERALS})
+        last_boot_notification_messsage_by_charger[charger_id] = missatge
+        missatges.append(missatge)
+    if connectors is not None:
+        missatge = {"charger": charger_id, "type": "statusNotification"}
+        missatge.update({camp: valor for camp, valor in estat.items() if camp not in CAMPS_GENERALS})
+        last_message_by_charger[charger_id] = missatge
+        missatges.append(missatge)
+    return missatges
+
 def websocket_listener():
     """
     Funcions per la comunicació amb el servidor WS del nucli del sistema de control.
@@ -173,10 +277,46 @@ def websocket_listener():
         """
         try:
             data = json.loads(message)
-            print("[ws] Rebut:", data)
+            if data.get("type") not in ("queryResult", "queryError"):
+                print("[ws] Rebut:", data)
 
             charger_id = data.get("charger")
             message_type = data.get("type")
+            if message_type in ("queryResult", "queryError"):
+                # resposta a una consulta a l'historial -> la rep la petició HTTP que l'espera
+                consulta = consultes_pendents.get(data.get("id"))
+                if consulta is not None:
+                    consulta["dades"] = data
+                    consulta["fet"].set()
+                return
+            if message_type == "stateSnapshot":
+                # estat complet dels carregadors subscrits
+                for carregador in data["chargers"]:
+                    charger_id = carregador.pop("charger")
+                    ultim_seq[charger_id] = carregador.pop("seq")
+                    estat_carregadors[charger_id] = {}
+                    for missatge in missatges_carregador(charger_id, carregador):
+                        socketio.emit('dades_actualitzades', missatge)
+                return
+            if message_type == "stateDelta":
+                if charger_id not in ultim_seq or data["seq"] <= ultim_seq[charger_id]:
+                    return # encara no hi ha l'estat complet del carregador o el canvi ja s'ha aplicat
+                if data["seq"] != ultim_seq[charger_id] + 1:
+                    # s'han perdut canvis del carregador -> demano al nucli els que falten
+                    ws.send("Flask:sync:%s:%d" % (charger_id, ultim_seq[charger_id]))
+                    return
+                ultim_seq[charger_id] = data["seq"]
+                for missatge in missatges_carregador(charger_id, data["fields"]):
+                    socketio.emit('dades_actualitzades', missatge)
+                return
+            if message_type in ("bulkProgress", "bulkResult", "commandAccepted", "commandError", "commandProgress", "commandResult"):
+                # les operacions massives no són d'un carregador en concret -> no es guarden
+                socketio.emit('operacio_massiva', data)
+                return
+            if message_type in ("fleetStatus", "fleetNearest", "ingestStats", "sampleControl"):
+                # l'estat de la flota és de tots els carregadors -> no es guarda
+                socketio.emit('estat_flota', data)
+                return
             if message_type == "bootNotification":
                 last_boot_notification_messsage_by_charger[charger_id] = data
             else:
@@ -205,6 +345,24 @@ def websocket_listener():
         print("WebSocket connectat al sistema en C")
         ws.send("Flask client")
 
+    # Si el nucli s'executa a la mateixa màquina es connecta pel socket de control local,
+    # sense passar pel proxy ni per TLS.
+    if os.path.exists(CONTROL_SOCKET):
+        try:
+            ws_c = ControlSocket(CONTROL_SOCKET)
+        except OSError as e:
+            print("Socket de control no disponible:", e)
+        else:
+            on_open(ws_c)
+            while True:
+                message = ws_c.recv()
+                if not message:
+                    break
+                on_message(ws_c, message)
+            ws_c.connected = False
+            on_close(ws_c, None, "socket de control tancat")
+            return
+
     # Es connecta a l'adreça del nucli del sistema de control.
     ssl_context = ssl.create_default_context()
     ssl_context.check_hostname = False
@@ -236,7 +394,7 @@ def rebre_operacio_des_de_client(data):
     try:
         print("Enviant al sistema en C:", data)
 
-        if ws_c and ws_c.sock and ws_c.sock.connected:
+        if nucli_connectat():
             ws_c.send(data)
         else:
             print("WebSocket al sistema C no connectat.")
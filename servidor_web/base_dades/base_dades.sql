@@ -4,25 +4,42 @@ CREATE TABLE IF NOT EXISTS usuaris (
     contrasenya TEXT NOT NULL 
 );
 
--- Taula de meterValues
+-- Noms dels codis del measurand, les unitats i el context dels meterValues
+CREATE TABLE IF NOT EXISTS measurands (
+    codi INTEGER PRIMARY KEY,
+    nom TEXT NOT NULL
+);
+
+CREATE TABLE IF NOT EXISTS unitats (
+    codi INTEGER PRIMARY KEY,
+    nom TEXT NOT NULL
+);
+
+CREATE TABLE IF NOT EXISTS contexts (
+    codi INTEGER PRIMARY KEY,
+    nom TEXT NOT NULL
+);
+
+-- Taula de meterValues (valor en les unitats canòniques; unit, measurand i context són codis)
 CREATE TABLE IF NOT EXISTS meter_values (
     id INTEGER PRIMARY KEY AUTOINCREMENT,
     charger_id INT NOT NULL,
     connector INT NOT NULL,
     transaccio INT,
     hora TEXT NOT NULL,
-    valor FLOAT NOT NULL,
-    unit TEXT,
-    measurand TEXT,
-    context TEXT
+    valor REAL NOT NULL,
+    unit INT,
+    measurand INT NOT NULL,
+    context INT NOT NULL,
+    ts INTEGER NOT NULL DEFAULT 0
 );
 
 -- Trigger per limitar les dades de meterValues a un màxim de 30
 CREATE TRIGGER max_meter_values BEFORE INSERT ON meter_values
     BEGIN
         DELETE FROM meter_values WHERE
-            hora = (SELECT min(hora) FROM meter_values)
-            and (SELECT COUNT(*) FROM meter_values) = 30;
+            id = (SELECT id FROM meter_values ORDER BY ts, id LIMIT 1)
+            and (SELECT COUNT(*) FROM meter_values) >= 30;
     END;
 
 -- Taula de transaccions
@@ -32,15 +49,16 @@ CREATE TABLE IF NOT EXISTS transaccions (
     estat TEXT NOT NULL,
     connector INT NOT NULL,
     hora TEXT NOT NULL,
-    motiu TEXT NOT NULL
+    motiu TEXT NOT NULL,
+    ts INTEGER NOT NULL DEFAULT 0
 );
 
 -- Trigger per limitar les dades de transaccions a un màxim de 30
 CREATE TRIGGER max_transaccions BEFORE INSERT ON transaccions
     BEGIN
         DELETE FROM transaccions WHERE
-            hora = (SELECT min(hora) FROM transaccions)
-            and (SELECT COUNT(*) FROM transaccions) = 30;
+            id = (SELECT id FROM transaccions ORDER BY ts, id LIMIT 1)
+            and (SELECT COUNT(*) FROM transaccions) >= 30;
     END;
 
 -- Taula d'estats
@@ -50,17 +68,86 @@ CREATE TABLE IF NOT EXISTS estats (
     connector INT NOT NULL,
     estat TEXT NOT NULL,
     hora TEXT NOT NULL,
-    error_code TEXT NOT NULL
+    error_code TEXT NOT NULL,
+    ts INTEGER NOT NULL DEFAULT 0
 );
 
 -- Trigger per limitar les dades d'estats a un màxim de 30
 CREATE TRIGGER max_estats BEFORE INSERT ON estats
     BEGIN
         DELETE FROM estats WHERE
-            hora = (SELECT min(hora) FROM estats)
-            and (SELECT COUNT(*) FROM estats) = 30;
+            id = (SELECT id FROM estats ORDER BY ts, id LIMIT 1)
+            and (SELECT COUNT(*) FROM estats) >= 30;
     END;
 
+-- Índexs de les consultes a l'historial (ts: mil·lisegons des de l'epoch en UTC)
+CREATE INDEX IF NOT EXISTS meter_values_charger_connector_ts ON meter_values(charger_id, connector, ts);
+CREATE INDEX IF NOT EXISTS meter_values_ts ON meter_values(ts);
+CREATE INDEX IF NOT EXISTS estats_charger_connector_ts ON estats(charger_id, connector, ts);
+CREATE INDEX IF NOT EXISTS estats_ts ON estats(ts);
+CREATE INDEX IF NOT EXISTS transaccions_charger_connector_ts ON transaccions(charger_id, connector, ts);
+CREATE INDEX IF NOT EXISTS transaccions_ts ON transaccions(ts);
+
+-- Agregats dels meterValues per intervals d'1 minut, 15 minuts i 1 hora (resolucio en segons)
+-- connector -1: tot el carregador; hora i ts: inici de l'interval; mitjana = suma / mostres
+CREATE TABLE IF NOT EXISTS meter_rollups (
+    id INTEGER PRIMARY KEY,
+    resolucio INT NOT NULL,
+    charger_id INT NOT NULL,
+    connector INT NOT NULL,
+    measurand INT NOT NULL,
+    hora TEXT NOT NULL,
+    ts INTEGER NOT NULL,
+    unit INT,
+    mostres INT NOT NULL,
+    minim REAL NOT NULL,
+    maxim REAL NOT NULL,
+    suma REAL NOT NULL,
+    ultim REAL NOT NULL,
+    hora_ultim INT NOT NULL,
+    energia REAL NOT NULL
+);
+
+CREATE UNIQUE INDEX IF NOT EXISTS meter_rollups_ts ON meter_rollups(resolucio, charger_id, connector, measurand, ts);
+
+-- Límit dels transactionIds reservats pel sistema de control
+CREATE TABLE IF NOT EXISTS tx_id_alloc (
+    id INTEGER PRIMARY KEY CHECK (id = 0),
+    high_water INTEGER NOT NULL
+);
+
+-- Última versió de la llista d'idTags del sistema de control
+CREATE TABLE IF NOT EXISTS auth_list_version (
+    id INTEGER PRIMARY KEY CHECK (id = 0),
+    version INTEGER NOT NULL
+);
+
+-- Interval de mostreig propi de cada carregador, abans que el control de càrrega l'augmenti
+CREATE TABLE IF NOT EXISTS sample_intervals (
+    charger_id INTEGER PRIMARY KEY,
+    interval INTEGER NOT NULL
+);
+
+-- Resum de cada sessió de càrrega (una fila per transacció acabada)
+CREATE TABLE IF NOT EXISTS sessions (
+    id INTEGER PRIMARY KEY AUTOINCREMENT,
+    transaction_id INT NOT NULL,
+    charger_id INT NOT NULL,
+    connector INT NOT NULL,
+    id_tag TEXT NOT NULL,
+    hora_inici TEXT NOT NULL,
+    hora_fi TEXT NOT NULL,
+    durada INT NOT NULL,
+    meter_start INT NOT NULL,
+    meter_stop INT NOT NULL,
+    energia INT NOT NULL,
+    motiu TEXT NOT NULL,
+    ts INTEGER NOT NULL DEFAULT 0
+);
+
+CREATE INDEX IF NOT EXISTS sessions_charger_connector_ts ON sessions(charger_id, connector, ts);
+CREATE INDEX IF NOT EXISTS sessions_ts ON sessions(ts);
+
 -- Insereix dos usuaris
 INSERT INTO usuaris (usuari, contrasenya) VALUES
 ('sergio','7110eda4d09e062aa5e4a390b0a572ac0d2c0220'),
@@ -1,80 +1,67 @@
+// cursor de la pàgina següent de cada taula (null si ja s'han carregat totes les files)
+const seguent = {};
+
 /*
-Mostra les meter_values de la base de dades a la corresponent taula.
+Demana una pàgina de files d'una taula de l'historial i les afegeix a la taula corresponent.
+Si inici és true buida la taula i comença per les files més recents.
 */
-function mostrarDades() {
-    fetch("/meter_values")
+function carregarPagina(ruta, classe, columnes, inici) {
+    const params = new URLSearchParams();
+    if (!inici && seguent[ruta])
+        params.set("cursor", seguent[ruta]);
+
+    fetch(ruta + "?" + params.toString())
         .then(response => response.json())
         .then(data => {
-            const taula = document.querySelector("table.w3-table-all.dades tbody")
-            taula.innerHTML = ""; // esborra el contingut actual
-            data.forEach(fila => {
-                const row = `
-                    <tr>
-                        <td>${fila.charger_id}</td>
-                        <td>${fila.connector}</td>
-                        <td>${fila.transaccio}</td>
-                        <td>${fila.hora}</td>
-                        <td>${fila.valor}</td>
-                        <td>${fila.unit}</td>
-                        <td>${fila.measurand}</td>
-                        <td>${fila.context}</td>
-                    </tr>`;
-                taula.innerHTML += row;
-            });
+            const taula = document.querySelector("table.w3-table-all." + classe + " tbody")
+            if (inici)
+                taula.innerHTML = ""; // esborra el contingut actual
+            // es formen totes les files de la pàgina i s'afegeixen a la taula d'un sol cop
+            const files = (data.rows || []).map(fila =>
+                "<tr>" + columnes.map(columna => `<td>${fila[columna] ?? ""}</td>`).join("") + "</tr>");
+            taula.insertAdjacentHTML("beforeend", files.join(""));
+            seguent[ruta] = data.next || null;
+            document.getElementById("mes_" + classe).style.display = seguent[ruta] ? "inline-block" : "none";
         });
 }
 
+/*
+Mostra les meter_values de la base de dades a la corresponent taula.
+*/
+function mostrarDades(inici) {
+    carregarPagina("/meter_values", "dades",
+        ["charger_id", "connector", "transaccio", "hora", "valor", "unit", "measurand", "context"], inici);
+}
+
 /*
 Mostra els estats de la base de dades a la corresponent taula.
 */
-function mostrarEstats() {
-    fetch("/estats")
-        .then(response => response.json())
-        .then(data => {
-            const taula = document.querySelector("table.w3-table-all.estats tbody")
-            taula.innerHTML = ""; // esborra el contingut actual
-            data.forEach(fila => {
-                const row = `
-                    <tr>
-                        <td>${fila.charger_id}</td>
-                        <td>${fila.estat}</td>
-                        <td>${fila.connector}</td>
-                        <td>${fila.hora}</td>
-                        <td>${fila.error_code}</td>
-                    </tr>`;
-                taula.innerHTML += row;
-            });
-        });
+function mostrarEstats(inici) {
+    carregarPagina("/estats", "estats", ["charger_id", "estat", "connector", "hora", "error_code"], inici);
 }
 
 /*
 Mostra les transaccions de la base de dades a la corresponent taula.
 */
-function mostrarTransaccions() {
-    fetch("/transaccions")
-        .then(response => response.json())
-        .then(data => {
-            const taula = document.querySelector("table.w3-table-all.transaccions tbody")
-            taula.innerHTML = ""; // esborra el contingut actual
-            data.forEach(fila => {
-                const row = `
-                    <tr>
-                        <td>${fila.charger_id}</td>
-                        <td>${fila.connector}</td>
-                        <td>${fila.estat}</td>
-                        <td>${fila.hora}</td>
-                        <td>${fila.motiu}</td>
-                    </tr>`;
-                taula.innerHTML += row;
-            });
-        });
+function mostrarTransaccions(inici) {
+    carregarPagina("/transaccions", "transaccions", ["charger_id", "connector", "estat", "hora", "motiu"], inici);
 }
 
+document.getElementById("mes_dades").addEventListener("click", function() {
+    mostrarDades(false);
+});
+document.getElementById("mes_estats").addEventListener("click", function() {
+    mostrarEstats(false);
+});
+document.getElementById("mes_transaccions").addEventListener("click", function() {
+    mostrarTransaccions(false);
+});
+
 /*
 Es carreguen les dades en carregar la pàgina.
 */
 window.onload = function() {
-    mostrarDades();
-    mostrarEstats();
-    mostrarTransaccions();
-}
\ No newline at end of file
+    mostrarDades(true);
+    mostrarEstats(true);
+    mostrarTransaccions(true);
+}
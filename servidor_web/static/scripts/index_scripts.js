@@ -146,6 +146,11 @@ document.addEventListener("DOMContentLoaded", () => {
         
         if (form.dataset.operation === "getConfiguration") {
           selectedKeys.push(value);
+        } else if (form.dataset.operation === "updateIdTag" && key === "status") {
+          // sense idTagInfo l'idTag s'esborra del magatzem
+          if (value !== "Esborrar") {
+            payload["idTagInfo"] = { status: value };
+          }
         } else if (objectesEnters.includes(key)) {
           payload[key] = parseInt(value, 10);
         } else {
@@ -168,6 +173,113 @@ document.addEventListener("DOMContentLoaded", () => {
   });
 });
 
+/*
+Envia una operació massiva al nucli del sistema.
+*/
+document.getElementById("bulkForm").addEventListener("submit", function (event) {
+  event.preventDefault();
+
+  const operacio = document.getElementById("bulkAction").value;
+  const feina = document.getElementById("bulkJob").value;
+
+  try {
+    JSON.parse(feina);
+  } catch (err) {
+    document.getElementById("bulkProgress").textContent = "La feina no és un JSON vàlid";
+    return;
+  }
+
+  if (socket && socket.connected) {
+    socket.emit("formulari_operacio", "Flask:bulk:" + operacio + ":" + JSON.stringify(JSON.parse(feina)));
+  } else {
+    console.error("WebSocket no disponible");
+  }
+});
+
+/*
+Mostra el progrés i el resultat de les operacions massives.
+*/
+socket.on('operacio_massiva', function(data) {
+  const progres = document.getElementById("bulkProgress");
+  if (data.type === "bulkProgress") {
+    progres.textContent = "Feina " + data.job + " (" + data.action + "): " + data.done + "/" + data.total +
+      " carregadors, " + data.ok + " sense errors, " + data.failed + " amb errors";
+  } else if (data.type === "bulkResult") {
+    progres.textContent = "Feina " + data.job + " (" + data.action + ") acabada: " + JSON.stringify(data.results) +
+      " " + JSON.stringify(data.statuses);
+    console.log("Resultat de la feina " + data.job, data.chargers);
+  }
+});
+
+/*
+Busca el connector més proper en un estat.
+*/
+document.getElementById("fleetForm").addEventListener("submit", function (event) {
+  event.preventDefault();
+
+  const estat = document.getElementById("fleetState").value;
+  const carregador = document.getElementById("fleetCharger").value;
+  const connector = document.getElementById("fleetConnector").value;
+
+  if (socket && socket.connected) {
+    socket.emit("formulari_operacio", "Flask:fleet:nearest:" + estat + ":" + carregador + ":" + connector);
+  } else {
+    console.error("WebSocket no disponible");
+  }
+});
+
+/*
+Demana l'estat de la cua d'entrada dels MeterValues.
+*/
+document.getElementById("ingestButton").addEventListener("click", function () {
+  if (socket && socket.connected) {
+    socket.emit("formulari_operacio", "Flask:fleet:ingest");
+  } else {
+    console.error("WebSocket no disponible");
+  }
+});
+
+/*
+Canvia els límits del MeterValueSampleInterval.
+*/
+document.getElementById("samplingForm").addEventListener("submit", function (event) {
+  event.preventDefault();
+
+  const minim = document.getElementById("samplingMin").value;
+  const maxim = document.getElementById("samplingMax").value;
+
+  if (socket && socket.connected) {
+    socket.emit("formulari_operacio", "Flask:fleet:sampling:" + minim + ":" + maxim);
+  } else {
+    console.error("WebSocket no disponible");
+  }
+});
+
+/*
+Mostra l'estat de la flota i el resultat de les consultes.
+*/
+socket.on('estat_flota', function(data) {
+  if (data.type === "fleetStatus") {
+    const estats = [];
+    for (const estat in data.counts) {
+      if (data.counts[estat] > 0) {
+        estats.push(estat + ": " + data.counts[estat]);
+      }
+    }
+    document.getElementById("fleetStatus").textContent = estats.length ? estats.join(", ") : "Cap connector";
+  } else if (data.type === "fleetNearest") {
+    document.getElementById("fleetNearest").textContent = data.charger === -1 ? "No s'ha trobat cap connector" :
+      "Carregador " + data.charger + ", connector " + data.connector;
+  } else if (data.type === "ingestStats") {
+    document.getElementById("ingestStats").textContent = "A la cua: " + data.depth + " (màxim " + data.maxDepth +
+      "), guardats: " + data.stored + ", directes: " + data.overflows + ", última ràfega: " + data.lastBurst +
+      " valors en " + data.lastBurstMs + " ms, lot màxim: " + data.maxBatchMs + " ms";
+  } else if (data.type === "sampleControl") {
+    document.getElementById("sampleControl").textContent = "MeterValueSampleInterval: " + data.interval + " s (entre " +
+      data.min + " i " + data.max + " s), cua: " + data.depth + ", lot: " + data.batchMs + " ms";
+  }
+});
+
 /*
 Mostra el carregador 1 per defecte en carregar la pàgina.
 */